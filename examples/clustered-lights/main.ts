@@ -0,0 +1,164 @@
+import { Effect, Console } from "effect";
+import { EngineService, EngineServiceLive } from "../../src/engine/Engine";
+import { INSTANCE_FLOATS, LIGHT_FLOATS } from "../../src/ffi/types";
+
+// Clustered lighting benchmark: a floor of tiles under thousands of moving
+// point lights. Prints the GPU frame time once a second.
+
+const LIGHT_COUNT = 4096;
+const TILES = 64;          // per side
+const TILE_SIZE = 1;
+const LIGHT_RADIUS = 2.5;
+
+const WIDTH = 1280;
+const HEIGHT = 720;
+
+// Column-major view looking from eye to target, y up
+function lookAt(eye: number[], target: number[]): Float32Array {
+  const f = normalize(sub(target, eye));
+  const s = normalize(cross(f, [0, 1, 0]));
+  const u = cross(s, f);
+  return new Float32Array([
+    s[0], u[0], -f[0], 0,
+    s[1], u[1], -f[1], 0,
+    s[2], u[2], -f[2], 0,
+    -dot(s, eye), -dot(u, eye), dot(f, eye), 1,
+  ]);
+}
+
+// Column-major perspective for Vulkan clip space: y down, depth 0 to 1
+function perspective(fovY: number, aspect: number, near: number, far: number): Float32Array {
+  const t = 1 / Math.tan(fovY / 2);
+  return new Float32Array([
+    t / aspect, 0, 0, 0,
+    0, -t, 0, 0,
+    0, 0, far / (near - far), -1,
+    0, 0, (near * far) / (near - far), 0,
+  ]);
+}
+
+const sub = (a: number[], b: number[]) => [a[0] - b[0], a[1] - b[1], a[2] - b[2]];
+const dot = (a: number[], b: number[]) => a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+const cross = (a: number[], b: number[]) => [
+  a[1] * b[2] - a[2] * b[1],
+  a[2] * b[0] - a[0] * b[2],
+  a[0] * b[1] - a[1] * b[0],
+];
+const normalize = (a: number[]) => {
+  const length = Math.hypot(a[0], a[1], a[2]);
+  return [a[0] / length, a[1] / length, a[2] / length];
+};
+
+// Tiles lie in the xz plane: the quad's +z normal turned to +y
+function floorInstances(): Float32Array {
+  const data = new Float32Array(TILES * TILES * INSTANCE_FLOATS);
+  const half = (TILES * TILE_SIZE) / 2;
+  for (let z = 0; z < TILES; z++) {
+    for (let x = 0; x < TILES; x++) {
+      const o = (z * TILES + x) * INSTANCE_FLOATS;
+      data.set([
+        TILE_SIZE, 0, 0, 0,
+        0, 0, -TILE_SIZE, 0,
+        0, TILE_SIZE, 0, 0,
+        (x + 0.5) * TILE_SIZE - half, 0, (z + 0.5) * TILE_SIZE - half, 1,
+      ], o);
+      const shade = (x + z) % 2 === 0 ? 0.8 : 0.6;
+      data.set([shade, shade, shade, 1], o + 16);
+    }
+  }
+  return data;
+}
+
+interface LightMotion {
+  x: number;
+  z: number;
+  orbit: number;
+  speed: number;
+  phase: number;
+}
+
+function lightMotions(): LightMotion[] {
+  const half = (TILES * TILE_SIZE) / 2;
+  return Array.from({ length: LIGHT_COUNT }, () => ({
+    x: (Math.random() * 2 - 1) * half,
+    z: (Math.random() * 2 - 1) * half,
+    orbit: 0.5 + Math.random() * 2,
+    speed: 0.5 + Math.random() * 1.5,
+    phase: Math.random() * Math.PI * 2,
+  }));
+}
+
+function writeLights(data: Float32Array, motions: LightMotion[], time: number): void {
+  for (let i = 0; i < motions.length; i++) {
+    const m = motions[i];
+    const angle = m.phase + time * m.speed;
+    const o = i * LIGHT_FLOATS;
+    data[o] = m.x + Math.cos(angle) * m.orbit;
+    data[o + 1] = 0.5;
+    data[o + 2] = m.z + Math.sin(angle) * m.orbit;
+    data[o + 3] = LIGHT_RADIUS;
+  }
+}
+
+const program = Effect.gen(function* () {
+  const engine = yield* EngineService;
+
+  yield* engine.init("HXO - Clustered Lights", WIDTH, HEIGHT);
+  yield* engine.setCamera(
+    lookAt([0, 18, 30], [0, 0, 0]),
+    perspective(Math.PI / 3, WIDTH / HEIGHT, 0.1, 200)
+  );
+  yield* engine.setInstances(floorInstances(), TILES * TILES);
+  yield* engine.setAmbientLight(0.03, 0.03, 0.04);
+
+  const motions = lightMotions();
+  const lights = new Float32Array(LIGHT_COUNT * LIGHT_FLOATS);
+  for (let i = 0; i < LIGHT_COUNT; i++) {
+    const hue = (i * 0.618034) % 1;
+    const o = i * LIGHT_FLOATS;
+    lights[o + 4] = 0.5 + 0.5 * Math.cos(Math.PI * 2 * hue);
+    lights[o + 5] = 0.5 + 0.5 * Math.cos(Math.PI * 2 * (hue - 1 / 3));
+    lights[o + 6] = 0.5 + 0.5 * Math.cos(Math.PI * 2 * (hue + 1 / 3));
+    lights[o + 7] = 2;
+  }
+
+  yield* Console.log(`Rendering ${LIGHT_COUNT} point lights (press ESC or close window to quit)...`);
+
+  const start = performance.now();
+  let lastReport = start;
+  let frames = 0;
+  let gpuTotal = 0;
+
+  while (true) {
+    const shouldQuit = yield* engine.pollEvents();
+    if (shouldQuit) break;
+
+    const now = performance.now();
+    writeLights(lights, motions, (now - start) / 1000);
+    yield* engine.setLights(lights, LIGHT_COUNT);
+
+    yield* engine.renderFrame(0, 0, 0, 1).pipe(
+      Effect.catchAll(() => Effect.void)
+    );
+
+    frames++;
+    gpuTotal += yield* engine.gpuFrameTime();
+    if (now - lastReport >= 1000) {
+      yield* Console.log(
+        `${frames} frames, GPU ${(gpuTotal / frames).toFixed(2)} ms/frame`
+      );
+      lastReport = now;
+      frames = 0;
+      gpuTotal = 0;
+    }
+  }
+
+  yield* engine.shutdown();
+});
+
+const runnable = program.pipe(Effect.provide(EngineServiceLive));
+
+Effect.runPromise(runnable).catch((error) => {
+  console.error("Fatal error:", error);
+  process.exit(1);
+});
@@ -0,0 +1,131 @@
+// CPU culling micro-benchmark: 1M spheres and AABBs against a perspective
+// frustum, per kernel, single-threaded and as jobs on the job system.
+//
+//   cmake -DHXO_BUILD_BENCHMARKS=ON .. && ninja cull_bench && ./cull_bench [count]
+
+#include "cull.h"
+#include "jobs.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace hxo;
+
+static constexpr uint32_t DEFAULT_COUNT = 1000000;
+static constexpr int ITERATIONS = 20;
+
+// Inward planes of a symmetric perspective frustum looking down -Z from the origin
+static Frustum make_frustum(float fov_y, float aspect, float near_z, float far_z) {
+    Frustum f = {};
+    float ty = std::tan(fov_y * 0.5f);
+    float tx = ty * aspect;
+    auto set = [&](int i, float x, float y, float z, float w) {
+        float len = std::sqrt(x * x + y * y + z * z);
+        f.planes[i][0] = x / len;
+        f.planes[i][1] = y / len;
+        f.planes[i][2] = z / len;
+        f.planes[i][3] = w / len;
+    };
+    set(0, 1.0f, 0.0f, -tx, 0.0f);   // left
+    set(1, -1.0f, 0.0f, -tx, 0.0f);  // right
+    set(2, 0.0f, 1.0f, -ty, 0.0f);   // bottom
+    set(3, 0.0f, -1.0f, -ty, 0.0f);  // top
+    set(4, 0.0f, 0.0f, -1.0f, -near_z);
+    set(5, 0.0f, 0.0f, 1.0f, far_z);
+    return f;
+}
+
+template <typename Fn>
+static double time_ms(Fn&& fn) {
+    double best = 1e30;
+    for (int i = 0; i < ITERATIONS; i++) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    uint32_t count = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : DEFAULT_COUNT;
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> pos(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> size(0.25f, 4.0f);
+
+    std::vector<float> x(count), y(count), z(count), r(count);
+    std::vector<float> min_x(count), min_y(count), min_z(count), max_x(count), max_y(count), max_z(count);
+    for (uint32_t i = 0; i < count; i++) {
+        x[i] = pos(rng);
+        y[i] = pos(rng);
+        z[i] = pos(rng);
+        r[i] = size(rng);
+        min_x[i] = x[i] - r[i];
+        min_y[i] = y[i] - r[i];
+        min_z[i] = z[i] - r[i];
+        max_x[i] = x[i] + r[i];
+        max_y[i] = y[i] + r[i];
+        max_z[i] = z[i] + r[i];
+    }
+
+    // Column-major model matrices at a 96-byte stride, like EngineInstance
+    constexpr size_t stride = 24;
+    std::vector<float> models(static_cast<size_t>(count) * stride, 0.0f);
+    for (uint32_t i = 0; i < count; i++) {
+        float* m = &models[i * stride];
+        m[0] = m[5] = m[10] = r[i];
+        m[15] = 1.0f;
+        m[12] = x[i];
+        m[13] = y[i];
+        m[14] = z[i];
+    }
+
+    SphereArrays spheres = {x.data(), y.data(), z.data(), r.data()};
+    AabbArrays boxes = {min_x.data(), min_y.data(), min_z.data(), max_x.data(), max_y.data(), max_z.data()};
+    Frustum frustum = make_frustum(1.0f, 16.0f / 9.0f, 0.1f, 400.0f);
+    frustum.max_distance = 300.0f;
+
+    JobSystem& jobs = job_system();
+    std::vector<uint32_t> out(count);
+    std::vector<float> tx(count), ty(count), tz(count), tr(count);
+
+    uint32_t reference_spheres = cull_spheres(CullKernel::Scalar, frustum, spheres, 0, count, out.data());
+    uint32_t reference_boxes = cull_aabbs(CullKernel::Scalar, frustum, boxes, 0, count, out.data());
+
+    std::printf("%u objects, %u threads, best of %d\n", count, jobs.thread_count(), ITERATIONS);
+    std::printf("visible: %u spheres, %u aabbs\n\n", reference_spheres, reference_boxes);
+    std::printf("%-8s %12s %12s %12s %12s %12s\n", "kernel", "sphere 1t", "sphere mt", "aabb 1t", "aabb mt", "xform 1t");
+
+    int failures = 0;
+    for (CullKernel kernel : {CullKernel::Scalar, CullKernel::Sse2, CullKernel::Avx2, CullKernel::Neon}) {
+        if (!cull_kernel_supported(kernel)) continue;
+
+        uint32_t visible = 0;
+        double sphere_1t = time_ms([&] { visible = cull_spheres(kernel, frustum, spheres, 0, count, out.data()); });
+        failures += visible != reference_spheres;
+        double sphere_mt = time_ms([&] { visible = cull_spheres_parallel(jobs, kernel, frustum, spheres, count, out.data()); });
+        failures += visible != reference_spheres;
+        double aabb_1t = time_ms([&] { visible = cull_aabbs(kernel, frustum, boxes, 0, count, out.data()); });
+        failures += visible != reference_boxes;
+        double aabb_mt = time_ms([&] { visible = cull_aabbs_parallel(jobs, kernel, frustum, boxes, count, out.data()); });
+        failures += visible != reference_boxes;
+        double xform_1t = time_ms([&] {
+            transform_spheres(kernel, models.data(), stride, count, 1.0f, tx.data(), ty.data(), tz.data(), tr.data());
+        });
+        failures += tr[count - 1] != r[count - 1];
+
+        std::printf("%-8s %9.3f ms %9.3f ms %9.3f ms %9.3f ms %9.3f ms\n", cull_kernel_name(kernel),
+                    sphere_1t, sphere_mt, aabb_1t, aabb_mt, xform_1t);
+    }
+
+    if (failures) {
+        std::printf("\n%d kernel results disagreed with the scalar reference\n", failures);
+        return 1;
+    }
+    return 0;
+}
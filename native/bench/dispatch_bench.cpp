@@ -0,0 +1,167 @@
+// Vulkan dispatch micro-benchmark: records the same stream of cheap commands
+// through the loader's exported vk* symbols and through the DeviceDispatch
+// table, and reports the per-call cost of the loader trampoline. Runs headless
+// on the first device with a graphics queue (lavapipe works).
+//
+//   cmake -DHXO_BUILD_BENCHMARKS=ON .. && ninja dispatch_bench && ./dispatch_bench [calls]
+
+#include "vk_dispatch.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace hxo;
+
+static constexpr uint32_t DEFAULT_CALLS = 1000000;
+static constexpr int ITERATIONS = 20;
+
+template <typename Fn>
+static double time_ms(Fn&& fn) {
+    double best = 1e30;
+    for (int i = 0; i < ITERATIONS; i++) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    uint32_t calls = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : DEFAULT_CALLS;
+
+    VkApplicationInfo app_info = {};
+    app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    app_info.pApplicationName = "dispatch_bench";
+    app_info.apiVersion = VK_API_VERSION_1_2;
+
+    VkInstanceCreateInfo instance_info = {};
+    instance_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    instance_info.pApplicationInfo = &app_info;
+
+    VkInstance instance = VK_NULL_HANDLE;
+    if (vkCreateInstance(&instance_info, nullptr, &instance) != VK_SUCCESS) {
+        std::printf("Failed to create Vulkan instance\n");
+        return 1;
+    }
+
+    uint32_t device_count = 0;
+    vkEnumeratePhysicalDevices(instance, &device_count, nullptr);
+    std::vector<VkPhysicalDevice> devices(device_count);
+    vkEnumeratePhysicalDevices(instance, &device_count, devices.data());
+
+    VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+    uint32_t family = UINT32_MAX;
+    for (VkPhysicalDevice device : devices) {
+        uint32_t family_count = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &family_count, nullptr);
+        std::vector<VkQueueFamilyProperties> families(family_count);
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &family_count, families.data());
+        for (uint32_t i = 0; i < family_count; i++) {
+            if (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+                physical_device = device;
+                family = i;
+                break;
+            }
+        }
+        if (physical_device) break;
+    }
+    if (!physical_device) {
+        std::printf("No device with a graphics queue\n");
+        vkDestroyInstance(instance, nullptr);
+        return 1;
+    }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+    float priority = 1.0f;
+    VkDeviceQueueCreateInfo queue_info = {};
+    queue_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queue_info.queueFamilyIndex = family;
+    queue_info.queueCount = 1;
+    queue_info.pQueuePriorities = &priority;
+
+    VkDeviceCreateInfo device_info = {};
+    device_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    device_info.queueCreateInfoCount = 1;
+    device_info.pQueueCreateInfos = &queue_info;
+
+    VkDevice device = VK_NULL_HANDLE;
+    if (vkCreateDevice(physical_device, &device_info, nullptr, &device) != VK_SUCCESS) {
+        std::printf("Failed to create logical device\n");
+        vkDestroyInstance(instance, nullptr);
+        return 1;
+    }
+
+    DeviceDispatch vk;
+    if (!load_device_dispatch(device, vk)) {
+        std::printf("Failed to load device entry points\n");
+        vkDestroyDevice(device, nullptr);
+        vkDestroyInstance(instance, nullptr);
+        return 1;
+    }
+
+    VkCommandPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.queueFamilyIndex = family;
+    VkCommandPool pool = VK_NULL_HANDLE;
+    vkCreateCommandPool(device, &pool_info, nullptr, &pool);
+
+    VkCommandBufferAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.commandPool = pool;
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc_info.commandBufferCount = 1;
+    VkCommandBuffer cmd = VK_NULL_HANDLE;
+    vkAllocateCommandBuffers(device, &alloc_info, &cmd);
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    VkViewport viewport = {0.0f, 0.0f, 1920.0f, 1080.0f, 0.0f, 1.0f};
+    VkRect2D scissor = {{0, 0}, {1920, 1080}};
+
+    // Viewport/scissor pairs only update dynamic state, so the driver side is
+    // about as cheap as a Vulkan call gets and the dispatch cost dominates
+    auto record_loader = [&] {
+        vkResetCommandPool(device, pool, 0);
+        vkBeginCommandBuffer(cmd, &begin_info);
+        for (uint32_t i = 0; i < calls; i += 2) {
+            vkCmdSetViewport(cmd, 0, 1, &viewport);
+            vkCmdSetScissor(cmd, 0, 1, &scissor);
+        }
+        vkEndCommandBuffer(cmd);
+    };
+    auto record_table = [&] {
+        vk.vkResetCommandPool(device, pool, 0);
+        vk.vkBeginCommandBuffer(cmd, &begin_info);
+        for (uint32_t i = 0; i < calls; i += 2) {
+            vk.vkCmdSetViewport(cmd, 0, 1, &viewport);
+            vk.vkCmdSetScissor(cmd, 0, 1, &scissor);
+        }
+        vk.vkEndCommandBuffer(cmd);
+    };
+
+    record_loader();
+    record_table();
+    double loader_ms = time_ms(record_loader);
+    double table_ms = time_ms(record_table);
+    double loader_ns = loader_ms * 1e6 / calls;
+    double table_ns = table_ms * 1e6 / calls;
+
+    std::printf("%s, %u calls, best of %d\n\n", properties.deviceName, calls, ITERATIONS);
+    std::printf("%-8s %12s %12s\n", "path", "total", "per call");
+    std::printf("%-8s %9.3f ms %9.2f ns\n", "loader", loader_ms, loader_ns);
+    std::printf("%-8s %9.3f ms %9.2f ns\n", "table", table_ms, table_ns);
+    std::printf("\nsaved %.2f ns per call (%.1f%%)\n", loader_ns - table_ns,
+                loader_ns > 0.0 ? 100.0 * (loader_ns - table_ns) / loader_ns : 0.0);
+
+    vkDestroyCommandPool(device, pool, nullptr);
+    vkDestroyDevice(device, nullptr);
+    vkDestroyInstance(instance, nullptr);
+    return 0;
+}
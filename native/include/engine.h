@@ -8,6 +8,70 @@
 extern "C" {
 #endif
 
+// Per-instance data for instanced quad rendering (96 bytes, std430 compatible).
+// The quad spans [-0.5, 0.5] in model space X/Y.
+typedef struct EngineInstance {
+    float model[16];       // column-major model matrix
+    float color[4];        // RGBA tint
+    uint32_t texture;      // texture handle, 0 for untextured
+    uint32_t flags;        // ENGINE_INSTANCE_* bits
+    uint32_t reserved[2];
+} EngineInstance;
+
+// EngineInstance flags
+#define ENGINE_INSTANCE_STATIC 1u  // rarely moves: cached in its own shadow layer
+#define ENGINE_INSTANCE_TRANSPARENT 2u  // blended by color alpha while engine_set_oit is on
+
+// A point light for engine_set_lights (32 bytes, std430 compatible). Its
+// contribution falls off smoothly to zero at radius.
+typedef struct EngineLight {
+    float position[3];     // world space
+    float radius;
+    float color[3];        // linear RGB
+    float intensity;
+} EngineLight;
+
+// Scene node transform layout for engine_scene_set_transforms: translation xyz,
+// rotation quaternion xyzw, scale xyz
+#define ENGINE_TRANSFORM_FLOATS 10
+
+// Pass as the instance to engine_scene_bind_instance to unbind
+#define ENGINE_NO_INSTANCE 0xFFFFFFFFu
+
+// Built-in ECS components, registered before any from engine_ecs_register_component
+#define ENGINE_COMPONENT_INSTANCE  0  // EngineInstance, drawn every frame
+#define ENGINE_COMPONENT_TRANSFORM 1  // ENGINE_TRANSFORM_FLOATS floats, composed into the Instance model
+#define ENGINE_INVALID_COMPONENT 0xFFFFFFFFu
+
+// Bulk job kinds for engine_jobs_submit
+#define ENGINE_JOB_MAT4_MULTIPLY      0  // out[i] = a[i] * b[i], 16 floats each
+#define ENGINE_JOB_COMPOSE_TRANSFORMS 1  // out[i] = T * R * S from a[i] (ENGINE_TRANSFORM_FLOATS floats)
+
+// Instance culling modes for engine_set_cull_mode
+#define ENGINE_CULL_NONE 0  // draw every instance
+#define ENGINE_CULL_GPU  1  // frustum/distance cull in a compute pass, draw indirect
+#define ENGINE_CULL_CPU  2  // SIMD cull on worker threads, upload only survivors
+
+// Post-process effects for engine_set_post_effects, applied in this order
+#define ENGINE_POST_TONEMAP     1u  // ACES filmic curve after exposure
+#define ENGINE_POST_COLOR_GRADE 2u  // saturation, then contrast around mid grey
+#define ENGINE_POST_VIGNETTE    4u  // darken toward the corners
+
+// Async task states for engine_task_status
+#define ENGINE_TASK_PENDING 0
+#define ENGINE_TASK_DONE    1
+#define ENGINE_TASK_FAILED  2  // also returned for unknown handles
+
+// GPU to use at the next engine_init, overriding HXO_GPU: "#" and an index in
+// enumeration order ("#1"), a device UUID (hex, dashes optional) or a case-insensitive
+// name substring such as "llvmpipe". NULL or "" picks the highest scoring
+// device: discrete > integrated > virtual > CPU, then features, then VRAM.
+void engine_set_preferred_device(const char* device);
+
+// Every device seen by the last engine_init with its score inputs, the chosen
+// one marked with '*', and why it was chosen. Valid until the next engine_init.
+const char* engine_device_report(void);
+
 // Initialize SDL3 window and Vulkan
 // Returns 0 on success, non-zero on failure
 int engine_init(const char* title, int width, int height);
@@ -28,6 +92,230 @@ int engine_render_frame(float r, float g, float b, float a);
 // Handle window resize (recreates swapchain)
 int engine_handle_resize(void);
 
+// Create a texture from tightly packed RGBA8 (sRGB) pixels, width * height * 4 bytes.
+// The pixels are copied before returning. Level 0 is uploaded and the mip chain
+// generated on the GPU at the next frame. Returns a texture handle, 0 on failure.
+uint32_t engine_create_texture(const void* pixels, uint32_t width, uint32_t height);
+
+// Destroy a texture. The handle is invalid right away; the image is freed once
+// the frames in flight that may sample it have completed.
+void engine_destroy_texture(uint32_t handle);
+
+// True when textures are bound through one descriptor-indexed table, false when
+// the engine falls back to one descriptor set per texture
+bool engine_bindless_enabled(void);
+
+// True when compute work (GPU culling) runs on its own queue alongside
+// rendering, synchronized through timeline semaphores
+bool engine_async_compute_enabled(void);
+
+// True when frames render straight into swapchain images with dynamic
+// rendering, false when they go through a render pass and framebuffers
+bool engine_dynamic_rendering_enabled(void);
+
+// Draw every instance depth-only before shading them, so each covered pixel
+// is shaded once. Worth its second geometry pass on scenes with heavy
+// overdraw and costly fragments. Off by default.
+void engine_set_depth_prepass(bool enabled);
+
+// Multisample the main pass with 2, 4 or 8 samples per pixel, clamped down to
+// what the device supports; 1 turns MSAA off. Samples are resolved into the
+// swapchain image inside the pass and never written to memory. Applies
+// immediately (waiting for the GPU to go idle) and at every engine_init.
+// Forced to 1 while temporal upscaling is on. Returns the sample count in
+// use, 0 before engine_init or on failure, which keeps the previous count.
+uint32_t engine_set_msaa_samples(uint32_t samples);
+
+// Render the scene at a fraction of the window resolution, picked every frame
+// from measured GPU time so frames fit in target_ms, and upscale it into the
+// swapchain image with a filtered blit. Scales are per axis, clamped to
+// [0.25, 1]. target_ms <= 0 turns dynamic resolution off. Returns 0 on
+// success, non-zero before engine_init, when the device lacks GPU timestamps
+// or swapchain blits, or when rebuilding the attachments failed, which keeps
+// the previous settings.
+int engine_set_dynamic_resolution(float min_scale, float max_scale, float target_ms);
+
+// Render the scene at `scale` of the window resolution per axis, clamped to
+// [0.25, 1], with a sub-pixel jitter that changes every frame, and rebuild
+// full resolution from the accumulated frames reprojected along per-pixel
+// motion vectors. Turns MSAA off. Dynamic resolution, when also on, picks
+// the scale instead. scale <= 0 turns it off. Returns 0 on success, non-zero
+// before engine_init, when the device lacks swapchain blits, or when
+// rebuilding the main pass failed, which keeps the previous mode.
+int engine_set_temporal_upscaling(float scale);
+
+// Post-process the main pass result with a combination of ENGINE_POST_*
+// effects, 0 for none. Under a render pass each effect is a subpass reading
+// the previous result through an input attachment, so intermediate results
+// stay on chip; with dynamic rendering one compute pass applies them all.
+// Runs before temporal upscaling and the upscale blit. Applies immediately,
+// waiting for the GPU to go idle. Returns 0 on success, non-zero before
+// engine_init, when the compute pass cannot reach the swapchain (no
+// swapchain blits), or when rebuilding the main pass failed, which keeps the
+// previous effects.
+int engine_set_post_effects(uint32_t effects);
+
+// Effect parameters, taking effect next frame: exposure before tone mapping
+// (default 1), contrast and saturation of the color grade (1 keeps the
+// image as is) and vignette strength in [0, 1] (default 0.5)
+void engine_set_post_params(float exposure, float contrast, float saturation, float vignette);
+
+// Per-axis scale the scene is rendered at, 1 while neither dynamic
+// resolution nor temporal upscaling is on
+float engine_render_scale(void);
+
+// GPU time of the last measured frame in milliseconds, 0 without timestamps
+float engine_gpu_frame_time(void);
+
+// Set camera matrices (column-major 4x4, Vulkan clip space). Either may be NULL
+// to keep the previous value.
+void engine_set_camera(const float* view, const float* proj);
+
+// Replace the instance list drawn each frame. The data is copied. While the list
+// is empty the hello triangle is drawn instead. On the classic texture path,
+// consecutive instances sharing a texture are drawn together, so sort by texture.
+void engine_set_instances(const EngineInstance* instances, uint32_t count);
+
+// Select how instances are culled before drawing (ENGINE_CULL_*).
+// Returns 0 on success, non-zero if the mode is unknown or unsupported.
+int engine_set_cull_mode(int mode);
+
+// Cull instances farther than this from the camera. 0 disables the distance test.
+void engine_set_cull_distance(float distance);
+
+// Replace the point lights. The data is copied. Each frame a compute pass bins
+// them into a 16x9x24 grid of view-frustum clusters, and instance fragments
+// evaluate only the lights of their cluster. While the list is empty
+// instances are drawn unlit.
+void engine_set_lights(const EngineLight* lights, uint32_t count);
+
+// Light added to every lit fragment (linear RGB), 0 by default
+void engine_set_ambient_light(float r, float g, float b);
+
+// Directional light: the direction it travels (world space, any length) and
+// its linear RGB color times intensity. Black, the default, turns it off.
+// It casts cascaded shadows unless engine_set_shadows disabled them.
+void engine_set_directional_light(float dx, float dy, float dz, float r, float g, float b);
+
+// Shadow maps for the directional light: 4 cascades of resolution^2 texels
+// (0 disables, at most 4096) spread over distance units from the camera.
+// Casters flagged ENGINE_INSTANCE_STATIC are cached per cascade and redrawn
+// only when the cascade moves or a static caster in it changes; the rest
+// are drawn over a copy of the cache whenever a caster in the cascade
+// changes. The nearest cascade updates the frame it goes stale, the others
+// on their turn once every far_interval frames. Defaults: 2048, 100, 4.
+void engine_set_shadows(uint32_t resolution, float distance, uint32_t far_interval);
+
+// Weighted blended order-independent transparency for instances flagged
+// ENGINE_INSTANCE_TRANSPARENT, which are otherwise drawn opaque. They are
+// drawn after the opaque ones, in any order and without writing depth, into
+// weighted sums of premultiplied color and of coverage that a full-screen
+// pass then blends over the scene, and cast no shadows. Applies immediately,
+// waiting for the GPU to go idle. Returns 0 on success, non-zero before
+// engine_init or when rebuilding the main pass failed, which keeps the
+// previous mode.
+int engine_set_oit(bool enabled);
+
+// Create a scene node under parent (0 for a root). Returns a node handle, 0 if
+// the parent does not exist.
+uint32_t engine_scene_create_node(uint32_t parent);
+
+// Destroy a node and all of its descendants
+void engine_scene_destroy_node(uint32_t node);
+
+// Move a node under a new parent (0 for root). Fails on cycles.
+bool engine_scene_set_parent(uint32_t node, uint32_t parent);
+
+// Set local transforms of count nodes, ENGINE_TRANSFORM_FLOATS floats per node
+void engine_scene_set_transforms(const uint32_t* nodes, const float* transforms, uint32_t count);
+
+// Write the node's world matrix into instance's model matrix each frame it
+// changes. Moved subtrees are recomposed natively before the frame is uploaded.
+bool engine_scene_bind_instance(uint32_t node, uint32_t instance);
+
+// Copy the node's world matrix (as of the last frame) into out[16]
+bool engine_scene_get_world_matrix(uint32_t node, float* out);
+
+// Entity-component store. Component data lives in 16 KB chunks with one
+// contiguous column per component; column pointers stay valid until shutdown
+// and only need re-querying when engine_ecs_version changes. While any entity
+// has an Instance component, those entities replace the engine_set_instances list.
+
+// Register a component of size bytes. Returns its id (bit in component masks),
+// ENGINE_INVALID_COMPONENT when all 64 are taken.
+uint32_t engine_ecs_register_component(uint32_t size);
+uint32_t engine_ecs_component_size(uint32_t component);
+
+// Create count zeroed entities with the components in mask. Handles are
+// written to out (may be NULL). Returns how many were created.
+uint32_t engine_ecs_create_entities(uint64_t mask, uint32_t count, uint32_t* out);
+
+// Structural changes are queued and applied by engine_ecs_flush (also run at
+// the start of every frame)
+void engine_ecs_destroy_entities(const uint32_t* entities, uint32_t count);
+void engine_ecs_add_components(const uint32_t* entities, uint32_t count, uint64_t mask);
+void engine_ecs_remove_components(const uint32_t* entities, uint32_t count, uint64_t mask);
+void engine_ecs_flush(void);
+
+bool engine_ecs_alive(uint32_t entity);
+uint32_t engine_ecs_version(void);
+
+// Write ids of chunks having every component in mask to chunks (up to max).
+// Returns the total number of matching chunks.
+uint32_t engine_ecs_query(uint64_t mask, uint32_t* chunks, uint32_t max);
+uint32_t engine_ecs_chunk_rows(uint32_t chunk);
+uint32_t engine_ecs_chunk_capacity(uint32_t chunk);
+// Entity handle of each row, chunk capacity entries
+const uint32_t* engine_ecs_chunk_entities(uint32_t chunk);
+// Component column, chunk capacity * component size bytes. NULL if absent.
+void* engine_ecs_chunk_column(uint32_t chunk, uint32_t component);
+// Report writes made through a chunk's column pointers. The engine only
+// recomposes, copies and re-bounds the Instance entities of dirty chunks
+// (or every chunk after a structural change).
+void engine_ecs_mark_dirty(uint32_t chunk);
+
+// Run count items of a bulk job (ENGINE_JOB_*) on the native worker threads.
+// Returns immediately with a job handle, 0 on bad arguments. a, b and out must
+// stay alive and untouched until the job is done.
+uint32_t engine_jobs_submit(int kind, const float* a, const float* b, float* out, uint32_t count);
+
+// True once the job has finished; the handle is released at that point
+bool engine_jobs_done(uint32_t job);
+
+// Help run jobs until this one finishes, then release the handle
+void engine_jobs_wait(uint32_t job);
+
+// Threads running native jobs, including the caller
+uint32_t engine_jobs_thread_count(void);
+
+// Read a whole file on a worker thread. Returns a task handle (0 on failure);
+// the bytes are fetched with engine_task_copy_result once it is done.
+uint32_t engine_task_read_file(const char* path);
+
+// Read raw RGBA8 pixels from a file and upload them as a texture. The task
+// value is the texture handle, reported once the GPU copy has completed.
+uint32_t engine_task_load_texture(const char* path, uint32_t width, uint32_t height);
+
+// Resume tasks whose file reads or GPU work finished. engine_render_frame
+// does this too; call it directly while no frames are rendered.
+void engine_task_poll(void);
+
+// ENGINE_TASK_PENDING, ENGINE_TASK_DONE or ENGINE_TASK_FAILED
+int engine_task_status(uint32_t task);
+
+// Integer result of a finished task (texture handle for loads). A loaded
+// texture belongs to the caller once this returns it; released before that,
+// the task destroys it.
+uint32_t engine_task_value(uint32_t task);
+
+// Byte result of a finished task: size, then copy up to capacity bytes
+uint32_t engine_task_result_size(uint32_t task);
+uint32_t engine_task_copy_result(uint32_t task, void* dst, uint32_t capacity);
+
+// Free the handle; a pending task keeps running and is dropped when done,
+// along with a texture it loaded
+void engine_task_release(uint32_t task);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,163 @@
+// Single-pass downsampler after AMD's FidelityFX SPD: one dispatch writes
+// every level of a mip chain. Each workgroup reduces a 64x64 tile of mip 0
+// to one texel of mip 6, keeping the levels in between in shared memory;
+// the last workgroup to finish, found through an atomic counter, reduces
+// those texels down to mip 12. Included by downsample.comp, which averages
+// 2x2 blocks with subgroup quad operations, and downsample_shared.comp,
+// which goes through shared memory on devices without them.
+
+layout(local_size_x = 256) in;
+
+layout(set = 0, binding = 0) uniform sampler2D source;
+// Levels 1 to 12; elements past the image's last level repeat it
+layout(set = 0, binding = 1, rgba8) uniform writeonly image2D mips[12];
+// Level 6 again, coherent: the last workgroup reads what all others wrote
+layout(set = 0, binding = 2, rgba8) uniform coherent image2D mip6;
+layout(set = 0, binding = 3) buffer Counters { uint counters[]; };
+
+layout(push_constant) uniform Params {
+    vec2 inverseSize;  // 1 / size of mip 0
+    uint mipCount;     // levels to write below mip 0
+    uint workGroups;   // in this dispatch
+    uint counter;      // element of counters this dispatch counts in
+    uint srgb;         // storage views are UNORM, so encode stores by hand
+} params;
+
+shared vec4 tile[16][16];
+shared uint finished_groups;
+#ifndef SUBGROUP_QUADS
+shared vec4 quad_values[256];
+#endif
+
+vec3 srgb_to_linear(vec3 c) {
+    return mix(c / 12.92, pow((c + 0.055) / 1.055, vec3(2.4)), greaterThan(c, vec3(0.04045)));
+}
+
+vec3 linear_to_srgb(vec3 c) {
+    return mix(c * 12.92, 1.055 * pow(c, vec3(1.0 / 2.4)) - 0.055, greaterThan(c, vec3(0.0031308)));
+}
+
+// Thread layout where each quad of invocations covers a 2x2 block, each 16
+// a 4x4 block and each 64 an 8x8 block, tiling 16x16
+uvec2 thread_position(uint index) {
+    uint x = bitfieldInsert(bitfieldExtract(index, 2, 3), index, 0, 1);
+    uint y = bitfieldInsert(bitfieldExtract(index, 3, 3), bitfieldExtract(index, 1, 2), 0, 2);
+    return uvec2(x + 8u * ((index >> 6) & 1u), y + 8u * (index >> 7));
+}
+
+// Average over the 2x2 block of each quad. Must be reached by the whole
+// workgroup: the shared memory path synchronizes it.
+vec4 quad_average(vec4 value) {
+#ifdef SUBGROUP_QUADS
+    value += subgroupQuadSwapHorizontal(value);
+    value += subgroupQuadSwapVertical(value);
+    return 0.25 * value;
+#else
+    barrier();
+    quad_values[gl_LocalInvocationIndex] = value;
+    barrier();
+    uint first = gl_LocalInvocationIndex & ~3u;
+    return 0.25 * (quad_values[first] + quad_values[first + 1u] +
+                   quad_values[first + 2u] + quad_values[first + 3u]);
+#endif
+}
+
+#define STORE_IN_BOUNDS(image) \
+    if (all(lessThan(position, imageSize(image)))) imageStore(image, position, value)
+
+void store(uint level, ivec2 position, vec4 value) {
+    if (params.srgb != 0u) value.rgb = linear_to_srgb(value.rgb);
+    // Constant indices keep the array access uniform
+    switch (level) {
+    case 1u: STORE_IN_BOUNDS(mips[0]); break;
+    case 2u: STORE_IN_BOUNDS(mips[1]); break;
+    case 3u: STORE_IN_BOUNDS(mips[2]); break;
+    case 4u: STORE_IN_BOUNDS(mips[3]); break;
+    case 5u: STORE_IN_BOUNDS(mips[4]); break;
+    case 6u: STORE_IN_BOUNDS(mip6); break;
+    case 7u: STORE_IN_BOUNDS(mips[6]); break;
+    case 8u: STORE_IN_BOUNDS(mips[7]); break;
+    case 9u: STORE_IN_BOUNDS(mips[8]); break;
+    case 10u: STORE_IN_BOUNDS(mips[9]); break;
+    case 11u: STORE_IN_BOUNDS(mips[10]); break;
+    case 12u: STORE_IN_BOUNDS(mips[11]); break;
+    }
+}
+
+// One texel of level 1: the bilinear tap between four texels of mip 0
+vec4 load_source(ivec2 position) {
+    return textureLod(source, (vec2(position) * 2.0 + 1.0) * params.inverseSize, 0.0);
+}
+
+// One texel of level 7 from the four of mip 6 under it
+vec4 load_mip6(ivec2 position) {
+    ivec2 last = imageSize(mip6) - 1;
+    vec4 sum = vec4(0.0);
+    for (int i = 0; i < 4; i++) {
+        vec4 texel = imageLoad(mip6, min(position * 2 + ivec2(i & 1, i >> 1), last));
+        if (params.srgb != 0u) texel.rgb = srgb_to_linear(texel.rgb);
+        sum += texel;
+    }
+    return 0.25 * sum;
+}
+
+// Write levels first_level to first_level + 5 for one 64x64 block of the
+// level above first_level. block is in units of that size.
+void downsample_block(uvec2 block, uint first_level) {
+    uvec2 thread = thread_position(gl_LocalInvocationIndex);
+    bool quad_leader = (gl_LocalInvocationIndex & 3u) == 0u;
+
+    // first_level: 32x32, one texel per thread in each 16x16 quadrant
+    vec4 quadrant[4];
+    for (uint q = 0u; q < 4u; q++) {
+        ivec2 position = ivec2(block * 32u + uvec2(q & 1u, q >> 1) * 16u + thread);
+        quadrant[q] = first_level == 1u ? load_source(position) : load_mip6(position);
+        store(first_level, position, quadrant[q]);
+    }
+    if (first_level + 1u > params.mipCount) return;
+
+    // The next level, 16x16, into shared memory
+    for (uint q = 0u; q < 4u; q++) {
+        vec4 value = quad_average(quadrant[q]);
+        if (quad_leader) {
+            uvec2 texel = (uvec2(q & 1u, q >> 1) * 16u + thread) / 2u;
+            store(first_level + 1u, ivec2(block * 16u + texel), value);
+            tile[texel.y][texel.x] = value;
+        }
+    }
+
+    // The rest from shared memory, halving the tile each time
+    uint level = first_level + 2u;
+    for (uint size = 8u; size > 0u; size /= 2u, level++) {
+        if (level > params.mipCount) return;
+        barrier();
+        bool active = all(lessThan(thread, uvec2(size * 2u)));
+        vec4 value = active ? tile[thread.y][thread.x] : vec4(0.0);
+        value = quad_average(value);
+        barrier();
+        if (active && quad_leader) {
+            uvec2 texel = thread / 2u;
+            store(level, ivec2(block * size + texel), value);
+            tile[texel.y][texel.x] = value;
+        }
+    }
+}
+
+void main() {
+    downsample_block(gl_WorkGroupID.xy, 1u);
+    if (params.mipCount <= 6u) return;
+
+    // Publish this group's texel of mip 6 before counting it
+    memoryBarrierImage();
+    barrier();
+    if (gl_LocalInvocationIndex == 0u) {
+        finished_groups = atomicAdd(counters[params.counter], 1u);
+    }
+    barrier();
+    if (finished_groups != params.workGroups - 1u) return;
+
+    // Every other group is done: ready the counter for the next dispatch
+    // and finish the chain
+    if (gl_LocalInvocationIndex == 0u) counters[params.counter] = 0u;
+    downsample_block(uvec2(0u), 7u);
+}
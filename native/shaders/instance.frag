@@ -0,0 +1,47 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+#extension GL_GOOGLE_include_directive : require
+
+#include "lighting.glsl"
+#include "oit.glsl"
+
+// Bindless texture table, indexed by the handle's 24-bit slot - 1
+layout(set = 0, binding = 0) uniform sampler2D textures[];
+
+layout(location = 0) in vec4 fragColor;
+layout(location = 1) in vec2 fragUV;
+layout(location = 2) flat in uint fragTexture;
+layout(location = 3) in vec4 fragClip;
+layout(location = 4) in vec4 fragPreviousClip;
+layout(location = 5) in vec3 fragWorld;
+layout(location = 6) in vec3 fragNormal;
+
+// Set while temporal upscaling is on, which adds the motion attachment
+layout(constant_id = 0) const bool MOTION_VECTORS = false;
+// Set for transparent instances, which only add to the OIT sums
+layout(constant_id = 1) const bool OIT_ACCUMULATE = false;
+
+layout(location = 0) out vec4 outColor;
+// Screen offset from where the surface was last frame, in UV units
+layout(location = 1) out vec2 outMotion;
+// Weighted color and coverage sum, and the product of (1 - alpha)
+layout(location = 2) out vec4 outAccumulation;
+layout(location = 3) out float outRevealage;
+
+void main() {
+    vec4 color = fragColor;
+    if (fragTexture != 0u) {
+        color *= texture(textures[nonuniformEXT((fragTexture & 0xFFFFFFu) - 1u)], fragUV);
+    }
+    vec3 lit = shade_point_lights(color.rgb, fragWorld, fragNormal, gl_FragCoord);
+    if (OIT_ACCUMULATE) {
+        float view_distance = abs((lighting.view * vec4(fragWorld, 1.0)).z);
+        outAccumulation = vec4(lit * color.a, color.a) * oit_weight(color.a, view_distance);
+        outRevealage = color.a;
+        return;
+    }
+    outColor = vec4(lit, color.a);
+    if (MOTION_VECTORS) {
+        outMotion = (fragClip.xy / fragClip.w - fragPreviousClip.xy / fragPreviousClip.w) * 0.5;
+    }
+}
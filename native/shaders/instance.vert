@@ -0,0 +1,78 @@
+#version 450
+
+struct Instance {
+    mat4 model;
+    vec4 color;
+    uint texture;
+    uint flags;
+    uint reserved1;
+    uint reserved2;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer Instances {
+    Instance instances[];
+};
+
+// Compacted indices of the instances that survived cull.comp
+layout(std430, set = 1, binding = 1) readonly buffer VisibleInstances {
+    uint visibleIndices[];
+};
+
+// Last frame's model matrices, packed like instances, for motion vectors
+layout(std430, set = 1, binding = 2) readonly buffer PreviousModels {
+    mat4 previousModels[];
+};
+
+// Last frame's camera, and the clip-space jitter baked into view_proj
+layout(std140, set = 1, binding = 3) uniform Motion {
+    mat4 previousViewProj;
+    vec2 jitter;
+} motion;
+
+// Set while temporal upscaling is on
+layout(constant_id = 0) const bool MOTION_VECTORS = false;
+
+layout(push_constant) uniform Camera {
+    mat4 view_proj;
+    uint useVisibleList;
+} camera;
+
+// Quad corners, indexed through the quad index buffer
+vec2 corners[4] = vec2[](
+    vec2(-0.5, -0.5),
+    vec2( 0.5, -0.5),
+    vec2( 0.5,  0.5),
+    vec2(-0.5,  0.5)
+);
+
+// Pre-pass and shading pipelines must produce bit-identical depth
+invariant gl_Position;
+
+layout(location = 0) out vec4 fragColor;
+layout(location = 1) out vec2 fragUV;
+layout(location = 2) flat out uint fragTexture;
+// Unjittered clip positions this frame and last frame
+layout(location = 3) out vec4 fragClip;
+layout(location = 4) out vec4 fragPreviousClip;
+// World-space position and quad normal, for lighting
+layout(location = 5) out vec3 fragWorld;
+layout(location = 6) out vec3 fragNormal;
+
+void main() {
+    uint index = camera.useVisibleList != 0u ? visibleIndices[gl_InstanceIndex] : gl_InstanceIndex;
+    Instance inst = instances[index];
+    vec2 corner = corners[gl_VertexIndex];
+    vec4 local = vec4(corner, 0.0, 1.0);
+
+    vec4 world = inst.model * local;
+    gl_Position = camera.view_proj * world;
+    if (MOTION_VECTORS) {
+        fragClip = vec4(gl_Position.xy - motion.jitter * gl_Position.w, gl_Position.zw);
+        fragPreviousClip = motion.previousViewProj * previousModels[index] * local;
+    }
+    fragColor = inst.color;
+    fragUV = corner + 0.5;
+    fragTexture = inst.texture;
+    fragWorld = world.xyz;
+    fragNormal = mat3(inst.model) * vec3(0.0, 0.0, 1.0);
+}
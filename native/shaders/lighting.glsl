@@ -0,0 +1,153 @@
+// Clustered point lights plus a directional light with cascaded shadow
+// maps. The view frustum is split into a grid of clusters:
+// screen tiles, each cut into depth slices spaced logarithmically under a
+// perspective projection and evenly under an orthographic one.
+// light_cull.comp lists the lights touching each cluster, and a fragment
+// shades with its own cluster's list only, so its cost follows the lights
+// near it rather than the lights in the scene. Shared by light_cull.comp,
+// which defines LIGHT_CULL to write the lists, and the instance fragment
+// shaders.
+
+// Must match ShadowCascades::CASCADES in shadow.h
+#define SHADOW_CASCADES 4
+
+#ifdef LIGHT_CULL
+#define LIGHT_LISTS
+#else
+#define LIGHT_LISTS readonly
+#endif
+
+// EngineLight in engine.h
+struct PointLight {
+    vec3 position;  // world space
+    float radius;
+    vec3 color;
+    float intensity;
+};
+
+layout(std430, set = 1, binding = 4) readonly buffer Lights {
+    PointLight lights[];
+};
+
+// Per cluster: first entry in lightIndices and entry count
+layout(std430, set = 1, binding = 5) LIGHT_LISTS buffer LightClusters {
+    uvec2 clusterRanges[];
+};
+
+layout(std430, set = 1, binding = 6) LIGHT_LISTS buffer LightIndices {
+    uint lightIndexCount;  // entries handed out so far this frame
+    uint lightIndices[];
+};
+
+// Clusters assume a projection without skew or rotation, so view x and y
+// each map to NDC through their own row and view z alone gives depth and w
+layout(std140, set = 1, binding = 7) uniform LightParams {
+    mat4 view;
+    vec4 projX;       // P[0][0], P[2][0], P[3][0]
+    vec4 projY;       // P[1][1], P[2][1], P[3][1]
+    vec4 projDepth;   // P[2][2], P[3][2], P[2][3], P[3][3]
+    uvec4 grid;       // clusters along x, y and z; light count
+    vec2 tileScale;   // clusters per render pixel
+    float nearZ;      // view z of the first slice boundary
+    float sliceScale; // slices per unit of slice_distance()
+    vec4 ambient;     // rgb; w is 1 while any light is set
+    uint logarithmic;
+    vec4 sunDirection;  // direction the light travels; w is 1 while shadows are on
+    vec4 sunColor;
+    // World to shadow clip space per cascade, as its layer was last rendered
+    mat4 shadowMatrices[SHADOW_CASCADES];
+    vec4 shadowTexels;  // world-space texel size per cascade
+    vec2 shadowTexel;   // one texel in shadow map UV
+} lighting;
+
+// View z of the surface at an NDC depth
+float view_z(float depth) {
+    vec4 p = lighting.projDepth;
+    return (p.y - depth * p.w) / (depth * p.z - p.x);
+}
+
+float slice_distance(float z) {
+    return lighting.logarithmic != 0u ? log(z / lighting.nearZ) : z - lighting.nearZ;
+}
+
+// View z where slice `slice` begins
+float slice_boundary(uint slice) {
+    float distance = float(slice) / lighting.sliceScale;
+    return lighting.logarithmic != 0u ? lighting.nearZ * exp(distance) : lighting.nearZ + distance;
+}
+
+// View-space point at NDC x, y on the plane at view z
+vec3 view_point(vec2 ndc, float z) {
+    float w = lighting.projDepth.z * z + lighting.projDepth.w;
+    return vec3((ndc.x * w - lighting.projX.y * z - lighting.projX.z) / lighting.projX.x,
+                (ndc.y * w - lighting.projY.y * z - lighting.projY.z) / lighting.projY.x,
+                z);
+}
+
+uint cluster_index(uvec3 cluster) {
+    return cluster.x + lighting.grid.x * (cluster.y + lighting.grid.y * cluster.z);
+}
+
+// Smooth falloff reaching zero at the radius, over inverse square
+float light_attenuation(float distance, float radius) {
+    float ratio = distance / radius;
+    float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+    return window * window / (distance * distance + 1.0);
+}
+
+#ifndef LIGHT_CULL
+// Composite layers of the cascades, compared against on lookup
+layout(set = 1, binding = 8) uniform sampler2DArrayShadow shadowMap;
+
+// Lit fraction of the directional light. The first cascade whose map holds
+// the point answers, from four filtered taps; the point is pushed a texel
+// along the normal against acne. Points past every cascade are lit.
+float sun_shadow(vec3 world, vec3 normal) {
+    if (lighting.sunDirection.w == 0.0) return 1.0;
+
+    for (int c = 0; c < SHADOW_CASCADES; c++) {
+        vec3 offset = world + normal * (1.5 * lighting.shadowTexels[c]);
+        vec4 position = lighting.shadowMatrices[c] * vec4(offset, 1.0);
+        vec2 uv = position.xy * 0.5 + 0.5;
+        vec2 margin = 1.5 * lighting.shadowTexel;
+        if (any(lessThan(uv, margin)) || any(greaterThan(uv, 1.0 - margin)) || position.z > 1.0) continue;
+
+        float lit = 0.0;
+        for (int i = 0; i < 4; i++) {
+            vec2 tap = uv + (vec2(i & 1, i >> 1) - 0.5) * lighting.shadowTexel;
+            lit += texture(shadowMap, vec4(tap, float(c), position.z));
+        }
+        return 0.25 * lit;
+    }
+    return 1.0;
+}
+
+// Ambient, the directional light and the point lights of this fragment's
+// cluster. Quads are lit from either side. Unlit while no light is set.
+vec3 shade_point_lights(vec3 albedo, vec3 world, vec3 normal, vec4 fragCoord) {
+    if (lighting.ambient.w == 0.0) return albedo;
+
+    vec3 n = normalize(normal);
+    vec3 light = lighting.ambient.rgb;
+
+    // Toward the light, which is the side a two-sided quad is lit from
+    float sun_facing = dot(n, -lighting.sunDirection.xyz);
+    vec3 lit_side = sun_facing < 0.0 ? -n : n;
+    light += lighting.sunColor.rgb * (abs(sun_facing) * sun_shadow(world, lit_side));
+
+    if (lighting.grid.w == 0u) return albedo * light;
+    uvec3 last = lighting.grid.xyz - 1u;
+    uvec2 tile = min(uvec2(fragCoord.xy * lighting.tileScale), last.xy);
+    float slice = floor(slice_distance(view_z(fragCoord.z)) * lighting.sliceScale);
+    uvec2 range = clusterRanges[cluster_index(uvec3(tile, uint(clamp(slice, 0.0, float(last.z)))))];
+
+    for (uint i = 0u; i < range.y; i++) {
+        PointLight l = lights[lightIndices[range.x + i]];
+        vec3 to_light = l.position - world;
+        float distance = length(to_light);
+        float facing = distance > 0.0 ? abs(dot(n, to_light / distance)) : 1.0;
+        light += l.color * (l.intensity * facing * light_attenuation(distance, l.radius));
+    }
+    return albedo * light;
+}
+#endif
@@ -0,0 +1,21 @@
+// Weighted blended order-independent transparency (McGuire and Bavoil).
+// Transparent fragments are summed in any order: premultiplied color and
+// coverage scaled by a weight that falls off with distance into one
+// attachment, and the product of their (1 - alpha) into another. The
+// composite divides the sum back into an average color and covers the
+// opaque scene with it by 1 - that product.
+
+// Favors near layers over far ones, staying inside half float range
+float oit_weight(float alpha, float view_distance) {
+    float near = view_distance / 5.0;
+    float far = view_distance / 200.0;
+    return alpha * clamp(10.0 / (1e-5 + near * near + far * far * far * far * far * far), 1e-2, 3e3);
+}
+
+// Straight color and coverage of the transparent layers at a pixel; zero
+// coverage where there are none
+vec4 oit_resolve(vec4 accum, float revealage) {
+    // Enough bright layers can overflow the sums; fall back to their coverage
+    if (any(isinf(accum))) accum = vec4(accum.a);
+    return vec4(accum.rgb / max(accum.a, 1e-5), 1.0 - revealage);
+}
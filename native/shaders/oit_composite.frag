@@ -0,0 +1,19 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "oit.glsl"
+
+// Transparency composite, run as the subpass after the main one. Both sums
+// are read at this pixel straight from their attachments, and the result is
+// blended over the opaque scene by its coverage.
+
+layout(input_attachment_index = 0, set = 0, binding = 0) uniform subpassInput accumulation;
+layout(input_attachment_index = 1, set = 0, binding = 1) uniform subpassInput revealage;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    float reveal = subpassLoad(revealage).r;
+    if (reveal >= 1.0) discard;
+    outColor = oit_resolve(subpassLoad(accumulation), reveal);
+}
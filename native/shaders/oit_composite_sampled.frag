@@ -0,0 +1,20 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "oit.glsl"
+
+// Transparency composite under dynamic rendering, which has no input
+// attachments: a pass of its own over the scene, fetching both sums at this
+// pixel.
+
+layout(set = 0, binding = 0) uniform sampler2D accumulation;
+layout(set = 0, binding = 1) uniform sampler2D revealage;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float reveal = texelFetch(revealage, pixel, 0).r;
+    if (reveal >= 1.0) discard;
+    outColor = oit_resolve(texelFetch(accumulation, pixel, 0), reveal);
+}
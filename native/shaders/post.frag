@@ -0,0 +1,20 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "post_effects.glsl"
+
+// One effect of the post-process chain, run as a subpass of the main render
+// pass. The previous subpass's result is read at this pixel straight from
+// the attachment, which on tilers never leaves tile memory.
+
+layout(constant_id = 0) const uint EFFECT = POST_TONEMAP;
+
+layout(input_attachment_index = 0, set = 0, binding = 0) uniform subpassInput previous;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    vec4 color = subpassLoad(previous);
+    vec2 uv = gl_FragCoord.xy / params.size;
+    outColor = vec4(apply_post_effect(EFFECT, color.rgb, uv), color.a);
+}
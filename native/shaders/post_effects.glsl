@@ -0,0 +1,40 @@
+// Post-process effects shared by the subpass chain (post.frag) and its
+// compute fallback (post.comp). Bits match ENGINE_POST_* in engine.h and
+// give the order effects run in.
+
+const uint POST_TONEMAP = 1u;
+const uint POST_COLOR_GRADE = 2u;
+const uint POST_VIGNETTE = 4u;
+
+layout(push_constant) uniform PostParams {
+    vec2 size;         // rendered region of the target, in pixels
+    float exposure;
+    float contrast;
+    float saturation;
+    float vignette;    // darkening at the corners, 0 to 1
+    uint effects;      // enabled effects, read by the compute fallback
+} params;
+
+// Narkowicz's fit of the ACES filmic curve
+vec3 tonemap(vec3 color) {
+    color *= params.exposure;
+    return clamp((color * (2.51 * color + 0.03)) / (color * (2.43 * color + 0.59) + 0.14), 0.0, 1.0);
+}
+
+vec3 color_grade(vec3 color) {
+    float luma = dot(color, vec3(0.2126, 0.7152, 0.0722));
+    color = mix(vec3(luma), color, params.saturation);
+    return max((color - 0.5) * params.contrast + 0.5, 0.0);
+}
+
+vec3 vignette(vec3 color, vec2 uv) {
+    // 0 at the center, 1 in the corners
+    float distance_to_center = length(uv - 0.5) * 1.41421356;
+    return color * (1.0 - params.vignette * smoothstep(0.4, 1.0, distance_to_center));
+}
+
+vec3 apply_post_effect(uint effect, vec3 color, vec2 uv) {
+    if (effect == POST_TONEMAP) return tonemap(color);
+    if (effect == POST_COLOR_GRADE) return color_grade(color);
+    return vignette(color, uv);
+}
@@ -0,0 +1,23 @@
+#version 450
+
+// Depth-only draw of shadow casters into one cascade layer. Casters are
+// packed per layer as model matrices; each draw covers one layer's range.
+layout(std430, set = 0, binding = 0) readonly buffer ShadowCasters {
+    mat4 models[];
+};
+
+layout(push_constant) uniform Cascade {
+    mat4 viewProj;
+} cascade;
+
+// Quad corners, indexed through the quad index buffer
+vec2 corners[4] = vec2[](
+    vec2(-0.5, -0.5),
+    vec2( 0.5, -0.5),
+    vec2( 0.5,  0.5),
+    vec2(-0.5,  0.5)
+);
+
+void main() {
+    gl_Position = cascade.viewProj * models[gl_InstanceIndex] * vec4(corners[gl_VertexIndex], 0.0, 1.0);
+}
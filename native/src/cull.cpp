@@ -0,0 +1,572 @@
+#include "cull.h"
+#include "jobs.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#define HXO_CULL_X86 1
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define HXO_CULL_AVX2 1
+#define HXO_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define HXO_CULL_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace hxo {
+
+// Smallest slice handed to a worker; below this threading costs more than it saves
+static constexpr uint32_t MIN_PARALLEL_GRAIN = 4096;
+
+static uint32_t write_mask(uint32_t* out, uint32_t base, uint32_t mask) {
+    uint32_t n = 0;
+    while (mask) {
+        out[n++] = base + static_cast<uint32_t>(std::countr_zero(mask));
+        mask &= mask - 1;
+    }
+    return n;
+}
+
+static float max_axis_scale(const float* m) {
+    float sx = m[0] * m[0] + m[1] * m[1] + m[2] * m[2];
+    float sy = m[4] * m[4] + m[5] * m[5] + m[6] * m[6];
+    float sz = m[8] * m[8] + m[9] * m[9] + m[10] * m[10];
+    return std::sqrt(std::max(sx, std::max(sy, sz)));
+}
+
+// Scalar kernels, also used for the tails of the SIMD loops
+
+static bool sphere_visible(const Frustum& f, float x, float y, float z, float r) {
+    for (const auto& p : f.planes) {
+        if (p[0] * x + p[1] * y + p[2] * z + p[3] < -r) return false;
+    }
+    if (f.max_distance > 0.0f) {
+        float dx = x - f.camera[0];
+        float dy = y - f.camera[1];
+        float dz = z - f.camera[2];
+        float reach = f.max_distance + r;
+        if (dx * dx + dy * dy + dz * dz > reach * reach) return false;
+    }
+    return true;
+}
+
+static bool aabb_visible(const Frustum& f, const float* lo, const float* hi) {
+    // Only the corner furthest along each plane normal needs testing
+    for (const auto& p : f.planes) {
+        float x = p[0] >= 0.0f ? hi[0] : lo[0];
+        float y = p[1] >= 0.0f ? hi[1] : lo[1];
+        float z = p[2] >= 0.0f ? hi[2] : lo[2];
+        if (p[0] * x + p[1] * y + p[2] * z + p[3] < 0.0f) return false;
+    }
+    if (f.max_distance > 0.0f) {
+        float d2 = 0.0f;
+        for (int a = 0; a < 3; a++) {
+            float d = std::max(std::max(lo[a] - f.camera[a], f.camera[a] - hi[a]), 0.0f);
+            d2 += d * d;
+        }
+        if (d2 > f.max_distance * f.max_distance) return false;
+    }
+    return true;
+}
+
+static uint32_t cull_spheres_scalar(const Frustum& f, const SphereArrays& s,
+                                    uint32_t begin, uint32_t end, uint32_t* out) {
+    uint32_t n = 0;
+    for (uint32_t i = begin; i < end; i++) {
+        out[n] = i;
+        n += sphere_visible(f, s.x[i], s.y[i], s.z[i], s.radius[i]) ? 1 : 0;
+    }
+    return n;
+}
+
+static uint32_t cull_aabbs_scalar(const Frustum& f, const AabbArrays& b,
+                                  uint32_t begin, uint32_t end, uint32_t* out) {
+    uint32_t n = 0;
+    for (uint32_t i = begin; i < end; i++) {
+        const float lo[3] = {b.min_x[i], b.min_y[i], b.min_z[i]};
+        const float hi[3] = {b.max_x[i], b.max_y[i], b.max_z[i]};
+        out[n] = i;
+        n += aabb_visible(f, lo, hi) ? 1 : 0;
+    }
+    return n;
+}
+
+static void transform_spheres_scalar(const float* models, size_t stride, uint32_t begin, uint32_t end,
+                                     float local_radius, float* x, float* y, float* z, float* radius) {
+    for (uint32_t i = begin; i < end; i++) {
+        const float* m = models + i * stride;
+        x[i] = m[12];
+        y[i] = m[13];
+        z[i] = m[14];
+        radius[i] = local_radius * max_axis_scale(m);
+    }
+}
+
+#if HXO_CULL_X86
+
+static uint32_t cull_spheres_sse2(const Frustum& f, const SphereArrays& s,
+                                  uint32_t begin, uint32_t end, uint32_t* out) {
+    __m128 px[6], py[6], pz[6], pw[6];
+    for (int p = 0; p < 6; p++) {
+        px[p] = _mm_set1_ps(f.planes[p][0]);
+        py[p] = _mm_set1_ps(f.planes[p][1]);
+        pz[p] = _mm_set1_ps(f.planes[p][2]);
+        pw[p] = _mm_set1_ps(f.planes[p][3]);
+    }
+    const bool use_distance = f.max_distance > 0.0f;
+    const __m128 cx = _mm_set1_ps(f.camera[0]);
+    const __m128 cy = _mm_set1_ps(f.camera[1]);
+    const __m128 cz = _mm_set1_ps(f.camera[2]);
+    const __m128 max_distance = _mm_set1_ps(f.max_distance);
+
+    uint32_t n = 0;
+    uint32_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        __m128 x = _mm_loadu_ps(s.x + i);
+        __m128 y = _mm_loadu_ps(s.y + i);
+        __m128 z = _mm_loadu_ps(s.z + i);
+        __m128 r = _mm_loadu_ps(s.radius + i);
+        __m128 neg_r = _mm_sub_ps(_mm_setzero_ps(), r);
+
+        __m128 visible = _mm_cmpge_ps(
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[0], x), _mm_mul_ps(py[0], y)),
+                       _mm_add_ps(_mm_mul_ps(pz[0], z), pw[0])), neg_r);
+        for (int p = 1; p < 6; p++) {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], x), _mm_mul_ps(py[p], y)),
+                                  _mm_add_ps(_mm_mul_ps(pz[p], z), pw[p]));
+            visible = _mm_and_ps(visible, _mm_cmpge_ps(d, neg_r));
+        }
+        if (use_distance) {
+            __m128 dx = _mm_sub_ps(x, cx);
+            __m128 dy = _mm_sub_ps(y, cy);
+            __m128 dz = _mm_sub_ps(z, cz);
+            __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            __m128 reach = _mm_add_ps(max_distance, r);
+            visible = _mm_and_ps(visible, _mm_cmple_ps(d2, _mm_mul_ps(reach, reach)));
+        }
+        n += write_mask(out + n, i, static_cast<uint32_t>(_mm_movemask_ps(visible)));
+    }
+    return n + cull_spheres_scalar(f, s, i, end, out + n);
+}
+
+static uint32_t cull_aabbs_sse2(const Frustum& f, const AabbArrays& b,
+                                uint32_t begin, uint32_t end, uint32_t* out) {
+    const bool use_distance = f.max_distance > 0.0f;
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 max_d2 = _mm_set1_ps(f.max_distance * f.max_distance);
+
+    uint32_t n = 0;
+    uint32_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        const __m128 lo[3] = {_mm_loadu_ps(b.min_x + i), _mm_loadu_ps(b.min_y + i), _mm_loadu_ps(b.min_z + i)};
+        const __m128 hi[3] = {_mm_loadu_ps(b.max_x + i), _mm_loadu_ps(b.max_y + i), _mm_loadu_ps(b.max_z + i)};
+
+        __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const auto& p : f.planes) {
+            // The plane is uniform across lanes, so the corner pick is scalar
+            __m128 d = _mm_set1_ps(p[3]);
+            for (int a = 0; a < 3; a++) {
+                d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(p[a]), p[a] >= 0.0f ? hi[a] : lo[a]));
+            }
+            visible = _mm_and_ps(visible, _mm_cmpge_ps(d, zero));
+        }
+        if (use_distance) {
+            __m128 d2 = zero;
+            for (int a = 0; a < 3; a++) {
+                __m128 c = _mm_set1_ps(f.camera[a]);
+                __m128 d = _mm_max_ps(_mm_max_ps(_mm_sub_ps(lo[a], c), _mm_sub_ps(c, hi[a])), zero);
+                d2 = _mm_add_ps(d2, _mm_mul_ps(d, d));
+            }
+            visible = _mm_and_ps(visible, _mm_cmple_ps(d2, max_d2));
+        }
+        n += write_mask(out + n, i, static_cast<uint32_t>(_mm_movemask_ps(visible)));
+    }
+    return n + cull_aabbs_scalar(f, b, i, end, out + n);
+}
+
+static void transform_spheres_sse2(const float* models, size_t stride, uint32_t count,
+                                   float local_radius, float* x, float* y, float* z, float* radius) {
+    const __m128 local = _mm_set1_ps(local_radius);
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const float* m0 = models + i * stride;
+        const float* m1 = m0 + stride;
+        const float* m2 = m1 + stride;
+        const float* m3 = m2 + stride;
+        auto column = [&](int k) { return _mm_setr_ps(m0[k], m1[k], m2[k], m3[k]); };
+
+        _mm_storeu_ps(x + i, column(12));
+        _mm_storeu_ps(y + i, column(13));
+        _mm_storeu_ps(z + i, column(14));
+
+        __m128 scale2 = _mm_setzero_ps();
+        for (int axis = 0; axis < 3; axis++) {
+            __m128 a = column(axis * 4 + 0);
+            __m128 b = column(axis * 4 + 1);
+            __m128 c = column(axis * 4 + 2);
+            __m128 len2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, a), _mm_mul_ps(b, b)), _mm_mul_ps(c, c));
+            scale2 = _mm_max_ps(scale2, len2);
+        }
+        _mm_storeu_ps(radius + i, _mm_mul_ps(local, _mm_sqrt_ps(scale2)));
+    }
+    transform_spheres_scalar(models, stride, i, count, local_radius, x, y, z, radius);
+}
+
+#endif // HXO_CULL_X86
+
+#if HXO_CULL_AVX2
+
+HXO_TARGET_AVX2
+static uint32_t cull_spheres_avx2(const Frustum& f, const SphereArrays& s,
+                                  uint32_t begin, uint32_t end, uint32_t* out) {
+    __m256 px[6], py[6], pz[6], pw[6];
+    for (int p = 0; p < 6; p++) {
+        px[p] = _mm256_set1_ps(f.planes[p][0]);
+        py[p] = _mm256_set1_ps(f.planes[p][1]);
+        pz[p] = _mm256_set1_ps(f.planes[p][2]);
+        pw[p] = _mm256_set1_ps(f.planes[p][3]);
+    }
+    const bool use_distance = f.max_distance > 0.0f;
+    const __m256 cx = _mm256_set1_ps(f.camera[0]);
+    const __m256 cy = _mm256_set1_ps(f.camera[1]);
+    const __m256 cz = _mm256_set1_ps(f.camera[2]);
+    const __m256 max_distance = _mm256_set1_ps(f.max_distance);
+
+    uint32_t n = 0;
+    uint32_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m256 x = _mm256_loadu_ps(s.x + i);
+        __m256 y = _mm256_loadu_ps(s.y + i);
+        __m256 z = _mm256_loadu_ps(s.z + i);
+        __m256 r = _mm256_loadu_ps(s.radius + i);
+        __m256 neg_r = _mm256_sub_ps(_mm256_setzero_ps(), r);
+
+        __m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            __m256 d = _mm256_fmadd_ps(px[p], x, _mm256_fmadd_ps(py[p], y, _mm256_fmadd_ps(pz[p], z, pw[p])));
+            visible = _mm256_and_ps(visible, _mm256_cmp_ps(d, neg_r, _CMP_GE_OQ));
+        }
+        if (use_distance) {
+            __m256 dx = _mm256_sub_ps(x, cx);
+            __m256 dy = _mm256_sub_ps(y, cy);
+            __m256 dz = _mm256_sub_ps(z, cz);
+            __m256 d2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz)));
+            __m256 reach = _mm256_add_ps(max_distance, r);
+            visible = _mm256_and_ps(visible, _mm256_cmp_ps(d2, _mm256_mul_ps(reach, reach), _CMP_LE_OQ));
+        }
+        n += write_mask(out + n, i, static_cast<uint32_t>(_mm256_movemask_ps(visible)));
+    }
+    return n + cull_spheres_scalar(f, s, i, end, out + n);
+}
+
+HXO_TARGET_AVX2
+static uint32_t cull_aabbs_avx2(const Frustum& f, const AabbArrays& b,
+                                uint32_t begin, uint32_t end, uint32_t* out) {
+    const bool use_distance = f.max_distance > 0.0f;
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 max_d2 = _mm256_set1_ps(f.max_distance * f.max_distance);
+
+    uint32_t n = 0;
+    uint32_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        const __m256 lo[3] = {_mm256_loadu_ps(b.min_x + i), _mm256_loadu_ps(b.min_y + i), _mm256_loadu_ps(b.min_z + i)};
+        const __m256 hi[3] = {_mm256_loadu_ps(b.max_x + i), _mm256_loadu_ps(b.max_y + i), _mm256_loadu_ps(b.max_z + i)};
+
+        __m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (const auto& p : f.planes) {
+            __m256 d = _mm256_set1_ps(p[3]);
+            for (int a = 0; a < 3; a++) {
+                d = _mm256_fmadd_ps(_mm256_set1_ps(p[a]), p[a] >= 0.0f ? hi[a] : lo[a], d);
+            }
+            visible = _mm256_and_ps(visible, _mm256_cmp_ps(d, zero, _CMP_GE_OQ));
+        }
+        if (use_distance) {
+            __m256 d2 = zero;
+            for (int a = 0; a < 3; a++) {
+                __m256 c = _mm256_set1_ps(f.camera[a]);
+                __m256 d = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(lo[a], c), _mm256_sub_ps(c, hi[a])), zero);
+                d2 = _mm256_fmadd_ps(d, d, d2);
+            }
+            visible = _mm256_and_ps(visible, _mm256_cmp_ps(d2, max_d2, _CMP_LE_OQ));
+        }
+        n += write_mask(out + n, i, static_cast<uint32_t>(_mm256_movemask_ps(visible)));
+    }
+    return n + cull_aabbs_scalar(f, b, i, end, out + n);
+}
+
+HXO_TARGET_AVX2
+static void transform_spheres_avx2(const float* models, size_t stride, uint32_t count,
+                                   float local_radius, float* x, float* y, float* z, float* radius) {
+    const __m256 local = _mm256_set1_ps(local_radius);
+    const __m256i lanes = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                             _mm256_set1_epi32(static_cast<int>(stride)));
+    uint32_t i = 0;
+    // Gather offsets are 32-bit, so stay in the vector loop only while they fit
+    for (; i + 8 <= count && stride * 8 < 0x7fffffff; i += 8) {
+        // Lambdas don't inherit the target attribute, so gather inline
+        const float* m = models + i * stride;
+        _mm256_storeu_ps(x + i, _mm256_i32gather_ps(m + 12, lanes, 4));
+        _mm256_storeu_ps(y + i, _mm256_i32gather_ps(m + 13, lanes, 4));
+        _mm256_storeu_ps(z + i, _mm256_i32gather_ps(m + 14, lanes, 4));
+
+        __m256 scale2 = _mm256_setzero_ps();
+        for (int axis = 0; axis < 3; axis++) {
+            __m256 a = _mm256_i32gather_ps(m + axis * 4 + 0, lanes, 4);
+            __m256 b = _mm256_i32gather_ps(m + axis * 4 + 1, lanes, 4);
+            __m256 c = _mm256_i32gather_ps(m + axis * 4 + 2, lanes, 4);
+            scale2 = _mm256_max_ps(scale2, _mm256_fmadd_ps(a, a, _mm256_fmadd_ps(b, b, _mm256_mul_ps(c, c))));
+        }
+        _mm256_storeu_ps(radius + i, _mm256_mul_ps(local, _mm256_sqrt_ps(scale2)));
+    }
+    transform_spheres_scalar(models, stride, i, count, local_radius, x, y, z, radius);
+}
+
+#endif // HXO_CULL_AVX2
+
+#if HXO_CULL_NEON
+
+static uint32_t neon_mask(uint32x4_t visible) {
+    static const uint32_t bits[4] = {1, 2, 4, 8};
+    return vaddvq_u32(vandq_u32(visible, vld1q_u32(bits)));
+}
+
+static uint32_t cull_spheres_neon(const Frustum& f, const SphereArrays& s,
+                                  uint32_t begin, uint32_t end, uint32_t* out) {
+    const bool use_distance = f.max_distance > 0.0f;
+    const float32x4_t cx = vdupq_n_f32(f.camera[0]);
+    const float32x4_t cy = vdupq_n_f32(f.camera[1]);
+    const float32x4_t cz = vdupq_n_f32(f.camera[2]);
+    const float32x4_t max_distance = vdupq_n_f32(f.max_distance);
+
+    uint32_t n = 0;
+    uint32_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        float32x4_t x = vld1q_f32(s.x + i);
+        float32x4_t y = vld1q_f32(s.y + i);
+        float32x4_t z = vld1q_f32(s.z + i);
+        float32x4_t r = vld1q_f32(s.radius + i);
+        float32x4_t neg_r = vnegq_f32(r);
+
+        uint32x4_t visible = vdupq_n_u32(~0u);
+        for (const auto& p : f.planes) {
+            float32x4_t d = vfmaq_n_f32(vfmaq_n_f32(vfmaq_n_f32(vdupq_n_f32(p[3]), z, p[2]), y, p[1]), x, p[0]);
+            visible = vandq_u32(visible, vcgeq_f32(d, neg_r));
+        }
+        if (use_distance) {
+            float32x4_t dx = vsubq_f32(x, cx);
+            float32x4_t dy = vsubq_f32(y, cy);
+            float32x4_t dz = vsubq_f32(z, cz);
+            float32x4_t d2 = vfmaq_f32(vfmaq_f32(vmulq_f32(dz, dz), dy, dy), dx, dx);
+            float32x4_t reach = vaddq_f32(max_distance, r);
+            visible = vandq_u32(visible, vcleq_f32(d2, vmulq_f32(reach, reach)));
+        }
+        n += write_mask(out + n, i, neon_mask(visible));
+    }
+    return n + cull_spheres_scalar(f, s, i, end, out + n);
+}
+
+static uint32_t cull_aabbs_neon(const Frustum& f, const AabbArrays& b,
+                                uint32_t begin, uint32_t end, uint32_t* out) {
+    const bool use_distance = f.max_distance > 0.0f;
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t max_d2 = vdupq_n_f32(f.max_distance * f.max_distance);
+
+    uint32_t n = 0;
+    uint32_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        const float32x4_t lo[3] = {vld1q_f32(b.min_x + i), vld1q_f32(b.min_y + i), vld1q_f32(b.min_z + i)};
+        const float32x4_t hi[3] = {vld1q_f32(b.max_x + i), vld1q_f32(b.max_y + i), vld1q_f32(b.max_z + i)};
+
+        uint32x4_t visible = vdupq_n_u32(~0u);
+        for (const auto& p : f.planes) {
+            float32x4_t d = vdupq_n_f32(p[3]);
+            for (int a = 0; a < 3; a++) {
+                d = vfmaq_n_f32(d, p[a] >= 0.0f ? hi[a] : lo[a], p[a]);
+            }
+            visible = vandq_u32(visible, vcgeq_f32(d, zero));
+        }
+        if (use_distance) {
+            float32x4_t d2 = zero;
+            for (int a = 0; a < 3; a++) {
+                float32x4_t c = vdupq_n_f32(f.camera[a]);
+                float32x4_t d = vmaxq_f32(vmaxq_f32(vsubq_f32(lo[a], c), vsubq_f32(c, hi[a])), zero);
+                d2 = vfmaq_f32(d2, d, d);
+            }
+            visible = vandq_u32(visible, vcleq_f32(d2, max_d2));
+        }
+        n += write_mask(out + n, i, neon_mask(visible));
+    }
+    return n + cull_aabbs_scalar(f, b, i, end, out + n);
+}
+
+static void transform_spheres_neon(const float* models, size_t stride, uint32_t count,
+                                   float local_radius, float* x, float* y, float* z, float* radius) {
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const float* m[4] = {models + i * stride, models + (i + 1) * stride,
+                             models + (i + 2) * stride, models + (i + 3) * stride};
+        auto column = [&](int k) {
+            const float lanes[4] = {m[0][k], m[1][k], m[2][k], m[3][k]};
+            return vld1q_f32(lanes);
+        };
+
+        vst1q_f32(x + i, column(12));
+        vst1q_f32(y + i, column(13));
+        vst1q_f32(z + i, column(14));
+
+        float32x4_t scale2 = vdupq_n_f32(0.0f);
+        for (int axis = 0; axis < 3; axis++) {
+            float32x4_t a = column(axis * 4 + 0);
+            float32x4_t b = column(axis * 4 + 1);
+            float32x4_t c = column(axis * 4 + 2);
+            scale2 = vmaxq_f32(scale2, vfmaq_f32(vfmaq_f32(vmulq_f32(c, c), b, b), a, a));
+        }
+        vst1q_f32(radius + i, vmulq_n_f32(vsqrtq_f32(scale2), local_radius));
+    }
+    transform_spheres_scalar(models, stride, i, count, local_radius, x, y, z, radius);
+}
+
+#endif // HXO_CULL_NEON
+
+bool cull_kernel_supported(CullKernel kernel) {
+    switch (kernel) {
+    case CullKernel::Scalar:
+        return true;
+#if HXO_CULL_X86
+    case CullKernel::Sse2:
+        return true;
+#endif
+#if HXO_CULL_AVX2
+    case CullKernel::Avx2:
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+#if HXO_CULL_NEON
+    case CullKernel::Neon:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+CullKernel cull_default_kernel() {
+    static const CullKernel kernel = [] {
+        for (CullKernel k : {CullKernel::Avx2, CullKernel::Neon, CullKernel::Sse2}) {
+            if (cull_kernel_supported(k)) return k;
+        }
+        return CullKernel::Scalar;
+    }();
+    return kernel;
+}
+
+const char* cull_kernel_name(CullKernel kernel) {
+    switch (kernel) {
+    case CullKernel::Scalar: return "scalar";
+    case CullKernel::Sse2: return "sse2";
+    case CullKernel::Avx2: return "avx2";
+    case CullKernel::Neon: return "neon";
+    }
+    return "unknown";
+}
+
+uint32_t cull_spheres(CullKernel kernel, const Frustum& frustum, const SphereArrays& spheres,
+                      uint32_t begin, uint32_t end, uint32_t* out) {
+    switch (kernel) {
+#if HXO_CULL_X86
+    case CullKernel::Sse2: return cull_spheres_sse2(frustum, spheres, begin, end, out);
+#endif
+#if HXO_CULL_AVX2
+    case CullKernel::Avx2: return cull_spheres_avx2(frustum, spheres, begin, end, out);
+#endif
+#if HXO_CULL_NEON
+    case CullKernel::Neon: return cull_spheres_neon(frustum, spheres, begin, end, out);
+#endif
+    default: return cull_spheres_scalar(frustum, spheres, begin, end, out);
+    }
+}
+
+uint32_t cull_aabbs(CullKernel kernel, const Frustum& frustum, const AabbArrays& boxes,
+                    uint32_t begin, uint32_t end, uint32_t* out) {
+    switch (kernel) {
+#if HXO_CULL_X86
+    case CullKernel::Sse2: return cull_aabbs_sse2(frustum, boxes, begin, end, out);
+#endif
+#if HXO_CULL_AVX2
+    case CullKernel::Avx2: return cull_aabbs_avx2(frustum, boxes, begin, end, out);
+#endif
+#if HXO_CULL_NEON
+    case CullKernel::Neon: return cull_aabbs_neon(frustum, boxes, begin, end, out);
+#endif
+    default: return cull_aabbs_scalar(frustum, boxes, begin, end, out);
+    }
+}
+
+void transform_spheres(CullKernel kernel, const float* models, size_t stride, uint32_t count,
+                       float local_radius, float* x, float* y, float* z, float* radius) {
+    switch (kernel) {
+#if HXO_CULL_X86
+    case CullKernel::Sse2:
+        transform_spheres_sse2(models, stride, count, local_radius, x, y, z, radius);
+        return;
+#endif
+#if HXO_CULL_AVX2
+    case CullKernel::Avx2:
+        transform_spheres_avx2(models, stride, count, local_radius, x, y, z, radius);
+        return;
+#endif
+#if HXO_CULL_NEON
+    case CullKernel::Neon:
+        transform_spheres_neon(models, stride, count, local_radius, x, y, z, radius);
+        return;
+#endif
+    default:
+        transform_spheres_scalar(models, stride, 0, count, local_radius, x, y, z, radius);
+        return;
+    }
+}
+
+// Each chunk writes its survivors at its own offset in out, then the runs are
+// packed down in chunk order so the result stays sorted
+template <typename CullRange>
+static uint32_t cull_parallel(JobSystem& jobs, uint32_t count, uint32_t* out, CullRange cull_range) {
+    if (count == 0) return 0;
+
+    uint32_t grain = std::max(MIN_PARALLEL_GRAIN, count / (jobs.thread_count() * 4));
+    grain = (grain + 7) & ~7u;
+    uint32_t chunks = (count + grain - 1) / grain;
+
+    std::vector<uint32_t> visible(chunks);
+    jobs.parallel_for(count, grain, [&](uint32_t begin, uint32_t end) {
+        visible[begin / grain] = cull_range(begin, end, out + begin);
+    });
+
+    uint32_t n = visible[0];
+    for (uint32_t c = 1; c < chunks; c++) {
+        if (visible[c] > 0) {
+            memmove(out + n, out + c * grain, visible[c] * sizeof(uint32_t));
+        }
+        n += visible[c];
+    }
+    return n;
+}
+
+uint32_t cull_spheres_parallel(JobSystem& jobs, CullKernel kernel, const Frustum& frustum,
+                               const SphereArrays& spheres, uint32_t count, uint32_t* out) {
+    return cull_parallel(jobs, count, out, [&](uint32_t begin, uint32_t end, uint32_t* dst) {
+        return cull_spheres(kernel, frustum, spheres, begin, end, dst);
+    });
+}
+
+uint32_t cull_aabbs_parallel(JobSystem& jobs, CullKernel kernel, const Frustum& frustum,
+                             const AabbArrays& boxes, uint32_t count, uint32_t* out) {
+    return cull_parallel(jobs, count, out, [&](uint32_t begin, uint32_t end, uint32_t* dst) {
+        return cull_aabbs(kernel, frustum, boxes, begin, end, dst);
+    });
+}
+
+} // namespace hxo
@@ -0,0 +1,70 @@
+#ifndef HXO_CULL_H
+#define HXO_CULL_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace hxo {
+
+class JobSystem;
+
+// Planes point inward, normalized (xyz = normal, w = distance). A point p is
+// inside a plane when dot(xyz, p) + w >= 0.
+struct Frustum {
+    float planes[6][4];
+    float camera[3];
+    float max_distance;  // 0 disables the distance test
+};
+
+// Structure-of-arrays bounds, one entry per object
+struct SphereArrays {
+    const float* x;
+    const float* y;
+    const float* z;
+    const float* radius;
+};
+
+struct AabbArrays {
+    const float* min_x;
+    const float* min_y;
+    const float* min_z;
+    const float* max_x;
+    const float* max_y;
+    const float* max_z;
+};
+
+enum class CullKernel {
+    Scalar,
+    Sse2,
+    Avx2,
+    Neon,
+};
+
+// Fastest kernel this CPU supports (checked once at runtime)
+CullKernel cull_default_kernel();
+bool cull_kernel_supported(CullKernel kernel);
+const char* cull_kernel_name(CullKernel kernel);
+
+// Write the indices in [begin, end) of objects inside the frustum to out, in
+// ascending order. out needs room for end - begin entries. Returns the count.
+uint32_t cull_spheres(CullKernel kernel, const Frustum& frustum, const SphereArrays& spheres,
+                      uint32_t begin, uint32_t end, uint32_t* out);
+uint32_t cull_aabbs(CullKernel kernel, const Frustum& frustum, const AabbArrays& boxes,
+                    uint32_t begin, uint32_t end, uint32_t* out);
+
+// Same as above over [0, count), split into jobs. out needs room for
+// count entries and holds the compacted visible indices on return.
+uint32_t cull_spheres_parallel(JobSystem& jobs, CullKernel kernel, const Frustum& frustum,
+                               const SphereArrays& spheres, uint32_t count, uint32_t* out);
+uint32_t cull_aabbs_parallel(JobSystem& jobs, CullKernel kernel, const Frustum& frustum,
+                             const AabbArrays& boxes, uint32_t count, uint32_t* out);
+
+// World-space bounding spheres of objects with a local sphere of local_radius
+// at the origin. models points at the first column-major 4x4 matrix; matrices
+// are stride floats apart. Radius is scaled by the largest axis scale.
+void transform_spheres(CullKernel kernel, const float* models, size_t stride, uint32_t count,
+                       float local_radius, float* x, float* y, float* z, float* radius);
+
+} // namespace hxo
+
+#endif // HXO_CULL_H
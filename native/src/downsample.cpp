@@ -0,0 +1,298 @@
+#include "downsample.h"
+
+#include <SDL3/SDL.h>
+#include <algorithm>
+#include <cstring>
+
+namespace hxo {
+
+namespace {
+
+// Matches Params in shaders/downsample.glsl
+struct PushConstants {
+    float inverse_size[2];
+    uint32_t mip_count;
+    uint32_t work_groups;
+    uint32_t counter;
+    uint32_t srgb;
+};
+
+// Each workgroup covers 64x64 texels of mip 0
+constexpr uint32_t TILE_SIZE = 64;
+
+} // namespace
+
+bool Downsampler::init(VkDevice device, const DeviceDispatch& vk, const VkPhysicalDeviceMemoryProperties& memory,
+                       VkShaderModule shader) {
+    m_device = device;
+    m_vk = &vk;
+    m_memory = memory;
+
+    VkSamplerCreateInfo sampler_info = {};
+    sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_info.magFilter = VK_FILTER_LINEAR;
+    sampler_info.minFilter = VK_FILTER_LINEAR;
+    sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    if (vkCreateSampler(m_device, &sampler_info, nullptr, &m_sampler) != VK_SUCCESS) {
+        SDL_Log("Downsampler: failed to create sampler");
+        return false;
+    }
+
+    // Mip 0, the levels below it, mip 6 again for the last workgroup, and
+    // the counters
+    VkDescriptorSetLayoutBinding bindings[4] = {};
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[1].descriptorCount = MAX_MIPS;
+    bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[2].descriptorCount = 1;
+    bindings[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[3].descriptorCount = 1;
+    for (uint32_t i = 0; i < 4; i++) {
+        bindings[i].binding = i;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = 4;
+    layout_info.pBindings = bindings;
+    if (vkCreateDescriptorSetLayout(m_device, &layout_info, nullptr, &m_set_layout) != VK_SUCCESS) {
+        SDL_Log("Downsampler: failed to create descriptor set layout");
+        return false;
+    }
+
+    VkPushConstantRange push_range = {};
+    push_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    push_range.offset = 0;
+    push_range.size = sizeof(PushConstants);
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {};
+    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_info.setLayoutCount = 1;
+    pipeline_layout_info.pSetLayouts = &m_set_layout;
+    pipeline_layout_info.pushConstantRangeCount = 1;
+    pipeline_layout_info.pPushConstantRanges = &push_range;
+    if (vkCreatePipelineLayout(m_device, &pipeline_layout_info, nullptr, &m_pipeline_layout) != VK_SUCCESS) {
+        SDL_Log("Downsampler: failed to create pipeline layout");
+        return false;
+    }
+
+    VkComputePipelineCreateInfo pipeline_info = {};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_info.stage.module = shader;
+    pipeline_info.stage.pName = "main";
+    pipeline_info.layout = m_pipeline_layout;
+    if (vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &m_pipeline) != VK_SUCCESS) {
+        SDL_Log("Downsampler: failed to create pipeline");
+        return false;
+    }
+    return true;
+}
+
+void Downsampler::destroy() {
+    if (!m_device) return;
+    for (VkImageView view : m_views) vkDestroyImageView(m_device, view, nullptr);
+    m_views.clear();
+    if (m_counters) vkDestroyBuffer(m_device, m_counters, nullptr);
+    if (m_counter_memory) vkFreeMemory(m_device, m_counter_memory, nullptr);
+    if (m_pool) vkDestroyDescriptorPool(m_device, m_pool, nullptr);
+    if (m_pipeline) vkDestroyPipeline(m_device, m_pipeline, nullptr);
+    if (m_pipeline_layout) vkDestroyPipelineLayout(m_device, m_pipeline_layout, nullptr);
+    if (m_set_layout) vkDestroyDescriptorSetLayout(m_device, m_set_layout, nullptr);
+    if (m_sampler) vkDestroySampler(m_device, m_sampler, nullptr);
+    *this = Downsampler();
+}
+
+bool Downsampler::begin(uint32_t count) {
+    for (VkImageView view : m_views) vkDestroyImageView(m_device, view, nullptr);
+    m_views.clear();
+    m_recorded = 0;
+
+    if (count > m_pool_capacity) {
+        uint32_t capacity = std::max(count, m_pool_capacity * 2);
+        if (m_pool) vkDestroyDescriptorPool(m_device, m_pool, nullptr);
+        m_pool = VK_NULL_HANDLE;
+        m_pool_capacity = 0;
+
+        VkDescriptorPoolSize pool_sizes[3] = {};
+        pool_sizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        pool_sizes[0].descriptorCount = capacity;
+        pool_sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        pool_sizes[1].descriptorCount = capacity * (MAX_MIPS + 1);
+        pool_sizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        pool_sizes[2].descriptorCount = capacity;
+
+        VkDescriptorPoolCreateInfo pool_info = {};
+        pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        pool_info.maxSets = capacity;
+        pool_info.poolSizeCount = 3;
+        pool_info.pPoolSizes = pool_sizes;
+        if (vkCreateDescriptorPool(m_device, &pool_info, nullptr, &m_pool) != VK_SUCCESS) {
+            SDL_Log("Downsampler: failed to create descriptor pool");
+            return false;
+        }
+        m_pool_capacity = capacity;
+    } else if (m_pool) {
+        vkResetDescriptorPool(m_device, m_pool, 0);
+    }
+
+    return reserve_counters(count);
+}
+
+bool Downsampler::record(VkCommandBuffer cmd, const Target& target) {
+    if (target.mip_levels < 2) return true;
+    if (m_recorded >= m_pool_capacity || m_recorded >= m_counter_capacity) {
+        SDL_Log("Downsampler: more dispatches than the batch began with");
+        return false;
+    }
+
+    uint32_t mip_count = std::min(target.mip_levels - 1, MAX_MIPS);
+    VkImageView source = create_view(target, target.sampled_format, target.base_mip);
+    if (!source) return false;
+    VkImageView mips[MAX_MIPS] = {};
+    for (uint32_t i = 0; i < mip_count; i++) {
+        mips[i] = create_view(target, STORAGE_FORMAT, target.base_mip + i + 1);
+        if (!mips[i]) return false;
+    }
+
+    VkDescriptorSetAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = m_pool;
+    alloc_info.descriptorSetCount = 1;
+    alloc_info.pSetLayouts = &m_set_layout;
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    if (vkAllocateDescriptorSets(m_device, &alloc_info, &set) != VK_SUCCESS) {
+        SDL_Log("Downsampler: failed to allocate descriptor set");
+        return false;
+    }
+
+    VkDescriptorImageInfo source_info = {m_sampler, source, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    // Elements past the last level repeat it; the shader never stores there
+    VkDescriptorImageInfo mip_infos[MAX_MIPS] = {};
+    for (uint32_t i = 0; i < MAX_MIPS; i++) {
+        mip_infos[i] = {VK_NULL_HANDLE, mips[std::min(i, mip_count - 1)], VK_IMAGE_LAYOUT_GENERAL};
+    }
+    VkDescriptorImageInfo mip6_info = mip_infos[5];
+    VkDescriptorBufferInfo counter_info = {m_counters, 0, VK_WHOLE_SIZE};
+
+    VkWriteDescriptorSet writes[4] = {};
+    for (uint32_t i = 0; i < 4; i++) {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = set;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    }
+    writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    writes[0].pImageInfo = &source_info;
+    writes[1].descriptorCount = MAX_MIPS;
+    writes[1].pImageInfo = mip_infos;
+    writes[2].pImageInfo = &mip6_info;
+    writes[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    writes[3].pBufferInfo = &counter_info;
+    vkUpdateDescriptorSets(m_device, 4, writes, 0, nullptr);
+
+    uint32_t groups_x = (target.width + TILE_SIZE - 1) / TILE_SIZE;
+    uint32_t groups_y = (target.height + TILE_SIZE - 1) / TILE_SIZE;
+
+    PushConstants push = {};
+    push.inverse_size[0] = 1.0f / static_cast<float>(target.width);
+    push.inverse_size[1] = 1.0f / static_cast<float>(target.height);
+    push.mip_count = mip_count;
+    push.work_groups = groups_x * groups_y;
+    push.counter = m_recorded++;
+    push.srgb = target.srgb ? 1u : 0u;
+
+    m_vk->vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+    m_vk->vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline_layout, 0, 1, &set, 0, nullptr);
+    m_vk->vkCmdPushConstants(cmd, m_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+    m_vk->vkCmdDispatch(cmd, groups_x, groups_y, 1);
+    return true;
+}
+
+VkImageView Downsampler::create_view(const Target& target, VkFormat format, uint32_t mip) {
+    // The image has both usages, which its formats may support only one each
+    VkImageViewUsageCreateInfo usage_info = {};
+    usage_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_USAGE_CREATE_INFO;
+    usage_info.usage = mip == 0 ? VK_IMAGE_USAGE_SAMPLED_BIT : VK_IMAGE_USAGE_STORAGE_BIT;
+
+    VkImageViewCreateInfo view_info = {};
+    view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_info.pNext = &usage_info;
+    view_info.image = target.image;
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format = format;
+    view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    view_info.subresourceRange.baseMipLevel = mip;
+    view_info.subresourceRange.levelCount = 1;
+    view_info.subresourceRange.baseArrayLayer = 0;
+    view_info.subresourceRange.layerCount = 1;
+
+    VkImageView view = VK_NULL_HANDLE;
+    if (vkCreateImageView(m_device, &view_info, nullptr, &view) != VK_SUCCESS) {
+        SDL_Log("Downsampler: failed to create mip view");
+        return VK_NULL_HANDLE;
+    }
+    m_views.push_back(view);
+    return view;
+}
+
+bool Downsampler::reserve_counters(uint32_t count) {
+    if (count <= m_counter_capacity) return true;
+    if (m_counters) vkDestroyBuffer(m_device, m_counters, nullptr);
+    if (m_counter_memory) vkFreeMemory(m_device, m_counter_memory, nullptr);
+    m_counters = VK_NULL_HANDLE;
+    m_counter_memory = VK_NULL_HANDLE;
+    m_counter_capacity = 0;
+
+    VkBufferCreateInfo buffer_info = {};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = sizeof(uint32_t) * count;
+    buffer_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(m_device, &buffer_info, nullptr, &m_counters) != VK_SUCCESS) {
+        SDL_Log("Downsampler: failed to create counter buffer");
+        return false;
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(m_device, m_counters, &requirements);
+
+    // Host visible only so the counters can start at zero without a fill
+    VkMemoryAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloc_info.allocationSize = requirements.size;
+    alloc_info.memoryTypeIndex = find_memory_type(requirements.memoryTypeBits,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    void* mapped = nullptr;
+    if (alloc_info.memoryTypeIndex == UINT32_MAX ||
+        vkAllocateMemory(m_device, &alloc_info, nullptr, &m_counter_memory) != VK_SUCCESS ||
+        vkMapMemory(m_device, m_counter_memory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS) {
+        SDL_Log("Downsampler: failed to allocate counter memory");
+        return false;
+    }
+    memset(mapped, 0, static_cast<size_t>(requirements.size));
+    vkUnmapMemory(m_device, m_counter_memory);
+    vkBindBufferMemory(m_device, m_counters, m_counter_memory, 0);
+
+    m_counter_capacity = count;
+    return true;
+}
+
+uint32_t Downsampler::find_memory_type(uint32_t type_bits, VkMemoryPropertyFlags properties) const {
+    for (uint32_t i = 0; i < m_memory.memoryTypeCount; i++) {
+        if ((type_bits & (1u << i)) && (m_memory.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+    return UINT32_MAX;
+}
+
+} // namespace hxo
@@ -0,0 +1,82 @@
+#ifndef HXO_DOWNSAMPLE_H
+#define HXO_DOWNSAMPLE_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+
+#include "vk_dispatch.h"
+
+namespace hxo {
+
+// Mip chains in one compute dispatch each, after AMD's single pass
+// downsampler (see shaders/downsample.glsl). A blit chain needs a barrier
+// between every pair of levels; this needs one before the dispatch and one
+// after it, however many images a batch covers.
+class Downsampler {
+public:
+    // Levels one dispatch writes below its source, enough for 4096x4096;
+    // deeper chains take another dispatch from the last level written
+    static constexpr uint32_t MAX_MIPS = 12;
+    // Levels below mip 0 are written through views of this format
+    static constexpr VkFormat STORAGE_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+
+    struct Target {
+        VkImage image = VK_NULL_HANDLE;
+        // The source level is read through a view of this format. When it is
+        // not STORAGE_FORMAT the image needs MUTABLE_FORMAT and EXTENDED_USAGE.
+        VkFormat sampled_format = STORAGE_FORMAT;
+        // Encode stores as sRGB, for sampled formats that decode on read
+        bool srgb = false;
+        uint32_t base_mip = 0;  // source level; width and height are its size
+        uint32_t width = 0;
+        uint32_t height = 0;
+        // From base_mip down, including it; the first MAX_MIPS below it are written
+        uint32_t mip_levels = 1;
+    };
+
+    // shader is downsample.comp when compute shaders support subgroup quad
+    // operations, downsample_shared.comp otherwise
+    bool init(VkDevice device, const DeviceDispatch& vk, const VkPhysicalDeviceMemoryProperties& memory,
+              VkShaderModule shader);
+    // The device must be idle
+    void destroy();
+
+    // Start a batch of up to count dispatches. Frees the views and sets of
+    // the last batch, which the GPU must have finished.
+    bool begin(uint32_t count);
+    // Write up to MAX_MIPS levels below target's base_mip. The base must be
+    // SHADER_READ_ONLY and the rest GENERAL; the writes are compute shader
+    // storage writes.
+    bool record(VkCommandBuffer cmd, const Target& target);
+
+private:
+    VkImageView create_view(const Target& target, VkFormat format, uint32_t mip);
+    bool reserve_counters(uint32_t count);
+    uint32_t find_memory_type(uint32_t type_bits, VkMemoryPropertyFlags properties) const;
+
+    VkDevice m_device = VK_NULL_HANDLE;
+    const DeviceDispatch* m_vk = nullptr;
+    VkPhysicalDeviceMemoryProperties m_memory = {};
+
+    VkSampler m_sampler = VK_NULL_HANDLE;
+    VkDescriptorSetLayout m_set_layout = VK_NULL_HANDLE;
+    VkPipelineLayout m_pipeline_layout = VK_NULL_HANDLE;
+    VkPipeline m_pipeline = VK_NULL_HANDLE;
+
+    // Sized for the largest batch so far, reset by begin()
+    VkDescriptorPool m_pool = VK_NULL_HANDLE;
+    uint32_t m_pool_capacity = 0;
+    std::vector<VkImageView> m_views;
+
+    // One counter per dispatch in a batch. The last workgroup of each
+    // dispatch sets its counter back to zero.
+    VkBuffer m_counters = VK_NULL_HANDLE;
+    VkDeviceMemory m_counter_memory = VK_NULL_HANDLE;
+    uint32_t m_counter_capacity = 0;
+    uint32_t m_recorded = 0;
+};
+
+} // namespace hxo
+
+#endif // HXO_DOWNSAMPLE_H
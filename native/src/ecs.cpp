@@ -0,0 +1,313 @@
+#include "ecs.h"
+#include <bit>
+#include <cstring>
+#include <new>
+
+namespace hxo {
+
+static constexpr uint32_t CACHE_LINE = 64;
+static constexpr uint32_t INDEX_BITS = 24;
+static constexpr uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+// Index + 1 must fit in the handle's index bits
+static constexpr uint32_t MAX_ENTITIES = INDEX_MASK - 1;
+static constexpr uint32_t NO_CHUNK = 0xFFFFFFFFu;
+
+static uint32_t align_up(uint32_t value, uint32_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static uint32_t make_handle(uint32_t index, uint8_t generation) {
+    return (static_cast<uint32_t>(generation) << INDEX_BITS) | (index + 1);
+}
+
+// Calls fn(component) for each set bit of mask
+template <typename Fn>
+static void for_each_component(uint64_t mask, Fn&& fn) {
+    while (mask) {
+        fn(static_cast<uint32_t>(std::countr_zero(mask)));
+        mask &= mask - 1;
+    }
+}
+
+void EcsWorld::ChunkDeleter::operator()(uint8_t* data) const {
+    ::operator delete[](data, std::align_val_t(CACHE_LINE));
+}
+
+uint32_t EcsWorld::register_component(uint32_t size) {
+    if (size == 0 || size > CHUNK_BYTES / 2 || m_sizes.size() >= MAX_COMPONENTS) {
+        return INVALID_COMPONENT;
+    }
+    m_sizes.push_back(size);
+    return static_cast<uint32_t>(m_sizes.size() - 1);
+}
+
+uint32_t EcsWorld::component_size(uint32_t component) const {
+    return component < m_sizes.size() ? m_sizes[component] : 0;
+}
+
+bool EcsWorld::alive(uint32_t entity) const {
+    uint32_t slot = entity & INDEX_MASK;
+    if (slot == 0 || slot > m_live.size()) return false;
+    uint32_t index = slot - 1;
+    return m_live[index] && m_generations[index] == (entity >> INDEX_BITS);
+}
+
+uint8_t* EcsWorld::column(const Chunk& chunk, uint32_t component) const {
+    return chunk.data.get() + m_archetypes[chunk.archetype].offsets[component];
+}
+
+// Columns start on cache lines, the entity column first. Capacity is the most
+// rows whose padded columns still fit in one chunk.
+uint32_t EcsWorld::find_or_create_archetype(uint64_t mask) {
+    for (uint32_t i = 0; i < m_archetypes.size(); i++) {
+        if (m_archetypes[i].mask == mask) return i;
+    }
+
+    Archetype archetype;
+    archetype.mask = mask;
+    uint32_t row_bytes = sizeof(uint32_t);
+    for_each_component(mask, [&](uint32_t c) { row_bytes += m_sizes[c]; });
+
+    for (uint32_t capacity = CHUNK_BYTES / row_bytes; capacity > 0; capacity--) {
+        uint32_t offset = align_up(capacity * sizeof(uint32_t), CACHE_LINE);
+        for_each_component(mask, [&](uint32_t c) {
+            archetype.offsets[c] = offset;
+            offset = align_up(offset + capacity * m_sizes[c], CACHE_LINE);
+        });
+        if (offset <= CHUNK_BYTES) {
+            archetype.capacity = capacity;
+            break;
+        }
+    }
+    if (archetype.capacity == 0) return NO_CHUNK;
+
+    m_archetypes.push_back(std::move(archetype));
+    return static_cast<uint32_t>(m_archetypes.size() - 1);
+}
+
+uint32_t EcsWorld::allocate_chunk(uint32_t archetype) {
+    uint32_t id;
+    if (!m_free_chunks.empty()) {
+        id = m_free_chunks.back();
+        m_free_chunks.pop_back();
+    } else {
+        Chunk chunk;
+        chunk.data.reset(static_cast<uint8_t*>(::operator new[](CHUNK_BYTES, std::align_val_t(CACHE_LINE))));
+        m_chunks.push_back(std::move(chunk));
+        id = static_cast<uint32_t>(m_chunks.size() - 1);
+    }
+    m_chunks[id].archetype = archetype;
+    m_chunks[id].rows = 0;
+    m_chunks[id].dirty = true;
+    m_archetypes[archetype].chunks.push_back(id);
+    return id;
+}
+
+EcsWorld::Location EcsWorld::append_row(uint32_t archetype, uint32_t entity) {
+    Archetype& arch = m_archetypes[archetype];
+    uint32_t id = arch.chunks.empty() ? NO_CHUNK : arch.chunks.back();
+    if (id == NO_CHUNK || m_chunks[id].rows == arch.capacity) {
+        id = allocate_chunk(archetype);
+    }
+
+    Chunk& chunk = m_chunks[id];
+    uint32_t row = chunk.rows++;
+    chunk.dirty = true;
+    reinterpret_cast<uint32_t*>(chunk.data.get())[row] = entity;
+    for_each_component(arch.mask, [&](uint32_t c) {
+        memset(column(chunk, c) + row * m_sizes[c], 0, m_sizes[c]);
+    });
+    return {id, row};
+}
+
+// Fill the hole with the archetype's last row so chunks stay dense
+void EcsWorld::remove_row(Location location) {
+    Chunk& chunk = m_chunks[location.chunk];
+    Archetype& arch = m_archetypes[chunk.archetype];
+    uint32_t last_id = arch.chunks.back();
+    Chunk& last = m_chunks[last_id];
+    uint32_t last_row = last.rows - 1;
+    chunk.dirty = true;
+    last.dirty = true;
+
+    if (location.chunk != last_id || location.row != last_row) {
+        auto* entities = reinterpret_cast<uint32_t*>(chunk.data.get());
+        auto* last_entities = reinterpret_cast<uint32_t*>(last.data.get());
+        uint32_t moved = last_entities[last_row];
+        entities[location.row] = moved;
+        for_each_component(arch.mask, [&](uint32_t c) {
+            memcpy(column(chunk, c) + location.row * m_sizes[c],
+                   column(last, c) + last_row * m_sizes[c], m_sizes[c]);
+        });
+        m_locations[(moved & INDEX_MASK) - 1] = location;
+    }
+
+    if (--last.rows == 0) {
+        arch.chunks.pop_back();
+        m_free_chunks.push_back(last_id);
+    }
+}
+
+void EcsWorld::move_entity(uint32_t entity, uint64_t mask) {
+    uint32_t index = (entity & INDEX_MASK) - 1;
+    Location from = m_locations[index];
+    uint64_t old_mask = m_archetypes[m_chunks[from.chunk].archetype].mask;
+    if (old_mask == mask) return;
+
+    uint32_t archetype = find_or_create_archetype(mask);
+    if (archetype == NO_CHUNK) return;
+
+    Location to = append_row(archetype, entity);
+    const Chunk& src = m_chunks[from.chunk];
+    const Chunk& dst = m_chunks[to.chunk];
+    for_each_component(old_mask & mask, [&](uint32_t c) {
+        memcpy(column(dst, c) + to.row * m_sizes[c], column(src, c) + from.row * m_sizes[c], m_sizes[c]);
+    });
+
+    m_locations[index] = to;
+    remove_row(from);
+}
+
+void EcsWorld::release_entity(uint32_t entity) {
+    uint32_t index = (entity & INDEX_MASK) - 1;
+    remove_row(m_locations[index]);
+    m_live[index] = 0;
+    m_generations[index]++;
+    m_free_entities.push_back(index);
+}
+
+uint32_t EcsWorld::create(uint64_t mask, uint32_t count, uint32_t* out) {
+    if (count == 0) return 0;
+    if (m_sizes.size() < 64 && (mask >> m_sizes.size()) != 0) return 0;
+    uint32_t archetype = find_or_create_archetype(mask);
+    if (archetype == NO_CHUNK) return 0;
+
+    uint32_t created = 0;
+    for (; created < count; created++) {
+        uint32_t index;
+        if (!m_free_entities.empty()) {
+            index = m_free_entities.back();
+            m_free_entities.pop_back();
+        } else if (m_live.size() < MAX_ENTITIES) {
+            index = static_cast<uint32_t>(m_live.size());
+            m_live.push_back(0);
+            m_generations.push_back(0);
+            m_locations.push_back({});
+        } else {
+            break;
+        }
+
+        uint32_t handle = make_handle(index, m_generations[index]);
+        m_live[index] = 1;
+        m_locations[index] = append_row(archetype, handle);
+        if (out) out[created] = handle;
+    }
+    m_version++;
+    return created;
+}
+
+void EcsWorld::destroy(const uint32_t* entities, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        m_ops.push_back({entities[i], OpKind::Destroy, 0});
+    }
+}
+
+void EcsWorld::add_components(const uint32_t* entities, uint32_t count, uint64_t mask) {
+    for (uint32_t i = 0; i < count; i++) {
+        m_ops.push_back({entities[i], OpKind::Add, mask});
+    }
+}
+
+void EcsWorld::remove_components(const uint32_t* entities, uint32_t count, uint64_t mask) {
+    for (uint32_t i = 0; i < count; i++) {
+        m_ops.push_back({entities[i], OpKind::Remove, mask});
+    }
+}
+
+// Ops apply in submission order; ones naming dead entities or unregistered
+// components are dropped
+void EcsWorld::flush() {
+    if (m_ops.empty()) return;
+
+    uint64_t registered = m_sizes.size() >= 64 ? ~0ull : (1ull << m_sizes.size()) - 1;
+    for (const Op& op : m_ops) {
+        if (!alive(op.entity)) continue;
+        if (op.kind == OpKind::Destroy) {
+            release_entity(op.entity);
+            continue;
+        }
+        if (op.mask & ~registered) continue;
+
+        Location location = m_locations[(op.entity & INDEX_MASK) - 1];
+        uint64_t mask = m_archetypes[m_chunks[location.chunk].archetype].mask;
+        move_entity(op.entity, op.kind == OpKind::Add ? mask | op.mask : mask & ~op.mask);
+    }
+    m_ops.clear();
+    m_version++;
+}
+
+void* EcsWorld::component(uint32_t entity, uint32_t component) {
+    if (!alive(entity) || component >= MAX_COMPONENTS) return nullptr;
+    Location location = m_locations[(entity & INDEX_MASK) - 1];
+    Chunk& chunk = m_chunks[location.chunk];
+    if (!(m_archetypes[chunk.archetype].mask & (1ull << component))) return nullptr;
+    chunk.dirty = true;
+    return column(chunk, component) + location.row * m_sizes[component];
+}
+
+void EcsWorld::mark_dirty(uint32_t chunk) {
+    if (chunk < m_chunks.size()) m_chunks[chunk].dirty = true;
+}
+
+bool EcsWorld::chunk_dirty(uint32_t chunk) const {
+    return chunk < m_chunks.size() && m_chunks[chunk].dirty;
+}
+
+void EcsWorld::clear_dirty(uint32_t chunk) {
+    if (chunk < m_chunks.size()) m_chunks[chunk].dirty = false;
+}
+
+uint32_t EcsWorld::query(uint64_t mask, uint32_t* out, uint32_t max) const {
+    uint32_t n = 0;
+    for (const Archetype& arch : m_archetypes) {
+        if ((arch.mask & mask) != mask) continue;
+        for (uint32_t id : arch.chunks) {
+            if (out && n < max) out[n] = id;
+            n++;
+        }
+    }
+    return n;
+}
+
+uint32_t EcsWorld::count(uint64_t mask) const {
+    uint32_t n = 0;
+    for (const Archetype& arch : m_archetypes) {
+        if ((arch.mask & mask) != mask) continue;
+        for (uint32_t id : arch.chunks) {
+            n += m_chunks[id].rows;
+        }
+    }
+    return n;
+}
+
+uint32_t EcsWorld::chunk_rows(uint32_t chunk) const {
+    return chunk < m_chunks.size() ? m_chunks[chunk].rows : 0;
+}
+
+uint32_t EcsWorld::chunk_capacity(uint32_t chunk) const {
+    return chunk < m_chunks.size() ? m_archetypes[m_chunks[chunk].archetype].capacity : 0;
+}
+
+const uint32_t* EcsWorld::chunk_entities(uint32_t chunk) const {
+    if (chunk >= m_chunks.size()) return nullptr;
+    return reinterpret_cast<const uint32_t*>(m_chunks[chunk].data.get());
+}
+
+void* EcsWorld::chunk_column(uint32_t chunk, uint32_t component) const {
+    if (chunk >= m_chunks.size() || component >= MAX_COMPONENTS) return nullptr;
+    const Chunk& c = m_chunks[chunk];
+    if (!(m_archetypes[c.archetype].mask & (1ull << component))) return nullptr;
+    return column(c, component);
+}
+
+} // namespace hxo
@@ -0,0 +1,132 @@
+#ifndef HXO_ECS_H
+#define HXO_ECS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace hxo {
+
+// Archetype entity-component store. Entities with the same component set
+// share an archetype, whose rows live in fixed-size chunks holding one
+// contiguous, cache-line aligned column per component. Chunk memory is never
+// moved or freed before the store is destroyed, so callers (including
+// TypeScript typed-array views) may hold column pointers across frames; they
+// only need re-querying when version() changes. Writes through those
+// pointers are reported per chunk with mark_dirty().
+//
+// Entity handles are 24-bit index + 8-bit generation, 0 is invalid.
+// Destroying entities and changing their component sets is queued and
+// applied in one batch by flush().
+class EcsWorld {
+public:
+    static constexpr uint32_t MAX_COMPONENTS = 64;
+    static constexpr uint32_t CHUNK_BYTES = 16384;
+    static constexpr uint32_t INVALID_COMPONENT = 0xFFFFFFFFu;
+
+    EcsWorld() = default;
+    EcsWorld(EcsWorld&&) noexcept = default;
+    EcsWorld& operator=(EcsWorld&&) noexcept = default;
+    EcsWorld(const EcsWorld&) = delete;
+    EcsWorld& operator=(const EcsWorld&) = delete;
+
+    // Returns the new component id, INVALID_COMPONENT when full or size is 0
+    uint32_t register_component(uint32_t size);
+    uint32_t component_size(uint32_t component) const;
+
+    // Create count entities with the components in mask, zero-initialized.
+    // Immediate; returns how many were created (stops early on bad masks or
+    // when handles run out).
+    uint32_t create(uint64_t mask, uint32_t count, uint32_t* out);
+
+    // Queued until flush()
+    void destroy(const uint32_t* entities, uint32_t count);
+    void add_components(const uint32_t* entities, uint32_t count, uint64_t mask);
+    void remove_components(const uint32_t* entities, uint32_t count, uint64_t mask);
+    void flush();
+
+    bool alive(uint32_t entity) const;
+    // Marks the entity's chunk dirty, since the caller may write through it
+    void* component(uint32_t entity, uint32_t component);
+
+    // Bumped whenever rows move between chunks or chunks are added/removed
+    uint32_t version() const { return m_version; }
+
+    // Component data of a chunk was written in place. New chunks start
+    // dirty; the flag stays set until its consumer clears it.
+    void mark_dirty(uint32_t chunk);
+    bool chunk_dirty(uint32_t chunk) const;
+    void clear_dirty(uint32_t chunk);
+
+    // Ids of chunks whose archetype has every component in mask. Returns the
+    // number of matching chunks; at most max ids are written.
+    uint32_t query(uint64_t mask, uint32_t* out, uint32_t max) const;
+
+    // Entities in chunks matching mask
+    uint32_t count(uint64_t mask) const;
+
+    uint32_t chunk_rows(uint32_t chunk) const;
+    uint32_t chunk_capacity(uint32_t chunk) const;
+    const uint32_t* chunk_entities(uint32_t chunk) const;
+    // nullptr when the chunk's archetype lacks the component
+    void* chunk_column(uint32_t chunk, uint32_t component) const;
+
+private:
+    struct ChunkDeleter {
+        void operator()(uint8_t* data) const;
+    };
+
+    struct Chunk {
+        std::unique_ptr<uint8_t[], ChunkDeleter> data;
+        uint32_t archetype = 0;
+        uint32_t rows = 0;
+        bool dirty = true;
+    };
+
+    struct Archetype {
+        uint64_t mask = 0;
+        uint32_t capacity = 0;                  // rows per chunk
+        uint32_t offsets[MAX_COMPONENTS] = {};  // column offsets, valid for bits in mask;
+                                                // entity handles are at offset 0
+        std::vector<uint32_t> chunks;           // chunk ids, only the last may be partly full
+    };
+
+    struct Location {
+        uint32_t chunk = 0;
+        uint32_t row = 0;
+    };
+
+    enum class OpKind : uint8_t { Destroy, Add, Remove };
+
+    struct Op {
+        uint32_t entity;
+        OpKind kind;
+        uint64_t mask;
+    };
+
+    uint32_t find_or_create_archetype(uint64_t mask);
+    uint32_t allocate_chunk(uint32_t archetype);
+    Location append_row(uint32_t archetype, uint32_t entity);
+    void remove_row(Location location);
+    void move_entity(uint32_t entity, uint64_t mask);
+    void release_entity(uint32_t entity);
+    uint8_t* column(const Chunk& chunk, uint32_t component) const;
+
+    std::vector<uint32_t> m_sizes;
+    std::vector<Archetype> m_archetypes;
+    std::vector<Chunk> m_chunks;
+    std::vector<uint32_t> m_free_chunks;
+
+    std::vector<Location> m_locations;   // by entity index
+    std::vector<uint8_t> m_generations;  // by entity index
+    std::vector<uint8_t> m_live;         // by entity index
+    std::vector<uint32_t> m_free_entities;
+
+    std::vector<Op> m_ops;
+    uint32_t m_version = 0;
+};
+
+} // namespace hxo
+
+#endif // HXO_ECS_H
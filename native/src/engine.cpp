@@ -1,12 +1,28 @@
 #include "engine.h"
+#include "cull.h"
+#include "ecs.h"
+#include "scene.h"
+#include "jobs.h"
+#include "task.h"
+#include "vk_dispatch.h"
+#include "render_graph.h"
+#include "resolution.h"
+#include "downsample.h"
+#include "shadow.h"
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_vulkan.h>
 #include <vulkan/vulkan.h>
 #include <vector>
+#include <unordered_map>
 #include <cstring>
 #include <algorithm>
 #include <fstream>
 #include <array>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <cstdlib>
+#include <bit>
 
 // Validation layers
 #ifdef NDEBUG
@@ -27,6 +43,82 @@ static constexpr uint32_t DEVICE_EXTENSION_COUNT = 1;
 
 static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
 
+// Textures are uploaded as sRGB RGBA8
+static constexpr VkFormat TEXTURE_FORMAT = VK_FORMAT_R8G8B8A8_SRGB;
+static constexpr VkDeviceSize STAGING_BUFFER_SIZE = 16 * 1024 * 1024;
+
+// Upper bound for the bindless texture table, clamped to device limits
+static constexpr uint32_t MAX_BINDLESS_TEXTURES = 4096;
+// Descriptor sets available to the classic one-set-per-texture path
+static constexpr uint32_t MAX_CLASSIC_TEXTURES = 1024;
+static constexpr uint32_t MIN_INSTANCE_CAPACITY = 1024;
+static constexpr uint32_t MIN_COMMAND_CAPACITY = 16;
+
+// Indirect buffer layout: draw count at 0, VkDrawIndexedIndirectCommand array after
+static constexpr VkDeviceSize INDIRECT_COMMANDS_OFFSET = 16;
+static constexpr uint32_t CULL_WORKGROUP_SIZE = 64;
+// Bounding radius of the unit quad relative to its largest axis scale
+static constexpr float QUAD_BOUNDS_RADIUS = 0.70710678f;
+// Instances packed per worker task when uploading CPU-culled survivors
+static constexpr uint32_t INSTANCE_COPY_GRAIN = 16384;
+// Draw lists at least this long are recorded into secondaries across threads
+static constexpr uint32_t PARALLEL_RECORD_MIN_DRAWS = 2048;
+static constexpr uint32_t MIN_DRAWS_PER_SECONDARY = 256;
+
+// Temporal upscaling: accumulated output, per-pixel motion in UV units,
+// length of the Halton jitter sequence and temporal.comp's workgroup size
+static constexpr VkFormat HISTORY_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+static constexpr VkFormat MOTION_FORMAT = VK_FORMAT_R16G16_SFLOAT;
+static constexpr uint32_t TEMPORAL_JITTER_PHASES = 16;
+static constexpr uint32_t TEMPORAL_WORKGROUP_SIZE = 8;
+
+// Post-processing: ENGINE_POST_* effects, the HDR format the main pass and
+// every effect but the last work in, and post.comp's workgroup size
+static constexpr uint32_t POST_EFFECT_COUNT = 3;
+static constexpr uint32_t POST_EFFECT_MASK = (1u << POST_EFFECT_COUNT) - 1;
+static constexpr VkFormat POST_COMPUTE_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+static constexpr uint32_t POST_WORKGROUP_SIZE = 8;
+
+// Weighted blended OIT: the weighted color and coverage sum, and the
+// product of (1 - alpha) that reveals the opaque scene
+static constexpr VkFormat OIT_ACCUM_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+static constexpr VkFormat OIT_REVEAL_FORMAT = VK_FORMAT_R16_SFLOAT;
+// Color attachment slots of the main pass. Motion vectors are only bound
+// under temporal upscaling and the OIT sums only while OIT is on; slots
+// in between stay unused.
+static constexpr uint32_t MAIN_COLOR_SLOT = 0;
+static constexpr uint32_t MAIN_MOTION_SLOT = 1;
+static constexpr uint32_t MAIN_ACCUM_SLOT = 2;
+static constexpr uint32_t MAIN_REVEAL_SLOT = 3;
+static constexpr uint32_t MAX_MAIN_COLOR_ATTACHMENTS = 4;
+
+// Clustered lighting: the cluster grid, whose x and y are light_cull.comp's
+// workgroup size, the light index entries budgeted per cluster on average,
+// and how far past the near plane slices reach under an infinite far plane
+static constexpr uint32_t LIGHT_CLUSTERS_X = 16;
+static constexpr uint32_t LIGHT_CLUSTERS_Y = 9;
+static constexpr uint32_t LIGHT_CLUSTERS_Z = 24;
+static constexpr uint32_t LIGHT_CLUSTER_COUNT = LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y * LIGHT_CLUSTERS_Z;
+static constexpr uint32_t LIGHT_INDICES_PER_CLUSTER = 128;
+static constexpr uint32_t MIN_LIGHT_CAPACITY = 256;
+static constexpr float MAX_LIGHT_DEPTH_RATIO = 10000.0f;
+
+// Cascaded shadow maps: defaults for engine_set_shadows, the largest
+// resolution accepted, the caster buffer's starting size and the depth bias
+// the shadow pipeline draws with
+static constexpr uint32_t SHADOW_CASCADES = hxo::ShadowCascades::CASCADES;
+static constexpr uint32_t DEFAULT_SHADOW_RESOLUTION = 2048;
+static constexpr float DEFAULT_SHADOW_DISTANCE = 100.0f;
+static constexpr uint32_t DEFAULT_SHADOW_FAR_INTERVAL = 4;
+static constexpr uint32_t MAX_SHADOW_RESOLUTION = 4096;
+static constexpr uint32_t MIN_SHADOW_CASTER_CAPACITY = 256;
+static constexpr float SHADOW_DEPTH_BIAS = 1.25f;
+static constexpr float SHADOW_SLOPE_BIAS = 1.75f;
+// g_shadow_images: the composite layers shading samples, and the static
+// caster cache each cascade's composite starts from
+static constexpr uint32_t SHADOW_COMPOSITE = 0;
+static constexpr uint32_t SHADOW_STATIC = 1;
+
 // Vertex structure
 struct Vertex {
     float pos[2];
@@ -54,6 +146,91 @@ struct Vertex {
     }
 };
 
+// Per-instance data read by instance.vert, must match engine.h EngineInstance
+struct InstanceData {
+    float model[16];
+    float color[4];
+    uint32_t texture;
+    uint32_t flags;
+    uint32_t reserved[2];
+};
+static_assert(sizeof(InstanceData) == sizeof(EngineInstance), "InstanceData must match EngineInstance");
+
+// World-space bounding sphere of an instance, read by cull.comp
+struct BoundingSphere {
+    float center[3];
+    float radius;
+};
+
+// Push constants for instance.vert
+struct InstancePushConstants {
+    float view_proj[16];
+    uint32_t use_visible_list;
+};
+
+// Push constants for cull.comp
+struct CullPushConstants {
+    float planes[6][4];
+    float camera_position[3];
+    float max_distance;
+    uint32_t instance_count;
+    uint32_t command_count;
+};
+static_assert(sizeof(CullPushConstants) <= 128, "Cull push constants exceed the guaranteed minimum");
+
+// Per-frame uniform read by instance.vert for motion vectors
+struct MotionUniforms {
+    float previous_view_proj[16];
+    float jitter[2];
+    float pad[2];
+};
+
+static_assert(sizeof(EngineLight) == 32, "EngineLight must match PointLight in lighting.glsl");
+
+// Per-frame uniform read by light_cull.comp and the instance fragment
+// shaders, matching LightParams in lighting.glsl
+struct LightUniforms {
+    float view[16];
+    float proj_x[4];
+    float proj_y[4];
+    float proj_depth[4];
+    uint32_t grid[4];
+    float tile_scale[2];
+    float near_z;
+    float slice_scale;
+    float ambient[4];
+    uint32_t logarithmic;
+    uint32_t pad[3];
+    float sun_direction[4];
+    float sun_color[4];
+    float shadow_matrices[SHADOW_CASCADES][16];
+    float shadow_texels[SHADOW_CASCADES];
+    float shadow_texel[2];
+    float pad2[2];
+};
+
+// Push constants for temporal.comp
+struct TemporalPushConstants {
+    float input_size[2];
+    float input_texel[2];
+    float output_size[2];
+    float jitter[2];
+    uint32_t history_valid;
+};
+
+// Push constants for post.frag and post.comp
+struct PostPushConstants {
+    float size[2];
+    float exposure;
+    float contrast;
+    float saturation;
+    float vignette;
+    uint32_t effects;
+};
+
+// Quad drawn per instance, corners come from gl_VertexIndex in instance.vert
+static const uint16_t QUAD_INDICES[] = {0, 1, 2, 2, 3, 0};
+
 // Hardcoded triangle vertices
 static const Vertex TRIANGLE_VERTICES[] = {
     {{ 0.0f, -0.5f}, {1.0f, 0.0f, 0.0f}},  // Top - red
@@ -69,10 +246,45 @@ static VkDebugUtilsMessengerEXT g_debug_messenger = VK_NULL_HANDLE;
 static VkSurfaceKHR g_surface = VK_NULL_HANDLE;
 static VkPhysicalDevice g_physical_device = VK_NULL_HANDLE;
 static VkDevice g_device = VK_NULL_HANDLE;
+// Direct device entry points for per-frame calls, skipping the loader
+static hxo::DeviceDispatch g_vk;
 static VkQueue g_graphics_queue = VK_NULL_HANDLE;
 static VkQueue g_present_queue = VK_NULL_HANDLE;
 static uint32_t g_graphics_family = 0;
 static uint32_t g_present_family = 0;
+// Transfer-only family for staging copies; UINT32_MAX and a null queue when
+// the device has none and uploads run on the graphics queue
+static VkQueue g_transfer_queue = VK_NULL_HANDLE;
+static uint32_t g_transfer_family = UINT32_MAX;
+// Compute family other than graphics for async compute, same convention
+static VkQueue g_compute_queue = VK_NULL_HANDLE;
+static uint32_t g_compute_family = UINT32_MAX;
+
+// Only when present and graphics families differ: the present queue acquires
+// each swapchain image from graphics with a prerecorded command buffer before
+// presenting it
+static VkCommandPool g_present_command_pool = VK_NULL_HANDLE;
+static std::vector<VkCommandBuffer> g_present_acquire_buffers;
+static std::vector<VkSemaphore> g_present_ready_semaphores;
+static VkPhysicalDeviceMemoryProperties g_memory_properties = {};
+
+// Device override from engine_set_preferred_device, else HXO_GPU: "#" and an
+// index into the enumeration order, a UUID, or a name substring
+static std::string g_preferred_device;
+// Why pick_physical_device chose what it did, for engine_device_report
+static std::string g_device_report;
+
+// Optional device features, filled by query_device_features
+static bool g_bindless_supported = false;
+static uint32_t g_bindless_capacity = 0;
+static bool g_anisotropy_supported = false;
+static float g_max_anisotropy = 1.0f;
+static bool g_draw_indirect_count_supported = false;
+static bool g_multi_draw_indirect_supported = false;
+static bool g_draw_indirect_first_instance_supported = false;
+// VK_KHR_dynamic_rendering with VK_KHR_synchronization2: frames render
+// straight into swapchain image views, with no render pass or framebuffers
+static bool g_dynamic_rendering_supported = false;
 
 // Swapchain
 static VkSwapchainKHR g_swapchain = VK_NULL_HANDLE;
@@ -80,11 +292,128 @@ static VkFormat g_swapchain_format = VK_FORMAT_UNDEFINED;
 static VkExtent2D g_swapchain_extent = {0, 0};
 static std::vector<VkImage> g_swapchain_images;
 static std::vector<VkImageView> g_swapchain_image_views;
+// Swapchain images can be blit targets, which dynamic resolution needs
+static bool g_swapchain_blit_supported = false;
 
-// Render pass and framebuffers
+// Render pass and framebuffers, both left empty with dynamic rendering
 static VkRenderPass g_render_pass = VK_NULL_HANDLE;
 static std::vector<VkFramebuffer> g_framebuffers;
 
+// Depth buffer, recreated with the swapchain. It is cleared at the start of
+// the main pass and never stored, so it is a transient attachment.
+static VkFormat g_depth_format = VK_FORMAT_UNDEFINED;
+static VkImage g_depth_image = VK_NULL_HANDLE;
+static VkDeviceMemory g_depth_memory = VK_NULL_HANDLE;
+static VkImageView g_depth_view = VK_NULL_HANDLE;
+
+// Multisampled color target, resolved into the swapchain image inside the
+// main pass and never stored. Only exists while MSAA is on.
+static VkImage g_msaa_color_image = VK_NULL_HANDLE;
+static VkDeviceMemory g_msaa_color_memory = VK_NULL_HANDLE;
+static VkImageView g_msaa_color_view = VK_NULL_HANDLE;
+// Sample count of the main pass attachments and graphics pipelines, the
+// requested count clamped to what both attachment kinds support
+static VkSampleCountFlagBits g_msaa_samples = VK_SAMPLE_COUNT_1_BIT;
+static uint32_t g_requested_msaa = 1;
+static VkSampleCountFlags g_supported_sample_counts = VK_SAMPLE_COUNT_1_BIT;
+
+// Dynamic resolution: the main pass renders the top-left g_render_extent of
+// g_scene_color, which has the swapchain's size, and a filtered blit scales
+// that into the swapchain image. Without it g_render_extent is the
+// swapchain extent and the pass renders straight into the swapchain.
+static bool g_dynamic_resolution = false;
+static hxo::ResolutionController g_resolution;
+static VkExtent2D g_render_extent = {0, 0};
+static VkImage g_scene_color_image = VK_NULL_HANDLE;
+static VkDeviceMemory g_scene_color_memory = VK_NULL_HANDLE;
+static VkImageView g_scene_color_view = VK_NULL_HANDLE;
+
+// Temporal upscaling: the main pass renders into the scene color target with
+// a sub-pixel jitter that changes every frame, plus motion vectors into a
+// second attachment. temporal.comp accumulates that into one of two
+// swapchain-sized history images, reading the other, and the result is
+// copied into the swapchain image. The scale is g_temporal_scale unless
+// dynamic resolution picks it.
+static bool g_temporal_upscaling = false;
+static float g_temporal_scale = 1.0f;
+static VkImage g_motion_image = VK_NULL_HANDLE;
+static VkDeviceMemory g_motion_memory = VK_NULL_HANDLE;
+static VkImageView g_motion_view = VK_NULL_HANDLE;
+static VkImage g_history_images[2] = {};
+static VkDeviceMemory g_history_memory[2] = {};
+static VkImageView g_history_views[2] = {};
+// History written this frame; the other one holds last frame's output
+static uint32_t g_history_index = 0;
+static bool g_history_valid = false;
+static uint32_t g_jitter_phase = 0;
+// This frame's sample offset in render pixels
+static float g_jitter[2] = {};
+static VkSampler g_temporal_sampler = VK_NULL_HANDLE;
+static VkDescriptorSetLayout g_temporal_set_layout = VK_NULL_HANDLE;
+static VkDescriptorPool g_temporal_descriptor_pool = VK_NULL_HANDLE;
+// Indexed by the history image written
+static VkDescriptorSet g_temporal_sets[2] = {};
+static VkPipelineLayout g_temporal_pipeline_layout = VK_NULL_HANDLE;
+static VkPipeline g_temporal_pipeline = VK_NULL_HANDLE;
+// Main pass color attachment formats by slot, VK_FORMAT_UNDEFINED where
+// a slot is unused
+static VkFormat g_main_color_formats[MAX_MAIN_COLOR_ATTACHMENTS] = {
+    VK_FORMAT_UNDEFINED, MOTION_FORMAT, OIT_ACCUM_FORMAT, OIT_REVEAL_FORMAT
+};
+
+// Post-processing of the main pass result, which stays HDR until the last
+// effect. Under a render pass each enabled effect is one more subpass,
+// reading the previous result through an input attachment: two transient
+// POST_COMPUTE_FORMAT attachments take turns, and the last subpass writes
+// the color target. Dynamic rendering has no input attachments, so there
+// the main pass renders into a POST_COMPUTE_FORMAT scene target and
+// post.comp applies every effect in place.
+static uint32_t g_post_effects = 0;
+static float g_post_exposure = 1.0f;
+static float g_post_contrast = 1.0f;
+static float g_post_saturation = 1.0f;
+static float g_post_vignette = 0.5f;
+static VkImage g_post_images[2] = {};
+static VkDeviceMemory g_post_memory[2] = {};
+static VkImageView g_post_views[2] = {};
+// Input attachment sets indexed by the attachment read, or the compute
+// fallback's storage image in set 0
+static VkDescriptorSetLayout g_post_set_layout = VK_NULL_HANDLE;
+static VkDescriptorPool g_post_descriptor_pool = VK_NULL_HANDLE;
+static VkDescriptorSet g_post_sets[2] = {};
+static VkPipelineLayout g_post_pipeline_layout = VK_NULL_HANDLE;
+// One per post subpass, or just the compute fallback in [0]
+static VkPipeline g_post_pipelines[POST_EFFECT_COUNT] = {};
+
+// Weighted blended order-independent transparency. Transparent instances
+// are drawn after the opaque ones in the main pass, in any order, into two
+// more color attachments, and a composite blends their sums over the scene:
+// the subpass after the main one under a render pass, reading them as input
+// attachments, or a pass of its own sampling them under dynamic rendering.
+// With MSAA the sums are resolved into the single-sample pair the
+// composite reads. Indexed accumulation, then revealage.
+static bool g_oit_enabled = false;
+static VkImage g_oit_images[2] = {};
+static VkDeviceMemory g_oit_memory[2] = {};
+static VkImageView g_oit_views[2] = {};
+static VkImage g_oit_msaa_images[2] = {};
+static VkDeviceMemory g_oit_msaa_memory[2] = {};
+static VkImageView g_oit_msaa_views[2] = {};
+static VkSampler g_oit_sampler = VK_NULL_HANDLE;
+static VkDescriptorSetLayout g_oit_set_layout = VK_NULL_HANDLE;
+static VkDescriptorPool g_oit_descriptor_pool = VK_NULL_HANDLE;
+static VkDescriptorSet g_oit_set = VK_NULL_HANDLE;
+static VkPipelineLayout g_oit_pipeline_layout = VK_NULL_HANDLE;
+static VkPipeline g_oit_composite_pipeline = VK_NULL_HANDLE;
+
+// GPU time of each frame's command buffer: two timestamps per frame slot,
+// read back once the slot's fence has signalled
+static VkQueryPool g_timestamp_pool = VK_NULL_HANDLE;
+static bool g_timestamps_pending[MAX_FRAMES_IN_FLIGHT] = {};
+static float g_timestamp_period = 0.0f;
+static uint64_t g_timestamp_mask = 0;
+static float g_gpu_frame_ms = 0.0f;
+
 // Graphics pipeline
 static VkPipelineLayout g_pipeline_layout = VK_NULL_HANDLE;
 static VkPipeline g_graphics_pipeline = VK_NULL_HANDLE;
@@ -98,10 +427,365 @@ static std::vector<VkSemaphore> g_image_available_semaphores;
 static std::vector<VkSemaphore> g_render_finished_semaphores;
 static std::vector<VkFence> g_in_flight_fences;
 static uint32_t g_current_frame = 0;
+static uint64_t g_frame_count = 0;  // frames started, for deferred descriptor writes and texture frees
 
 // Rendering mode
 static bool g_draw_triangle = false;
 
+// Texture descriptors: one update-after-bind array when bindless is supported,
+// otherwise one descriptor set per texture
+static VkSampler g_texture_sampler = VK_NULL_HANDLE;
+static VkDescriptorSetLayout g_texture_set_layout = VK_NULL_HANDLE;
+static VkDescriptorPool g_texture_descriptor_pool = VK_NULL_HANDLE;
+static VkDescriptorSet g_bindless_set = VK_NULL_HANDLE;
+static uint32_t g_white_texture = 0;
+
+// Instanced quads
+struct FrameInstances {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    void* mapped = nullptr;
+    uint32_t capacity = 0;
+    VkDescriptorSet set = VK_NULL_HANDLE;
+
+    // GPU culling: bounds in, compacted visible indices and draw commands out
+    VkBuffer bounds_buffer = VK_NULL_HANDLE;
+    VkDeviceMemory bounds_memory = VK_NULL_HANDLE;
+    void* bounds_mapped = nullptr;
+    VkBuffer visible_buffer = VK_NULL_HANDLE;
+    VkDeviceMemory visible_memory = VK_NULL_HANDLE;
+    VkBuffer indirect_buffer = VK_NULL_HANDLE;
+    VkDeviceMemory indirect_memory = VK_NULL_HANDLE;
+    VkBuffer template_buffer = VK_NULL_HANDLE;
+    VkDeviceMemory template_memory = VK_NULL_HANDLE;
+    void* template_mapped = nullptr;
+    uint32_t command_capacity = 0;
+    VkDescriptorSet cull_set = VK_NULL_HANDLE;
+
+    // Motion vectors: last frame's models packed like the instances, sized
+    // with them, and the camera uniform
+    VkBuffer previous_buffer = VK_NULL_HANDLE;
+    VkDeviceMemory previous_memory = VK_NULL_HANDLE;
+    void* previous_mapped = nullptr;
+    VkBuffer motion_buffer = VK_NULL_HANDLE;
+    VkDeviceMemory motion_memory = VK_NULL_HANDLE;
+    void* motion_mapped = nullptr;
+};
+
+// A run of instances drawn with one call, textured with a single set on the
+// classic path. Runs never mix opaque and transparent instances.
+struct DrawItem {
+    uint32_t first_instance;
+    uint32_t instance_count;
+    uint32_t texture;
+    bool transparent;
+};
+
+static VkDescriptorSetLayout g_instance_set_layout = VK_NULL_HANDLE;
+static VkDescriptorPool g_instance_descriptor_pool = VK_NULL_HANDLE;
+static VkPipelineLayout g_instance_pipeline_layout = VK_NULL_HANDLE;
+static VkPipeline g_instance_pipeline = VK_NULL_HANDLE;
+// Depth pre-pass variants: depth only, then shading that tests EQUAL
+static VkPipeline g_instance_depth_pipeline = VK_NULL_HANDLE;
+static VkPipeline g_instance_equal_pipeline = VK_NULL_HANDLE;
+// Transparent instances into the OIT sums, while OIT is on
+static VkPipeline g_instance_oit_pipeline = VK_NULL_HANDLE;
+static bool g_depth_prepass = false;
+static VkBuffer g_quad_index_buffer = VK_NULL_HANDLE;
+static VkDeviceMemory g_quad_index_memory = VK_NULL_HANDLE;
+static FrameInstances g_frame_instances[MAX_FRAMES_IN_FLIGHT];
+static std::vector<InstanceData> g_instances;
+// Stable id of each instance across repacks: its entity handle when the
+// ECS owns g_instances, else its index + 1
+static std::vector<uint32_t> g_instance_ids;
+static std::vector<BoundingSphere> g_instance_bounds;
+static std::vector<DrawItem> g_draw_list;
+// Bounds again as structure-of-arrays for the SIMD CPU cull
+static std::vector<float> g_bounds_x, g_bounds_y, g_bounds_z, g_bounds_radius;
+// Transform hierarchy whose world matrices land in g_instances[].model
+static hxo::SceneGraph g_scene;
+// Secondary command buffers recorded by one worker thread for one frame
+struct RecordContext {
+    VkCommandPool pool = VK_NULL_HANDLE;
+    std::vector<VkCommandBuffer> buffers;
+    uint32_t used = 0;
+};
+
+static std::vector<RecordContext> g_record_contexts[MAX_FRAMES_IN_FLIGHT];
+
+// Clustered point lights: the lights copied in each frame and the uniform,
+// then the per-cluster ranges and index lists light_cull.comp writes for the
+// fragment shaders. All are bound in the frame's instance set.
+struct FrameLights {
+    VkBuffer light_buffer = VK_NULL_HANDLE;
+    VkDeviceMemory light_memory = VK_NULL_HANDLE;
+    void* light_mapped = nullptr;
+    uint32_t capacity = 0;
+    VkBuffer uniform_buffer = VK_NULL_HANDLE;
+    VkDeviceMemory uniform_memory = VK_NULL_HANDLE;
+    void* uniform_mapped = nullptr;
+    VkBuffer cluster_buffer = VK_NULL_HANDLE;
+    VkDeviceMemory cluster_memory = VK_NULL_HANDLE;
+    // Entry count handed out so far at 0, then the entries
+    VkBuffer index_buffer = VK_NULL_HANDLE;
+    VkDeviceMemory index_memory = VK_NULL_HANDLE;
+};
+
+static FrameLights g_frame_lights[MAX_FRAMES_IN_FLIGHT];
+static std::vector<EngineLight> g_lights;
+static float g_ambient_light[3] = {0.0f, 0.0f, 0.0f};
+static VkPipelineLayout g_light_cull_pipeline_layout = VK_NULL_HANDLE;
+static VkPipeline g_light_cull_pipeline = VK_NULL_HANDLE;
+
+// Directional light, lit while its color is not black
+static float g_sun_direction[3] = {0.0f, -1.0f, 0.0f};
+static float g_sun_color[3] = {0.0f, 0.0f, 0.0f};
+
+// Cascaded shadow maps for the directional light. Both images hold one
+// layer per cascade. They are allocated at g_shadow_resolution once shadows
+// are first needed and stay 1x1 placeholders, still bound for shading,
+// while they are off.
+static hxo::ShadowCascades g_shadow_cascades;
+static uint32_t g_shadow_resolution = DEFAULT_SHADOW_RESOLUTION;  // 0 disables shadows
+static float g_shadow_distance = DEFAULT_SHADOW_DISTANCE;
+static uint32_t g_shadow_far_interval = DEFAULT_SHADOW_FAR_INTERVAL;
+static uint32_t g_shadow_map_size = 0;
+static uint64_t g_shadow_frame = 0;
+static VkFormat g_shadow_format = VK_FORMAT_UNDEFINED;
+static VkImage g_shadow_images[2] = {};
+static VkDeviceMemory g_shadow_memory[2] = {};
+static VkImageView g_shadow_layer_views[2][SHADOW_CASCADES] = {};
+static VkFramebuffer g_shadow_framebuffers[2][SHADOW_CASCADES] = {};
+// The composite layers as one array, sampled with depth comparison
+static VkImageView g_shadow_view = VK_NULL_HANDLE;
+static VkSampler g_shadow_sampler = VK_NULL_HANDLE;
+// Whether each image has been through a frame and rests in the layout its
+// last pass left: shader read for the composite, transfer source for the cache
+static bool g_shadow_layouts_valid[2] = {};
+// Shadow passes clearing the layer (static casters) or drawing over a copy
+// of the cache (dynamic casters)
+static VkRenderPass g_shadow_clear_pass = VK_NULL_HANDLE;
+static VkRenderPass g_shadow_load_pass = VK_NULL_HANDLE;
+static VkDescriptorSetLayout g_shadow_set_layout = VK_NULL_HANDLE;
+static VkPipelineLayout g_shadow_pipeline_layout = VK_NULL_HANDLE;
+static VkPipeline g_shadow_pipeline = VK_NULL_HANDLE;
+
+// Model matrices of the casters drawn this frame, grouped per layer
+struct FrameShadows {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    void* mapped = nullptr;
+    uint32_t capacity = 0;
+    VkDescriptorSet set = VK_NULL_HANDLE;
+};
+
+static FrameShadows g_frame_shadows[MAX_FRAMES_IN_FLIGHT];
+
+// Caster state the cached layers were rendered from, compared against the
+// instances each frame to find the cascades a change reaches
+struct ShadowCaster {
+    uint32_t id;  // g_instance_ids entry
+    float model[16];
+    BoundingSphere bounds;
+    bool is_static;
+    bool transparent;  // drawn blended under OIT, so casts no shadow then
+};
+
+static std::vector<ShadowCaster> g_shadow_casters;
+
+// One cascade layer's draw this frame: a range of the frame's casters
+struct ShadowDraw {
+    uint32_t cascade;
+    bool is_static;
+    uint32_t first;
+    uint32_t count;
+};
+
+static hxo::ShadowCascades::Update g_shadow_updates[SHADOW_CASCADES];
+static std::vector<ShadowDraw> g_shadow_draws;
+static std::vector<uint32_t> g_shadow_draw_casters;
+static std::vector<VkCommandBuffer> g_secondary_buffers;
+
+// Async compute: one command buffer per frame in flight on the compute queue.
+// Each submission signals the next value of g_compute_timeline, and the
+// frame's graphics submit waits on every value queued in g_graphics_waits.
+struct QueueWait {
+    VkSemaphore semaphore;
+    uint64_t value;
+    VkPipelineStageFlags stage;
+};
+
+static VkCommandPool g_compute_command_pool = VK_NULL_HANDLE;
+static VkCommandBuffer g_compute_command_buffers[MAX_FRAMES_IN_FLIGHT] = {};
+static VkSemaphore g_compute_timeline = VK_NULL_HANDLE;
+static uint64_t g_compute_submitted = 0;
+static std::vector<QueueWait> g_graphics_waits;
+
+// Per-queue frame graphs, redeclared every frame: passes on the graphics
+// command buffer, and the async compute passes when that queue is in use
+static hxo::RenderGraph g_frame_graph;
+static hxo::RenderGraph g_compute_graph;
+
+// Bulk jobs submitted from TypeScript. Handles are 24-bit index + 1 and an
+// 8-bit generation bumped on release, so a stale handle never names the
+// batch that took over its slot.
+struct BatchJob {
+    hxo::JobCounter counter;
+    uint8_t generation = 0;
+    bool active = false;
+};
+
+static constexpr uint32_t BATCH_JOB_INDEX_BITS = 24;
+static constexpr uint32_t BATCH_JOB_INDEX_MASK = (1u << BATCH_JOB_INDEX_BITS) - 1;
+static constexpr uint32_t BATCH_JOB_GRAIN = 1024;
+static std::vector<std::unique_ptr<BatchJob>> g_batch_jobs;
+static std::vector<uint32_t> g_free_batch_jobs;
+
+// Entity store; entities with an Instance component replace g_instances
+static hxo::EcsWorld create_world() {
+    hxo::EcsWorld world;
+    world.register_component(sizeof(InstanceData));                    // ENGINE_COMPONENT_INSTANCE
+    world.register_component(ENGINE_TRANSFORM_FLOATS * sizeof(float));  // ENGINE_COMPONENT_TRANSFORM
+    return world;
+}
+static constexpr uint64_t component_bit(uint32_t component) {
+    return 1ull << component;
+}
+static hxo::EcsWorld g_world = create_world();
+static bool g_instances_from_ecs = false;
+// Instance chunks in packing order, the first instance each packs to, and
+// the world version they were packed at
+static std::vector<uint32_t> g_ecs_chunks;
+static std::vector<uint32_t> g_ecs_chunk_offsets;
+static uint32_t g_ecs_packed_version = 0;
+static std::vector<uint32_t> g_ecs_dirty_chunks;
+// Survivors of the CPU cull and the draws over them, rebuilt each frame
+static std::vector<uint32_t> g_cpu_visible;
+static std::vector<DrawItem> g_visible_draw_list;
+// Indirect commands matching g_draw_list, with zero instances before culling
+static std::vector<VkDrawIndexedIndirectCommand> g_draw_templates;
+
+// Culling
+static int g_cull_mode = ENGINE_CULL_NONE;
+static float g_cull_distance = 0.0f;
+static VkDescriptorSetLayout g_cull_set_layout = VK_NULL_HANDLE;
+static VkPipelineLayout g_cull_pipeline_layout = VK_NULL_HANDLE;
+static VkPipeline g_cull_pipeline = VK_NULL_HANDLE;
+
+// Camera matrices (column-major)
+static float g_view[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+static float g_proj[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+static float g_view_proj[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+// g_view_proj with this frame's jitter, which instances are drawn with
+static float g_draw_view_proj[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+// Unjittered camera and instance models of the last frame, for motion vectors
+static float g_previous_view_proj[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+static std::vector<float> g_previous_models;
+static float g_camera_position[3] = {0, 0, 0};
+static float g_frustum_planes[6][4] = {};
+
+// Textures. Handles are 24-bit index + 1 and an 8-bit generation bumped on
+// destroy, so a stale handle never names the texture that took its slot
+// (0 is invalid).
+struct Texture {
+    VkImage image = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkImageView view = VK_NULL_HANDLE;
+    VkDescriptorSet set = VK_NULL_HANDLE;  // classic path only
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t mip_levels = 1;
+    uint8_t generation = 0;
+    bool ready = false;  // uploaded and in SHADER_READ_ONLY
+};
+
+static constexpr uint32_t TEXTURE_INDEX_BITS = 24;
+static constexpr uint32_t TEXTURE_INDEX_MASK = (1u << TEXTURE_INDEX_BITS) - 1;
+
+// A level 0 upload waiting in the staging buffer for the next flush
+struct PendingUpload {
+    uint32_t texture;
+    VkDeviceSize staging_offset;
+};
+
+static std::vector<Texture> g_textures;
+static std::vector<uint32_t> g_free_textures;
+static std::vector<PendingUpload> g_pending_uploads;
+
+// A bindless write held back until every frame in flight when its upload was
+// submitted has retired; those frames may still sample the slot
+struct DeferredDescriptor {
+    uint32_t texture;
+    uint64_t frame;  // first frame whose fence wait covers them
+};
+
+// A destroyed texture whose slot returns to the free list once the frames
+// that may still sample it have retired
+struct RetiredTexture {
+    uint32_t texture;
+    uint64_t frame;  // first frame whose fence wait covers them
+};
+
+static std::vector<DeferredDescriptor> g_deferred_descriptors;
+static std::vector<RetiredTexture> g_retired_textures;
+static bool g_texture_mips_supported = false;
+// Mip chains come from the single pass downsampler when the device can run
+// it, one dispatch per texture instead of a blit and barrier per level
+static hxo::Downsampler g_downsampler;
+static bool g_texture_downsample = false;
+
+// Host-visible staging buffer shared by all uploads in a batch
+static VkBuffer g_staging_buffer = VK_NULL_HANDLE;
+static VkDeviceMemory g_staging_memory = VK_NULL_HANDLE;
+static VkDeviceSize g_staging_size = 0;
+static VkDeviceSize g_staging_offset = 0;
+static uint8_t* g_staging_mapped = nullptr;
+static VkCommandBuffer g_upload_command_buffer = VK_NULL_HANDLE;
+static VkFence g_upload_fence = VK_NULL_HANDLE;
+
+// Upload batches are numbered from 1. A timeline semaphore signals each
+// batch's number when the device supports it; otherwise the fence tracks the
+// single batch in flight. The staging buffer and upload command buffer stay
+// busy until g_upload_submitted completes.
+static bool g_timeline_supported = false;
+static VkSemaphore g_upload_timeline = VK_NULL_HANDLE;
+static uint64_t g_upload_submitted = 0;
+static uint64_t g_upload_completed = 0;
+
+// Dedicated transfer queue: copies of a batch run there and release the
+// images, then the graphics queue acquires them and generates mips. One batch
+// waits between the two halves at a time.
+static VkCommandPool g_transfer_command_pool = VK_NULL_HANDLE;
+static VkCommandBuffer g_transfer_command_buffer = VK_NULL_HANDLE;
+static VkSemaphore g_transfer_semaphore = VK_NULL_HANDLE;
+static VkFence g_transfer_fence = VK_NULL_HANDLE;
+static bool g_transfer_busy = false;
+static std::vector<PendingUpload> g_transfer_uploads;
+
+// Task handles handed to TypeScript: 24-bit slot index + 1 and an 8-bit
+// generation bumped when the slot is freed, like batch job handles
+struct TaskResult {
+    bool ok = false;
+    uint32_t value = 0;
+    std::vector<uint8_t> bytes;
+};
+
+// A texture load's handle is owned by the task until engine_task_value
+// hands it out, and destroyed if the task is released before that
+struct AsyncTask {
+    hxo::Task<TaskResult> task;
+    uint8_t generation = 0;
+    bool released = false;
+    bool owns_texture = false;
+};
+
+static constexpr uint32_t TASK_INDEX_BITS = 24;
+static constexpr uint32_t TASK_INDEX_MASK = (1u << TASK_INDEX_BITS) - 1;
+
+static std::vector<AsyncTask> g_tasks;
+static std::vector<uint32_t> g_free_tasks;
+static void pump_tasks();
+
 // Debug callback
 static VKAPI_ATTR VkBool32 VKAPI_CALL debug_callback(
     VkDebugUtilsMessageSeverityFlagBitsEXT severity,
@@ -252,9 +936,15 @@ static int create_surface() {
 struct QueueFamilyIndices {
     uint32_t graphics = UINT32_MAX;
     uint32_t present = UINT32_MAX;
+    uint32_t transfer = UINT32_MAX;  // optional
+    uint32_t compute = UINT32_MAX;   // optional, never the graphics family
     bool complete() const { return graphics != UINT32_MAX && present != UINT32_MAX; }
 };
 
+// Graphics goes to the best scoring family: one that can also present wins
+// outright, since a single queue then renders and presents and the swapchain
+// images never change owner; more queues break ties. Present falls back to
+// any family that can present.
 static QueueFamilyIndices find_queue_families(VkPhysicalDevice device) {
     QueueFamilyIndices indices;
 
@@ -263,16 +953,42 @@ static QueueFamilyIndices find_queue_families(VkPhysicalDevice device) {
     std::vector<VkQueueFamilyProperties> families(count);
     vkGetPhysicalDeviceQueueFamilyProperties(device, &count, families.data());
 
+    uint32_t best_score = 0;
     for (uint32_t i = 0; i < count; i++) {
-        if (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-            indices.graphics = i;
-        }
         VkBool32 present_support = false;
         vkGetPhysicalDeviceSurfaceSupportKHR(device, i, g_surface, &present_support);
-        if (present_support) {
+        if (present_support && indices.present == UINT32_MAX) {
             indices.present = i;
         }
-        if (indices.complete()) break;
+        if (!(families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)) continue;
+
+        uint32_t score = 1 + std::min(families[i].queueCount, 16u);
+        if (present_support) score += 1000;
+        if (score > best_score) {
+            best_score = score;
+            indices.graphics = i;
+            if (present_support) indices.present = i;
+        }
+    }
+
+    // A family without graphics or compute usually maps to the copy engine,
+    // which runs alongside the graphics queue
+    for (uint32_t i = 0; i < count; i++) {
+        VkQueueFlags flags = families[i].queueFlags;
+        if (!(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT)) continue;
+        if (indices.transfer == UINT32_MAX || !(flags & VK_QUEUE_COMPUTE_BIT)) {
+            indices.transfer = i;
+        }
+        if (!(flags & VK_QUEUE_COMPUTE_BIT)) break;
+    }
+
+    // Compute without graphics runs on its own engine where the GPU has one
+    for (uint32_t i = 0; i < count; i++) {
+        VkQueueFlags flags = families[i].queueFlags;
+        if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+            indices.compute = i;
+            break;
+        }
     }
     return indices;
 }
@@ -296,68 +1012,383 @@ static bool check_device_extension_support(VkPhysicalDevice device) {
     return true;
 }
 
+static bool device_extension_supported(VkPhysicalDevice device, const char* name) {
+    uint32_t count;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &count, nullptr);
+    std::vector<VkExtensionProperties> available(count);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &count, available.data());
+
+    for (const auto& ext : available) {
+        if (strcmp(name, ext.extensionName) == 0) return true;
+    }
+    return false;
+}
+
+static void query_device_features(VkPhysicalDevice device) {
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(device, &props);
+
+    VkPhysicalDeviceFeatures2 features2 = {};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    VkPhysicalDeviceVulkan12Features features12 = {};
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    VkPhysicalDeviceSynchronization2FeaturesKHR sync2_features = {};
+    sync2_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamic_rendering_features = {};
+    dynamic_rendering_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+
+    // The 1.2 feature struct may only be chained on 1.2+ devices. Dynamic
+    // rendering also needs 1.2, which provides its depth/stencil resolve
+    // dependency in core.
+    bool api_1_2 = props.apiVersion >= VK_API_VERSION_1_2;
+    bool dynamic_rendering_extensions = api_1_2 &&
+        device_extension_supported(device, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME) &&
+        device_extension_supported(device, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+    if (api_1_2) features2.pNext = &features12;
+    if (dynamic_rendering_extensions) {
+        features12.pNext = &sync2_features;
+        sync2_features.pNext = &dynamic_rendering_features;
+    }
+    vkGetPhysicalDeviceFeatures2(device, &features2);
+
+    g_anisotropy_supported = features2.features.samplerAnisotropy == VK_TRUE;
+    g_multi_draw_indirect_supported = features2.features.multiDrawIndirect == VK_TRUE;
+    g_draw_indirect_first_instance_supported = features2.features.drawIndirectFirstInstance == VK_TRUE;
+    g_draw_indirect_count_supported = api_1_2 && features12.drawIndirectCount;
+    g_timeline_supported = api_1_2 && features12.timelineSemaphore;
+    g_dynamic_rendering_supported = dynamic_rendering_extensions &&
+        sync2_features.synchronization2 && dynamic_rendering_features.dynamicRendering;
+    g_max_anisotropy = g_anisotropy_supported ? std::min(props.limits.maxSamplerAnisotropy, 8.0f) : 1.0f;
+    g_supported_sample_counts = props.limits.framebufferColorSampleCounts & props.limits.framebufferDepthSampleCounts;
+
+    g_bindless_supported = api_1_2 &&
+        features12.descriptorIndexing &&
+        features12.runtimeDescriptorArray &&
+        features12.descriptorBindingPartiallyBound &&
+        features12.descriptorBindingSampledImageUpdateAfterBind &&
+        features12.descriptorBindingUpdateUnusedWhilePending &&
+        features12.shaderSampledImageArrayNonUniformIndexing;
+
+    if (g_bindless_supported) {
+        VkPhysicalDeviceDescriptorIndexingProperties indexing_props = {};
+        indexing_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+        VkPhysicalDeviceProperties2 props2 = {};
+        props2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        props2.pNext = &indexing_props;
+        vkGetPhysicalDeviceProperties2(device, &props2);
+
+        g_bindless_capacity = std::min({MAX_BINDLESS_TEXTURES,
+            indexing_props.maxPerStageDescriptorUpdateAfterBindSampledImages,
+            indexing_props.maxDescriptorSetUpdateAfterBindSampledImages});
+    }
+
+    SDL_Log("Texture binding: %s", g_bindless_supported ? "bindless" : "classic");
+    SDL_Log("Render path: %s", g_dynamic_rendering_supported ? "dynamic rendering" : "render pass");
+}
+
+struct DeviceCandidate {
+    VkPhysicalDevice device = VK_NULL_HANDLE;
+    QueueFamilyIndices indices;
+    uint64_t score = 0;
+    std::string summary;
+    std::string name;
+    std::string uuid;
+};
+
+static const char* device_type_name(VkPhysicalDeviceType type) {
+    switch (type) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return "discrete";
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return "integrated";
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return "virtual";
+    case VK_PHYSICAL_DEVICE_TYPE_CPU: return "cpu";
+    default: return "other";
+    }
+}
+
+// Device type dominates, then each feature the renderer uses, then VRAM in MB.
+// Returns 0 for devices the engine cannot run on; summary says why either way.
+static uint64_t score_physical_device(VkPhysicalDevice device, const QueueFamilyIndices& indices,
+                                      std::string& summary) {
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(device, &props);
+    summary = device_type_name(props.deviceType);
+
+    if (!indices.complete()) {
+        summary += ", no graphics/present queue";
+        return 0;
+    }
+    if (!check_device_extension_support(device)) {
+        summary += ", missing swapchain extension";
+        return 0;
+    }
+    uint32_t format_count = 0, mode_count = 0;
+    vkGetPhysicalDeviceSurfaceFormatsKHR(device, g_surface, &format_count, nullptr);
+    vkGetPhysicalDeviceSurfacePresentModesKHR(device, g_surface, &mode_count, nullptr);
+    if (format_count == 0 || mode_count == 0) {
+        summary += ", surface unsupported";
+        return 0;
+    }
+
+    uint64_t type_tier = 0;
+    switch (props.deviceType) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: type_tier = 4; break;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: type_tier = 3; break;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: type_tier = 2; break;
+    case VK_PHYSICAL_DEVICE_TYPE_CPU: type_tier = 1; break;
+    default: break;
+    }
+
+    VkPhysicalDeviceMemoryProperties memory;
+    vkGetPhysicalDeviceMemoryProperties(device, &memory);
+    uint64_t vram_mb = 0;
+    for (uint32_t i = 0; i < memory.memoryHeapCount; i++) {
+        if (memory.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            vram_mb += memory.memoryHeaps[i].size >> 20;
+        }
+    }
+
+    VkPhysicalDeviceFeatures2 features2 = {};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    VkPhysicalDeviceVulkan12Features features12 = {};
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    bool api_1_2 = props.apiVersion >= VK_API_VERSION_1_2;
+    if (api_1_2) features2.pNext = &features12;
+    vkGetPhysicalDeviceFeatures2(device, &features2);
+
+    struct Feature {
+        bool present;
+        const char* name;
+    };
+    const Feature features[] = {
+        {api_1_2 && features12.descriptorIndexing && features12.runtimeDescriptorArray, "bindless"},
+        {api_1_2 && features12.drawIndirectCount == VK_TRUE, "indirect-count"},
+        {api_1_2 && features12.timelineSemaphore == VK_TRUE, "timeline"},
+        {features2.features.multiDrawIndirect == VK_TRUE, "multi-draw-indirect"},
+        {indices.transfer != UINT32_MAX, "transfer-queue"},
+        {indices.graphics == indices.present, "present-on-graphics"},
+    };
+
+    uint64_t feature_count = 0;
+    for (const Feature& feature : features) {
+        if (!feature.present) continue;
+        feature_count++;
+        summary += ", ";
+        summary += feature.name;
+    }
+    summary += ", " + std::to_string(vram_mb) + " MB";
+
+    // Type tier in the top bits, feature count next, VRAM (clamped) lowest;
+    // the low bit keeps every usable device above zero
+    return (type_tier << 48) | (feature_count << 32) | (std::min<uint64_t>(vram_mb, 0x7fffffff) << 1) | 1;
+}
+
+static std::string device_uuid(VkPhysicalDevice device) {
+    VkPhysicalDeviceIDProperties id_props = {};
+    id_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+    VkPhysicalDeviceProperties2 props2 = {};
+    props2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    props2.pNext = &id_props;
+    vkGetPhysicalDeviceProperties2(device, &props2);
+
+    static const char HEX[] = "0123456789abcdef";
+    std::string uuid;
+    for (uint32_t i = 0; i < VK_UUID_SIZE; i++) {
+        uuid += HEX[id_props.deviceUUID[i] >> 4];
+        uuid += HEX[id_props.deviceUUID[i] & 15];
+    }
+    return uuid;
+}
+
+static std::string lowercase_without_dashes(const std::string& text) {
+    std::string result;
+    for (char c : text) {
+        if (c == '-') continue;
+        result += static_cast<char>(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+    }
+    return result;
+}
+
+// "#" and an index, full UUID, or case-insensitive name substring such as
+// "llvmpipe" to pin lavapipe for deterministic CI runs. The index needs its
+// prefix so a name or UUID made only of digits still matches as one.
+static bool device_matches(const std::string& request, size_t index, const DeviceCandidate& candidate) {
+    if (request.size() > 1 && request[0] == '#' &&
+        std::all_of(request.begin() + 1, request.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+        return std::strtoul(request.c_str() + 1, nullptr, 10) == index;
+    }
+    std::string wanted = lowercase_without_dashes(request);
+    if (wanted == candidate.uuid) return true;
+    return lowercase_without_dashes(candidate.name).find(wanted) != std::string::npos;
+}
+
 static int pick_physical_device() {
     uint32_t count = 0;
     vkEnumeratePhysicalDevices(g_instance, &count, nullptr);
     if (count == 0) {
         SDL_Log("No Vulkan-capable GPUs found");
+        g_device_report = "no Vulkan devices";
         return 1;
     }
 
     std::vector<VkPhysicalDevice> devices(count);
     vkEnumeratePhysicalDevices(g_instance, &count, devices.data());
 
-    for (const auto& device : devices) {
-        auto indices = find_queue_families(device);
-        if (!indices.complete()) continue;
-        if (!check_device_extension_support(device)) continue;
+    std::vector<DeviceCandidate> candidates(count);
+    for (uint32_t i = 0; i < count; i++) {
+        DeviceCandidate& candidate = candidates[i];
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(devices[i], &props);
+        candidate.device = devices[i];
+        candidate.name = props.deviceName;
+        candidate.uuid = device_uuid(devices[i]);
+        candidate.indices = find_queue_families(devices[i]);
+        candidate.score = score_physical_device(devices[i], candidate.indices, candidate.summary);
+    }
 
-        uint32_t format_count, mode_count;
-        vkGetPhysicalDeviceSurfaceFormatsKHR(device, g_surface, &format_count, nullptr);
-        vkGetPhysicalDeviceSurfacePresentModesKHR(device, g_surface, &mode_count, nullptr);
-        if (format_count == 0 || mode_count == 0) continue;
+    std::string request = g_preferred_device;
+    const char* source = "engine_set_preferred_device";
+    if (request.empty()) {
+        const char* env = std::getenv("HXO_GPU");
+        if (env) request = env;
+        source = "HXO_GPU";
+    }
 
-        g_physical_device = device;
-        g_graphics_family = indices.graphics;
-        g_present_family = indices.present;
+    int chosen = -1;
+    std::string reason = "highest score";
+    if (!request.empty()) {
+        for (uint32_t i = 0; i < count; i++) {
+            if (candidates[i].score > 0 && device_matches(request, i, candidates[i])) {
+                chosen = static_cast<int>(i);
+                reason = std::string(source) + "=" + request;
+                break;
+            }
+        }
+        if (chosen < 0) {
+            SDL_Log("%s=%s matches no usable GPU, falling back to scoring", source, request.c_str());
+            reason = std::string("highest score (") + source + "=" + request + " matched nothing usable)";
+        }
+    }
+    if (chosen < 0) {
+        for (uint32_t i = 0; i < count; i++) {
+            if (candidates[i].score > 0 &&
+                (chosen < 0 || candidates[i].score > candidates[static_cast<uint32_t>(chosen)].score)) {
+                chosen = static_cast<int>(i);
+            }
+        }
+    }
 
-        VkPhysicalDeviceProperties props;
-        vkGetPhysicalDeviceProperties(device, &props);
-        SDL_Log("Selected GPU: %s", props.deviceName);
-        return 0;
+    g_device_report.clear();
+    for (uint32_t i = 0; i < count; i++) {
+        const DeviceCandidate& candidate = candidates[i];
+        g_device_report += (static_cast<int>(i) == chosen ? "* " : "  ");
+        g_device_report += "#" + std::to_string(i) + " " + candidate.name + " (" + candidate.summary + ")";
+        g_device_report += candidate.score > 0 ? "" : " unusable";
+        g_device_report += " uuid " + candidate.uuid + "\n";
     }
 
-    SDL_Log("No suitable GPU found");
-    return 2;
+    if (chosen < 0) {
+        SDL_Log("No suitable GPU found");
+        g_device_report += "no usable device";
+        return 2;
+    }
+    g_device_report += "selected by " + reason;
+
+    const DeviceCandidate& selected = candidates[static_cast<uint32_t>(chosen)];
+    g_physical_device = selected.device;
+    g_graphics_family = selected.indices.graphics;
+    g_present_family = selected.indices.present;
+    g_transfer_family = selected.indices.transfer;
+    g_compute_family = selected.indices.compute;
+    vkGetPhysicalDeviceMemoryProperties(selected.device, &g_memory_properties);
+    query_device_features(selected.device);
+
+    SDL_Log("Selected GPU: %s (%s, %s)", selected.name.c_str(), selected.summary.c_str(), reason.c_str());
+    return 0;
 }
 
 static int create_logical_device() {
-    std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
-    float priority = 1.0f;
-
-    std::vector<uint32_t> unique_families = {g_graphics_family};
-    if (g_present_family != g_graphics_family) {
-        unique_families.push_back(g_present_family);
-    }
+    uint32_t family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(g_physical_device, &family_count, nullptr);
+    std::vector<VkQueueFamilyProperties> families(family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(g_physical_device, &family_count, families.data());
+
+    // Cross-queue sync for async compute relies on timeline semaphores
+    if (!g_timeline_supported) g_compute_family = UINT32_MAX;
+
+    // Each role takes its own queue from its family while the family has
+    // queues left, then shares the last one. Present rides on the graphics
+    // queue whenever both use the same family.
+    std::vector<uint32_t> taken(family_count, 0);
+    auto take_queue = [&](uint32_t family) {
+        if (taken[family] < families[family].queueCount) return taken[family]++;
+        return taken[family] - 1;
+    };
+    uint32_t graphics_index = take_queue(g_graphics_family);
+    uint32_t present_index = g_present_family == g_graphics_family ? graphics_index : take_queue(g_present_family);
+    uint32_t transfer_index = g_transfer_family != UINT32_MAX ? take_queue(g_transfer_family) : 0;
+    uint32_t compute_index = g_compute_family != UINT32_MAX ? take_queue(g_compute_family) : 0;
 
-    for (uint32_t family : unique_families) {
+    uint32_t max_queues = *std::max_element(taken.begin(), taken.end());
+    std::vector<float> priorities(max_queues, 1.0f);
+    std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
+    for (uint32_t family = 0; family < family_count; family++) {
+        if (taken[family] == 0) continue;
         VkDeviceQueueCreateInfo info = {};
         info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
         info.queueFamilyIndex = family;
-        info.queueCount = 1;
-        info.pQueuePriorities = &priority;
+        info.queueCount = taken[family];
+        info.pQueuePriorities = priorities.data();
         queue_create_infos.push_back(info);
     }
 
-    VkPhysicalDeviceFeatures features = {};
+    VkPhysicalDeviceFeatures2 features2 = {};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.features.samplerAnisotropy = g_anisotropy_supported ? VK_TRUE : VK_FALSE;
+    features2.features.multiDrawIndirect = g_multi_draw_indirect_supported ? VK_TRUE : VK_FALSE;
+    features2.features.drawIndirectFirstInstance = g_draw_indirect_first_instance_supported ? VK_TRUE : VK_FALSE;
+
+    VkPhysicalDeviceVulkan12Features features12 = {};
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    if (g_draw_indirect_count_supported) {
+        features12.drawIndirectCount = VK_TRUE;
+        features2.pNext = &features12;
+    }
+    if (g_timeline_supported) {
+        features12.timelineSemaphore = VK_TRUE;
+        features2.pNext = &features12;
+    }
+    if (g_bindless_supported) {
+        features12.descriptorIndexing = VK_TRUE;
+        features12.runtimeDescriptorArray = VK_TRUE;
+        features12.descriptorBindingPartiallyBound = VK_TRUE;
+        features12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        features12.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+        features12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        features2.pNext = &features12;
+    }
+
+    std::vector<const char*> extensions(DEVICE_EXTENSIONS, DEVICE_EXTENSIONS + DEVICE_EXTENSION_COUNT);
+    VkPhysicalDeviceSynchronization2FeaturesKHR sync2_features = {};
+    sync2_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamic_rendering_features = {};
+    dynamic_rendering_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+    if (g_dynamic_rendering_supported) {
+        extensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+        extensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+        sync2_features.synchronization2 = VK_TRUE;
+        dynamic_rendering_features.dynamicRendering = VK_TRUE;
+        dynamic_rendering_features.pNext = features2.pNext;
+        sync2_features.pNext = &dynamic_rendering_features;
+        features2.pNext = &sync2_features;
+    }
 
     VkDeviceCreateInfo create_info = {};
     create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    create_info.pNext = &features2;
     create_info.queueCreateInfoCount = static_cast<uint32_t>(queue_create_infos.size());
     create_info.pQueueCreateInfos = queue_create_infos.data();
-    create_info.pEnabledFeatures = &features;
-    create_info.enabledExtensionCount = DEVICE_EXTENSION_COUNT;
-    create_info.ppEnabledExtensionNames = DEVICE_EXTENSIONS;
+    create_info.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    create_info.ppEnabledExtensionNames = extensions.data();
 
     if (ENABLE_VALIDATION) {
         create_info.enabledLayerCount = VALIDATION_LAYER_COUNT;
@@ -368,9 +1399,28 @@ static int create_logical_device() {
         SDL_Log("Failed to create logical device");
         return 1;
     }
+    if (!hxo::load_device_dispatch(g_device, g_vk)) {
+        SDL_Log("Failed to load device entry points");
+        return 2;
+    }
+    if (g_dynamic_rendering_supported &&
+        (!g_vk.vkCmdBeginRenderingKHR || !g_vk.vkCmdEndRenderingKHR || !g_vk.vkCmdPipelineBarrier2KHR)) {
+        SDL_Log("Dynamic rendering entry points missing, using render pass path");
+        g_dynamic_rendering_supported = false;
+    }
 
-    vkGetDeviceQueue(g_device, g_graphics_family, 0, &g_graphics_queue);
-    vkGetDeviceQueue(g_device, g_present_family, 0, &g_present_queue);
+    vkGetDeviceQueue(g_device, g_graphics_family, graphics_index, &g_graphics_queue);
+    vkGetDeviceQueue(g_device, g_present_family, present_index, &g_present_queue);
+    SDL_Log("Graphics queue: family %u, present: %s", g_graphics_family,
+        g_present_family == g_graphics_family ? "same queue" : "separate family");
+    if (g_transfer_family != UINT32_MAX) {
+        vkGetDeviceQueue(g_device, g_transfer_family, transfer_index, &g_transfer_queue);
+        SDL_Log("Texture uploads: dedicated transfer queue (family %u, queue %u)", g_transfer_family, transfer_index);
+    }
+    if (g_compute_family != UINT32_MAX) {
+        vkGetDeviceQueue(g_device, g_compute_family, compute_index, &g_compute_queue);
+        SDL_Log("Async compute: queue family %u, queue %u", g_compute_family, compute_index);
+    }
     return 0;
 }
 
@@ -436,14 +1486,20 @@ static int create_swapchain() {
     create_info.imageArrayLayers = 1;
     create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
-    uint32_t queue_families[] = {g_graphics_family, g_present_family};
-    if (g_graphics_family != g_present_family) {
-        create_info.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
-        create_info.queueFamilyIndexCount = 2;
-        create_info.pQueueFamilyIndices = queue_families;
-    } else {
-        create_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    }
+    // Blitting the scene in also needs the format to be a blit source (the
+    // scene color target shares it) and filterable
+    VkFormatProperties format_properties;
+    vkGetPhysicalDeviceFormatProperties(g_physical_device, surface_format.format, &format_properties);
+    VkFormatFeatureFlags blit_features = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    g_swapchain_blit_supported = (caps.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) &&
+        (format_properties.optimalTilingFeatures & blit_features) == blit_features;
+    if (g_swapchain_blit_supported) create_info.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+    // Exclusive even with a separate present family: ownership moves to it
+    // explicitly each frame (see record_present_acquires), which is cheaper
+    // than concurrent sharing on drivers that disable compression for it
+    create_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
     create_info.preTransform = caps.currentTransform;
     create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
@@ -489,42 +1545,242 @@ static int create_swapchain() {
     return 0;
 }
 
+static uint32_t post_effect_count() {
+    return static_cast<uint32_t>(std::popcount(g_post_effects));
+}
+
+static bool post_subpasses_active() {
+    return g_post_effects != 0 && !g_dynamic_rendering_supported;
+}
+
+static bool post_compute_active() {
+    return g_post_effects != 0 && g_dynamic_rendering_supported;
+}
+
+// Transient attachments the post subpasses take turns reading and writing
+static uint32_t post_attachment_count() {
+    return post_subpasses_active() ? std::min(post_effect_count(), 2u) : 0;
+}
+
+// The main pass draws into the scene color target rather than the swapchain
+// image, which a later pass fills from it
+static bool scene_target_active() {
+    return g_dynamic_resolution || g_temporal_upscaling || post_compute_active();
+}
+
+static bool oit_active() {
+    return g_oit_enabled;
+}
+
+// Subpasses before the post-process ones: the main subpass, then the OIT
+// composite under a render pass
+static uint32_t main_subpass_count() {
+    return oit_active() && !g_dynamic_rendering_supported ? 2 : 1;
+}
+
+// Scene color, plus motion vectors under temporal upscaling, plus the OIT
+// sums while OIT is on
+static uint32_t main_color_attachment_count() {
+    if (oit_active()) return MAX_MAIN_COLOR_ATTACHMENTS;
+    return g_temporal_upscaling ? 2 : 1;
+}
+
 static int create_render_pass() {
+    if (g_dynamic_rendering_supported) return 0;
+    bool msaa = g_msaa_samples != VK_SAMPLE_COUNT_1_BIT;
+
+    // With MSAA the swapchain image is only the resolve target
     VkAttachmentDescription color_attachment = {};
     color_attachment.format = g_swapchain_format;
     color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    color_attachment.loadOp = msaa ? VK_ATTACHMENT_LOAD_OP_DONT_CARE : VK_ATTACHMENT_LOAD_OP_CLEAR;
     color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-    VkAttachmentReference color_ref = {};
-    color_ref.attachment = 0;
-    color_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    VkSubpassDescription subpass = {};
-    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpass.colorAttachmentCount = 1;
-    subpass.pColorAttachments = &color_ref;
-
-    VkSubpassDependency dependency = {};
-    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependency.dstSubpass = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.srcAccessMask = 0;
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    // The frame graph moves the image in and out of the attachment layout
+    // with the same barriers it uses under dynamic rendering
+    color_attachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    color_attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    // Depth is only needed while the pass runs; DONT_CARE lets tilers keep
+    // it in tile memory
+    VkAttachmentDescription depth_attachment = {};
+    depth_attachment.format = g_depth_format;
+    depth_attachment.samples = g_msaa_samples;
+    depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depth_attachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depth_attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    // Samples are resolved at the end of the subpass, so like depth they
+    // never leave tile memory
+    uint32_t post_count = post_attachment_count();
+    VkAttachmentDescription msaa_attachment = color_attachment;
+    if (post_count > 0) msaa_attachment.format = POST_COMPUTE_FORMAT;
+    msaa_attachment.samples = g_msaa_samples;
+    msaa_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    msaa_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+    // Motion vectors are read by temporal.comp after the pass. Temporal
+    // upscaling replaces MSAA, so they are never multisampled.
+    VkAttachmentDescription motion_attachment = color_attachment;
+    motion_attachment.format = MOTION_FORMAT;
+    motion_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+
+    // The first post attachment takes the main subpass's color, so it is
+    // cleared unless it only receives the resolve. None of them are stored.
+    // They hold HDR color; only the last post subpass writes the target.
+    VkAttachmentDescription post_attachment = color_attachment;
+    post_attachment.format = POST_COMPUTE_FORMAT;
+    post_attachment.loadOp = msaa ? VK_ATTACHMENT_LOAD_OP_DONT_CARE : VK_ATTACHMENT_LOAD_OP_CLEAR;
+    post_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    // With post subpasses the last one writes the whole target
+    if (post_count > 0) color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+
+    // The OIT sums start empty: nothing added, everything revealed. The
+    // composite subpass reads them (or their resolves), so none are stored.
+    VkAttachmentDescription accum_attachment = color_attachment;
+    accum_attachment.format = OIT_ACCUM_FORMAT;
+    accum_attachment.loadOp = msaa ? VK_ATTACHMENT_LOAD_OP_DONT_CARE : VK_ATTACHMENT_LOAD_OP_CLEAR;
+    accum_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    VkAttachmentDescription reveal_attachment = accum_attachment;
+    reveal_attachment.format = OIT_REVEAL_FORMAT;
+
+    VkAttachmentDescription attachments[10] = {color_attachment, depth_attachment};
+    uint32_t attachment_count = 2;
+    if (msaa) attachments[attachment_count++] = msaa_attachment;
+
+    VkAttachmentReference color_refs[MAX_MAIN_COLOR_ATTACHMENTS] = {};
+    VkAttachmentReference resolve_refs[MAX_MAIN_COLOR_ATTACHMENTS] = {};
+    for (uint32_t i = 0; i < MAX_MAIN_COLOR_ATTACHMENTS; i++) {
+        color_refs[i] = {VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+        resolve_refs[i] = {VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    }
+    color_refs[MAIN_COLOR_SLOT].attachment = msaa ? 2 : 0;
+    resolve_refs[MAIN_COLOR_SLOT].attachment = 0;
+    if (g_temporal_upscaling) {
+        color_refs[MAIN_MOTION_SLOT].attachment = attachment_count;
+        attachments[attachment_count++] = motion_attachment;
+    }
+
+    uint32_t first_post = attachment_count;
+    for (uint32_t i = 0; i < post_count; i++) {
+        attachments[attachment_count++] = post_attachment;
+        post_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    }
+    // The main subpass renders (or resolves) into the first post attachment
+    if (post_count > 0) {
+        if (msaa) {
+            resolve_refs[MAIN_COLOR_SLOT].attachment = first_post;
+        } else {
+            color_refs[MAIN_COLOR_SLOT].attachment = first_post;
+        }
+    }
+
+    // The single-sample sums the composite reads, then with MSAA the
+    // multisampled ones transparent instances are drawn into
+    uint32_t first_oit = attachment_count;
+    if (oit_active()) {
+        attachments[attachment_count++] = accum_attachment;
+        attachments[attachment_count++] = reveal_attachment;
+        color_refs[MAIN_ACCUM_SLOT].attachment = first_oit;
+        color_refs[MAIN_REVEAL_SLOT].attachment = first_oit + 1;
+        if (msaa) {
+            accum_attachment.samples = g_msaa_samples;
+            accum_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            reveal_attachment.samples = g_msaa_samples;
+            reveal_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            resolve_refs[MAIN_ACCUM_SLOT].attachment = first_oit;
+            resolve_refs[MAIN_REVEAL_SLOT].attachment = first_oit + 1;
+            color_refs[MAIN_ACCUM_SLOT].attachment = attachment_count;
+            attachments[attachment_count++] = accum_attachment;
+            color_refs[MAIN_REVEAL_SLOT].attachment = attachment_count;
+            attachments[attachment_count++] = reveal_attachment;
+        }
+    }
+
+    VkAttachmentReference depth_ref = {};
+    depth_ref.attachment = 1;
+    depth_ref.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpasses[2 + POST_EFFECT_COUNT] = {};
+    subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpasses[0].colorAttachmentCount = main_color_attachment_count();
+    subpasses[0].pColorAttachments = color_refs;
+    subpasses[0].pResolveAttachments = msaa ? resolve_refs : nullptr;
+    subpasses[0].pDepthStencilAttachment = &depth_ref;
+
+    // The OIT composite reads both sums at its pixel and blends over what
+    // the main subpass wrote (or resolved), once all of that is done
+    uint32_t main_subpasses = main_subpass_count();
+    VkAttachmentReference oit_input_refs[2] = {};
+    VkAttachmentReference scene_ref = msaa ? resolve_refs[MAIN_COLOR_SLOT] : color_refs[MAIN_COLOR_SLOT];
+    VkSubpassDependency dependencies[1 + POST_EFFECT_COUNT] = {};
+    uint32_t dependency_count = 0;
+    if (main_subpasses > 1) {
+        for (uint32_t i = 0; i < 2; i++) {
+            oit_input_refs[i] = {first_oit + i, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        }
+        subpasses[1].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpasses[1].inputAttachmentCount = 2;
+        subpasses[1].pInputAttachments = oit_input_refs;
+        subpasses[1].colorAttachmentCount = 1;
+        subpasses[1].pColorAttachments = &scene_ref;
+
+        VkSubpassDependency& dependency = dependencies[dependency_count++];
+        dependency.srcSubpass = 0;
+        dependency.dstSubpass = 1;
+        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependency.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                                   VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+    }
+
+    // Post subpass i reads what the subpass before it wrote at the same
+    // pixel and writes the other post attachment, or the target if it is the
+    // last. Each waits for the previous one's writes and, since it
+    // overwrites the attachment that one read, for its reads.
+    uint32_t post_subpasses = post_count > 0 ? post_effect_count() : 0;
+    uint32_t subpass_count = main_subpasses + post_subpasses;
+    VkAttachmentReference input_refs[POST_EFFECT_COUNT] = {};
+    VkAttachmentReference output_refs[POST_EFFECT_COUNT] = {};
+    for (uint32_t i = 0; i < post_subpasses; i++) {
+        VkAttachmentReference& input = input_refs[i];
+        input.attachment = first_post + i % 2;
+        input.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        VkAttachmentReference& output = output_refs[i];
+        output.attachment = i + 1 == post_subpasses ? 0 : first_post + (i + 1) % 2;
+        output.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        uint32_t subpass = main_subpasses + i;
+        subpasses[subpass].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpasses[subpass].inputAttachmentCount = 1;
+        subpasses[subpass].pInputAttachments = &input;
+        subpasses[subpass].colorAttachmentCount = 1;
+        subpasses[subpass].pColorAttachments = &output;
+
+        VkSubpassDependency& dependency = dependencies[dependency_count++];
+        dependency.srcSubpass = subpass - 1;
+        dependency.dstSubpass = subpass;
+        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependency.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+    }
 
     VkRenderPassCreateInfo create_info = {};
     create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    create_info.attachmentCount = 1;
-    create_info.pAttachments = &color_attachment;
-    create_info.subpassCount = 1;
-    create_info.pSubpasses = &subpass;
-    create_info.dependencyCount = 1;
-    create_info.pDependencies = &dependency;
+    create_info.attachmentCount = attachment_count;
+    create_info.pAttachments = attachments;
+    create_info.subpassCount = subpass_count;
+    create_info.pSubpasses = subpasses;
+    create_info.dependencyCount = dependency_count;
+    create_info.pDependencies = dependencies;
 
     if (vkCreateRenderPass(g_device, &create_info, nullptr, &g_render_pass) != VK_SUCCESS) {
         SDL_Log("Failed to create render pass");
@@ -533,6 +1789,17 @@ static int create_render_pass() {
     return 0;
 }
 
+// Attachment formats a pipeline renders to under dynamic rendering, chained
+// into its create info in place of a render pass
+static VkPipelineRenderingCreateInfoKHR pipeline_rendering_info() {
+    VkPipelineRenderingCreateInfoKHR info = {};
+    info.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+    info.colorAttachmentCount = main_color_attachment_count();
+    info.pColorAttachmentFormats = g_main_color_formats;
+    info.depthAttachmentFormat = g_depth_format;
+    return info;
+}
+
 static int create_graphics_pipeline() {
     auto vert_code = read_file("triangle.vert.spv");
     auto frag_code = read_file("triangle.frag.spv");
@@ -592,7 +1859,13 @@ static int create_graphics_pipeline() {
     VkPipelineMultisampleStateCreateInfo multisampling = {};
     multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
     multisampling.sampleShadingEnable = VK_FALSE;
-    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    multisampling.rasterizationSamples = g_msaa_samples;
+
+    // The hello triangle is flat; it ignores the depth buffer
+    VkPipelineDepthStencilStateCreateInfo depth_stencil = {};
+    depth_stencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depth_stencil.depthTestEnable = VK_FALSE;
+    depth_stencil.depthWriteEnable = VK_FALSE;
 
     VkPipelineColorBlendAttachmentState color_blend_attachment = {};
     color_blend_attachment.colorWriteMask =
@@ -600,11 +1873,15 @@ static int create_graphics_pipeline() {
         VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
     color_blend_attachment.blendEnable = VK_FALSE;
 
+    // The triangle does not move, so the cleared motion vectors stay, and
+    // it adds nothing to the OIT sums
+    VkPipelineColorBlendAttachmentState blend_attachments[MAX_MAIN_COLOR_ATTACHMENTS] = {color_blend_attachment};
+
     VkPipelineColorBlendStateCreateInfo color_blending = {};
     color_blending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
     color_blending.logicOpEnable = VK_FALSE;
-    color_blending.attachmentCount = 1;
-    color_blending.pAttachments = &color_blend_attachment;
+    color_blending.attachmentCount = main_color_attachment_count();
+    color_blending.pAttachments = blend_attachments;
 
     std::vector<VkDynamicState> dynamic_states = {
         VK_DYNAMIC_STATE_VIEWPORT,
@@ -635,12 +1912,16 @@ static int create_graphics_pipeline() {
     pipeline_info.pViewportState = &viewport_state;
     pipeline_info.pRasterizationState = &rasterizer;
     pipeline_info.pMultisampleState = &multisampling;
+    pipeline_info.pDepthStencilState = &depth_stencil;
     pipeline_info.pColorBlendState = &color_blending;
     pipeline_info.pDynamicState = &dynamic_state;
     pipeline_info.layout = g_pipeline_layout;
     pipeline_info.renderPass = g_render_pass;
     pipeline_info.subpass = 0;
 
+    VkPipelineRenderingCreateInfoKHR rendering_info = pipeline_rendering_info();
+    if (g_dynamic_rendering_supported) pipeline_info.pNext = &rendering_info;
+
     if (vkCreateGraphicsPipelines(g_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &g_graphics_pipeline) != VK_SUCCESS) {
         SDL_Log("Failed to create graphics pipeline");
         vkDestroyShaderModule(g_device, vert_module, nullptr);
@@ -657,14 +1938,28 @@ static int create_graphics_pipeline() {
 }
 
 static int create_framebuffers() {
+    if (g_dynamic_rendering_supported) return 0;
+
     g_framebuffers.resize(g_swapchain_image_views.size());
 
     for (size_t i = 0; i < g_swapchain_image_views.size(); i++) {
         VkFramebufferCreateInfo create_info = {};
         create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        VkImageView color_view = scene_target_active() ? g_scene_color_view : g_swapchain_image_views[i];
+        VkImageView attachments[10] = {color_view, g_depth_view};
+        uint32_t attachment_count = 2;
+        if (g_msaa_color_view) attachments[attachment_count++] = g_msaa_color_view;
+        if (g_motion_view) attachments[attachment_count++] = g_motion_view;
+        for (uint32_t p = 0; p < post_attachment_count(); p++) attachments[attachment_count++] = g_post_views[p];
+        if (oit_active()) {
+            for (VkImageView view : g_oit_views) attachments[attachment_count++] = view;
+            if (g_oit_msaa_views[0]) {
+                for (VkImageView view : g_oit_msaa_views) attachments[attachment_count++] = view;
+            }
+        }
         create_info.renderPass = g_render_pass;
-        create_info.attachmentCount = 1;
-        create_info.pAttachments = &g_swapchain_image_views[i];
+        create_info.attachmentCount = attachment_count;
+        create_info.pAttachments = attachments;
         create_info.width = g_swapchain_extent.width;
         create_info.height = g_swapchain_extent.height;
         create_info.layers = 1;
@@ -690,6 +1985,94 @@ static int create_command_pool() {
     return 0;
 }
 
+static int create_compute_resources() {
+    if (!g_compute_queue) return 0;
+
+    VkCommandPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    pool_info.queueFamilyIndex = g_compute_family;
+    if (vkCreateCommandPool(g_device, &pool_info, nullptr, &g_compute_command_pool) != VK_SUCCESS) {
+        SDL_Log("Failed to create compute command pool");
+        return 1;
+    }
+
+    VkCommandBufferAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.commandPool = g_compute_command_pool;
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc_info.commandBufferCount = MAX_FRAMES_IN_FLIGHT;
+    if (vkAllocateCommandBuffers(g_device, &alloc_info, g_compute_command_buffers) != VK_SUCCESS) {
+        SDL_Log("Failed to allocate compute command buffers");
+        return 2;
+    }
+
+    VkSemaphoreTypeCreateInfo type_info = {};
+    type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    type_info.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphore_info = {};
+    semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphore_info.pNext = &type_info;
+    if (vkCreateSemaphore(g_device, &semaphore_info, nullptr, &g_compute_timeline) != VK_SUCCESS) {
+        SDL_Log("Failed to create compute timeline semaphore");
+        return 3;
+    }
+    return 0;
+}
+
+// Two timestamps per frame in flight, bracketing its command buffer
+static int create_timestamp_queries() {
+    uint32_t family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(g_physical_device, &family_count, nullptr);
+    std::vector<VkQueueFamilyProperties> families(family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(g_physical_device, &family_count, families.data());
+
+    uint32_t valid_bits = families[g_graphics_family].timestampValidBits;
+    if (valid_bits == 0) {
+        SDL_Log("GPU timestamps unsupported on the graphics queue");
+        return 0;
+    }
+
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(g_physical_device, &props);
+    g_timestamp_period = props.limits.timestampPeriod;
+    g_timestamp_mask = valid_bits >= 64 ? UINT64_MAX : (uint64_t(1) << valid_bits) - 1;
+
+    VkQueryPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    pool_info.queryCount = 2 * MAX_FRAMES_IN_FLIGHT;
+    if (vkCreateQueryPool(g_device, &pool_info, nullptr, &g_timestamp_pool) != VK_SUCCESS) {
+        SDL_Log("Failed to create timestamp query pool");
+        return 1;
+    }
+    return 0;
+}
+
+// One transient pool per frame in flight per worker thread, so threads never
+// share a pool while recording
+static int create_record_contexts() {
+    uint32_t threads = hxo::job_system().thread_count();
+
+    VkCommandPoolCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    create_info.queueFamilyIndex = g_graphics_family;
+
+    for (auto& contexts : g_record_contexts) {
+        contexts.resize(threads);
+        for (RecordContext& context : contexts) {
+            if (vkCreateCommandPool(g_device, &create_info, nullptr, &context.pool) != VK_SUCCESS) {
+                SDL_Log("Failed to create worker command pool");
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
 static int create_command_buffers() {
     g_command_buffers.resize(MAX_FRAMES_IN_FLIGHT);
 
@@ -729,20 +2112,3986 @@ static int create_sync_objects() {
     return 0;
 }
 
-static void cleanup_swapchain() {
-    for (auto fb : g_framebuffers) {
-        vkDestroyFramebuffer(g_device, fb, nullptr);
+// Layout the last pass of the frame leaves the swapchain image in
+static VkImageLayout swapchain_final_layout() {
+    return scene_target_active() ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+}
+
+// Acquire half of the image ownership transfer from the graphics to the
+// present family. The frame graph's final barrier is the release half; both
+// must describe the same transfer, including the move to PRESENT_SRC, so the
+// acquires are rerecorded whenever swapchain_final_layout() changes.
+static VkImageMemoryBarrier present_acquire_barrier(VkImage image) {
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = 0;
+    barrier.oldLayout = swapchain_final_layout();
+    barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    barrier.srcQueueFamilyIndex = g_graphics_family;
+    barrier.dstQueueFamilyIndex = g_present_family;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    return barrier;
+}
+
+// One acquire command buffer per swapchain image, rerecorded with the
+// swapchain, running on the present queue after the frame's release. Images
+// come back to graphics without a transfer: the frame graph imports each
+// one as UNDEFINED, and its first barrier (a sync2 one when available)
+// discards the old contents on the way into the attachment or transfer
+// layout, so they do not matter.
+static int record_present_acquires() {
+    if (!g_present_command_pool) return 0;
+
+    if (!g_present_acquire_buffers.empty()) {
+        vkFreeCommandBuffers(g_device, g_present_command_pool,
+            static_cast<uint32_t>(g_present_acquire_buffers.size()), g_present_acquire_buffers.data());
     }
-    g_framebuffers.clear();
+    g_present_acquire_buffers.resize(g_swapchain_images.size());
 
-    for (auto view : g_swapchain_image_views) {
-        vkDestroyImageView(g_device, view, nullptr);
+    VkCommandBufferAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.commandPool = g_present_command_pool;
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc_info.commandBufferCount = static_cast<uint32_t>(g_present_acquire_buffers.size());
+    if (vkAllocateCommandBuffers(g_device, &alloc_info, g_present_acquire_buffers.data()) != VK_SUCCESS) {
+        SDL_Log("Failed to allocate present command buffers");
+        g_present_acquire_buffers.clear();
+        return 1;
     }
-    g_swapchain_image_views.clear();
 
-    if (g_swapchain) {
-        vkDestroySwapchainKHR(g_device, g_swapchain, nullptr);
-        g_swapchain = VK_NULL_HANDLE;
+    for (size_t i = 0; i < g_present_acquire_buffers.size(); i++) {
+        VkCommandBuffer cmd = g_present_acquire_buffers[i];
+        VkCommandBufferBeginInfo begin_info = {};
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+        vkBeginCommandBuffer(cmd, &begin_info);
+
+        VkImageMemoryBarrier barrier = present_acquire_barrier(g_swapchain_images[i]);
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+            0, nullptr, 0, nullptr, 1, &barrier);
+        vkEndCommandBuffer(cmd);
+    }
+    return 0;
+}
+
+static int create_present_handoff() {
+    if (g_present_family == g_graphics_family) return 0;
+
+    VkCommandPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.queueFamilyIndex = g_present_family;
+    if (vkCreateCommandPool(g_device, &pool_info, nullptr, &g_present_command_pool) != VK_SUCCESS) {
+        SDL_Log("Failed to create present command pool");
+        return 1;
+    }
+
+    VkSemaphoreCreateInfo sem_info = {};
+    sem_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    g_present_ready_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
+    for (VkSemaphore& semaphore : g_present_ready_semaphores) {
+        if (vkCreateSemaphore(g_device, &sem_info, nullptr, &semaphore) != VK_SUCCESS) {
+            SDL_Log("Failed to create present semaphores");
+            return 2;
+        }
+    }
+    return record_present_acquires() != 0 ? 3 : 0;
+}
+
+static uint32_t find_memory_type(uint32_t type_bits, VkMemoryPropertyFlags properties) {
+    for (uint32_t i = 0; i < g_memory_properties.memoryTypeCount; i++) {
+        if ((type_bits & (1u << i)) &&
+            (g_memory_properties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+    return UINT32_MAX;
+}
+
+// compute_shared buffers are written on the async compute queue and read by
+// graphics; sharing them concurrently avoids an ownership transfer per frame
+static int create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+                         VkBuffer* buffer, VkDeviceMemory* memory, bool compute_shared = false) {
+    uint32_t families[] = {g_graphics_family, g_compute_family};
+
+    VkBufferCreateInfo buffer_info = {};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = size;
+    buffer_info.usage = usage;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (compute_shared && g_compute_queue) {
+        buffer_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        buffer_info.queueFamilyIndexCount = 2;
+        buffer_info.pQueueFamilyIndices = families;
+    }
+
+    if (vkCreateBuffer(g_device, &buffer_info, nullptr, buffer) != VK_SUCCESS) {
+        SDL_Log("Failed to create buffer");
+        return 1;
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(g_device, *buffer, &requirements);
+
+    VkMemoryAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloc_info.allocationSize = requirements.size;
+    alloc_info.memoryTypeIndex = find_memory_type(requirements.memoryTypeBits, properties);
+
+    if (alloc_info.memoryTypeIndex == UINT32_MAX ||
+        vkAllocateMemory(g_device, &alloc_info, nullptr, memory) != VK_SUCCESS) {
+        SDL_Log("Failed to allocate buffer memory");
+        vkDestroyBuffer(g_device, *buffer, nullptr);
+        *buffer = VK_NULL_HANDLE;
+        return 2;
+    }
+
+    vkBindBufferMemory(g_device, *buffer, *memory, 0);
+    return 0;
+}
+
+static int create_image(uint32_t width, uint32_t height, uint32_t mip_levels, VkSampleCountFlagBits samples,
+                        VkFormat format, VkImageUsageFlags usage, VkImage* image, VkDeviceMemory* memory,
+                        VkImageCreateFlags flags = 0, uint32_t array_layers = 1) {
+    VkImageCreateInfo image_info = {};
+    image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_info.flags = flags;
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.format = format;
+    image_info.extent = {width, height, 1};
+    image_info.mipLevels = mip_levels;
+    image_info.arrayLayers = array_layers;
+    image_info.samples = samples;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.usage = usage;
+    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    if (vkCreateImage(g_device, &image_info, nullptr, image) != VK_SUCCESS) {
+        SDL_Log("Failed to create image");
+        return 1;
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(g_device, *image, &requirements);
+
+    VkMemoryAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloc_info.allocationSize = requirements.size;
+    alloc_info.memoryTypeIndex = UINT32_MAX;
+    // Transient attachments never leave tile memory on tilers, which may
+    // then never back lazily allocated memory at all
+    if (usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) {
+        alloc_info.memoryTypeIndex = find_memory_type(requirements.memoryTypeBits,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+    }
+    if (alloc_info.memoryTypeIndex == UINT32_MAX) {
+        alloc_info.memoryTypeIndex = find_memory_type(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+
+    if (alloc_info.memoryTypeIndex == UINT32_MAX ||
+        vkAllocateMemory(g_device, &alloc_info, nullptr, memory) != VK_SUCCESS) {
+        SDL_Log("Failed to allocate image memory");
+        vkDestroyImage(g_device, *image, nullptr);
+        *image = VK_NULL_HANDLE;
+        return 2;
+    }
+
+    vkBindImageMemory(g_device, *image, *memory, 0);
+    return 0;
+}
+
+static VkImageAspectFlags depth_aspect(VkFormat format) {
+    VkImageAspectFlags aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    if (format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT) {
+        aspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
+    return aspect;
+}
+
+// Stencil is unused, so plain D32 first; the packed formats cover devices
+// without it as an attachment
+static VkFormat choose_depth_format() {
+    const VkFormat candidates[] = {
+        VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT
+    };
+    for (VkFormat format : candidates) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(g_physical_device, format, &properties);
+        if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) return format;
+    }
+    return VK_FORMAT_UNDEFINED;
+}
+
+static int create_attachment_view(VkImage image, VkFormat format, VkImageAspectFlags aspect, VkImageView* view) {
+    VkImageViewCreateInfo view_info = {};
+    view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_info.image = image;
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format = format;
+    view_info.subresourceRange.aspectMask = aspect;
+    view_info.subresourceRange.levelCount = 1;
+    view_info.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(g_device, &view_info, nullptr, view) != VK_SUCCESS) {
+        SDL_Log("Failed to create attachment view");
+        return 1;
+    }
+    return 0;
+}
+
+// Highest of 8x, 4x and 2x up to the request that color and depth
+// attachments both support
+static VkSampleCountFlagBits clamp_sample_count(uint32_t requested) {
+    const VkSampleCountFlagBits counts[] = {VK_SAMPLE_COUNT_8_BIT, VK_SAMPLE_COUNT_4_BIT, VK_SAMPLE_COUNT_2_BIT};
+    for (VkSampleCountFlagBits count : counts) {
+        if (static_cast<uint32_t>(count) <= requested && (g_supported_sample_counts & count)) return count;
+    }
+    return VK_SAMPLE_COUNT_1_BIT;
+}
+
+// Temporal upscaling antialiases on its own and keeps the main pass at one
+// sample; the requested count applies again once it is off
+static VkSampleCountFlagBits main_sample_count() {
+    return g_temporal_upscaling ? VK_SAMPLE_COUNT_1_BIT : clamp_sample_count(g_requested_msaa);
+}
+
+static VkExtent2D scaled_extent(float scale) {
+    VkExtent2D extent = {};
+    extent.width = std::max(1u, static_cast<uint32_t>(std::lround(g_swapchain_extent.width * scale)));
+    extent.height = std::max(1u, static_cast<uint32_t>(std::lround(g_swapchain_extent.height * scale)));
+    return extent;
+}
+
+// Point both temporal sets at the current attachments: each samples the
+// scene, the motion vectors and the history it does not write
+static void write_temporal_descriptors() {
+    for (uint32_t i = 0; i < 2; i++) {
+        VkDescriptorImageInfo images[4] = {};
+        images[0] = {g_temporal_sampler, g_scene_color_view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        images[1] = {g_temporal_sampler, g_motion_view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        images[2] = {g_temporal_sampler, g_history_views[1 - i], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        images[3] = {VK_NULL_HANDLE, g_history_views[i], VK_IMAGE_LAYOUT_GENERAL};
+
+        VkWriteDescriptorSet writes[4] = {};
+        for (uint32_t b = 0; b < 4; b++) {
+            writes[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[b].dstSet = g_temporal_sets[i];
+            writes[b].dstBinding = b;
+            writes[b].descriptorCount = 1;
+            writes[b].descriptorType = b < 3 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+                                             : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            writes[b].pImageInfo = &images[b];
+        }
+        vkUpdateDescriptorSets(g_device, 4, writes, 0, nullptr);
+    }
+}
+
+// Motion vectors and the two history images of temporal upscaling. The
+// history starts out invalid, so the first frame ignores it.
+static int create_temporal_attachments() {
+    uint32_t width = g_swapchain_extent.width;
+    uint32_t height = g_swapchain_extent.height;
+    if (create_image(width, height, 1, VK_SAMPLE_COUNT_1_BIT, MOTION_FORMAT,
+                     VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                     &g_motion_image, &g_motion_memory) != 0) {
+        return 1;
+    }
+    if (create_attachment_view(g_motion_image, MOTION_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT, &g_motion_view) != 0) {
+        return 2;
+    }
+    for (uint32_t i = 0; i < 2; i++) {
+        if (create_image(width, height, 1, VK_SAMPLE_COUNT_1_BIT, HISTORY_FORMAT,
+                         VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                         &g_history_images[i], &g_history_memory[i]) != 0) {
+            return 3;
+        }
+        if (create_attachment_view(g_history_images[i], HISTORY_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT,
+                                   &g_history_views[i]) != 0) {
+            return 4;
+        }
+    }
+    g_history_valid = false;
+    write_temporal_descriptors();
+    return 0;
+}
+
+// Transient attachments of the post subpasses, or under dynamic rendering
+// just the scene target as post.comp's storage image
+static int create_post_attachments() {
+    if (post_compute_active()) {
+        VkDescriptorImageInfo image = {VK_NULL_HANDLE, g_scene_color_view, VK_IMAGE_LAYOUT_GENERAL};
+        VkWriteDescriptorSet write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = g_post_sets[0];
+        write.dstBinding = 0;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        write.pImageInfo = &image;
+        vkUpdateDescriptorSets(g_device, 1, &write, 0, nullptr);
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < post_attachment_count(); i++) {
+        if (create_image(g_swapchain_extent.width, g_swapchain_extent.height, 1, VK_SAMPLE_COUNT_1_BIT,
+                         POST_COMPUTE_FORMAT,
+                         VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT |
+                         VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+                         &g_post_images[i], &g_post_memory[i]) != 0) {
+            return 1;
+        }
+        if (create_attachment_view(g_post_images[i], POST_COMPUTE_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT,
+                                   &g_post_views[i]) != 0) {
+            return 2;
+        }
+
+        VkDescriptorImageInfo image = {VK_NULL_HANDLE, g_post_views[i], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        VkWriteDescriptorSet write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = g_post_sets[i];
+        write.dstBinding = 0;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        write.pImageInfo = &image;
+        vkUpdateDescriptorSets(g_device, 1, &write, 0, nullptr);
+    }
+    return 0;
+}
+
+// The OIT sums the composite reads, plus under MSAA the multisampled pair
+// transparent instances are drawn into and resolved from. Read as input
+// attachments they never leave the render pass; under dynamic rendering
+// the composite pass samples them.
+static int create_oit_attachments() {
+    uint32_t width = g_swapchain_extent.width;
+    uint32_t height = g_swapchain_extent.height;
+    const VkFormat formats[2] = {OIT_ACCUM_FORMAT, OIT_REVEAL_FORMAT};
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    usage |= g_dynamic_rendering_supported ? VK_IMAGE_USAGE_SAMPLED_BIT
+                                           : VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    bool msaa = g_msaa_samples != VK_SAMPLE_COUNT_1_BIT;
+
+    VkDescriptorImageInfo images[2] = {};
+    VkWriteDescriptorSet writes[2] = {};
+    for (uint32_t i = 0; i < 2; i++) {
+        if (create_image(width, height, 1, VK_SAMPLE_COUNT_1_BIT, formats[i], usage,
+                         &g_oit_images[i], &g_oit_memory[i]) != 0) {
+            return 1;
+        }
+        if (create_attachment_view(g_oit_images[i], formats[i], VK_IMAGE_ASPECT_COLOR_BIT, &g_oit_views[i]) != 0) {
+            return 2;
+        }
+        if (msaa) {
+            if (create_image(width, height, 1, g_msaa_samples, formats[i],
+                             VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+                             &g_oit_msaa_images[i], &g_oit_msaa_memory[i]) != 0) {
+                return 3;
+            }
+            if (create_attachment_view(g_oit_msaa_images[i], formats[i], VK_IMAGE_ASPECT_COLOR_BIT,
+                                       &g_oit_msaa_views[i]) != 0) {
+                return 4;
+            }
+        }
+
+        images[i] = {g_oit_sampler, g_oit_views[i], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = g_oit_set;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = g_dynamic_rendering_supported ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+                                                                 : VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        writes[i].pImageInfo = &images[i];
+    }
+    vkUpdateDescriptorSets(g_device, 2, writes, 0, nullptr);
+    return 0;
+}
+
+// Depth buffer and, with MSAA, the multisampled color target when the
+// render pass framebuffers need them; under dynamic rendering the frame
+// graph allocates both as transients. When the main pass does not draw into
+// the swapchain image also the scene color target, which the passes after
+// it read, and any post-process attachments.
+static int create_attachments() {
+    g_render_extent = g_swapchain_extent;
+    if (g_dynamic_resolution) {
+        g_render_extent = scaled_extent(g_resolution.scale());
+    } else if (g_temporal_upscaling) {
+        g_render_extent = scaled_extent(g_temporal_scale);
+    }
+
+    if (g_depth_format == VK_FORMAT_UNDEFINED) {
+        g_depth_format = choose_depth_format();
+        if (g_depth_format == VK_FORMAT_UNDEFINED) {
+            SDL_Log("No supported depth format");
+            return 1;
+        }
+    }
+
+    uint32_t width = g_swapchain_extent.width;
+    uint32_t height = g_swapchain_extent.height;
+    if (!g_dynamic_rendering_supported) {
+        if (create_image(width, height, 1, g_msaa_samples, g_depth_format,
+                         VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+                         &g_depth_image, &g_depth_memory) != 0) {
+            return 2;
+        }
+        if (create_attachment_view(g_depth_image, g_depth_format, depth_aspect(g_depth_format), &g_depth_view) != 0) {
+            return 3;
+        }
+    }
+
+    // Post effects work on unclamped color: the main pass renders HDR for
+    // post.comp to load and store, or for the post subpasses to read
+    VkFormat color_format = g_post_effects != 0 ? POST_COMPUTE_FORMAT : g_swapchain_format;
+    g_main_color_formats[MAIN_COLOR_SLOT] = color_format;
+    g_main_color_formats[MAIN_MOTION_SLOT] = g_temporal_upscaling ? MOTION_FORMAT : VK_FORMAT_UNDEFINED;
+    if (scene_target_active()) {
+        // Blitted by the upscale, sampled by temporal.comp or processed by
+        // post.comp. The last post subpass writes it already tone mapped.
+        VkFormat scene_format = post_subpasses_active() ? g_swapchain_format : color_format;
+        VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        if (g_temporal_upscaling) usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+        if (post_compute_active()) usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+        if (create_image(width, height, 1, VK_SAMPLE_COUNT_1_BIT, scene_format, usage,
+                         &g_scene_color_image, &g_scene_color_memory) != 0) {
+            return 6;
+        }
+        if (create_attachment_view(g_scene_color_image, scene_format, VK_IMAGE_ASPECT_COLOR_BIT,
+                                   &g_scene_color_view) != 0) {
+            return 7;
+        }
+    }
+    if (g_temporal_upscaling && create_temporal_attachments() != 0) return 8;
+    if (g_post_effects != 0 && create_post_attachments() != 0) return 9;
+    if (oit_active() && create_oit_attachments() != 0) return 10;
+
+    if (g_msaa_samples == VK_SAMPLE_COUNT_1_BIT || g_dynamic_rendering_supported) return 0;
+    if (create_image(width, height, 1, g_msaa_samples, color_format,
+                     VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+                     &g_msaa_color_image, &g_msaa_color_memory) != 0) {
+        return 4;
+    }
+    if (create_attachment_view(g_msaa_color_image, color_format, VK_IMAGE_ASPECT_COLOR_BIT,
+                               &g_msaa_color_view) != 0) {
+        return 5;
+    }
+    return 0;
+}
+
+// Highest upload batch the GPU has finished
+static uint64_t upload_completed_value() {
+    if (g_upload_timeline) {
+        uint64_t value = 0;
+        g_vk.vkGetSemaphoreCounterValue(g_device, g_upload_timeline, &value);
+        return value;
+    }
+    if (g_upload_completed < g_upload_submitted &&
+        g_vk.vkGetFenceStatus(g_device, g_upload_fence) == VK_SUCCESS) {
+        g_upload_completed = g_upload_submitted;
+    }
+    return g_upload_completed;
+}
+
+static void wait_for_uploads(uint64_t batch) {
+    if (batch == 0 || upload_completed_value() >= batch) return;
+
+    if (g_upload_timeline) {
+        VkSemaphoreWaitInfo wait_info = {};
+        wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        wait_info.semaphoreCount = 1;
+        wait_info.pSemaphores = &g_upload_timeline;
+        wait_info.pValues = &batch;
+        vkWaitSemaphores(g_device, &wait_info, UINT64_MAX);
+    } else {
+        vkWaitForFences(g_device, 1, &g_upload_fence, VK_TRUE, UINT64_MAX);
+        g_upload_completed = g_upload_submitted;
+    }
+}
+
+static bool transfer_copies_done() {
+    if (g_transfer_busy && g_vk.vkGetFenceStatus(g_device, g_transfer_fence) == VK_SUCCESS) {
+        g_transfer_busy = false;
+    }
+    return !g_transfer_busy;
+}
+
+// The staging buffer is free once the copies reading it are done
+static void wait_for_staging() {
+    if (g_transfer_queue) {
+        if (!transfer_copies_done()) {
+            vkWaitForFences(g_device, 1, &g_transfer_fence, VK_TRUE, UINT64_MAX);
+            g_transfer_busy = false;
+        }
+    } else {
+        wait_for_uploads(g_upload_submitted);
+    }
+}
+
+static void destroy_staging_buffer() {
+    wait_for_staging();
+    if (g_staging_memory) {
+        vkUnmapMemory(g_device, g_staging_memory);
+        vkFreeMemory(g_device, g_staging_memory, nullptr);
+    }
+    if (g_staging_buffer) vkDestroyBuffer(g_device, g_staging_buffer, nullptr);
+    g_staging_buffer = VK_NULL_HANDLE;
+    g_staging_memory = VK_NULL_HANDLE;
+    g_staging_mapped = nullptr;
+    g_staging_size = 0;
+    g_staging_offset = 0;
+}
+
+static int create_staging_buffer(VkDeviceSize size) {
+    if (create_buffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                      &g_staging_buffer, &g_staging_memory) != 0) {
+        return 1;
+    }
+    void* mapped = nullptr;
+    if (vkMapMemory(g_device, g_staging_memory, 0, size, 0, &mapped) != VK_SUCCESS) {
+        SDL_Log("Failed to map staging buffer");
+        vkFreeMemory(g_device, g_staging_memory, nullptr);
+        vkDestroyBuffer(g_device, g_staging_buffer, nullptr);
+        g_staging_buffer = VK_NULL_HANDLE;
+        g_staging_memory = VK_NULL_HANDLE;
+        return 2;
+    }
+    g_staging_mapped = static_cast<uint8_t*>(mapped);
+    g_staging_size = size;
+    g_staging_offset = 0;
+    return 0;
+}
+
+static int create_upload_resources() {
+    VkFormatProperties format_props;
+    vkGetPhysicalDeviceFormatProperties(g_physical_device, TEXTURE_FORMAT, &format_props);
+    VkFormatFeatureFlags blit_features = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                         VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    g_texture_mips_supported = (format_props.optimalTilingFeatures & blit_features) == blit_features;
+    if (!g_texture_mips_supported) {
+        SDL_Log("Texture format does not support linear blits, mipmaps disabled");
+    }
+
+    VkCommandBufferAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.commandPool = g_command_pool;
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc_info.commandBufferCount = 1;
+
+    if (vkAllocateCommandBuffers(g_device, &alloc_info, &g_upload_command_buffer) != VK_SUCCESS) {
+        SDL_Log("Failed to allocate upload command buffer");
+        return 1;
+    }
+
+    if (g_timeline_supported) {
+        VkSemaphoreTypeCreateInfo type_info = {};
+        type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        type_info.initialValue = 0;
+
+        VkSemaphoreCreateInfo semaphore_info = {};
+        semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphore_info.pNext = &type_info;
+        if (vkCreateSemaphore(g_device, &semaphore_info, nullptr, &g_upload_timeline) != VK_SUCCESS) {
+            SDL_Log("Failed to create upload timeline semaphore");
+            return 2;
+        }
+    } else {
+        VkFenceCreateInfo fence_info = {};
+        fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        if (vkCreateFence(g_device, &fence_info, nullptr, &g_upload_fence) != VK_SUCCESS) {
+            SDL_Log("Failed to create upload fence");
+            return 2;
+        }
+    }
+
+    if (g_transfer_queue) {
+        VkCommandPoolCreateInfo pool_info = {};
+        pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        pool_info.queueFamilyIndex = g_transfer_family;
+
+        VkSemaphoreCreateInfo semaphore_info = {};
+        semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        VkFenceCreateInfo fence_info = {};
+        fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+        if (vkCreateCommandPool(g_device, &pool_info, nullptr, &g_transfer_command_pool) != VK_SUCCESS ||
+            vkCreateSemaphore(g_device, &semaphore_info, nullptr, &g_transfer_semaphore) != VK_SUCCESS ||
+            vkCreateFence(g_device, &fence_info, nullptr, &g_transfer_fence) != VK_SUCCESS) {
+            SDL_Log("Failed to create transfer queue resources");
+            return 4;
+        }
+
+        alloc_info.commandPool = g_transfer_command_pool;
+        if (vkAllocateCommandBuffers(g_device, &alloc_info, &g_transfer_command_buffer) != VK_SUCCESS) {
+            SDL_Log("Failed to allocate transfer command buffer");
+            return 4;
+        }
+    }
+
+    return create_staging_buffer(STAGING_BUFFER_SIZE) != 0 ? 3 : 0;
+}
+
+// The single pass downsampler samples mip 0 with linear filtering and writes
+// the levels below through UNORM storage views of the sRGB texture. Compute
+// shaders with subgroup quad operations combine texels without shared memory.
+static int create_texture_downsampler() {
+    VkFormatProperties sampled_props;
+    VkFormatProperties storage_props;
+    vkGetPhysicalDeviceFormatProperties(g_physical_device, TEXTURE_FORMAT, &sampled_props);
+    vkGetPhysicalDeviceFormatProperties(g_physical_device, hxo::Downsampler::STORAGE_FORMAT, &storage_props);
+    if (!(sampled_props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ||
+        !(storage_props.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT)) {
+        SDL_Log("Texture format cannot be downsampled in compute, mipmaps use blits");
+        return 0;
+    }
+
+    VkPhysicalDeviceSubgroupProperties subgroup_props = {};
+    subgroup_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+    VkPhysicalDeviceProperties2 props2 = {};
+    props2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    props2.pNext = &subgroup_props;
+    vkGetPhysicalDeviceProperties2(g_physical_device, &props2);
+    bool quads = (subgroup_props.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) &&
+                 (subgroup_props.supportedOperations & VK_SUBGROUP_FEATURE_QUAD_BIT);
+
+    auto comp_code = read_file(quads ? "downsample.comp.spv" : "downsample_shared.comp.spv");
+    if (comp_code.empty()) {
+        SDL_Log("Failed to load downsample shader");
+        return 1;
+    }
+    VkShaderModule comp_module = create_shader_module(comp_code);
+    if (!comp_module) return 2;
+
+    bool created = g_downsampler.init(g_device, g_vk, g_memory_properties, comp_module);
+    vkDestroyShaderModule(g_device, comp_module, nullptr);
+    if (!created) return 3;
+
+    g_texture_downsample = true;
+    g_texture_mips_supported = true;
+    SDL_Log("Texture mipmaps: single pass downsampler (%s)", quads ? "subgroup quads" : "shared memory");
+    return 0;
+}
+
+static VkImageMemoryBarrier texture_barrier(const Texture& tex, uint32_t base_mip, uint32_t mip_count,
+                                            VkImageLayout old_layout, VkImageLayout new_layout,
+                                            VkAccessFlags src_access, VkAccessFlags dst_access) {
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = src_access;
+    barrier.dstAccessMask = dst_access;
+    barrier.oldLayout = old_layout;
+    barrier.newLayout = new_layout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = tex.image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = base_mip;
+    barrier.subresourceRange.levelCount = mip_count;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    return barrier;
+}
+
+static int write_texture_descriptor(uint32_t index, Texture& tex);
+
+static void begin_upload_commands(VkCommandBuffer cmd) {
+    vkResetCommandBuffer(cmd, 0);
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(cmd, &begin_info);
+}
+
+// Every mip of every texture: UNDEFINED -> TRANSFER_DST, then level 0 from
+// the staging buffer. Runs on the transfer queue when there is one.
+static void record_upload_copies(VkCommandBuffer cmd, const std::vector<PendingUpload>& uploads) {
+    std::vector<VkImageMemoryBarrier> barriers;
+    barriers.reserve(uploads.size());
+    for (const auto& upload : uploads) {
+        const Texture& tex = g_textures[upload.texture];
+        barriers.push_back(texture_barrier(tex, 0, tex.mip_levels,
+            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            0, VK_ACCESS_TRANSFER_WRITE_BIT));
+    }
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+        0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+    for (const auto& upload : uploads) {
+        const Texture& tex = g_textures[upload.texture];
+        VkBufferImageCopy region = {};
+        region.bufferOffset = upload.staging_offset;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = {tex.width, tex.height, 1};
+        vkCmdCopyBufferToImage(cmd, g_staging_buffer, tex.image,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    }
+}
+
+// Hand every mip from the transfer family to the graphics family. The
+// release (transfer queue) and acquire (graphics queue) halves must describe
+// the same transfer; the layout stays TRANSFER_DST.
+static void record_ownership_transfer(VkCommandBuffer cmd, const std::vector<PendingUpload>& uploads,
+                                      bool acquire) {
+    VkAccessFlags src_access = acquire ? VkAccessFlags(0) : VK_ACCESS_TRANSFER_WRITE_BIT;
+    VkAccessFlags dst_access = acquire ? VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT : VkAccessFlags(0);
+
+    std::vector<VkImageMemoryBarrier> barriers;
+    barriers.reserve(uploads.size());
+    for (const auto& upload : uploads) {
+        const Texture& tex = g_textures[upload.texture];
+        VkImageMemoryBarrier barrier = texture_barrier(tex, 0, tex.mip_levels,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            src_access, dst_access);
+        barrier.srcQueueFamilyIndex = g_transfer_family;
+        barrier.dstQueueFamilyIndex = g_graphics_family;
+        barriers.push_back(barrier);
+    }
+    VkPipelineStageFlags src_stage = acquire ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT : VK_PIPELINE_STAGE_TRANSFER_BIT;
+    VkPipelineStageFlags dst_stage = acquire ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    vkCmdPipelineBarrier(cmd, src_stage, dst_stage, 0,
+        0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+}
+
+// Generate the mip chain level by level: level-1 becomes a blit source for
+// every texture that has a level at this depth, then all blits are recorded.
+// Ends with every level in SHADER_READ_ONLY. Blits need the graphics queue.
+static void record_upload_mips(VkCommandBuffer cmd, const std::vector<PendingUpload>& uploads) {
+    std::vector<VkImageMemoryBarrier> barriers;
+    barriers.reserve(uploads.size() * 2);
+    uint32_t max_levels = 1;
+    for (const auto& upload : uploads) {
+        max_levels = std::max(max_levels, g_textures[upload.texture].mip_levels);
+    }
+
+    for (uint32_t level = 1; level < max_levels; level++) {
+        barriers.clear();
+        for (const auto& upload : uploads) {
+            const Texture& tex = g_textures[upload.texture];
+            if (level >= tex.mip_levels) continue;
+            barriers.push_back(texture_barrier(tex, level - 1, 1,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT));
+        }
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+            0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+        for (const auto& upload : uploads) {
+            const Texture& tex = g_textures[upload.texture];
+            if (level >= tex.mip_levels) continue;
+
+            int32_t src_w = static_cast<int32_t>(std::max(tex.width >> (level - 1), 1u));
+            int32_t src_h = static_cast<int32_t>(std::max(tex.height >> (level - 1), 1u));
+            int32_t dst_w = static_cast<int32_t>(std::max(tex.width >> level, 1u));
+            int32_t dst_h = static_cast<int32_t>(std::max(tex.height >> level, 1u));
+
+            VkImageBlit blit = {};
+            blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            blit.srcSubresource.mipLevel = level - 1;
+            blit.srcSubresource.baseArrayLayer = 0;
+            blit.srcSubresource.layerCount = 1;
+            blit.srcOffsets[0] = {0, 0, 0};
+            blit.srcOffsets[1] = {src_w, src_h, 1};
+            blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            blit.dstSubresource.mipLevel = level;
+            blit.dstSubresource.baseArrayLayer = 0;
+            blit.dstSubresource.layerCount = 1;
+            blit.dstOffsets[0] = {0, 0, 0};
+            blit.dstOffsets[1] = {dst_w, dst_h, 1};
+
+            vkCmdBlitImage(cmd,
+                tex.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                tex.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                1, &blit, VK_FILTER_LINEAR);
+        }
+    }
+
+    // Final transition to SHADER_READ_ONLY: all levels but the last were blit
+    // sources, the last one is still a transfer destination
+    barriers.clear();
+    for (const auto& upload : uploads) {
+        const Texture& tex = g_textures[upload.texture];
+        if (tex.mip_levels > 1) {
+            barriers.push_back(texture_barrier(tex, 0, tex.mip_levels - 1,
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT));
+        }
+        barriers.push_back(texture_barrier(tex, tex.mip_levels - 1, 1,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT));
+    }
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+        0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+}
+
+// The same in one dispatch per texture: level 0 becomes sampled and the rest
+// storage, the downsampler writes every level below, then those become
+// SHADER_READ_ONLY too. Two barriers for the whole batch, plus one more per
+// MAX_MIPS levels past the first dispatch (textures above 4096): each later
+// dispatch reads the last level the one before it wrote.
+static int record_upload_downsample(VkCommandBuffer cmd, const std::vector<PendingUpload>& uploads) {
+    constexpr uint32_t MAX_MIPS = hxo::Downsampler::MAX_MIPS;
+    std::vector<VkImageMemoryBarrier> barriers;
+    barriers.reserve(uploads.size() * 2);
+    uint32_t dispatches = 0;
+    for (const auto& upload : uploads) {
+        const Texture& tex = g_textures[upload.texture];
+        barriers.push_back(texture_barrier(tex, 0, 1,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT));
+        if (tex.mip_levels > 1) {
+            barriers.push_back(texture_barrier(tex, 1, tex.mip_levels - 1,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
+                0, VK_ACCESS_SHADER_WRITE_BIT));
+            dispatches += (tex.mip_levels - 2) / MAX_MIPS + 1;
+        }
+    }
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+        0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+    // The previous batch has completed, so its views and sets can go
+    if (!g_downsampler.begin(dispatches)) return 1;
+    for (uint32_t base = 0;; base += MAX_MIPS) {
+        barriers.clear();
+        for (const auto& upload : uploads) {
+            const Texture& tex = g_textures[upload.texture];
+            if (tex.mip_levels <= base + 1) continue;
+
+            hxo::Downsampler::Target target;
+            target.image = tex.image;
+            target.sampled_format = TEXTURE_FORMAT;
+            target.srgb = true;
+            target.base_mip = base;
+            target.width = std::max(tex.width >> base, 1u);
+            target.height = std::max(tex.height >> base, 1u);
+            target.mip_levels = tex.mip_levels - base;
+            if (!g_downsampler.record(cmd, target)) return 2;
+
+            // The next dispatch samples the last of these levels
+            barriers.push_back(texture_barrier(tex, base + 1, std::min(tex.mip_levels - 1 - base, MAX_MIPS),
+                VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT));
+        }
+        if (barriers.empty()) break;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+            0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+    }
+    return 0;
+}
+
+// Submit the graphics half of a batch: the copies too when there is no
+// transfer queue, otherwise the ownership acquire after waiting on the
+// transfer semaphore. Frames sampling these textures are submitted later on
+// the same queue, so the final barrier orders them; nothing here waits on
+// the GPU. Signals the batch number on the upload timeline.
+static int submit_upload_batch(const std::vector<PendingUpload>& uploads, bool from_transfer_queue) {
+    // The previous batch still owns the command buffer until it completes
+    wait_for_uploads(g_upload_submitted);
+
+    VkCommandBuffer cmd = g_upload_command_buffer;
+    begin_upload_commands(cmd);
+    if (from_transfer_queue) {
+        record_ownership_transfer(cmd, uploads, true);
+    } else {
+        record_upload_copies(cmd, uploads);
+    }
+    if (!g_texture_downsample) {
+        record_upload_mips(cmd, uploads);
+    } else if (record_upload_downsample(cmd, uploads) != 0) {
+        SDL_Log("Failed to record texture mip generation");
+        vkEndCommandBuffer(cmd);
+        return 2;
+    }
+    vkEndCommandBuffer(cmd);
+
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &cmd;
+
+    VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    if (from_transfer_queue) {
+        submit_info.waitSemaphoreCount = 1;
+        submit_info.pWaitSemaphores = &g_transfer_semaphore;
+        submit_info.pWaitDstStageMask = &wait_stage;
+    }
+
+    uint64_t batch = g_upload_submitted + 1;
+    VkTimelineSemaphoreSubmitInfo timeline_info = {};
+    timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timeline_info.signalSemaphoreValueCount = 1;
+    timeline_info.pSignalSemaphoreValues = &batch;
+
+    VkFence fence = VK_NULL_HANDLE;
+    if (g_upload_timeline) {
+        submit_info.pNext = &timeline_info;
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &g_upload_timeline;
+    } else {
+        fence = g_upload_fence;
+        vkResetFences(g_device, 1, &fence);
+    }
+
+    if (vkQueueSubmit(g_graphics_queue, 1, &submit_info, fence) != VK_SUCCESS) {
+        SDL_Log("Failed to submit texture uploads");
+        return 1;
+    }
+    g_upload_submitted = batch;
+
+    // Sampling is safe from here on; bindless slots showed white until now.
+    // Frames already submitted may still read the white descriptor, so the
+    // write waits for the last of them (UPDATE_UNUSED_WHILE_PENDING only
+    // covers slots no pending frame uses).
+    for (const auto& upload : uploads) {
+        g_textures[upload.texture].ready = true;
+        if (g_bindless_supported && from_transfer_queue) {
+            g_deferred_descriptors.push_back({upload.texture, g_frame_count + MAX_FRAMES_IN_FLIGHT - 1});
+        }
+    }
+    return 0;
+}
+
+// Called after this frame's fence wait: every frame before
+// g_frame_count - MAX_FRAMES_IN_FLIGHT + 1 has completed
+static void apply_deferred_descriptors() {
+    size_t kept = 0;
+    for (const auto& deferred : g_deferred_descriptors) {
+        if (deferred.frame > g_frame_count) {
+            g_deferred_descriptors[kept++] = deferred;
+        } else {
+            write_texture_descriptor(deferred.texture, g_textures[deferred.texture]);
+        }
+    }
+    g_deferred_descriptors.resize(kept);
+}
+
+// Move the batch waiting on the transfer queue to the graphics queue, whether
+// or not its copies are done yet; the GPU waits on the transfer semaphore
+static int finish_transfer_uploads() {
+    if (g_transfer_uploads.empty()) return 0;
+    int result = submit_upload_batch(g_transfer_uploads, true);
+    g_transfer_uploads.clear();
+    return result;
+}
+
+// Called every frame: finish a transfer batch only once its copies are done,
+// so the graphics queue never stalls on them
+static int advance_transfer_uploads() {
+    if (g_transfer_uploads.empty() || !transfer_copies_done()) return 0;
+    return finish_transfer_uploads();
+}
+
+// Submit every pending upload as one batch. Layout transitions for all
+// textures in the batch share a pipeline barrier per mip level rather than
+// one barrier per texture per level. With a dedicated transfer queue only the
+// copies are submitted here; the mips follow on the graphics queue once the
+// copies land, while frames keep rendering.
+static int flush_texture_uploads() {
+    if (advance_transfer_uploads() != 0) return 1;
+    if (g_pending_uploads.empty()) return 0;
+
+    if (!g_transfer_queue) {
+        int result = submit_upload_batch(g_pending_uploads, false);
+        g_pending_uploads.clear();
+        g_staging_offset = 0;
+        return result;
+    }
+
+    // One batch per stage: the previous one moves on to the graphics queue
+    // and its copies must be done before the transfer command buffer is reused
+    if (finish_transfer_uploads() != 0) return 1;
+    wait_for_staging();
+
+    VkCommandBuffer cmd = g_transfer_command_buffer;
+    begin_upload_commands(cmd);
+    record_upload_copies(cmd, g_pending_uploads);
+    record_ownership_transfer(cmd, g_pending_uploads, false);
+    vkEndCommandBuffer(cmd);
+
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &cmd;
+    submit_info.signalSemaphoreCount = 1;
+    submit_info.pSignalSemaphores = &g_transfer_semaphore;
+
+    vkResetFences(g_device, 1, &g_transfer_fence);
+    if (vkQueueSubmit(g_transfer_queue, 1, &submit_info, g_transfer_fence) != VK_SUCCESS) {
+        SDL_Log("Failed to submit texture copies");
+        return 1;
+    }
+    g_transfer_busy = true;
+
+    g_transfer_uploads.swap(g_pending_uploads);
+    g_pending_uploads.clear();
+    g_staging_offset = 0;
+    return 0;
+}
+
+static void destroy_texture_resources(Texture& tex) {
+    if (tex.set) vkFreeDescriptorSets(g_device, g_texture_descriptor_pool, 1, &tex.set);
+    if (tex.view) vkDestroyImageView(g_device, tex.view, nullptr);
+    if (tex.image) vkDestroyImage(g_device, tex.image, nullptr);
+    if (tex.memory) vkFreeMemory(g_device, tex.memory, nullptr);
+    uint8_t generation = tex.generation;
+    tex = Texture{};
+    tex.generation = generation;
+}
+
+// Point the texture's descriptor at its view: a slot in the bindless table,
+// or a set of its own on the classic path
+static int write_texture_descriptor(uint32_t index, Texture& tex) {
+    VkDescriptorSet dst_set = g_bindless_set;
+    uint32_t dst_element = index;
+
+    if (!g_bindless_supported) {
+        VkDescriptorSetAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        alloc_info.descriptorPool = g_texture_descriptor_pool;
+        alloc_info.descriptorSetCount = 1;
+        alloc_info.pSetLayouts = &g_texture_set_layout;
+        if (vkAllocateDescriptorSets(g_device, &alloc_info, &tex.set) != VK_SUCCESS) {
+            SDL_Log("Failed to allocate texture descriptor set");
+            return 1;
+        }
+        dst_set = tex.set;
+        dst_element = 0;
+    }
+
+    VkDescriptorImageInfo image_info = {};
+    image_info.sampler = g_texture_sampler;
+    image_info.imageView = tex.view;
+    image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = dst_set;
+    write.dstBinding = 0;
+    write.dstArrayElement = dst_element;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &image_info;
+    vkUpdateDescriptorSets(g_device, 1, &write, 0, nullptr);
+    return 0;
+}
+
+static uint32_t create_texture(const void* pixels, uint32_t width, uint32_t height) {
+    if (!pixels || width == 0 || height == 0) return 0;
+
+    VkDeviceSize size = static_cast<VkDeviceSize>(width) * height * 4;
+
+    // Make room in the staging buffer, flushing the current batch or growing
+    // the buffer if this texture does not fit
+    if (g_staging_offset + size > g_staging_size) {
+        if (flush_texture_uploads() != 0) return 0;
+        if (size > g_staging_size) {
+            destroy_staging_buffer();
+            if (create_staging_buffer(size) != 0) return 0;
+        }
+    }
+
+    // Texture slots double as indices into the bindless table
+    uint32_t index = g_free_textures.empty() ? static_cast<uint32_t>(g_textures.size()) : g_free_textures.back();
+    if (g_bindless_supported && index >= g_bindless_capacity) {
+        SDL_Log("Bindless texture table is full (%u textures)", g_bindless_capacity);
+        return 0;
+    }
+    if (index >= TEXTURE_INDEX_MASK) {
+        SDL_Log("Out of texture handles");
+        return 0;
+    }
+
+    uint32_t mip_levels = 1;
+    if (g_texture_mips_supported) {
+        mip_levels = 32 - static_cast<uint32_t>(__builtin_clz(std::max(width, height)));
+    }
+
+    Texture tex;
+    tex.generation = index < g_textures.size() ? g_textures[index].generation : 0;
+    tex.width = width;
+    tex.height = height;
+    tex.mip_levels = mip_levels;
+
+    // The downsampler writes lower levels through UNORM views, which sRGB
+    // formats cannot be used for storage through
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    VkImageCreateFlags flags = 0;
+    if (mip_levels > 1 && g_texture_downsample) {
+        usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+        flags = VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT;
+    } else if (mip_levels > 1) {
+        usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
+
+    if (create_image(width, height, mip_levels, VK_SAMPLE_COUNT_1_BIT, TEXTURE_FORMAT, usage,
+                     &tex.image, &tex.memory, flags) != 0) {
+        return 0;
+    }
+
+    VkImageViewUsageCreateInfo view_usage = {};
+    view_usage.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_USAGE_CREATE_INFO;
+    view_usage.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+
+    VkImageViewCreateInfo view_info = {};
+    view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_info.pNext = flags ? &view_usage : nullptr;
+    view_info.image = tex.image;
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format = TEXTURE_FORMAT;
+    view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    view_info.subresourceRange.baseMipLevel = 0;
+    view_info.subresourceRange.levelCount = mip_levels;
+    view_info.subresourceRange.baseArrayLayer = 0;
+    view_info.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(g_device, &view_info, nullptr, &tex.view) != VK_SUCCESS) {
+        SDL_Log("Failed to create texture view");
+        vkDestroyImage(g_device, tex.image, nullptr);
+        vkFreeMemory(g_device, tex.memory, nullptr);
+        return 0;
+    }
+
+    // Copies on the transfer queue finish frames later; until then the
+    // bindless slot shows white (classic draws check Texture::ready)
+    Texture* shown = &tex;
+    if (g_bindless_supported && g_transfer_queue && g_white_texture != 0) {
+        shown = &g_textures[(g_white_texture & TEXTURE_INDEX_MASK) - 1];
+    }
+    if (write_texture_descriptor(index, *shown) != 0) {
+        destroy_texture_resources(tex);
+        return 0;
+    }
+
+    // Copy level 0 now; the caller's buffer need not outlive this call. A new
+    // batch reuses the staging buffer, so the last one must have finished.
+    if (g_staging_offset == 0) wait_for_staging();
+    PendingUpload upload = {};
+    upload.staging_offset = g_staging_offset;
+    memcpy(g_staging_mapped + g_staging_offset, pixels, size);
+    // bufferOffset must be a multiple of the texel size (4)
+    g_staging_offset += (size + 3) & ~VkDeviceSize(3);
+
+    if (!g_free_textures.empty()) {
+        g_free_textures.pop_back();
+        g_textures[index] = tex;
+    } else {
+        g_textures.push_back(tex);
+    }
+
+    upload.texture = index;
+    g_pending_uploads.push_back(upload);
+    return (static_cast<uint32_t>(tex.generation) << TEXTURE_INDEX_BITS) | (index + 1);
+}
+
+static Texture* get_texture(uint32_t handle) {
+    uint32_t slot = handle & TEXTURE_INDEX_MASK;
+    if (slot == 0 || slot > g_textures.size()) return nullptr;
+    Texture* tex = &g_textures[slot - 1];
+    if (tex->generation != handle >> TEXTURE_INDEX_BITS) return nullptr;
+    return tex->image ? tex : nullptr;
+}
+
+// Called after this frame's fence wait: every frame before
+// g_frame_count - MAX_FRAMES_IN_FLIGHT + 1 has completed. A retired slot
+// shows white again before it can be handed out.
+static void free_retired_textures() {
+    size_t kept = 0;
+    Texture* white = get_texture(g_white_texture);
+    for (const auto& retired : g_retired_textures) {
+        if (retired.frame > g_frame_count) {
+            g_retired_textures[kept++] = retired;
+            continue;
+        }
+        destroy_texture_resources(g_textures[retired.texture]);
+        if (g_bindless_supported && white) write_texture_descriptor(retired.texture, *white);
+        g_free_textures.push_back(retired.texture);
+    }
+    g_retired_textures.resize(kept);
+}
+
+static int create_descriptor_resources() {
+    VkSamplerCreateInfo sampler_info = {};
+    sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_info.magFilter = VK_FILTER_LINEAR;
+    sampler_info.minFilter = VK_FILTER_LINEAR;
+    sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    sampler_info.anisotropyEnable = g_anisotropy_supported ? VK_TRUE : VK_FALSE;
+    sampler_info.maxAnisotropy = g_max_anisotropy;
+    sampler_info.minLod = 0.0f;
+    sampler_info.maxLod = VK_LOD_CLAMP_NONE;
+    sampler_info.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+
+    if (vkCreateSampler(g_device, &sampler_info, nullptr, &g_texture_sampler) != VK_SUCCESS) {
+        SDL_Log("Failed to create texture sampler");
+        return 1;
+    }
+
+    // Set 0: textures
+    VkDescriptorSetLayoutBinding texture_binding = {};
+    texture_binding.binding = 0;
+    texture_binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    texture_binding.descriptorCount = g_bindless_supported ? g_bindless_capacity : 1;
+    texture_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorBindingFlags binding_flags =
+        VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+        VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT |
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo flags_info = {};
+    flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    flags_info.bindingCount = 1;
+    flags_info.pBindingFlags = &binding_flags;
+
+    VkDescriptorSetLayoutCreateInfo texture_layout_info = {};
+    texture_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    texture_layout_info.bindingCount = 1;
+    texture_layout_info.pBindings = &texture_binding;
+    if (g_bindless_supported) {
+        texture_layout_info.pNext = &flags_info;
+        texture_layout_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    }
+
+    if (vkCreateDescriptorSetLayout(g_device, &texture_layout_info, nullptr, &g_texture_set_layout) != VK_SUCCESS) {
+        SDL_Log("Failed to create texture descriptor set layout");
+        return 2;
+    }
+
+    VkDescriptorPoolSize texture_pool_size = {};
+    texture_pool_size.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+    VkDescriptorPoolCreateInfo texture_pool_info = {};
+    texture_pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    texture_pool_info.poolSizeCount = 1;
+    texture_pool_info.pPoolSizes = &texture_pool_size;
+    if (g_bindless_supported) {
+        texture_pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+        texture_pool_info.maxSets = 1;
+        texture_pool_size.descriptorCount = g_bindless_capacity;
+    } else {
+        texture_pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+        texture_pool_info.maxSets = MAX_CLASSIC_TEXTURES;
+        texture_pool_size.descriptorCount = MAX_CLASSIC_TEXTURES;
+    }
+
+    if (vkCreateDescriptorPool(g_device, &texture_pool_info, nullptr, &g_texture_descriptor_pool) != VK_SUCCESS) {
+        SDL_Log("Failed to create texture descriptor pool");
+        return 3;
+    }
+
+    if (g_bindless_supported) {
+        VkDescriptorSetAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        alloc_info.descriptorPool = g_texture_descriptor_pool;
+        alloc_info.descriptorSetCount = 1;
+        alloc_info.pSetLayouts = &g_texture_set_layout;
+        if (vkAllocateDescriptorSets(g_device, &alloc_info, &g_bindless_set) != VK_SUCCESS) {
+            SDL_Log("Failed to allocate bindless descriptor set");
+            return 4;
+        }
+    }
+
+    // Set 1: per-frame instance data, visible instance indices, last frame's
+    // models and the motion uniform; then the lights, cluster ranges, light
+    // index lists and light uniform, shared by the fragment shaders and
+    // light_cull.comp; and the shadow cascades
+    VkDescriptorSetLayoutBinding instance_bindings[9] = {};
+    for (uint32_t i = 0; i < 8; i++) {
+        bool uniform = i == 3 || i == 7;
+        instance_bindings[i].binding = i;
+        instance_bindings[i].descriptorType = uniform ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER
+                                                      : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        instance_bindings[i].descriptorCount = 1;
+        instance_bindings[i].stageFlags = i < 4 ? VK_SHADER_STAGE_VERTEX_BIT
+                                                : VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    instance_bindings[8].binding = 8;
+    instance_bindings[8].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    instance_bindings[8].descriptorCount = 1;
+    instance_bindings[8].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayoutCreateInfo instance_layout_info = {};
+    instance_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    instance_layout_info.bindingCount = 9;
+    instance_layout_info.pBindings = instance_bindings;
+
+    if (vkCreateDescriptorSetLayout(g_device, &instance_layout_info, nullptr, &g_instance_set_layout) != VK_SUCCESS) {
+        SDL_Log("Failed to create instance descriptor set layout");
+        return 5;
+    }
+
+    // Culling set: bounds, visible indices, indirect commands
+    VkDescriptorSetLayoutBinding cull_bindings[3] = {};
+    for (uint32_t i = 0; i < 3; i++) {
+        cull_bindings[i].binding = i;
+        cull_bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        cull_bindings[i].descriptorCount = 1;
+        cull_bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo cull_layout_info = {};
+    cull_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    cull_layout_info.bindingCount = 3;
+    cull_layout_info.pBindings = cull_bindings;
+
+    if (vkCreateDescriptorSetLayout(g_device, &cull_layout_info, nullptr, &g_cull_set_layout) != VK_SUCCESS) {
+        SDL_Log("Failed to create cull descriptor set layout");
+        return 5;
+    }
+
+    // Shadow set: the frame's caster matrices
+    VkDescriptorSetLayoutBinding shadow_binding = {};
+    shadow_binding.binding = 0;
+    shadow_binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    shadow_binding.descriptorCount = 1;
+    shadow_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkDescriptorSetLayoutCreateInfo shadow_layout_info = {};
+    shadow_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    shadow_layout_info.bindingCount = 1;
+    shadow_layout_info.pBindings = &shadow_binding;
+
+    if (vkCreateDescriptorSetLayout(g_device, &shadow_layout_info, nullptr, &g_shadow_set_layout) != VK_SUCCESS) {
+        SDL_Log("Failed to create shadow descriptor set layout");
+        return 5;
+    }
+
+    VkDescriptorPoolSize instance_pool_sizes[3] = {};
+    instance_pool_sizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    instance_pool_sizes[0].descriptorCount = MAX_FRAMES_IN_FLIGHT * 10;
+    instance_pool_sizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    instance_pool_sizes[1].descriptorCount = MAX_FRAMES_IN_FLIGHT * 2;
+    instance_pool_sizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    instance_pool_sizes[2].descriptorCount = MAX_FRAMES_IN_FLIGHT;
+
+    VkDescriptorPoolCreateInfo instance_pool_info = {};
+    instance_pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    instance_pool_info.maxSets = MAX_FRAMES_IN_FLIGHT * 3;
+    instance_pool_info.poolSizeCount = 3;
+    instance_pool_info.pPoolSizes = instance_pool_sizes;
+
+    if (vkCreateDescriptorPool(g_device, &instance_pool_info, nullptr, &g_instance_descriptor_pool) != VK_SUCCESS) {
+        SDL_Log("Failed to create instance descriptor pool");
+        return 6;
+    }
+    return 0;
+}
+
+static int create_instance_pipeline() {
+    auto vert_code = read_file("instance.vert.spv");
+    auto frag_code = read_file(g_bindless_supported ? "instance.frag.spv" : "instance_classic.frag.spv");
+
+    if (vert_code.empty() || frag_code.empty()) {
+        SDL_Log("Failed to load instance shaders");
+        return 1;
+    }
+
+    VkShaderModule vert_module = create_shader_module(vert_code);
+    VkShaderModule frag_module = create_shader_module(frag_code);
+
+    if (!vert_module || !frag_module) {
+        if (vert_module) vkDestroyShaderModule(g_device, vert_module, nullptr);
+        if (frag_module) vkDestroyShaderModule(g_device, frag_module, nullptr);
+        return 2;
+    }
+
+    VkPipelineShaderStageCreateInfo stages[2] = {};
+    stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = vert_module;
+    stages[0].pName = "main";
+    stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = frag_module;
+    stages[1].pName = "main";
+
+    // Motion vector outputs are compiled in only under temporal upscaling.
+    // The OIT variant writes the sums instead of the scene color.
+    VkBool32 constants[2] = {g_temporal_upscaling ? VK_TRUE : VK_FALSE, VK_TRUE};
+    VkSpecializationMapEntry constant_entries[2] = {
+        {0, 0, sizeof(VkBool32)}, {1, sizeof(VkBool32), sizeof(VkBool32)}
+    };
+    VkSpecializationInfo specialization = {1, constant_entries, sizeof(VkBool32), constants};
+    VkSpecializationInfo oit_specialization = {2, constant_entries, sizeof(constants), constants};
+    stages[0].pSpecializationInfo = &specialization;
+    stages[1].pSpecializationInfo = &specialization;
+    VkPipelineShaderStageCreateInfo oit_stages[2] = {stages[0], stages[1]};
+    oit_stages[1].pSpecializationInfo = &oit_specialization;
+
+    // Quad corners and instance data are fetched in the vertex shader
+    VkPipelineVertexInputStateCreateInfo vertex_input = {};
+    vertex_input.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+    input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkPipelineViewportStateCreateInfo viewport_state = {};
+    viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport_state.viewportCount = 1;
+    viewport_state.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer = {};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_NONE;
+    rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling = {};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = g_msaa_samples;
+
+    // LESS_OR_EQUAL keeps draw order for coplanar quads, as before depth
+    VkPipelineDepthStencilStateCreateInfo depth_stencil = {};
+    depth_stencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depth_stencil.depthTestEnable = VK_TRUE;
+    depth_stencil.depthWriteEnable = VK_TRUE;
+    depth_stencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+    VkPipelineColorBlendAttachmentState color_blend_attachment = {};
+    color_blend_attachment.colorWriteMask =
+        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+        VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    color_blend_attachment.blendEnable = VK_FALSE;
+    VkPipelineColorBlendAttachmentState motion_blend_attachment = {};
+    motion_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT;
+    // Opaque instances leave the OIT sums alone
+    VkPipelineColorBlendAttachmentState blend_attachments[MAX_MAIN_COLOR_ATTACHMENTS] = {
+        color_blend_attachment, motion_blend_attachment
+    };
+
+    VkPipelineColorBlendStateCreateInfo color_blending = {};
+    color_blending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    color_blending.attachmentCount = main_color_attachment_count();
+    color_blending.pAttachments = blend_attachments;
+
+    VkDynamicState dynamic_states[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+
+    VkPipelineDynamicStateCreateInfo dynamic_state = {};
+    dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_state.dynamicStateCount = 2;
+    dynamic_state.pDynamicStates = dynamic_states;
+
+    VkDescriptorSetLayout set_layouts[] = {g_texture_set_layout, g_instance_set_layout};
+
+    VkPushConstantRange push_range = {};
+    push_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    push_range.offset = 0;
+    push_range.size = sizeof(InstancePushConstants);
+
+    VkPipelineLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_info.setLayoutCount = 2;
+    layout_info.pSetLayouts = set_layouts;
+    layout_info.pushConstantRangeCount = 1;
+    layout_info.pPushConstantRanges = &push_range;
+
+    if (vkCreatePipelineLayout(g_device, &layout_info, nullptr, &g_instance_pipeline_layout) != VK_SUCCESS) {
+        SDL_Log("Failed to create instance pipeline layout");
+        vkDestroyShaderModule(g_device, vert_module, nullptr);
+        vkDestroyShaderModule(g_device, frag_module, nullptr);
+        return 3;
+    }
+
+    VkGraphicsPipelineCreateInfo pipeline_info = {};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipeline_info.stageCount = 2;
+    pipeline_info.pStages = stages;
+    pipeline_info.pVertexInputState = &vertex_input;
+    pipeline_info.pInputAssemblyState = &input_assembly;
+    pipeline_info.pViewportState = &viewport_state;
+    pipeline_info.pRasterizationState = &rasterizer;
+    pipeline_info.pMultisampleState = &multisampling;
+    pipeline_info.pDepthStencilState = &depth_stencil;
+    pipeline_info.pColorBlendState = &color_blending;
+    pipeline_info.pDynamicState = &dynamic_state;
+    pipeline_info.layout = g_instance_pipeline_layout;
+    pipeline_info.renderPass = g_render_pass;
+    pipeline_info.subpass = 0;
+
+    VkPipelineRenderingCreateInfoKHR rendering_info = pipeline_rendering_info();
+    if (g_dynamic_rendering_supported) pipeline_info.pNext = &rendering_info;
+
+    // The pre-pass has no fragment shader and writes no color. The shading
+    // pass after it only runs for the fragments that won, which instance.vert
+    // reproduces exactly because gl_Position is invariant.
+    VkPipelineColorBlendAttachmentState no_color[MAX_MAIN_COLOR_ATTACHMENTS] = {};
+    VkPipelineColorBlendStateCreateInfo depth_only_blending = color_blending;
+    depth_only_blending.pAttachments = no_color;
+
+    VkPipelineDepthStencilStateCreateInfo equal_depth = depth_stencil;
+    equal_depth.depthWriteEnable = VK_FALSE;
+    equal_depth.depthCompareOp = VK_COMPARE_OP_EQUAL;
+
+    // Transparent instances are tested against the opaque depth without
+    // writing it. Their weighted color and coverage add up, and each
+    // multiplies the revealage by 1 - alpha.
+    VkPipelineDepthStencilStateCreateInfo test_depth = depth_stencil;
+    test_depth.depthWriteEnable = VK_FALSE;
+
+    VkPipelineColorBlendAttachmentState oit_blend_attachments[MAX_MAIN_COLOR_ATTACHMENTS] = {};
+    VkPipelineColorBlendAttachmentState& accum_blend = oit_blend_attachments[MAIN_ACCUM_SLOT];
+    accum_blend.blendEnable = VK_TRUE;
+    accum_blend.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    accum_blend.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    accum_blend.colorBlendOp = VK_BLEND_OP_ADD;
+    accum_blend.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    accum_blend.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    accum_blend.alphaBlendOp = VK_BLEND_OP_ADD;
+    accum_blend.colorWriteMask = color_blend_attachment.colorWriteMask;
+    VkPipelineColorBlendAttachmentState& reveal_blend = oit_blend_attachments[MAIN_REVEAL_SLOT];
+    reveal_blend.blendEnable = VK_TRUE;
+    reveal_blend.srcColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+    reveal_blend.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_COLOR;
+    reveal_blend.colorBlendOp = VK_BLEND_OP_ADD;
+    reveal_blend.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    reveal_blend.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    reveal_blend.alphaBlendOp = VK_BLEND_OP_ADD;
+    reveal_blend.colorWriteMask = VK_COLOR_COMPONENT_R_BIT;
+    VkPipelineColorBlendStateCreateInfo oit_blending = color_blending;
+    oit_blending.pAttachments = oit_blend_attachments;
+
+    VkGraphicsPipelineCreateInfo pipeline_infos[4] = {pipeline_info, pipeline_info, pipeline_info, pipeline_info};
+    pipeline_infos[1].stageCount = 1;
+    pipeline_infos[1].pColorBlendState = &depth_only_blending;
+    pipeline_infos[2].pDepthStencilState = &equal_depth;
+    pipeline_infos[3].pStages = oit_stages;
+    pipeline_infos[3].pDepthStencilState = &test_depth;
+    pipeline_infos[3].pColorBlendState = &oit_blending;
+
+    VkPipeline pipelines[4] = {};
+    uint32_t pipeline_count = oit_active() ? 4 : 3;
+    VkResult result = vkCreateGraphicsPipelines(g_device, VK_NULL_HANDLE, pipeline_count, pipeline_infos, nullptr,
+        pipelines);
+    g_instance_pipeline = pipelines[0];
+    g_instance_depth_pipeline = pipelines[1];
+    g_instance_equal_pipeline = pipelines[2];
+    g_instance_oit_pipeline = pipelines[3];
+    vkDestroyShaderModule(g_device, vert_module, nullptr);
+    vkDestroyShaderModule(g_device, frag_module, nullptr);
+
+    if (result != VK_SUCCESS) {
+        SDL_Log("Failed to create instance pipeline");
+        return 4;
+    }
+    return 0;
+}
+
+static int create_mapped_buffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                                VkBuffer* buffer, VkDeviceMemory* memory, void** mapped) {
+    if (create_buffer(size, usage,
+                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                      buffer, memory) != 0) {
+        return 1;
+    }
+    if (vkMapMemory(g_device, *memory, 0, size, 0, mapped) != VK_SUCCESS) {
+        SDL_Log("Failed to map buffer");
+        vkDestroyBuffer(g_device, *buffer, nullptr);
+        vkFreeMemory(g_device, *memory, nullptr);
+        *buffer = VK_NULL_HANDLE;
+        *memory = VK_NULL_HANDLE;
+        return 2;
+    }
+    return 0;
+}
+
+static void destroy_buffer(VkBuffer& buffer, VkDeviceMemory& memory) {
+    if (buffer) vkDestroyBuffer(g_device, buffer, nullptr);
+    if (memory) vkFreeMemory(g_device, memory, nullptr);
+    buffer = VK_NULL_HANDLE;
+    memory = VK_NULL_HANDLE;
+}
+
+static void write_storage_descriptor(VkDescriptorSet set, uint32_t binding, VkBuffer buffer) {
+    VkDescriptorBufferInfo buffer_info = {};
+    buffer_info.buffer = buffer;
+    buffer_info.offset = 0;
+    buffer_info.range = VK_WHOLE_SIZE;
+
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = set;
+    write.dstBinding = binding;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = &buffer_info;
+    vkUpdateDescriptorSets(g_device, 1, &write, 0, nullptr);
+}
+
+static void destroy_frame_instances(FrameInstances& frame) {
+    // Mapped memory is implicitly unmapped when freed
+    destroy_buffer(frame.buffer, frame.memory);
+    destroy_buffer(frame.bounds_buffer, frame.bounds_memory);
+    destroy_buffer(frame.visible_buffer, frame.visible_memory);
+    destroy_buffer(frame.previous_buffer, frame.previous_memory);
+    frame.mapped = nullptr;
+    frame.bounds_mapped = nullptr;
+    frame.previous_mapped = nullptr;
+    frame.capacity = 0;
+}
+
+static void destroy_frame_commands(FrameInstances& frame) {
+    destroy_buffer(frame.indirect_buffer, frame.indirect_memory);
+    destroy_buffer(frame.template_buffer, frame.template_memory);
+    frame.template_mapped = nullptr;
+    frame.command_capacity = 0;
+}
+
+// (Re)allocate a frame's per-instance buffers to hold at least `count` instances.
+// Only called once the frame's fence has signaled.
+static int reserve_frame_instances(FrameInstances& frame, uint32_t count) {
+    if (count <= frame.capacity && frame.buffer) return 0;
+
+    uint32_t capacity = std::max(frame.capacity, MIN_INSTANCE_CAPACITY);
+    while (capacity < count) capacity *= 2;
+
+    destroy_frame_instances(frame);
+
+    if (create_mapped_buffer(static_cast<VkDeviceSize>(capacity) * sizeof(InstanceData),
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                             &frame.buffer, &frame.memory, &frame.mapped) != 0) {
+        return 1;
+    }
+    if (create_mapped_buffer(static_cast<VkDeviceSize>(capacity) * sizeof(BoundingSphere),
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                             &frame.bounds_buffer, &frame.bounds_memory, &frame.bounds_mapped) != 0) {
+        return 2;
+    }
+    if (create_buffer(static_cast<VkDeviceSize>(capacity) * sizeof(uint32_t),
+                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                      &frame.visible_buffer, &frame.visible_memory, true) != 0) {
+        return 3;
+    }
+    if (create_mapped_buffer(static_cast<VkDeviceSize>(capacity) * sizeof(InstanceData::model),
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                             &frame.previous_buffer, &frame.previous_memory, &frame.previous_mapped) != 0) {
+        return 4;
+    }
+    frame.capacity = capacity;
+
+    write_storage_descriptor(frame.set, 0, frame.buffer);
+    write_storage_descriptor(frame.set, 1, frame.visible_buffer);
+    write_storage_descriptor(frame.set, 2, frame.previous_buffer);
+    write_storage_descriptor(frame.cull_set, 0, frame.bounds_buffer);
+    write_storage_descriptor(frame.cull_set, 1, frame.visible_buffer);
+    return 0;
+}
+
+// (Re)allocate a frame's indirect command buffers for at least `count` draws
+static int reserve_frame_commands(FrameInstances& frame, uint32_t count) {
+    if (count <= frame.command_capacity && frame.indirect_buffer) return 0;
+
+    uint32_t capacity = std::max(frame.command_capacity, MIN_COMMAND_CAPACITY);
+    while (capacity < count) capacity *= 2;
+
+    destroy_frame_commands(frame);
+
+    VkDeviceSize size = INDIRECT_COMMANDS_OFFSET +
+        static_cast<VkDeviceSize>(capacity) * sizeof(VkDrawIndexedIndirectCommand);
+    if (create_mapped_buffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                             &frame.template_buffer, &frame.template_memory, &frame.template_mapped) != 0) {
+        return 1;
+    }
+    if (create_buffer(size,
+                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                      VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                      &frame.indirect_buffer, &frame.indirect_memory, true) != 0) {
+        return 2;
+    }
+    frame.command_capacity = capacity;
+
+    write_storage_descriptor(frame.cull_set, 2, frame.indirect_buffer);
+    return 0;
+}
+
+static int create_instance_resources() {
+    VkDescriptorSetLayout layouts[MAX_FRAMES_IN_FLIGHT];
+    VkDescriptorSet sets[MAX_FRAMES_IN_FLIGHT];
+    VkDescriptorSetLayout cull_layouts[MAX_FRAMES_IN_FLIGHT];
+    VkDescriptorSet cull_sets[MAX_FRAMES_IN_FLIGHT];
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        layouts[i] = g_instance_set_layout;
+        cull_layouts[i] = g_cull_set_layout;
+    }
+
+    VkDescriptorSetAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = g_instance_descriptor_pool;
+    alloc_info.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+    alloc_info.pSetLayouts = layouts;
+
+    if (vkAllocateDescriptorSets(g_device, &alloc_info, sets) != VK_SUCCESS) {
+        SDL_Log("Failed to allocate instance descriptor sets");
+        return 1;
+    }
+
+    alloc_info.pSetLayouts = cull_layouts;
+    if (vkAllocateDescriptorSets(g_device, &alloc_info, cull_sets) != VK_SUCCESS) {
+        SDL_Log("Failed to allocate cull descriptor sets");
+        return 1;
+    }
+
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        FrameInstances& frame = g_frame_instances[i];
+        frame.set = sets[i];
+        frame.cull_set = cull_sets[i];
+        if (reserve_frame_instances(frame, MIN_INSTANCE_CAPACITY) != 0) return 2;
+        if (reserve_frame_commands(frame, MIN_COMMAND_CAPACITY) != 0) return 2;
+
+        // Written every frame, but bound even while temporal upscaling is off
+        if (create_mapped_buffer(sizeof(MotionUniforms), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                 &frame.motion_buffer, &frame.motion_memory, &frame.motion_mapped) != 0) {
+            return 2;
+        }
+        memset(frame.motion_mapped, 0, sizeof(MotionUniforms));
+        VkDescriptorBufferInfo motion_info = {frame.motion_buffer, 0, sizeof(MotionUniforms)};
+        VkWriteDescriptorSet write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = frame.set;
+        write.dstBinding = 3;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        write.pBufferInfo = &motion_info;
+        vkUpdateDescriptorSets(g_device, 1, &write, 0, nullptr);
+    }
+
+    VkDeviceSize index_size = sizeof(QUAD_INDICES);
+    if (create_buffer(index_size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                      &g_quad_index_buffer, &g_quad_index_memory) != 0) {
+        return 3;
+    }
+    void* mapped = nullptr;
+    vkMapMemory(g_device, g_quad_index_memory, 0, index_size, 0, &mapped);
+    memcpy(mapped, QUAD_INDICES, index_size);
+    vkUnmapMemory(g_device, g_quad_index_memory);
+
+    // Bound for untextured draws on the classic path, and written over
+    // destroyed slots in the bindless table so stale indices stay valid
+    const uint32_t white = 0xFFFFFFFFu;
+    g_white_texture = create_texture(&white, 1, 1);
+    if (g_white_texture == 0) return 4;
+    // Stands in for textures still uploading, so it must be ready first
+    if (flush_texture_uploads() != 0 || finish_transfer_uploads() != 0) return 5;
+    return 0;
+}
+
+static int create_cull_pipeline() {
+    auto comp_code = read_file("cull.comp.spv");
+    if (comp_code.empty()) {
+        SDL_Log("Failed to load cull shader");
+        return 1;
+    }
+
+    VkShaderModule comp_module = create_shader_module(comp_code);
+    if (!comp_module) return 2;
+
+    VkPushConstantRange push_range = {};
+    push_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    push_range.offset = 0;
+    push_range.size = sizeof(CullPushConstants);
+
+    VkPipelineLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_info.setLayoutCount = 1;
+    layout_info.pSetLayouts = &g_cull_set_layout;
+    layout_info.pushConstantRangeCount = 1;
+    layout_info.pPushConstantRanges = &push_range;
+
+    if (vkCreatePipelineLayout(g_device, &layout_info, nullptr, &g_cull_pipeline_layout) != VK_SUCCESS) {
+        SDL_Log("Failed to create cull pipeline layout");
+        vkDestroyShaderModule(g_device, comp_module, nullptr);
+        return 3;
+    }
+
+    VkComputePipelineCreateInfo pipeline_info = {};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_info.stage.module = comp_module;
+    pipeline_info.stage.pName = "main";
+    pipeline_info.layout = g_cull_pipeline_layout;
+
+    VkResult result = vkCreateComputePipelines(g_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &g_cull_pipeline);
+    vkDestroyShaderModule(g_device, comp_module, nullptr);
+
+    if (result != VK_SUCCESS) {
+        SDL_Log("Failed to create cull pipeline");
+        return 4;
+    }
+    return 0;
+}
+
+static void destroy_frame_lights(FrameLights& lights) {
+    destroy_buffer(lights.light_buffer, lights.light_memory);
+    destroy_buffer(lights.uniform_buffer, lights.uniform_memory);
+    destroy_buffer(lights.cluster_buffer, lights.cluster_memory);
+    destroy_buffer(lights.index_buffer, lights.index_memory);
+    lights.light_mapped = nullptr;
+    lights.uniform_mapped = nullptr;
+    lights.capacity = 0;
+}
+
+// (Re)allocate a frame's light buffer for at least `count` lights. Only
+// called once the frame's fence has signaled.
+static int reserve_frame_lights(FrameLights& lights, VkDescriptorSet set, uint32_t count) {
+    if (count <= lights.capacity && lights.light_buffer) return 0;
+
+    uint32_t capacity = std::max(lights.capacity, MIN_LIGHT_CAPACITY);
+    while (capacity < count) capacity *= 2;
+
+    destroy_buffer(lights.light_buffer, lights.light_memory);
+    lights.light_mapped = nullptr;
+    lights.capacity = 0;
+    if (create_mapped_buffer(static_cast<VkDeviceSize>(capacity) * sizeof(EngineLight),
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                             &lights.light_buffer, &lights.light_memory, &lights.light_mapped) != 0) {
+        return 1;
+    }
+    lights.capacity = capacity;
+    write_storage_descriptor(set, 4, lights.light_buffer);
+    return 0;
+}
+
+// Per-frame light buffers, bound in the instance sets, and light_cull.comp.
+// The cull pipeline binds the instance set at set 1 like the draws do.
+static int create_light_resources() {
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        FrameLights& lights = g_frame_lights[i];
+        VkDescriptorSet set = g_frame_instances[i].set;
+        if (reserve_frame_lights(lights, set, MIN_LIGHT_CAPACITY) != 0) return 1;
+        if (create_mapped_buffer(sizeof(LightUniforms), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                 &lights.uniform_buffer, &lights.uniform_memory, &lights.uniform_mapped) != 0) {
+            return 1;
+        }
+        memset(lights.uniform_mapped, 0, sizeof(LightUniforms));
+        if (create_buffer(static_cast<VkDeviceSize>(LIGHT_CLUSTER_COUNT) * 2 * sizeof(uint32_t),
+                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                          &lights.cluster_buffer, &lights.cluster_memory) != 0) {
+            return 1;
+        }
+        VkDeviceSize index_size = (1 + static_cast<VkDeviceSize>(LIGHT_CLUSTER_COUNT) * LIGHT_INDICES_PER_CLUSTER) *
+                                  sizeof(uint32_t);
+        if (create_buffer(index_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &lights.index_buffer, &lights.index_memory) != 0) {
+            return 1;
+        }
+        write_storage_descriptor(set, 5, lights.cluster_buffer);
+        write_storage_descriptor(set, 6, lights.index_buffer);
+
+        VkDescriptorBufferInfo uniform_info = {lights.uniform_buffer, 0, sizeof(LightUniforms)};
+        VkWriteDescriptorSet write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = set;
+        write.dstBinding = 7;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        write.pBufferInfo = &uniform_info;
+        vkUpdateDescriptorSets(g_device, 1, &write, 0, nullptr);
+    }
+
+    auto comp_code = read_file("light_cull.comp.spv");
+    if (comp_code.empty()) {
+        SDL_Log("Failed to load light cull shader");
+        return 2;
+    }
+    VkShaderModule comp_module = create_shader_module(comp_code);
+    if (!comp_module) return 3;
+
+    VkDescriptorSetLayout set_layouts[] = {g_texture_set_layout, g_instance_set_layout};
+    VkPipelineLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_info.setLayoutCount = 2;
+    layout_info.pSetLayouts = set_layouts;
+    if (vkCreatePipelineLayout(g_device, &layout_info, nullptr, &g_light_cull_pipeline_layout) != VK_SUCCESS) {
+        SDL_Log("Failed to create light cull pipeline layout");
+        vkDestroyShaderModule(g_device, comp_module, nullptr);
+        return 4;
+    }
+
+    VkComputePipelineCreateInfo pipeline_info = {};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_info.stage.module = comp_module;
+    pipeline_info.stage.pName = "main";
+    pipeline_info.layout = g_light_cull_pipeline_layout;
+
+    VkResult result = vkCreateComputePipelines(g_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr,
+        &g_light_cull_pipeline);
+    vkDestroyShaderModule(g_device, comp_module, nullptr);
+
+    if (result != VK_SUCCESS) {
+        SDL_Log("Failed to create light cull pipeline");
+        return 5;
+    }
+    return 0;
+}
+
+// Depth formats that can be rendered and sampled; D16 is required to
+// support both
+static VkFormat choose_shadow_format() {
+    const VkFormat candidates[] = {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM};
+    VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                                  VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+    for (VkFormat format : candidates) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(g_physical_device, format, &properties);
+        if ((properties.optimalTilingFeatures & needed) == needed) return format;
+    }
+    return VK_FORMAT_UNDEFINED;
+}
+
+static void destroy_shadow_maps() {
+    for (uint32_t image = 0; image < 2; image++) {
+        for (uint32_t c = 0; c < SHADOW_CASCADES; c++) {
+            if (g_shadow_framebuffers[image][c]) vkDestroyFramebuffer(g_device, g_shadow_framebuffers[image][c], nullptr);
+            if (g_shadow_layer_views[image][c]) vkDestroyImageView(g_device, g_shadow_layer_views[image][c], nullptr);
+            g_shadow_framebuffers[image][c] = VK_NULL_HANDLE;
+            g_shadow_layer_views[image][c] = VK_NULL_HANDLE;
+        }
+        if (g_shadow_images[image]) vkDestroyImage(g_device, g_shadow_images[image], nullptr);
+        if (g_shadow_memory[image]) vkFreeMemory(g_device, g_shadow_memory[image], nullptr);
+        g_shadow_images[image] = VK_NULL_HANDLE;
+        g_shadow_memory[image] = VK_NULL_HANDLE;
+        g_shadow_layouts_valid[image] = false;
+    }
+    if (g_shadow_view) vkDestroyImageView(g_device, g_shadow_view, nullptr);
+    g_shadow_view = VK_NULL_HANDLE;
+    g_shadow_map_size = 0;
+}
+
+static int create_shadow_view(VkImage image, VkImageViewType type, uint32_t first_layer, uint32_t layers,
+                              VkImageView* view) {
+    VkImageViewCreateInfo view_info = {};
+    view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_info.image = image;
+    view_info.viewType = type;
+    view_info.format = g_shadow_format;
+    view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    view_info.subresourceRange.levelCount = 1;
+    view_info.subresourceRange.baseArrayLayer = first_layer;
+    view_info.subresourceRange.layerCount = layers;
+    if (vkCreateImageView(g_device, &view_info, nullptr, view) != VK_SUCCESS) {
+        SDL_Log("Failed to create shadow map view");
+        return 1;
+    }
+    return 0;
+}
+
+// (Re)create both shadow images at size x size and point every frame's
+// instance set at the composite. The device must be idle.
+static int create_shadow_maps(uint32_t size) {
+    destroy_shadow_maps();
+
+    const VkImageUsageFlags usages[2] = {
+        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+    };
+    for (uint32_t image = 0; image < 2; image++) {
+        if (create_image(size, size, 1, VK_SAMPLE_COUNT_1_BIT, g_shadow_format, usages[image],
+                         &g_shadow_images[image], &g_shadow_memory[image], 0, SHADOW_CASCADES) != 0) {
+            return 1;
+        }
+        for (uint32_t c = 0; c < SHADOW_CASCADES; c++) {
+            if (create_shadow_view(g_shadow_images[image], VK_IMAGE_VIEW_TYPE_2D, c, 1,
+                                   &g_shadow_layer_views[image][c]) != 0) {
+                return 2;
+            }
+
+            VkFramebufferCreateInfo framebuffer_info = {};
+            framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebuffer_info.renderPass = g_shadow_clear_pass;
+            framebuffer_info.attachmentCount = 1;
+            framebuffer_info.pAttachments = &g_shadow_layer_views[image][c];
+            framebuffer_info.width = size;
+            framebuffer_info.height = size;
+            framebuffer_info.layers = 1;
+            if (vkCreateFramebuffer(g_device, &framebuffer_info, nullptr, &g_shadow_framebuffers[image][c]) != VK_SUCCESS) {
+                SDL_Log("Failed to create shadow framebuffer");
+                return 3;
+            }
+        }
+    }
+    if (create_shadow_view(g_shadow_images[SHADOW_COMPOSITE], VK_IMAGE_VIEW_TYPE_2D_ARRAY, 0, SHADOW_CASCADES,
+                           &g_shadow_view) != 0) {
+        return 2;
+    }
+
+    VkDescriptorImageInfo image_info = {g_shadow_sampler, g_shadow_view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        VkWriteDescriptorSet write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = g_frame_instances[i].set;
+        write.dstBinding = 8;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &image_info;
+        vkUpdateDescriptorSets(g_device, 1, &write, 0, nullptr);
+    }
+
+    g_shadow_map_size = size;
+    g_shadow_cascades.configure(size, g_shadow_distance, g_shadow_far_interval);
+    return 0;
+}
+
+static bool shadows_enabled() {
+    return g_shadow_resolution > 0 && (g_sun_color[0] > 0.0f || g_sun_color[1] > 0.0f || g_sun_color[2] > 0.0f);
+}
+
+// Allocate the maps once shadows are wanted at a new resolution, and drop
+// back to the placeholder when they are turned off
+static int ensure_shadow_maps() {
+    uint32_t size = shadows_enabled() ? g_shadow_resolution : 1;
+    if (size == g_shadow_map_size) return 0;
+
+    vkDeviceWaitIdle(g_device);
+    if (create_shadow_maps(size) == 0) {
+        if (size > 1) SDL_Log("Shadows: %u cascades at %ux%u", SHADOW_CASCADES, size, size);
+        return 0;
+    }
+    SDL_Log("Shadows: failed to allocate %ux%u maps, disabled", size, size);
+    g_shadow_resolution = 0;
+    return create_shadow_maps(1);
+}
+
+static void destroy_frame_shadows(FrameShadows& shadows) {
+    destroy_buffer(shadows.buffer, shadows.memory);
+    shadows.mapped = nullptr;
+    shadows.capacity = 0;
+}
+
+// (Re)allocate a frame's caster buffer for at least `count` matrices. Only
+// called once the frame's fence has signaled.
+static int reserve_frame_shadows(FrameShadows& shadows, uint32_t count) {
+    if (count <= shadows.capacity && shadows.buffer) return 0;
+
+    uint32_t capacity = std::max(shadows.capacity, MIN_SHADOW_CASTER_CAPACITY);
+    while (capacity < count) capacity *= 2;
+
+    destroy_frame_shadows(shadows);
+    if (create_mapped_buffer(static_cast<VkDeviceSize>(capacity) * 16 * sizeof(float),
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                             &shadows.buffer, &shadows.memory, &shadows.mapped) != 0) {
+        return 1;
+    }
+    shadows.capacity = capacity;
+    write_storage_descriptor(shadows.set, 0, shadows.buffer);
+    return 0;
+}
+
+// Shadow render passes, shadow.vert's depth-only pipeline, the comparison
+// sampler, the per-frame caster buffers and the placeholder maps
+static int create_shadow_resources() {
+    g_shadow_format = choose_shadow_format();
+    if (g_shadow_format == VK_FORMAT_UNDEFINED) {
+        SDL_Log("No shadow map depth format");
+        return 1;
+    }
+    VkFormatProperties format_properties;
+    vkGetPhysicalDeviceFormatProperties(g_physical_device, g_shadow_format, &format_properties);
+    bool linear = format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+    // Filtered comparisons give each tap a bilinear blend of four results
+    VkSamplerCreateInfo sampler_info = {};
+    sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_info.magFilter = linear ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+    sampler_info.minFilter = sampler_info.magFilter;
+    sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.compareEnable = VK_TRUE;
+    sampler_info.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    sampler_info.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    if (vkCreateSampler(g_device, &sampler_info, nullptr, &g_shadow_sampler) != VK_SUCCESS) {
+        SDL_Log("Failed to create shadow sampler");
+        return 2;
+    }
+
+    // The frame graph moves the layers in and out of the attachment layout
+    VkRenderPass* passes[2] = {&g_shadow_clear_pass, &g_shadow_load_pass};
+    for (uint32_t i = 0; i < 2; i++) {
+        VkAttachmentDescription attachment = {};
+        attachment.format = g_shadow_format;
+        attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        attachment.loadOp = i == 0 ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+        attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentReference depth_ref = {0, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+        VkSubpassDescription subpass = {};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.pDepthStencilAttachment = &depth_ref;
+
+        VkRenderPassCreateInfo pass_info = {};
+        pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        pass_info.attachmentCount = 1;
+        pass_info.pAttachments = &attachment;
+        pass_info.subpassCount = 1;
+        pass_info.pSubpasses = &subpass;
+        if (vkCreateRenderPass(g_device, &pass_info, nullptr, passes[i]) != VK_SUCCESS) {
+            SDL_Log("Failed to create shadow render pass");
+            return 3;
+        }
+    }
+
+    auto vert_code = read_file("shadow.vert.spv");
+    if (vert_code.empty()) {
+        SDL_Log("Failed to load shadow shader");
+        return 4;
+    }
+    VkShaderModule vert_module = create_shader_module(vert_code);
+    if (!vert_module) return 5;
+
+    VkPushConstantRange push_range = {VK_SHADER_STAGE_VERTEX_BIT, 0, 16 * sizeof(float)};
+    VkPipelineLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_info.setLayoutCount = 1;
+    layout_info.pSetLayouts = &g_shadow_set_layout;
+    layout_info.pushConstantRangeCount = 1;
+    layout_info.pPushConstantRanges = &push_range;
+    if (vkCreatePipelineLayout(g_device, &layout_info, nullptr, &g_shadow_pipeline_layout) != VK_SUCCESS) {
+        SDL_Log("Failed to create shadow pipeline layout");
+        vkDestroyShaderModule(g_device, vert_module, nullptr);
+        return 6;
+    }
+
+    VkPipelineShaderStageCreateInfo stage = {};
+    stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stage.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stage.module = vert_module;
+    stage.pName = "main";
+
+    VkPipelineVertexInputStateCreateInfo vertex_input = {};
+    vertex_input.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+    input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkPipelineViewportStateCreateInfo viewport_state = {};
+    viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport_state.viewportCount = 1;
+    viewport_state.scissorCount = 1;
+
+    // Quads cast from both sides; the bias keeps lit surfaces off their own
+    // depth
+    VkPipelineRasterizationStateCreateInfo rasterizer = {};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_NONE;
+    rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+    rasterizer.depthBiasEnable = VK_TRUE;
+    rasterizer.depthBiasConstantFactor = SHADOW_DEPTH_BIAS;
+    rasterizer.depthBiasSlopeFactor = SHADOW_SLOPE_BIAS;
+
+    VkPipelineMultisampleStateCreateInfo multisampling = {};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineDepthStencilStateCreateInfo depth_stencil = {};
+    depth_stencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depth_stencil.depthTestEnable = VK_TRUE;
+    depth_stencil.depthWriteEnable = VK_TRUE;
+    depth_stencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+    VkPipelineColorBlendStateCreateInfo color_blending = {};
+    color_blending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+
+    VkDynamicState dynamic_states[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamic_state = {};
+    dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_state.dynamicStateCount = 2;
+    dynamic_state.pDynamicStates = dynamic_states;
+
+    VkGraphicsPipelineCreateInfo pipeline_info = {};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipeline_info.stageCount = 1;
+    pipeline_info.pStages = &stage;
+    pipeline_info.pVertexInputState = &vertex_input;
+    pipeline_info.pInputAssemblyState = &input_assembly;
+    pipeline_info.pViewportState = &viewport_state;
+    pipeline_info.pRasterizationState = &rasterizer;
+    pipeline_info.pMultisampleState = &multisampling;
+    pipeline_info.pDepthStencilState = &depth_stencil;
+    pipeline_info.pColorBlendState = &color_blending;
+    pipeline_info.pDynamicState = &dynamic_state;
+    pipeline_info.layout = g_shadow_pipeline_layout;
+    pipeline_info.renderPass = g_shadow_clear_pass;
+    pipeline_info.subpass = 0;
+
+    VkResult result = vkCreateGraphicsPipelines(g_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr,
+        &g_shadow_pipeline);
+    vkDestroyShaderModule(g_device, vert_module, nullptr);
+    if (result != VK_SUCCESS) {
+        SDL_Log("Failed to create shadow pipeline");
+        return 7;
+    }
+
+    VkDescriptorSetLayout layouts[MAX_FRAMES_IN_FLIGHT];
+    VkDescriptorSet sets[MAX_FRAMES_IN_FLIGHT];
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) layouts[i] = g_shadow_set_layout;
+
+    VkDescriptorSetAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = g_instance_descriptor_pool;
+    alloc_info.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+    alloc_info.pSetLayouts = layouts;
+    if (vkAllocateDescriptorSets(g_device, &alloc_info, sets) != VK_SUCCESS) {
+        SDL_Log("Failed to allocate shadow descriptor sets");
+        return 8;
+    }
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        g_frame_shadows[i].set = sets[i];
+        if (reserve_frame_shadows(g_frame_shadows[i], MIN_SHADOW_CASTER_CAPACITY) != 0) return 9;
+    }
+
+    if (create_shadow_maps(1) != 0) return 10;
+    return 0;
+}
+
+// temporal.comp and its two descriptor sets, one per history image written.
+// The sets are filled whenever the temporal attachments are created.
+static int create_temporal_pipeline() {
+    VkSamplerCreateInfo sampler_info = {};
+    sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_info.magFilter = VK_FILTER_LINEAR;
+    sampler_info.minFilter = VK_FILTER_LINEAR;
+    sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    if (vkCreateSampler(g_device, &sampler_info, nullptr, &g_temporal_sampler) != VK_SUCCESS) {
+        SDL_Log("Failed to create temporal sampler");
+        return 1;
+    }
+
+    // Scene color, motion vectors and last frame's history in; history out
+    VkDescriptorSetLayoutBinding bindings[4] = {};
+    for (uint32_t i = 0; i < 4; i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = i < 3 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+                                           : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = 4;
+    layout_info.pBindings = bindings;
+    if (vkCreateDescriptorSetLayout(g_device, &layout_info, nullptr, &g_temporal_set_layout) != VK_SUCCESS) {
+        SDL_Log("Failed to create temporal descriptor set layout");
+        return 2;
+    }
+
+    VkDescriptorPoolSize pool_sizes[2] = {};
+    pool_sizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    pool_sizes[0].descriptorCount = 6;
+    pool_sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    pool_sizes[1].descriptorCount = 2;
+
+    VkDescriptorPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.maxSets = 2;
+    pool_info.poolSizeCount = 2;
+    pool_info.pPoolSizes = pool_sizes;
+    if (vkCreateDescriptorPool(g_device, &pool_info, nullptr, &g_temporal_descriptor_pool) != VK_SUCCESS) {
+        SDL_Log("Failed to create temporal descriptor pool");
+        return 3;
+    }
+
+    VkDescriptorSetLayout set_layouts[2] = {g_temporal_set_layout, g_temporal_set_layout};
+    VkDescriptorSetAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = g_temporal_descriptor_pool;
+    alloc_info.descriptorSetCount = 2;
+    alloc_info.pSetLayouts = set_layouts;
+    if (vkAllocateDescriptorSets(g_device, &alloc_info, g_temporal_sets) != VK_SUCCESS) {
+        SDL_Log("Failed to allocate temporal descriptor sets");
+        return 4;
+    }
+
+    auto comp_code = read_file("temporal.comp.spv");
+    if (comp_code.empty()) {
+        SDL_Log("Failed to load temporal shader");
+        return 5;
+    }
+    VkShaderModule comp_module = create_shader_module(comp_code);
+    if (!comp_module) return 6;
+
+    VkPushConstantRange push_range = {};
+    push_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    push_range.offset = 0;
+    push_range.size = sizeof(TemporalPushConstants);
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {};
+    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_info.setLayoutCount = 1;
+    pipeline_layout_info.pSetLayouts = &g_temporal_set_layout;
+    pipeline_layout_info.pushConstantRangeCount = 1;
+    pipeline_layout_info.pPushConstantRanges = &push_range;
+    if (vkCreatePipelineLayout(g_device, &pipeline_layout_info, nullptr, &g_temporal_pipeline_layout) != VK_SUCCESS) {
+        SDL_Log("Failed to create temporal pipeline layout");
+        vkDestroyShaderModule(g_device, comp_module, nullptr);
+        return 7;
+    }
+
+    VkComputePipelineCreateInfo pipeline_info = {};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_info.stage.module = comp_module;
+    pipeline_info.stage.pName = "main";
+    pipeline_info.layout = g_temporal_pipeline_layout;
+
+    VkResult result = vkCreateComputePipelines(g_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr,
+        &g_temporal_pipeline);
+    vkDestroyShaderModule(g_device, comp_module, nullptr);
+
+    if (result != VK_SUCCESS) {
+        SDL_Log("Failed to create temporal pipeline");
+        return 8;
+    }
+    return 0;
+}
+
+// Descriptor sets and pipeline layout of post-processing. Which path runs
+// is fixed by the device: input attachments read by post.frag under a
+// render pass, otherwise post.comp on a storage image, whose pipeline does
+// not depend on the render pass and is created here.
+static int create_post_resources() {
+    VkDescriptorType type = g_dynamic_rendering_supported ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE
+                                                          : VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+    VkShaderStageFlags stage = g_dynamic_rendering_supported ? VK_SHADER_STAGE_COMPUTE_BIT
+                                                             : VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayoutBinding binding = {};
+    binding.binding = 0;
+    binding.descriptorType = type;
+    binding.descriptorCount = 1;
+    binding.stageFlags = stage;
+
+    VkDescriptorSetLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = 1;
+    layout_info.pBindings = &binding;
+    if (vkCreateDescriptorSetLayout(g_device, &layout_info, nullptr, &g_post_set_layout) != VK_SUCCESS) {
+        SDL_Log("Failed to create post-process descriptor set layout");
+        return 1;
+    }
+
+    VkDescriptorPoolSize pool_size = {type, 2};
+    VkDescriptorPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.maxSets = 2;
+    pool_info.poolSizeCount = 1;
+    pool_info.pPoolSizes = &pool_size;
+    if (vkCreateDescriptorPool(g_device, &pool_info, nullptr, &g_post_descriptor_pool) != VK_SUCCESS) {
+        SDL_Log("Failed to create post-process descriptor pool");
+        return 2;
+    }
+
+    VkDescriptorSetLayout set_layouts[2] = {g_post_set_layout, g_post_set_layout};
+    VkDescriptorSetAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = g_post_descriptor_pool;
+    alloc_info.descriptorSetCount = 2;
+    alloc_info.pSetLayouts = set_layouts;
+    if (vkAllocateDescriptorSets(g_device, &alloc_info, g_post_sets) != VK_SUCCESS) {
+        SDL_Log("Failed to allocate post-process descriptor sets");
+        return 3;
+    }
+
+    VkPushConstantRange push_range = {};
+    push_range.stageFlags = stage;
+    push_range.offset = 0;
+    push_range.size = sizeof(PostPushConstants);
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {};
+    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_info.setLayoutCount = 1;
+    pipeline_layout_info.pSetLayouts = &g_post_set_layout;
+    pipeline_layout_info.pushConstantRangeCount = 1;
+    pipeline_layout_info.pPushConstantRanges = &push_range;
+    if (vkCreatePipelineLayout(g_device, &pipeline_layout_info, nullptr, &g_post_pipeline_layout) != VK_SUCCESS) {
+        SDL_Log("Failed to create post-process pipeline layout");
+        return 4;
+    }
+    if (!g_dynamic_rendering_supported) return 0;
+
+    auto comp_code = read_file("post.comp.spv");
+    if (comp_code.empty()) {
+        SDL_Log("Failed to load post-process shader");
+        return 5;
+    }
+    VkShaderModule comp_module = create_shader_module(comp_code);
+    if (!comp_module) return 6;
+
+    VkComputePipelineCreateInfo pipeline_info = {};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_info.stage.module = comp_module;
+    pipeline_info.stage.pName = "main";
+    pipeline_info.layout = g_post_pipeline_layout;
+
+    VkResult result = vkCreateComputePipelines(g_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr,
+        &g_post_pipelines[0]);
+    vkDestroyShaderModule(g_device, comp_module, nullptr);
+
+    if (result != VK_SUCCESS) {
+        SDL_Log("Failed to create post-process compute pipeline");
+        return 7;
+    }
+    return 0;
+}
+
+// One pipeline per post subpass: post.frag specialized to the effect that
+// subpass applies, a full-screen triangle with nothing to test or blend
+static int create_post_pipelines() {
+    if (!post_subpasses_active()) return 0;
+
+    auto vert_code = read_file("fullscreen.vert.spv");
+    auto frag_code = read_file("post.frag.spv");
+    if (vert_code.empty() || frag_code.empty()) {
+        SDL_Log("Failed to load post-process shaders");
+        return 1;
+    }
+    VkShaderModule vert_module = create_shader_module(vert_code);
+    VkShaderModule frag_module = create_shader_module(frag_code);
+    if (!vert_module || !frag_module) {
+        if (vert_module) vkDestroyShaderModule(g_device, vert_module, nullptr);
+        if (frag_module) vkDestroyShaderModule(g_device, frag_module, nullptr);
+        return 2;
+    }
+
+    VkPipelineVertexInputStateCreateInfo vertex_input = {};
+    vertex_input.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+    input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkPipelineViewportStateCreateInfo viewport_state = {};
+    viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport_state.viewportCount = 1;
+    viewport_state.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer = {};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_NONE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling = {};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineColorBlendAttachmentState blend_attachment = {};
+    blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                                      VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    VkPipelineColorBlendStateCreateInfo color_blending = {};
+    color_blending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    color_blending.attachmentCount = 1;
+    color_blending.pAttachments = &blend_attachment;
+
+    VkDynamicState dynamic_states[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamic_state = {};
+    dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_state.dynamicStateCount = 2;
+    dynamic_state.pDynamicStates = dynamic_states;
+
+    VkSpecializationMapEntry effect_entry = {0, 0, sizeof(uint32_t)};
+    uint32_t effects[POST_EFFECT_COUNT] = {};
+    VkSpecializationInfo specializations[POST_EFFECT_COUNT] = {};
+    VkPipelineShaderStageCreateInfo stages[POST_EFFECT_COUNT][2] = {};
+    VkGraphicsPipelineCreateInfo pipeline_infos[POST_EFFECT_COUNT] = {};
+    uint32_t count = 0;
+    for (uint32_t bit = 0; bit < POST_EFFECT_COUNT; bit++) {
+        if (!(g_post_effects & (1u << bit))) continue;
+        effects[count] = 1u << bit;
+        specializations[count].mapEntryCount = 1;
+        specializations[count].pMapEntries = &effect_entry;
+        specializations[count].dataSize = sizeof(uint32_t);
+        specializations[count].pData = &effects[count];
+
+        VkPipelineShaderStageCreateInfo& vert_stage = stages[count][0];
+        vert_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        vert_stage.stage = VK_SHADER_STAGE_VERTEX_BIT;
+        vert_stage.module = vert_module;
+        vert_stage.pName = "main";
+        VkPipelineShaderStageCreateInfo& frag_stage = stages[count][1];
+        frag_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        frag_stage.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        frag_stage.module = frag_module;
+        frag_stage.pName = "main";
+        frag_stage.pSpecializationInfo = &specializations[count];
+
+        VkGraphicsPipelineCreateInfo& pipeline_info = pipeline_infos[count];
+        pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pipeline_info.stageCount = 2;
+        pipeline_info.pStages = stages[count];
+        pipeline_info.pVertexInputState = &vertex_input;
+        pipeline_info.pInputAssemblyState = &input_assembly;
+        pipeline_info.pViewportState = &viewport_state;
+        pipeline_info.pRasterizationState = &rasterizer;
+        pipeline_info.pMultisampleState = &multisampling;
+        pipeline_info.pColorBlendState = &color_blending;
+        pipeline_info.pDynamicState = &dynamic_state;
+        pipeline_info.layout = g_post_pipeline_layout;
+        pipeline_info.renderPass = g_render_pass;
+        pipeline_info.subpass = main_subpass_count() + count;
+        count++;
+    }
+
+    VkResult result = vkCreateGraphicsPipelines(g_device, VK_NULL_HANDLE, count, pipeline_infos, nullptr,
+        g_post_pipelines);
+    vkDestroyShaderModule(g_device, vert_module, nullptr);
+    vkDestroyShaderModule(g_device, frag_module, nullptr);
+
+    if (result != VK_SUCCESS) {
+        SDL_Log("Failed to create post-process pipelines");
+        return 3;
+    }
+    return 0;
+}
+
+// Descriptor set and pipeline layout of the OIT composite: the two sums as
+// input attachments under a render pass, otherwise sampled by texel
+static int create_oit_resources() {
+    VkDescriptorType type = g_dynamic_rendering_supported ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+                                                          : VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+    if (g_dynamic_rendering_supported) {
+        VkSamplerCreateInfo sampler_info = {};
+        sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        sampler_info.magFilter = VK_FILTER_NEAREST;
+        sampler_info.minFilter = VK_FILTER_NEAREST;
+        sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        if (vkCreateSampler(g_device, &sampler_info, nullptr, &g_oit_sampler) != VK_SUCCESS) {
+            SDL_Log("Failed to create OIT sampler");
+            return 1;
+        }
+    }
+
+    VkDescriptorSetLayoutBinding bindings[2] = {};
+    for (uint32_t i = 0; i < 2; i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = type;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = 2;
+    layout_info.pBindings = bindings;
+    if (vkCreateDescriptorSetLayout(g_device, &layout_info, nullptr, &g_oit_set_layout) != VK_SUCCESS) {
+        SDL_Log("Failed to create OIT descriptor set layout");
+        return 2;
+    }
+
+    VkDescriptorPoolSize pool_size = {type, 2};
+    VkDescriptorPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.maxSets = 1;
+    pool_info.poolSizeCount = 1;
+    pool_info.pPoolSizes = &pool_size;
+    if (vkCreateDescriptorPool(g_device, &pool_info, nullptr, &g_oit_descriptor_pool) != VK_SUCCESS) {
+        SDL_Log("Failed to create OIT descriptor pool");
+        return 3;
+    }
+
+    VkDescriptorSetAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = g_oit_descriptor_pool;
+    alloc_info.descriptorSetCount = 1;
+    alloc_info.pSetLayouts = &g_oit_set_layout;
+    if (vkAllocateDescriptorSets(g_device, &alloc_info, &g_oit_set) != VK_SUCCESS) {
+        SDL_Log("Failed to allocate OIT descriptor set");
+        return 4;
+    }
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {};
+    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_info.setLayoutCount = 1;
+    pipeline_layout_info.pSetLayouts = &g_oit_set_layout;
+    if (vkCreatePipelineLayout(g_device, &pipeline_layout_info, nullptr, &g_oit_pipeline_layout) != VK_SUCCESS) {
+        SDL_Log("Failed to create OIT pipeline layout");
+        return 5;
+    }
+    return 0;
+}
+
+// Full-screen triangle blending the resolved transparency over the scene
+// color: subpass 1 of the main render pass, or its own rendering pass
+static int create_oit_pipeline() {
+    if (!oit_active()) return 0;
+
+    auto vert_code = read_file("fullscreen.vert.spv");
+    auto frag_code = read_file(g_dynamic_rendering_supported ? "oit_composite_sampled.frag.spv"
+                                                             : "oit_composite.frag.spv");
+    if (vert_code.empty() || frag_code.empty()) {
+        SDL_Log("Failed to load OIT composite shaders");
+        return 1;
+    }
+    VkShaderModule vert_module = create_shader_module(vert_code);
+    VkShaderModule frag_module = create_shader_module(frag_code);
+    if (!vert_module || !frag_module) {
+        if (vert_module) vkDestroyShaderModule(g_device, vert_module, nullptr);
+        if (frag_module) vkDestroyShaderModule(g_device, frag_module, nullptr);
+        return 2;
+    }
+
+    VkPipelineShaderStageCreateInfo stages[2] = {};
+    stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = vert_module;
+    stages[0].pName = "main";
+    stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = frag_module;
+    stages[1].pName = "main";
+
+    VkPipelineVertexInputStateCreateInfo vertex_input = {};
+    vertex_input.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+    input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkPipelineViewportStateCreateInfo viewport_state = {};
+    viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport_state.viewportCount = 1;
+    viewport_state.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer = {};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_NONE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling = {};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    // Color over the scene by the covered fraction; scene alpha is kept
+    VkPipelineColorBlendAttachmentState blend_attachment = {};
+    blend_attachment.blendEnable = VK_TRUE;
+    blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blend_attachment.colorBlendOp = VK_BLEND_OP_ADD;
+    blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    blend_attachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                                      VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    VkPipelineColorBlendStateCreateInfo color_blending = {};
+    color_blending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    color_blending.attachmentCount = 1;
+    color_blending.pAttachments = &blend_attachment;
+
+    VkDynamicState dynamic_states[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamic_state = {};
+    dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_state.dynamicStateCount = 2;
+    dynamic_state.pDynamicStates = dynamic_states;
+
+    VkGraphicsPipelineCreateInfo pipeline_info = {};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipeline_info.stageCount = 2;
+    pipeline_info.pStages = stages;
+    pipeline_info.pVertexInputState = &vertex_input;
+    pipeline_info.pInputAssemblyState = &input_assembly;
+    pipeline_info.pViewportState = &viewport_state;
+    pipeline_info.pRasterizationState = &rasterizer;
+    pipeline_info.pMultisampleState = &multisampling;
+    pipeline_info.pColorBlendState = &color_blending;
+    pipeline_info.pDynamicState = &dynamic_state;
+    pipeline_info.layout = g_oit_pipeline_layout;
+
+    VkPipelineRenderingCreateInfoKHR rendering_info = {};
+    if (g_dynamic_rendering_supported) {
+        rendering_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+        rendering_info.colorAttachmentCount = 1;
+        rendering_info.pColorAttachmentFormats = &g_main_color_formats[MAIN_COLOR_SLOT];
+        pipeline_info.pNext = &rendering_info;
+    } else {
+        pipeline_info.renderPass = g_render_pass;
+        pipeline_info.subpass = 1;
+    }
+
+    VkResult result = vkCreateGraphicsPipelines(g_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr,
+        &g_oit_composite_pipeline);
+    vkDestroyShaderModule(g_device, vert_module, nullptr);
+    vkDestroyShaderModule(g_device, frag_module, nullptr);
+
+    if (result != VK_SUCCESS) {
+        SDL_Log("Failed to create OIT composite pipeline");
+        return 3;
+    }
+    return 0;
+}
+
+// Group instances into draws. Bindless draws each run of opaque or
+// transparent instances at once; the classic path also needs a new draw
+// wherever the texture (and so the bound set) changes.
+template <typename InstanceAt>
+static void build_draw_items(std::vector<DrawItem>& draws, uint32_t count, InstanceAt instance_at) {
+    draws.clear();
+    if (count == 0) return;
+
+    auto item_for = [](uint32_t i, const InstanceData& instance) {
+        bool transparent = (instance.flags & ENGINE_INSTANCE_TRANSPARENT) != 0;
+        return DrawItem{i, 1, g_bindless_supported ? 0 : instance.texture, transparent};
+    };
+    DrawItem item = item_for(0, instance_at(0));
+    for (uint32_t i = 1; i < count; i++) {
+        DrawItem next = item_for(i, instance_at(i));
+        if (next.texture == item.texture && next.transparent == item.transparent) {
+            item.instance_count++;
+            continue;
+        }
+        draws.push_back(item);
+        item = next;
+    }
+    draws.push_back(item);
+}
+
+static void build_draw_list() {
+    g_draw_templates.clear();
+    build_draw_items(g_draw_list, static_cast<uint32_t>(g_instances.size()),
+        [](uint32_t i) -> const InstanceData& { return g_instances[i]; });
+
+    // Each command owns the slice of the visible list starting at its first
+    // instance; cull.comp appends into it and bumps instanceCount
+    for (const DrawItem& item : g_draw_list) {
+        VkDrawIndexedIndirectCommand command = {};
+        command.indexCount = 6;
+        command.instanceCount = 0;
+        command.firstIndex = 0;
+        command.vertexOffset = 0;
+        command.firstInstance = item.first_instance;
+        g_draw_templates.push_back(command);
+    }
+}
+
+// World-space bounding sphere of each quad, from its model matrix
+static void refresh_instance_bounds(uint32_t first, uint32_t end) {
+    if (first >= end) return;
+    hxo::transform_spheres(hxo::cull_default_kernel(), g_instances[first].model,
+        sizeof(InstanceData) / sizeof(float), end - first, QUAD_BOUNDS_RADIUS,
+        g_bounds_x.data() + first, g_bounds_y.data() + first,
+        g_bounds_z.data() + first, g_bounds_radius.data() + first);
+
+    for (uint32_t i = first; i < end; i++) {
+        g_instance_bounds[i] = {{g_bounds_x[i], g_bounds_y[i], g_bounds_z[i]}, g_bounds_radius[i]};
+    }
+}
+
+static void compute_instance_bounds() {
+    uint32_t count = static_cast<uint32_t>(g_instances.size());
+    g_bounds_x.resize(count);
+    g_bounds_y.resize(count);
+    g_bounds_z.resize(count);
+    g_bounds_radius.resize(count);
+    g_instance_bounds.resize(count);
+    refresh_instance_bounds(0, count);
+}
+
+// Native transform system: compose each Transform of the listed chunks
+// (indices into g_ecs_chunks) into its Instance model
+static void run_ecs_transforms(const std::vector<uint32_t>& chunks) {
+    hxo::job_system().parallel_for(static_cast<uint32_t>(chunks.size()), 1, [&chunks](uint32_t begin, uint32_t end) {
+        for (uint32_t c = begin; c < end; c++) {
+            uint32_t chunk = g_ecs_chunks[chunks[c]];
+            auto* transforms = static_cast<const float*>(g_world.chunk_column(chunk, ENGINE_COMPONENT_TRANSFORM));
+            if (!transforms) continue;
+            auto* instances = static_cast<InstanceData*>(g_world.chunk_column(chunk, ENGINE_COMPONENT_INSTANCE));
+            uint32_t rows = g_world.chunk_rows(chunk);
+            for (uint32_t r = 0; r < rows; r++) {
+                hxo::compose_transform(transforms + r * ENGINE_TRANSFORM_FLOATS, instances[r].model);
+            }
+        }
+    });
+}
+
+// Copy a packed chunk's Instance column into g_instances. Returns whether a
+// texture or flag changed, which regroups the draws.
+static bool pack_ecs_chunk(uint32_t index) {
+    uint32_t chunk = g_ecs_chunks[index];
+    uint32_t offset = g_ecs_chunk_offsets[index];
+    uint32_t rows = g_world.chunk_rows(chunk);
+    auto* src = static_cast<const InstanceData*>(g_world.chunk_column(chunk, ENGINE_COMPONENT_INSTANCE));
+    bool regroup = false;
+    for (uint32_t r = 0; r < rows && !regroup; r++) {
+        regroup = src[r].texture != g_instances[offset + r].texture || src[r].flags != g_instances[offset + r].flags;
+    }
+    memcpy(&g_instances[offset], src, rows * sizeof(InstanceData));
+    g_world.clear_dirty(chunk);
+    return regroup;
+}
+
+// Apply queued structural changes, then bring g_instances up to date with
+// the Instance columns. A structural change repacks every chunk; otherwise
+// only chunks marked dirty are recomposed, copied and re-bounded.
+static void update_ecs_instances() {
+    g_world.flush();
+
+    uint64_t mask = component_bit(ENGINE_COMPONENT_INSTANCE);
+    if (g_world.version() != g_ecs_packed_version) {
+        g_ecs_packed_version = g_world.version();
+        uint32_t count = g_world.count(mask);
+        if (count == 0 && !g_instances_from_ecs) return;
+        g_instances_from_ecs = count > 0;
+
+        uint32_t chunks = g_world.query(mask, nullptr, 0);
+        g_ecs_chunks.resize(chunks);
+        g_world.query(mask, g_ecs_chunks.data(), chunks);
+        g_ecs_chunk_offsets.resize(chunks);
+        g_ecs_dirty_chunks.resize(chunks);
+        uint32_t offset = 0;
+        for (uint32_t i = 0; i < chunks; i++) {
+            g_ecs_chunk_offsets[i] = offset;
+            g_ecs_dirty_chunks[i] = i;
+            offset += g_world.chunk_rows(g_ecs_chunks[i]);
+        }
+
+        run_ecs_transforms(g_ecs_dirty_chunks);
+        g_instances.resize(count);
+        g_instance_ids.resize(count);
+        for (uint32_t i = 0; i < chunks; i++) {
+            pack_ecs_chunk(i);
+            memcpy(&g_instance_ids[g_ecs_chunk_offsets[i]], g_world.chunk_entities(g_ecs_chunks[i]),
+                g_world.chunk_rows(g_ecs_chunks[i]) * sizeof(uint32_t));
+        }
+        compute_instance_bounds();
+        build_draw_list();
+        g_scene.rewrite_instances();
+        return;
+    }
+    if (!g_instances_from_ecs) return;
+
+    g_ecs_dirty_chunks.clear();
+    for (uint32_t i = 0; i < g_ecs_chunks.size(); i++) {
+        if (g_world.chunk_dirty(g_ecs_chunks[i])) g_ecs_dirty_chunks.push_back(i);
+    }
+    if (g_ecs_dirty_chunks.empty()) return;
+
+    run_ecs_transforms(g_ecs_dirty_chunks);
+    bool regroup = false;
+    for (uint32_t i : g_ecs_dirty_chunks) {
+        regroup |= pack_ecs_chunk(i);
+        uint32_t first = g_ecs_chunk_offsets[i];
+        refresh_instance_bounds(first, first + g_world.chunk_rows(g_ecs_chunks[i]));
+    }
+    if (regroup) build_draw_list();
+    // Bound scene nodes write over the copied models again
+    g_scene.rewrite_instances();
+}
+
+// Recompose moved scene nodes straight into the instance models; only the
+// written range needs new bounds
+static void update_scene_instances() {
+    uint32_t count = static_cast<uint32_t>(g_instances.size());
+    float* models = count > 0 ? g_instances[0].model : nullptr;
+    uint32_t first, end;
+    if (g_scene.update(models, sizeof(InstanceData) / sizeof(float), count, &first, &end)) {
+        refresh_instance_bounds(first, end);
+    }
+}
+
+// Frustum planes (Gribb/Hartmann) from the view-projection, for 0..1 clip depth
+static void update_frustum_planes() {
+    const float* m = g_view_proj;
+    auto row = [m](int r, int c) { return m[c * 4 + r]; };
+    for (int c = 0; c < 4; c++) {
+        g_frustum_planes[0][c] = row(3, c) + row(0, c);  // left
+        g_frustum_planes[1][c] = row(3, c) - row(0, c);  // right
+        g_frustum_planes[2][c] = row(3, c) + row(1, c);  // bottom
+        g_frustum_planes[3][c] = row(3, c) - row(1, c);  // top
+        g_frustum_planes[4][c] = row(2, c);              // near
+        g_frustum_planes[5][c] = row(3, c) - row(2, c);  // far
+    }
+    for (auto& plane : g_frustum_planes) {
+        float len = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        if (len > 0.0f) {
+            for (float& v : plane) v /= len;
+        }
+    }
+}
+
+// Camera position from the inverse of the rigid view transform: -R^T * t
+static void update_camera_position() {
+    const float* v = g_view;
+    for (int i = 0; i < 3; i++) {
+        g_camera_position[i] = -(v[i * 4 + 0] * v[12] + v[i * 4 + 1] * v[13] + v[i * 4 + 2] * v[14]);
+    }
+}
+
+static bool gpu_culling_active() {
+    return g_cull_mode == ENGINE_CULL_GPU && !g_draw_list.empty();
+}
+
+static bool cpu_culling_active() {
+    return g_cull_mode == ENGINE_CULL_CPU && !g_draw_list.empty();
+}
+
+// Cull as jobs and pack the survivors into this frame's instance
+// buffer, so the draws read them without an index indirection
+static int upload_visible_instances(FrameInstances& frame) {
+    uint32_t count = static_cast<uint32_t>(g_instances.size());
+
+    hxo::Frustum frustum = {};
+    memcpy(frustum.planes, g_frustum_planes, sizeof(frustum.planes));
+    memcpy(frustum.camera, g_camera_position, sizeof(frustum.camera));
+    frustum.max_distance = g_cull_distance;
+    hxo::SphereArrays spheres = {g_bounds_x.data(), g_bounds_y.data(), g_bounds_z.data(), g_bounds_radius.data()};
+
+    hxo::JobSystem& jobs = hxo::job_system();
+    g_cpu_visible.resize(count);
+    uint32_t visible = hxo::cull_spheres_parallel(jobs, hxo::cull_default_kernel(), frustum, spheres,
+        count, g_cpu_visible.data());
+    g_cpu_visible.resize(visible);
+
+    build_draw_items(g_visible_draw_list, visible,
+        [](uint32_t i) -> const InstanceData& { return g_instances[g_cpu_visible[i]]; });
+    if (visible == 0) return 0;
+
+    if (reserve_frame_instances(frame, visible) != 0) return 1;
+    auto* dst = static_cast<InstanceData*>(frame.mapped);
+    jobs.parallel_for(visible, INSTANCE_COPY_GRAIN, [dst](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            dst[i] = g_instances[g_cpu_visible[i]];
+        }
+    });
+    return 0;
+}
+
+static bool async_compute_active() {
+    return g_compute_queue != VK_NULL_HANDLE;
+}
+
+// This frame's compute command buffer, reset and begun. Its previous use
+// finished before the frame fence signalled, since that frame's graphics
+// submit waited on it.
+static VkCommandBuffer begin_async_compute() {
+    VkCommandBuffer cmd = g_compute_command_buffers[g_current_frame];
+    g_vk.vkResetCommandBuffer(cmd, 0);
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    g_vk.vkBeginCommandBuffer(cmd, &begin_info);
+    return cmd;
+}
+
+// Submit compute work recorded since begin_async_compute. It runs alongside
+// whatever the graphics queue is still doing; this frame's graphics work
+// waits for it at graphics_stage. Returns 0 on success.
+static int submit_async_compute(VkCommandBuffer cmd, VkPipelineStageFlags graphics_stage) {
+    g_vk.vkEndCommandBuffer(cmd);
+
+    uint64_t value = g_compute_submitted + 1;
+    VkTimelineSemaphoreSubmitInfo timeline_info = {};
+    timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timeline_info.signalSemaphoreValueCount = 1;
+    timeline_info.pSignalSemaphoreValues = &value;
+
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.pNext = &timeline_info;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &cmd;
+    submit_info.signalSemaphoreCount = 1;
+    submit_info.pSignalSemaphores = &g_compute_timeline;
+
+    if (g_vk.vkQueueSubmit(g_compute_queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
+        SDL_Log("Failed to submit async compute work");
+        return 1;
+    }
+    g_compute_submitted = value;
+    g_graphics_waits.push_back({g_compute_timeline, value, graphics_stage});
+    return 0;
+}
+
+static bool lighting_active() {
+    return !g_lights.empty() && !g_draw_list.empty();
+}
+
+static bool shadows_active() {
+    return shadows_enabled() && g_shadow_map_size == g_shadow_resolution && !g_draw_list.empty();
+}
+
+static void snapshot_shadow_caster(ShadowCaster& caster, uint32_t index) {
+    const InstanceData& instance = g_instances[index];
+    caster.id = g_instance_ids[index];
+    memcpy(caster.model, instance.model, sizeof(caster.model));
+    caster.bounds = g_instance_bounds[index];
+    caster.is_static = (instance.flags & ENGINE_INSTANCE_STATIC) != 0;
+    caster.transparent = (instance.flags & ENGINE_INSTANCE_TRANSPARENT) != 0;
+}
+
+static void touch_shadow_caster(const ShadowCaster& caster) {
+    g_shadow_cascades.touch(caster.bounds.center, caster.bounds.radius, caster.is_static);
+}
+
+// Re-snapshot a caster whose instance moved or changed kind, dirtying the
+// cascades where it was and where it is
+static void update_shadow_caster(ShadowCaster& caster, uint32_t index) {
+    const InstanceData& instance = g_instances[index];
+    bool is_static = (instance.flags & ENGINE_INSTANCE_STATIC) != 0;
+    bool transparent = (instance.flags & ENGINE_INSTANCE_TRANSPARENT) != 0;
+    if (is_static == caster.is_static && transparent == caster.transparent &&
+        memcmp(instance.model, caster.model, sizeof(caster.model)) == 0) {
+        return;
+    }
+    touch_shadow_caster(caster);
+    snapshot_shadow_caster(caster, index);
+    touch_shadow_caster(caster);
+}
+
+// Instances were added, removed or reordered: match casters by id so only
+// the cascades an added, removed or moved caster reaches are dirtied
+static void rematch_shadow_casters() {
+    std::unordered_map<uint32_t, uint32_t> previous;
+    previous.reserve(g_shadow_casters.size());
+    for (uint32_t i = 0; i < g_shadow_casters.size(); i++) previous.emplace(g_shadow_casters[i].id, i);
+
+    uint32_t count = static_cast<uint32_t>(g_instances.size());
+    std::vector<ShadowCaster> casters(count);
+    for (uint32_t i = 0; i < count; i++) {
+        auto it = previous.find(g_instance_ids[i]);
+        if (it == previous.end()) {
+            snapshot_shadow_caster(casters[i], i);
+            touch_shadow_caster(casters[i]);
+            continue;
+        }
+        casters[i] = g_shadow_casters[it->second];
+        previous.erase(it);
+        update_shadow_caster(casters[i], i);
+    }
+    for (const auto& [id, index] : previous) touch_shadow_caster(g_shadow_casters[index]);
+    g_shadow_casters = std::move(casters);
+}
+
+// Compare the instances with the casters the cached layers hold and dirty
+// the cascades each change reaches, where the caster was and where it is
+static void track_shadow_casters() {
+    uint32_t count = static_cast<uint32_t>(g_instances.size());
+    bool same_ids = g_shadow_casters.size() == count;
+    for (uint32_t i = 0; i < count && same_ids; i++) same_ids = g_shadow_casters[i].id == g_instance_ids[i];
+    if (!same_ids) {
+        rematch_shadow_casters();
+        return;
+    }
+    for (uint32_t i = 0; i < count; i++) update_shadow_caster(g_shadow_casters[i], i);
+}
+
+// Pick this frame's cascade renders and pack their casters into the
+// frame's buffer, one range per layer holding the casters that reach it.
+// Returns 0 with g_shadow_draws empty when every cached layer holds.
+static int update_shadows(FrameShadows& shadows) {
+    g_shadow_draws.clear();
+    if (!shadows_active()) return 0;
+
+    float direction[3] = {g_sun_direction[0], g_sun_direction[1], g_sun_direction[2]};
+    g_shadow_cascades.set_direction(direction);
+    track_shadow_casters();
+    if (!g_shadow_cascades.update(g_view, g_proj, g_shadow_frame++, g_shadow_updates)) return 0;
+
+    g_shadow_draw_casters.clear();
+    uint32_t count = static_cast<uint32_t>(g_shadow_casters.size());
+    for (uint32_t c = 0; c < SHADOW_CASCADES; c++) {
+        for (bool is_static : {true, false}) {
+            bool wanted = is_static ? g_shadow_updates[c].static_layer : g_shadow_updates[c].composite;
+            if (!wanted) continue;
+            ShadowDraw draw = {c, is_static, static_cast<uint32_t>(g_shadow_draw_casters.size()), 0};
+            for (uint32_t i = 0; i < count; i++) {
+                const ShadowCaster& caster = g_shadow_casters[i];
+                if (caster.transparent && oit_active()) continue;
+                if (caster.is_static == is_static &&
+                    g_shadow_cascades.overlaps(c, caster.bounds.center, caster.bounds.radius)) {
+                    g_shadow_draw_casters.push_back(i);
+                }
+            }
+            draw.count = static_cast<uint32_t>(g_shadow_draw_casters.size()) - draw.first;
+            g_shadow_draws.push_back(draw);
+        }
+    }
+
+    uint32_t total = static_cast<uint32_t>(g_shadow_draw_casters.size());
+    if (reserve_frame_shadows(shadows, total) != 0) return 1;
+    auto* models = static_cast<float*>(shadows.mapped);
+    for (uint32_t i = 0; i < total; i++) {
+        memcpy(models + i * 16, g_instances[g_shadow_draw_casters[i]].model, 16 * sizeof(float));
+    }
+    return 0;
+}
+
+// Draw one layer's casters. Static layers are cleared first; composite
+// layers keep the cache copied into them.
+static void record_shadow_draw(VkCommandBuffer cmd, const ShadowDraw& draw) {
+    uint32_t image = draw.is_static ? SHADOW_STATIC : SHADOW_COMPOSITE;
+    VkClearValue clear = {};
+    clear.depthStencil = {1.0f, 0};
+
+    VkRenderPassBeginInfo pass_info = {};
+    pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    pass_info.renderPass = draw.is_static ? g_shadow_clear_pass : g_shadow_load_pass;
+    pass_info.framebuffer = g_shadow_framebuffers[image][draw.cascade];
+    pass_info.renderArea.extent = {g_shadow_map_size, g_shadow_map_size};
+    pass_info.clearValueCount = draw.is_static ? 1 : 0;
+    pass_info.pClearValues = &clear;
+    g_vk.vkCmdBeginRenderPass(cmd, &pass_info, VK_SUBPASS_CONTENTS_INLINE);
+
+    if (draw.count > 0) {
+        VkViewport viewport = {0.0f, 0.0f, static_cast<float>(g_shadow_map_size),
+                               static_cast<float>(g_shadow_map_size), 0.0f, 1.0f};
+        VkRect2D scissor = {{0, 0}, {g_shadow_map_size, g_shadow_map_size}};
+        g_vk.vkCmdSetViewport(cmd, 0, 1, &viewport);
+        g_vk.vkCmdSetScissor(cmd, 0, 1, &scissor);
+        g_vk.vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, g_shadow_pipeline);
+        g_vk.vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, g_shadow_pipeline_layout,
+            0, 1, &g_frame_shadows[g_current_frame].set, 0, nullptr);
+        g_vk.vkCmdPushConstants(cmd, g_shadow_pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT,
+            0, 16 * sizeof(float), g_shadow_cascades.view_proj(draw.cascade));
+        g_vk.vkCmdBindIndexBuffer(cmd, g_quad_index_buffer, 0, VK_INDEX_TYPE_UINT16);
+        g_vk.vkCmdDrawIndexed(cmd, 6, draw.count, 0, 0, draw.first);
+    }
+    g_vk.vkCmdEndRenderPass(cmd);
+}
+
+static void record_shadow_static(VkCommandBuffer cmd) {
+    for (const ShadowDraw& draw : g_shadow_draws) {
+        if (draw.is_static) record_shadow_draw(cmd, draw);
+    }
+}
+
+// Start each updated composite layer from its cascade's static cache
+static void record_shadow_copy(VkCommandBuffer cmd) {
+    VkImageCopy regions[SHADOW_CASCADES] = {};
+    uint32_t count = 0;
+    for (uint32_t c = 0; c < SHADOW_CASCADES; c++) {
+        if (!g_shadow_updates[c].composite) continue;
+        VkImageCopy& region = regions[count++];
+        region.srcSubresource = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, c, 1};
+        region.dstSubresource = region.srcSubresource;
+        region.extent = {g_shadow_map_size, g_shadow_map_size, 1};
+    }
+    g_vk.vkCmdCopyImage(cmd, g_shadow_images[SHADOW_STATIC], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        g_shadow_images[SHADOW_COMPOSITE], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, count, regions);
+}
+
+static void record_shadow_dynamic(VkCommandBuffer cmd) {
+    for (const ShadowDraw& draw : g_shadow_draws) {
+        if (!draw.is_static && draw.count > 0) record_shadow_draw(cmd, draw);
+    }
+}
+
+// Refresh the cascades update_shadows() picked: static casters into the
+// cache, the cache into the composite, dynamic casters over it
+static void add_shadow_passes(hxo::RenderGraph& graph, hxo::ResourceHandle shadow_map) {
+    hxo::ImageImport cache = {};
+    cache.image = g_shadow_images[SHADOW_STATIC];
+    cache.view = VK_NULL_HANDLE;
+    cache.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    cache.initial_layout = g_shadow_layouts_valid[SHADOW_STATIC] ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                                                                 : VK_IMAGE_LAYOUT_UNDEFINED;
+    cache.initial_stage = VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR;
+    hxo::ResourceHandle static_map = graph.import_image("shadow_cache", cache);
+
+    bool any_static = false;
+    for (const ShadowDraw& draw : g_shadow_draws) any_static |= draw.is_static;
+    if (any_static) {
+        graph.add_pass("shadow_static", record_shadow_static)
+            .write(static_map, hxo::ResourceUsage::DepthAttachment);
+    }
+    graph.add_pass("shadow_copy", record_shadow_copy)
+        .read(static_map, hxo::ResourceUsage::TransferSrc)
+        .write(shadow_map, hxo::ResourceUsage::TransferDst);
+    graph.add_pass("shadow_dynamic", record_shadow_dynamic)
+        .read(shadow_map, hxo::ResourceUsage::DepthAttachment)
+        .write(shadow_map, hxo::ResourceUsage::DepthAttachment);
+}
+
+// Copy the lights into this frame's buffer and fill the light uniform. The
+// uniform is written even without lights: it tells the shaders to skip
+// lighting.
+static int upload_frame_lights(FrameLights& lights, VkDescriptorSet set) {
+    uint32_t count = static_cast<uint32_t>(g_lights.size());
+    if (count > 0) {
+        if (reserve_frame_lights(lights, set, count) != 0) return 1;
+        memcpy(lights.light_mapped, g_lights.data(), count * sizeof(EngineLight));
+    }
+
+    LightUniforms uniforms = {};
+    memcpy(uniforms.view, g_view, sizeof(uniforms.view));
+    const float* p = g_proj;
+    float proj_x[] = {p[0], p[8], p[12], 0.0f};
+    float proj_y[] = {p[5], p[9], p[13], 0.0f};
+    float proj_depth[] = {p[10], p[14], p[11], p[15]};
+    memcpy(uniforms.proj_x, proj_x, sizeof(proj_x));
+    memcpy(uniforms.proj_y, proj_y, sizeof(proj_y));
+    memcpy(uniforms.proj_depth, proj_depth, sizeof(proj_depth));
+    uniforms.grid[0] = LIGHT_CLUSTERS_X;
+    uniforms.grid[1] = LIGHT_CLUSTERS_Y;
+    uniforms.grid[2] = LIGHT_CLUSTERS_Z;
+    uniforms.grid[3] = count;
+    uniforms.tile_scale[0] = static_cast<float>(LIGHT_CLUSTERS_X) / static_cast<float>(g_render_extent.width);
+    uniforms.tile_scale[1] = static_cast<float>(LIGHT_CLUSTERS_Y) / static_cast<float>(g_render_extent.height);
+
+    // Slices span the view z of depth 0 to depth 1: logarithmically from
+    // the plane nearer the eye under a perspective projection (w depends on
+    // z), evenly otherwise
+    auto view_z = [p](float depth) { return (p[14] - depth * p[15]) / (depth * p[11] - p[10]); };
+    float z0 = view_z(0.0f);
+    float z1 = view_z(1.0f);
+    uniforms.logarithmic = p[11] != 0.0f ? 1 : 0;
+    if (uniforms.logarithmic) {
+        bool reversed = !(std::fabs(z0) <= std::fabs(z1));
+        float near_z = reversed ? z1 : z0;
+        float far_z = reversed ? z0 : z1;
+        if (!std::isfinite(far_z) || std::fabs(far_z) > std::fabs(near_z) * MAX_LIGHT_DEPTH_RATIO) {
+            far_z = near_z * MAX_LIGHT_DEPTH_RATIO;
+        }
+        uniforms.near_z = near_z;
+        uniforms.slice_scale = LIGHT_CLUSTERS_Z / std::log(far_z / near_z);
+    } else {
+        uniforms.near_z = z0;
+        uniforms.slice_scale = LIGHT_CLUSTERS_Z / (z1 - z0);
+    }
+    // Lighting stays off on a degenerate projection rather than divide by zero
+    bool valid = std::isfinite(uniforms.near_z) && std::isfinite(uniforms.slice_scale) &&
+                 p[0] != 0.0f && p[5] != 0.0f;
+    if (!valid) uniforms.grid[3] = 0;
+
+    // The cascades are sampled with the matrices their layers were last
+    // rendered with, which lag the camera on frames they wait their turn
+    bool sun = g_sun_color[0] > 0.0f || g_sun_color[1] > 0.0f || g_sun_color[2] > 0.0f;
+    memcpy(uniforms.sun_direction, g_sun_direction, sizeof(g_sun_direction));
+    uniforms.sun_direction[3] = shadows_active() && g_shadow_cascades.ready() ? 1.0f : 0.0f;
+    memcpy(uniforms.sun_color, g_sun_color, sizeof(g_sun_color));
+    for (uint32_t c = 0; c < SHADOW_CASCADES; c++) {
+        memcpy(uniforms.shadow_matrices[c], g_shadow_cascades.view_proj(c), sizeof(uniforms.shadow_matrices[c]));
+        uniforms.shadow_texels[c] = g_shadow_cascades.texel_size(c);
+    }
+    uniforms.shadow_texel[0] = 1.0f / static_cast<float>(g_shadow_map_size);
+    uniforms.shadow_texel[1] = uniforms.shadow_texel[0];
+
+    memcpy(uniforms.ambient, g_ambient_light, sizeof(g_ambient_light));
+    uniforms.ambient[3] = (count > 0 && valid) || sun ? 1.0f : 0.0f;
+
+    memcpy(lights.uniform_mapped, &uniforms, sizeof(uniforms));
+    return 0;
+}
+
+// light_cull.comp hands out index entries from a counter that starts at zero
+static void record_light_reset(VkCommandBuffer cmd) {
+    g_vk.vkCmdFillBuffer(cmd, g_frame_lights[g_current_frame].index_buffer, 0, sizeof(uint32_t), 0);
+}
+
+static void record_light_cull(VkCommandBuffer cmd) {
+    g_vk.vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, g_light_cull_pipeline);
+    g_vk.vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, g_light_cull_pipeline_layout,
+        1, 1, &g_frame_instances[g_current_frame].set, 0, nullptr);
+    g_vk.vkCmdDispatch(cmd, 1, 1, LIGHT_CLUSTERS_Z);
+}
+
+// Bin the lights into clusters ahead of the main pass. Light data and the
+// uniform are host-written and need no barriers.
+static void add_light_passes(hxo::RenderGraph& graph, hxo::ResourceHandle clusters, hxo::ResourceHandle indices) {
+    graph.add_pass("reset_light_indices", record_light_reset)
+        .write(indices, hxo::ResourceUsage::TransferDst);
+    graph.add_pass("light_cull", record_light_cull)
+        .read(indices, hxo::ResourceUsage::ComputeStorage)
+        .write(indices, hxo::ResourceUsage::ComputeStorage)
+        .write(clusters, hxo::ResourceUsage::ComputeStorage);
+}
+
+// Reset the indirect commands from the templates; cull.comp raises the
+// instance counts of the survivors
+static void record_draw_reset(VkCommandBuffer cmd) {
+    FrameInstances& frame = g_frame_instances[g_current_frame];
+    uint32_t command_count = static_cast<uint32_t>(g_draw_templates.size());
+
+    VkBufferCopy copy = {};
+    copy.size = INDIRECT_COMMANDS_OFFSET + command_count * sizeof(VkDrawIndexedIndirectCommand);
+    g_vk.vkCmdCopyBuffer(cmd, frame.template_buffer, frame.indirect_buffer, 1, &copy);
+}
+
+static void record_cull_dispatch(VkCommandBuffer cmd) {
+    FrameInstances& frame = g_frame_instances[g_current_frame];
+    uint32_t instance_count = static_cast<uint32_t>(g_instances.size());
+
+    CullPushConstants params = {};
+    memcpy(params.planes, g_frustum_planes, sizeof(params.planes));
+    memcpy(params.camera_position, g_camera_position, sizeof(params.camera_position));
+    params.max_distance = g_cull_distance;
+    params.instance_count = instance_count;
+    params.command_count = static_cast<uint32_t>(g_draw_templates.size());
+
+    g_vk.vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, g_cull_pipeline);
+    g_vk.vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, g_cull_pipeline_layout,
+        0, 1, &frame.cull_set, 0, nullptr);
+    g_vk.vkCmdPushConstants(cmd, g_cull_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT,
+        0, sizeof(params), &params);
+    g_vk.vkCmdDispatch(cmd, (instance_count + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+}
+
+// Culling writes compacted visible indices and draw commands. Bounds and
+// templates are host-written and need no barriers.
+static void add_cull_passes(hxo::RenderGraph& graph, hxo::ResourceHandle indirect, hxo::ResourceHandle visible) {
+    graph.add_pass("reset_draws", record_draw_reset)
+        .write(indirect, hxo::ResourceUsage::TransferDst);
+    graph.add_pass("cull", record_cull_dispatch)
+        .read(indirect, hxo::ResourceUsage::ComputeStorage)
+        .write(indirect, hxo::ResourceUsage::ComputeStorage)
+        .write(visible, hxo::ResourceUsage::ComputeStorage);
+}
+
+static void set_viewport_and_scissor(VkCommandBuffer cmd) {
+    VkViewport viewport = {};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(g_render_extent.width);
+    viewport.height = static_cast<float>(g_render_extent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    g_vk.vkCmdSetViewport(cmd, 0, 1, &viewport);
+
+    VkRect2D scissor = {};
+    scissor.offset = {0, 0};
+    scissor.extent = g_render_extent;
+    g_vk.vkCmdSetScissor(cmd, 0, 1, &scissor);
+}
+
+// State shared by every instance draw: pipeline, instance set, camera, quad indices
+static void bind_instance_state(VkCommandBuffer cmd, bool gpu_culled, VkPipeline pipeline) {
+    FrameInstances& frame = g_frame_instances[g_current_frame];
+
+    InstancePushConstants push = {};
+    memcpy(push.view_proj, g_draw_view_proj, sizeof(push.view_proj));
+    push.use_visible_list = gpu_culled ? 1 : 0;
+
+    g_vk.vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    g_vk.vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, g_instance_pipeline_layout,
+        1, 1, &frame.set, 0, nullptr);
+    g_vk.vkCmdPushConstants(cmd, g_instance_pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT,
+        0, sizeof(push), &push);
+    g_vk.vkCmdBindIndexBuffer(cmd, g_quad_index_buffer, 0, VK_INDEX_TYPE_UINT16);
+    if (g_bindless_supported) {
+        g_vk.vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, g_instance_pipeline_layout,
+            0, 1, &g_bindless_set, 0, nullptr);
+    }
+}
+
+// Whether the item goes into the OIT sums rather than the opaque draws
+static bool draws_transparent(const DrawItem& item) {
+    return item.transparent && oit_active();
+}
+
+static bool has_oit_draws(const std::vector<DrawItem>& draws) {
+    return oit_active() && std::any_of(draws.begin(), draws.end(),
+        [](const DrawItem& item) { return item.transparent; });
+}
+
+// Draws the opaque or the transparent items of [begin, end) of the list,
+// binding classic texture sets as they change
+static void record_draw_range(VkCommandBuffer cmd, const std::vector<DrawItem>& draws,
+                              uint32_t begin, uint32_t end, bool gpu_culled, bool transparent) {
+    FrameInstances& frame = g_frame_instances[g_current_frame];
+    constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+    uint32_t bound_texture = UINT32_MAX;
+    for (uint32_t i = begin; i < end; i++) {
+        const DrawItem& item = draws[i];
+        if (draws_transparent(item) != transparent) continue;
+        if (!g_bindless_supported && item.texture != bound_texture) {
+            Texture* tex = get_texture(item.texture);
+            if (!tex || !tex->ready) tex = get_texture(g_white_texture);
+            g_vk.vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, g_instance_pipeline_layout,
+                0, 1, &tex->set, 0, nullptr);
+            bound_texture = item.texture;
+        }
+        if (gpu_culled) {
+            g_vk.vkCmdDrawIndexedIndirect(cmd, frame.indirect_buffer,
+                INDIRECT_COMMANDS_OFFSET + i * stride, 1, stride);
+        } else {
+            g_vk.vkCmdDrawIndexed(cmd, 6, item.instance_count, 0, 0, item.first_instance);
+        }
+    }
+}
+
+// Every opaque or every transparent draw of the list with the pipeline
+// already bound
+static void record_list_draws(VkCommandBuffer cmd, const std::vector<DrawItem>& draws, bool gpu_culled,
+                              bool transparent) {
+    FrameInstances& frame = g_frame_instances[g_current_frame];
+    uint32_t command_count = static_cast<uint32_t>(draws.size());
+    constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+    // One draw for the whole pipeline, count written by cull.comp, unless
+    // the list mixes in transparent runs
+    if (g_bindless_supported && gpu_culled && !has_oit_draws(draws)) {
+        if (transparent) return;
+        if (g_draw_indirect_count_supported) {
+            g_vk.vkCmdDrawIndexedIndirectCount(cmd, frame.indirect_buffer, INDIRECT_COMMANDS_OFFSET,
+                frame.indirect_buffer, 0, command_count, stride);
+        } else if (g_multi_draw_indirect_supported) {
+            g_vk.vkCmdDrawIndexedIndirect(cmd, frame.indirect_buffer, INDIRECT_COMMANDS_OFFSET,
+                command_count, stride);
+        } else {
+            record_draw_range(cmd, draws, 0, command_count, gpu_culled, false);
+        }
+        return;
+    }
+
+    record_draw_range(cmd, draws, 0, command_count, gpu_culled, transparent);
+}
+
+// Shading pipeline for instance draws, given the depth pre-pass setting
+static VkPipeline instance_shading_pipeline() {
+    return g_depth_prepass ? g_instance_equal_pipeline : g_instance_pipeline;
+}
+
+static void record_instance_draws(VkCommandBuffer cmd, const std::vector<DrawItem>& draws) {
+    if (draws.empty()) return;
+    bool gpu_culled = gpu_culling_active();
+    if (g_depth_prepass) {
+        // Depth for the whole opaque list first, so each pixel is shaded once
+        bind_instance_state(cmd, gpu_culled, g_instance_depth_pipeline);
+        record_list_draws(cmd, draws, gpu_culled, false);
+        g_vk.vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, instance_shading_pipeline());
+    } else {
+        bind_instance_state(cmd, gpu_culled, g_instance_pipeline);
+    }
+    record_list_draws(cmd, draws, gpu_culled, false);
+
+    // Transparent runs last, tested against every opaque depth
+    if (has_oit_draws(draws)) {
+        g_vk.vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, g_instance_oit_pipeline);
+        record_list_draws(cmd, draws, gpu_culled, true);
+    }
+}
+
+// Long classic draw lists are split across worker threads; the bindless
+// path is a handful of commands and stays inline
+static bool use_secondary_recording(const std::vector<DrawItem>& draws) {
+    return draws.size() >= PARALLEL_RECORD_MIN_DRAWS &&
+        !(g_bindless_supported && gpu_culling_active());
+}
+
+// Record the draw list into secondary command buffers, one per slice, each
+// from a pool owned by the recording thread. g_secondary_buffers ends up in
+// draw order for vkCmdExecuteCommands; with the depth pre-pass every slice's
+// depth buffer comes before all shading buffers, and the buffers drawing
+// transparent items into the OIT sums come after them. framebuffer is null
+// under dynamic rendering.
+static int record_secondary_draws(const std::vector<DrawItem>& draws, VkFramebuffer framebuffer) {
+    hxo::JobSystem& jobs = hxo::job_system();
+    auto& contexts = g_record_contexts[g_current_frame];
+    uint32_t count = static_cast<uint32_t>(draws.size());
+    uint32_t target_slices = jobs.thread_count() * 2;
+    uint32_t grain = std::max(MIN_DRAWS_PER_SECONDARY, (count + target_slices - 1) / target_slices);
+    uint32_t slices = (count + grain - 1) / grain;
+    bool oit = has_oit_draws(draws);
+    uint32_t buffers_per_slice = (g_depth_prepass ? 2 : 1) + (oit ? 1 : 0);
+
+    // This frame's fence has signalled, so its pools are free to reset. Any
+    // thread may record any slice, so each pool needs a buffer per slice.
+    uint32_t needed = slices * buffers_per_slice;
+    for (RecordContext& context : contexts) {
+        g_vk.vkResetCommandPool(g_device, context.pool, 0);
+        if (context.buffers.size() < needed) {
+            uint32_t missing = needed - static_cast<uint32_t>(context.buffers.size());
+            VkCommandBufferAllocateInfo alloc_info = {};
+            alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            alloc_info.commandPool = context.pool;
+            alloc_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            alloc_info.commandBufferCount = missing;
+
+            size_t first = context.buffers.size();
+            context.buffers.resize(first + missing);
+            if (g_vk.vkAllocateCommandBuffers(g_device, &alloc_info, context.buffers.data() + first) != VK_SUCCESS) {
+                SDL_Log("Failed to allocate secondary command buffers");
+                context.buffers.resize(first);
+                return 1;
+            }
+        }
+        context.used = 0;
+    }
+
+    VkCommandBufferInheritanceRenderingInfoKHR rendering_inheritance = {};
+    rendering_inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR;
+    rendering_inheritance.colorAttachmentCount = main_color_attachment_count();
+    rendering_inheritance.pColorAttachmentFormats = g_main_color_formats;
+    rendering_inheritance.depthAttachmentFormat = g_depth_format;
+    rendering_inheritance.rasterizationSamples = g_msaa_samples;
+
+    VkCommandBufferInheritanceInfo inheritance = {};
+    inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    if (g_dynamic_rendering_supported) inheritance.pNext = &rendering_inheritance;
+    inheritance.renderPass = g_render_pass;
+    inheritance.subpass = 0;
+    inheritance.framebuffer = framebuffer;
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT |
+                       VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    begin_info.pInheritanceInfo = &inheritance;
+
+    bool gpu_culled = gpu_culling_active();
+    g_secondary_buffers.resize(needed);
+    jobs.parallel_for(count, grain, [&](uint32_t begin, uint32_t end) {
+        RecordContext& context = contexts[hxo::JobSystem::thread_index()];
+        uint32_t slice = begin / grain;
+        auto record = [&](VkPipeline pipeline, uint32_t group, bool transparent) {
+            VkCommandBuffer cmd = context.buffers[context.used++];
+            g_vk.vkBeginCommandBuffer(cmd, &begin_info);
+            set_viewport_and_scissor(cmd);
+            bind_instance_state(cmd, gpu_culled, pipeline);
+            record_draw_range(cmd, draws, begin, end, gpu_culled, transparent);
+            g_vk.vkEndCommandBuffer(cmd);
+            g_secondary_buffers[group * slices + slice] = cmd;
+        };
+
+        uint32_t group = 0;
+        if (g_depth_prepass) record(g_instance_depth_pipeline, group++, false);
+        record(instance_shading_pipeline(), group++, false);
+        if (oit) record(g_instance_oit_pipeline, group, true);
+    });
+    return 0;
+}
+
+// Start drawing into a swapchain image (or the scene color target under
+// dynamic resolution), through the render pass or with dynamic rendering.
+// The frame graph has already moved the attachments into their layouts;
+// under dynamic rendering depth_view and msaa_view are its transients.
+// Depth and the color samples are cleared; with MSAA the color target is
+// only written by the resolve. Motion vectors clear to zero, so whatever is
+// not drawn counts as static. The OIT sums start with nothing added and
+// everything revealed.
+static void begin_main_pass(VkCommandBuffer cmd, uint32_t image_index, const VkClearValue& clear_value,
+                            bool secondary, VkImageView depth_view, VkImageView msaa_view) {
+    bool msaa = g_msaa_samples != VK_SAMPLE_COUNT_1_BIT;
+    VkClearValue accum_clear = {};
+    VkClearValue reveal_clear = {};
+    reveal_clear.color = {{1.0f, 0.0f, 0.0f, 0.0f}};
+    VkClearValue clear_values[10] = {};
+    clear_values[0] = clear_value;
+    clear_values[1].depthStencil = {1.0f, 0};
+    uint32_t clear_count = 2;
+    if (msaa) clear_values[clear_count++] = clear_value;
+    if (g_temporal_upscaling) clear_values[clear_count++].color = {{0.0f, 0.0f, 0.0f, 0.0f}};
+    for (uint32_t i = 0; i < post_attachment_count(); i++) clear_values[clear_count++] = clear_value;
+    if (oit_active()) {
+        for (uint32_t i = 0; i < (msaa ? 2u : 1u); i++) {
+            clear_values[clear_count++] = accum_clear;
+            clear_values[clear_count++] = reveal_clear;
+        }
+    }
+
+    if (!g_dynamic_rendering_supported) {
+        VkRenderPassBeginInfo rp_info = {};
+        rp_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        rp_info.renderPass = g_render_pass;
+        rp_info.framebuffer = g_framebuffers[image_index];
+        rp_info.renderArea.offset = {0, 0};
+        rp_info.renderArea.extent = g_render_extent;
+        rp_info.clearValueCount = clear_count;
+        rp_info.pClearValues = clear_values;
+
+        VkSubpassContents contents = secondary
+            ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE;
+        g_vk.vkCmdBeginRenderPass(cmd, &rp_info, contents);
+        return;
+    }
+
+    VkImageView target = scene_target_active() ? g_scene_color_view : g_swapchain_image_views[image_index];
+    VkRenderingAttachmentInfoKHR color_attachments[MAX_MAIN_COLOR_ATTACHMENTS] = {};
+    VkRenderingAttachmentInfoKHR& color_attachment = color_attachments[MAIN_COLOR_SLOT];
+    color_attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+    color_attachment.imageView = target;
+    color_attachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    color_attachment.clearValue = clear_value;
+    if (msaa) {
+        color_attachment.imageView = msaa_view;
+        color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        color_attachment.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT_KHR;
+        color_attachment.resolveImageView = target;
+        color_attachment.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    }
+    // Null without temporal upscaling, which leaves the slot unused
+    VkRenderingAttachmentInfoKHR& motion_attachment = color_attachments[MAIN_MOTION_SLOT];
+    motion_attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+    motion_attachment.imageView = g_motion_view;
+    motion_attachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    motion_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    motion_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    // The composite pass samples the sums, resolved first under MSAA
+    for (uint32_t i = 0; i < 2 && oit_active(); i++) {
+        VkRenderingAttachmentInfoKHR& oit_attachment = color_attachments[MAIN_ACCUM_SLOT + i];
+        oit_attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+        oit_attachment.imageView = g_oit_views[i];
+        oit_attachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        oit_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        oit_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        oit_attachment.clearValue = i == 0 ? accum_clear : reveal_clear;
+        if (msaa) {
+            oit_attachment.imageView = g_oit_msaa_views[i];
+            oit_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            oit_attachment.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT_KHR;
+            oit_attachment.resolveImageView = g_oit_views[i];
+            oit_attachment.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        }
+    }
+
+    VkRenderingAttachmentInfoKHR depth_attachment = {};
+    depth_attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+    depth_attachment.imageView = depth_view;
+    depth_attachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depth_attachment.clearValue = clear_values[1];
+
+    VkRenderingInfoKHR rendering_info = {};
+    rendering_info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+    rendering_info.flags = secondary ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR : VkRenderingFlagsKHR(0);
+    rendering_info.renderArea.offset = {0, 0};
+    rendering_info.renderArea.extent = g_render_extent;
+    rendering_info.layerCount = 1;
+    rendering_info.colorAttachmentCount = main_color_attachment_count();
+    rendering_info.pColorAttachments = color_attachments;
+    rendering_info.pDepthAttachment = &depth_attachment;
+    g_vk.vkCmdBeginRenderingKHR(cmd, &rendering_info);
+}
+
+static PostPushConstants post_push_constants() {
+    PostPushConstants params = {};
+    params.size[0] = static_cast<float>(g_render_extent.width);
+    params.size[1] = static_cast<float>(g_render_extent.height);
+    params.exposure = g_post_exposure;
+    params.contrast = g_post_contrast;
+    params.saturation = g_post_saturation;
+    params.vignette = g_post_vignette;
+    params.effects = g_post_effects;
+    return params;
+}
+
+// Each enabled effect is one more subpass, recorded inline even after
+// secondary buffers: a full-screen triangle reading the previous subpass's
+// result at its own pixel
+static void record_post_subpasses(VkCommandBuffer cmd) {
+    PostPushConstants params = post_push_constants();
+    for (uint32_t i = 0; i < post_effect_count(); i++) {
+        g_vk.vkCmdNextSubpass(cmd, VK_SUBPASS_CONTENTS_INLINE);
+        set_viewport_and_scissor(cmd);
+        g_vk.vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, g_post_pipelines[i]);
+        g_vk.vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, g_post_pipeline_layout,
+            0, 1, &g_post_sets[i % 2], 0, nullptr);
+        g_vk.vkCmdPushConstants(cmd, g_post_pipeline_layout, VK_SHADER_STAGE_FRAGMENT_BIT,
+            0, sizeof(params), &params);
+        g_vk.vkCmdDraw(cmd, 3, 1, 0, 0);
+    }
+}
+
+// Full-screen triangle blending the resolved transparency over the scene
+// color, in the composite subpass or the composite pass's own rendering
+static void record_oit_composite(VkCommandBuffer cmd) {
+    set_viewport_and_scissor(cmd);
+    g_vk.vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, g_oit_composite_pipeline);
+    g_vk.vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, g_oit_pipeline_layout,
+        0, 1, &g_oit_set, 0, nullptr);
+    g_vk.vkCmdDraw(cmd, 3, 1, 0, 0);
+}
+
+// The composite as its own pass under dynamic rendering, drawing over the
+// main pass's result with the sums sampled
+static void record_oit_composite_pass(VkCommandBuffer cmd, uint32_t image_index) {
+    VkRenderingAttachmentInfoKHR color_attachment = {};
+    color_attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+    color_attachment.imageView = scene_target_active() ? g_scene_color_view : g_swapchain_image_views[image_index];
+    color_attachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+    VkRenderingInfoKHR rendering_info = {};
+    rendering_info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+    rendering_info.renderArea.offset = {0, 0};
+    rendering_info.renderArea.extent = g_render_extent;
+    rendering_info.layerCount = 1;
+    rendering_info.colorAttachmentCount = 1;
+    rendering_info.pColorAttachments = &color_attachment;
+    g_vk.vkCmdBeginRenderingKHR(cmd, &rendering_info);
+    record_oit_composite(cmd);
+    g_vk.vkCmdEndRenderingKHR(cmd);
+}
+
+static void end_main_pass(VkCommandBuffer cmd) {
+    if (g_dynamic_rendering_supported) {
+        g_vk.vkCmdEndRenderingKHR(cmd);
+    } else {
+        if (oit_active()) {
+            g_vk.vkCmdNextSubpass(cmd, VK_SUBPASS_CONTENTS_INLINE);
+            record_oit_composite(cmd);
+        }
+        if (post_subpasses_active()) record_post_subpasses(cmd);
+        g_vk.vkCmdEndRenderPass(cmd);
+    }
+}
+
+// Every enabled effect in one dispatch over the rendered part of the scene
+// target, the fallback for the post subpasses under dynamic rendering
+static void record_post_compute(VkCommandBuffer cmd) {
+    PostPushConstants params = post_push_constants();
+    g_vk.vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, g_post_pipelines[0]);
+    g_vk.vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, g_post_pipeline_layout,
+        0, 1, &g_post_sets[0], 0, nullptr);
+    g_vk.vkCmdPushConstants(cmd, g_post_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT,
+        0, sizeof(params), &params);
+    g_vk.vkCmdDispatch(cmd, (g_render_extent.width + POST_WORKGROUP_SIZE - 1) / POST_WORKGROUP_SIZE,
+        (g_render_extent.height + POST_WORKGROUP_SIZE - 1) / POST_WORKGROUP_SIZE, 1);
+}
+
+// Filtered blit of the rendered part of the scene target over the whole
+// swapchain image. Under temporal upscaling the history written this frame
+// already has the swapchain's size, and the blit only converts its format.
+static void record_upscale(VkCommandBuffer cmd, uint32_t image_index) {
+    VkImage source = g_scene_color_image;
+    VkExtent2D extent = g_render_extent;
+    VkFilter filter = VK_FILTER_LINEAR;
+    if (g_temporal_upscaling) {
+        source = g_history_images[g_history_index];
+        extent = g_swapchain_extent;
+        filter = VK_FILTER_NEAREST;
+    }
+
+    VkImageBlit region = {};
+    region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.srcSubresource.layerCount = 1;
+    region.srcOffsets[1] = {static_cast<int32_t>(extent.width), static_cast<int32_t>(extent.height), 1};
+    region.dstSubresource = region.srcSubresource;
+    region.dstOffsets[1] = {static_cast<int32_t>(g_swapchain_extent.width),
+                            static_cast<int32_t>(g_swapchain_extent.height), 1};
+    g_vk.vkCmdBlitImage(cmd, source, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        g_swapchain_images[image_index], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, filter);
+}
+
+// Accumulate this frame into the history image it writes
+static void record_temporal_resolve(VkCommandBuffer cmd) {
+    TemporalPushConstants params = {};
+    params.input_size[0] = static_cast<float>(g_render_extent.width);
+    params.input_size[1] = static_cast<float>(g_render_extent.height);
+    params.input_texel[0] = 1.0f / static_cast<float>(g_swapchain_extent.width);
+    params.input_texel[1] = 1.0f / static_cast<float>(g_swapchain_extent.height);
+    params.output_size[0] = static_cast<float>(g_swapchain_extent.width);
+    params.output_size[1] = static_cast<float>(g_swapchain_extent.height);
+    params.jitter[0] = g_jitter[0];
+    params.jitter[1] = g_jitter[1];
+    params.history_valid = g_history_valid ? 1 : 0;
+
+    g_vk.vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, g_temporal_pipeline);
+    g_vk.vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, g_temporal_pipeline_layout,
+        0, 1, &g_temporal_sets[g_history_index], 0, nullptr);
+    g_vk.vkCmdPushConstants(cmd, g_temporal_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT,
+        0, sizeof(params), &params);
+    g_vk.vkCmdDispatch(cmd, (g_swapchain_extent.width + TEMPORAL_WORKGROUP_SIZE - 1) / TEMPORAL_WORKGROUP_SIZE,
+        (g_swapchain_extent.height + TEMPORAL_WORKGROUP_SIZE - 1) / TEMPORAL_WORKGROUP_SIZE, 1);
+}
+
+// Element `index` (from 1) of the Halton low-discrepancy sequence in `base`
+static float halton(uint32_t index, uint32_t base) {
+    float result = 0.0f;
+    float fraction = 1.0f;
+    while (index > 0) {
+        fraction /= static_cast<float>(base);
+        result += fraction * static_cast<float>(index % base);
+        index /= base;
+    }
+    return result;
+}
+
+// Pick this frame's sub-pixel sample offset and shift the projection by it:
+// clip x and y move by the offset in NDC times w. Without temporal
+// upscaling instances are drawn with the plain camera.
+static void update_jitter() {
+    memcpy(g_draw_view_proj, g_view_proj, sizeof(g_draw_view_proj));
+    if (!g_temporal_upscaling) return;
+
+    g_jitter_phase = (g_jitter_phase + 1) % TEMPORAL_JITTER_PHASES;
+    g_jitter[0] = halton(g_jitter_phase + 1, 2) - 0.5f;
+    g_jitter[1] = halton(g_jitter_phase + 1, 3) - 0.5f;
+    float offset_x = 2.0f * g_jitter[0] / static_cast<float>(g_render_extent.width);
+    float offset_y = 2.0f * g_jitter[1] / static_cast<float>(g_render_extent.height);
+    for (int col = 0; col < 4; col++) {
+        g_draw_view_proj[col * 4 + 0] += offset_x * g_view_proj[col * 4 + 3];
+        g_draw_view_proj[col * 4 + 1] += offset_y * g_view_proj[col * 4 + 3];
+    }
+}
+
+// Give instance.vert what it needs for motion vectors: last frame's models,
+// packed like this frame's instance buffer, and last frame's camera. An
+// instance set of a different size has no meaningful previous transforms,
+// so it starts out motionless.
+static void upload_motion_data(FrameInstances& frame, bool cpu_culled) {
+    constexpr uint32_t model_floats = sizeof(InstanceData::model) / sizeof(float);
+    uint32_t count = static_cast<uint32_t>(g_instances.size());
+    hxo::JobSystem& jobs = hxo::job_system();
+    auto save_models = [](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            memcpy(&g_previous_models[i * model_floats], g_instances[i].model, sizeof(InstanceData::model));
+        }
+    };
+    bool resized = g_previous_models.size() != static_cast<size_t>(count) * model_floats;
+    if (resized) {
+        g_previous_models.resize(static_cast<size_t>(count) * model_floats);
+        jobs.parallel_for(count, INSTANCE_COPY_GRAIN, save_models);
+    }
+
+    auto* dst = static_cast<float*>(frame.previous_mapped);
+    if (cpu_culled) {
+        uint32_t visible = static_cast<uint32_t>(g_cpu_visible.size());
+        jobs.parallel_for(visible, INSTANCE_COPY_GRAIN, [dst](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                memcpy(dst + i * model_floats, &g_previous_models[g_cpu_visible[i] * model_floats],
+                    sizeof(InstanceData::model));
+            }
+        });
+    } else if (count > 0) {
+        memcpy(dst, g_previous_models.data(), count * sizeof(InstanceData::model));
+    }
+    if (!resized) jobs.parallel_for(count, INSTANCE_COPY_GRAIN, save_models);
+
+    auto* motion = static_cast<MotionUniforms*>(frame.motion_mapped);
+    memcpy(motion->previous_view_proj, g_previous_view_proj, sizeof(motion->previous_view_proj));
+    motion->jitter[0] = 2.0f * g_jitter[0] / static_cast<float>(g_render_extent.width);
+    motion->jitter[1] = 2.0f * g_jitter[1] / static_cast<float>(g_render_extent.height);
+    memcpy(g_previous_view_proj, g_view_proj, sizeof(g_previous_view_proj));
+}
+
+// Read this slot's timestamps from its last submission, whose fence has
+// signalled, and let dynamic resolution pick the scale for this frame
+static void read_frame_timestamps() {
+    if (!g_timestamp_pool || !g_timestamps_pending[g_current_frame]) return;
+
+    uint64_t ticks[2] = {};
+    if (g_vk.vkGetQueryPoolResults(g_device, g_timestamp_pool, g_current_frame * 2, 2, sizeof(ticks), ticks,
+            sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+        return;
+    }
+    g_timestamps_pending[g_current_frame] = false;
+    uint64_t elapsed = (ticks[1] - ticks[0]) & g_timestamp_mask;
+    g_gpu_frame_ms = static_cast<float>(static_cast<double>(elapsed) * g_timestamp_period / 1e6);
+
+    if (g_dynamic_resolution) g_render_extent = scaled_extent(g_resolution.update(g_gpu_frame_ms));
+}
+
+static void multiply_mat4(float* out, const float* a, const float* b) {
+    float result[16];
+    for (int col = 0; col < 4; col++) {
+        for (int row = 0; row < 4; row++) {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; k++) {
+                sum += a[k * 4 + row] * b[col * 4 + k];
+            }
+            result[col * 4 + row] = sum;
+        }
+    }
+    memcpy(out, result, sizeof(result));
+}
+
+static void destroy_attachment(VkImage& image, VkDeviceMemory& memory, VkImageView& view) {
+    if (view) vkDestroyImageView(g_device, view, nullptr);
+    if (image) vkDestroyImage(g_device, image, nullptr);
+    if (memory) vkFreeMemory(g_device, memory, nullptr);
+    view = VK_NULL_HANDLE;
+    image = VK_NULL_HANDLE;
+    memory = VK_NULL_HANDLE;
+}
+
+static void destroy_attachments() {
+    for (auto fb : g_framebuffers) {
+        vkDestroyFramebuffer(g_device, fb, nullptr);
+    }
+    g_framebuffers.clear();
+
+    destroy_attachment(g_depth_image, g_depth_memory, g_depth_view);
+    destroy_attachment(g_msaa_color_image, g_msaa_color_memory, g_msaa_color_view);
+    destroy_attachment(g_scene_color_image, g_scene_color_memory, g_scene_color_view);
+    destroy_attachment(g_motion_image, g_motion_memory, g_motion_view);
+    for (uint32_t i = 0; i < 2; i++) {
+        destroy_attachment(g_history_images[i], g_history_memory[i], g_history_views[i]);
+        destroy_attachment(g_post_images[i], g_post_memory[i], g_post_views[i]);
+        destroy_attachment(g_oit_images[i], g_oit_memory[i], g_oit_views[i]);
+        destroy_attachment(g_oit_msaa_images[i], g_oit_msaa_memory[i], g_oit_msaa_views[i]);
+    }
+}
+
+static void destroy_graphics_pipelines() {
+    VkPipeline* pipelines[] = {
+        &g_graphics_pipeline, &g_instance_pipeline, &g_instance_depth_pipeline, &g_instance_equal_pipeline,
+        &g_instance_oit_pipeline, &g_oit_composite_pipeline
+    };
+    for (VkPipeline* pipeline : pipelines) {
+        if (*pipeline) vkDestroyPipeline(g_device, *pipeline, nullptr);
+        *pipeline = VK_NULL_HANDLE;
+    }
+    // The post compute pipeline outlives render pass changes
+    if (!g_dynamic_rendering_supported) {
+        for (VkPipeline& pipeline : g_post_pipelines) {
+            if (pipeline) vkDestroyPipeline(g_device, pipeline, nullptr);
+            pipeline = VK_NULL_HANDLE;
+        }
+    }
+    if (g_pipeline_layout) vkDestroyPipelineLayout(g_device, g_pipeline_layout, nullptr);
+    if (g_instance_pipeline_layout) vkDestroyPipelineLayout(g_device, g_instance_pipeline_layout, nullptr);
+    g_pipeline_layout = VK_NULL_HANDLE;
+    g_instance_pipeline_layout = VK_NULL_HANDLE;
+}
+
+static void cleanup_swapchain() {
+    destroy_attachments();
+
+    for (auto view : g_swapchain_image_views) {
+        vkDestroyImageView(g_device, view, nullptr);
+    }
+    g_swapchain_image_views.clear();
+
+    if (g_swapchain) {
+        vkDestroySwapchainKHR(g_device, g_swapchain, nullptr);
+        g_swapchain = VK_NULL_HANDLE;
     }
 }
 
@@ -757,8 +6106,44 @@ static int recreate_swapchain() {
     vkDeviceWaitIdle(g_device);
     cleanup_swapchain();
 
+    // With dynamic rendering only the swapchain, its views and the
+    // attachments are rebuilt
     if (create_swapchain() != 0) return 1;
+    if (create_attachments() != 0) return 4;
     if (create_framebuffers() != 0) return 2;
+    if (record_present_acquires() != 0) return 3;
+    return 0;
+}
+
+// Turning dynamic resolution on or off changes the attachments, the
+// framebuffers and the layout swapchain images are released in
+static int rebuild_attachments() {
+    vkDeviceWaitIdle(g_device);
+    destroy_attachments();
+    if (create_attachments() != 0) return 1;
+    if (create_framebuffers() != 0) return 2;
+    if (record_present_acquires() != 0) return 3;
+    return 0;
+}
+
+// The attachments, render pass, framebuffers and every graphics pipeline
+// depend on the sample count, on whether motion vectors are written and on
+// the post-process effects
+static int rebuild_main_pass() {
+    vkDeviceWaitIdle(g_device);
+    destroy_attachments();
+    destroy_graphics_pipelines();
+    if (g_render_pass) vkDestroyRenderPass(g_device, g_render_pass, nullptr);
+    g_render_pass = VK_NULL_HANDLE;
+
+    if (create_attachments() != 0) return 1;
+    if (create_render_pass() != 0) return 2;
+    if (create_graphics_pipeline() != 0) return 3;
+    if (create_instance_pipeline() != 0) return 4;
+    if (create_post_pipelines() != 0) return 5;
+    if (create_oit_pipeline() != 0) return 6;
+    if (create_framebuffers() != 0) return 7;
+    if (record_present_acquires() != 0) return 8;
     return 0;
 }
 
@@ -790,19 +6175,47 @@ int engine_init(const char* title, int width, int height) {
     if (create_surface() != 0) return 4;
     if (pick_physical_device() != 0) return 5;
     if (create_logical_device() != 0) return 6;
+    g_msaa_samples = clamp_sample_count(g_requested_msaa);
+    SDL_Log("MSAA: %ux", static_cast<uint32_t>(g_msaa_samples));
     if (create_swapchain() != 0) return 7;
+    if (create_attachments() != 0) return 22;
     if (create_render_pass() != 0) return 8;
     if (create_graphics_pipeline() != 0) return 9;
     if (create_framebuffers() != 0) return 10;
     if (create_command_pool() != 0) return 11;
     if (create_command_buffers() != 0) return 12;
     if (create_sync_objects() != 0) return 13;
+    if (create_upload_resources() != 0) return 14;
+    if (create_descriptor_resources() != 0) return 15;
+    if (create_instance_pipeline() != 0) return 16;
+    if (create_instance_resources() != 0) return 17;
+    if (create_cull_pipeline() != 0) return 18;
+    if (create_record_contexts() != 0) return 19;
+    if (create_compute_resources() != 0) return 20;
+    if (create_present_handoff() != 0) return 21;
+    if (create_timestamp_queries() != 0) return 23;
+    if (create_temporal_pipeline() != 0) return 24;
+    if (create_post_resources() != 0) return 25;
+    if (create_texture_downsampler() != 0) return 26;
+    if (create_light_resources() != 0) return 27;
+    if (create_shadow_resources() != 0) return 28;
+    if (create_oit_resources() != 0) return 29;
+
+    // Synchronization2 is enabled together with dynamic rendering
+    g_frame_graph.init(g_device, g_vk, g_memory_properties, g_dynamic_rendering_supported, MAX_FRAMES_IN_FLIGHT);
+    g_compute_graph.init(g_device, g_vk, g_memory_properties, g_dynamic_rendering_supported, MAX_FRAMES_IN_FLIGHT);
 
     SDL_Log("Engine initialized with Vulkan: %s (%dx%d)", title, width, height);
     return 0;
 }
 
 void engine_shutdown(void) {
+    // Suspended tasks are dropped, not finished; file reads in flight still
+    // hold their frames until their jobs return
+    hxo::task_scheduler().clear();
+    g_tasks.clear();
+    g_free_tasks.clear();
+
     if (g_device) {
         vkDeviceWaitIdle(g_device);
     }
@@ -816,12 +6229,160 @@ void engine_shutdown(void) {
             vkDestroyFence(g_device, g_in_flight_fences[i], nullptr);
     }
 
+    for (auto& tex : g_textures) {
+        destroy_texture_resources(tex);
+    }
+    g_textures.clear();
+    g_free_textures.clear();
+    g_retired_textures.clear();
+    g_scene = hxo::SceneGraph();
+    g_world = create_world();
+    g_instances_from_ecs = false;
+    g_ecs_packed_version = 0;
+    g_pending_uploads.clear();
+    g_deferred_descriptors.clear();
+    g_downsampler.destroy();
+    g_texture_downsample = false;
+    destroy_staging_buffer();
+    if (g_upload_fence) vkDestroyFence(g_device, g_upload_fence, nullptr);
+    if (g_upload_timeline) vkDestroySemaphore(g_device, g_upload_timeline, nullptr);
+    if (g_transfer_fence) vkDestroyFence(g_device, g_transfer_fence, nullptr);
+    if (g_transfer_semaphore) vkDestroySemaphore(g_device, g_transfer_semaphore, nullptr);
+    if (g_transfer_command_pool) vkDestroyCommandPool(g_device, g_transfer_command_pool, nullptr);
+    g_transfer_fence = VK_NULL_HANDLE;
+    g_transfer_semaphore = VK_NULL_HANDLE;
+    g_transfer_command_pool = VK_NULL_HANDLE;
+    g_transfer_uploads.clear();
+    g_transfer_busy = false;
+    g_transfer_queue = VK_NULL_HANDLE;
+    for (VkSemaphore semaphore : g_present_ready_semaphores) {
+        if (semaphore) vkDestroySemaphore(g_device, semaphore, nullptr);
+    }
+    g_present_ready_semaphores.clear();
+    if (g_present_command_pool) vkDestroyCommandPool(g_device, g_present_command_pool, nullptr);
+    g_present_command_pool = VK_NULL_HANDLE;
+    g_present_acquire_buffers.clear();
+    if (g_compute_timeline) vkDestroySemaphore(g_device, g_compute_timeline, nullptr);
+    if (g_compute_command_pool) vkDestroyCommandPool(g_device, g_compute_command_pool, nullptr);
+    g_compute_timeline = VK_NULL_HANDLE;
+    g_compute_command_pool = VK_NULL_HANDLE;
+    g_compute_queue = VK_NULL_HANDLE;
+    g_compute_submitted = 0;
+    g_graphics_waits.clear();
+    g_frame_graph.destroy();
+    g_compute_graph.destroy();
+    if (g_timestamp_pool) vkDestroyQueryPool(g_device, g_timestamp_pool, nullptr);
+    g_timestamp_pool = VK_NULL_HANDLE;
+    for (bool& pending : g_timestamps_pending) pending = false;
+    g_gpu_frame_ms = 0.0f;
+    g_dynamic_resolution = false;
+    g_upload_fence = VK_NULL_HANDLE;
+    g_upload_timeline = VK_NULL_HANDLE;
+    g_upload_submitted = 0;
+    g_upload_completed = 0;
+
+    for (auto& frame : g_frame_instances) {
+        destroy_frame_instances(frame);
+        destroy_frame_commands(frame);
+        destroy_buffer(frame.motion_buffer, frame.motion_memory);
+        frame.motion_mapped = nullptr;
+    }
+    for (auto& lights : g_frame_lights) {
+        destroy_frame_lights(lights);
+    }
+    if (g_light_cull_pipeline) vkDestroyPipeline(g_device, g_light_cull_pipeline, nullptr);
+    if (g_light_cull_pipeline_layout) vkDestroyPipelineLayout(g_device, g_light_cull_pipeline_layout, nullptr);
+    g_light_cull_pipeline = VK_NULL_HANDLE;
+    g_light_cull_pipeline_layout = VK_NULL_HANDLE;
+    g_lights.clear();
+    for (float& channel : g_ambient_light) channel = 0.0f;
+    destroy_shadow_maps();
+    for (auto& shadows : g_frame_shadows) {
+        destroy_frame_shadows(shadows);
+        shadows.set = VK_NULL_HANDLE;
+    }
+    if (g_shadow_pipeline) vkDestroyPipeline(g_device, g_shadow_pipeline, nullptr);
+    if (g_shadow_pipeline_layout) vkDestroyPipelineLayout(g_device, g_shadow_pipeline_layout, nullptr);
+    if (g_shadow_set_layout) vkDestroyDescriptorSetLayout(g_device, g_shadow_set_layout, nullptr);
+    if (g_shadow_clear_pass) vkDestroyRenderPass(g_device, g_shadow_clear_pass, nullptr);
+    if (g_shadow_load_pass) vkDestroyRenderPass(g_device, g_shadow_load_pass, nullptr);
+    if (g_shadow_sampler) vkDestroySampler(g_device, g_shadow_sampler, nullptr);
+    g_shadow_pipeline = VK_NULL_HANDLE;
+    g_shadow_pipeline_layout = VK_NULL_HANDLE;
+    g_shadow_set_layout = VK_NULL_HANDLE;
+    g_shadow_clear_pass = VK_NULL_HANDLE;
+    g_shadow_load_pass = VK_NULL_HANDLE;
+    g_shadow_sampler = VK_NULL_HANDLE;
+    g_shadow_format = VK_FORMAT_UNDEFINED;
+    g_shadow_casters.clear();
+    g_shadow_draws.clear();
+    for (float& channel : g_sun_color) channel = 0.0f;
+    if (g_temporal_pipeline) vkDestroyPipeline(g_device, g_temporal_pipeline, nullptr);
+    if (g_temporal_pipeline_layout) vkDestroyPipelineLayout(g_device, g_temporal_pipeline_layout, nullptr);
+    if (g_temporal_descriptor_pool) vkDestroyDescriptorPool(g_device, g_temporal_descriptor_pool, nullptr);
+    if (g_temporal_set_layout) vkDestroyDescriptorSetLayout(g_device, g_temporal_set_layout, nullptr);
+    if (g_temporal_sampler) vkDestroySampler(g_device, g_temporal_sampler, nullptr);
+    g_temporal_pipeline = VK_NULL_HANDLE;
+    g_temporal_pipeline_layout = VK_NULL_HANDLE;
+    g_temporal_descriptor_pool = VK_NULL_HANDLE;
+    g_temporal_set_layout = VK_NULL_HANDLE;
+    g_temporal_sampler = VK_NULL_HANDLE;
+    g_temporal_upscaling = false;
+    g_history_valid = false;
+    g_previous_models.clear();
+    // Post subpass pipelines go with the other graphics pipelines below
+    if (g_dynamic_rendering_supported && g_post_pipelines[0]) {
+        vkDestroyPipeline(g_device, g_post_pipelines[0], nullptr);
+        g_post_pipelines[0] = VK_NULL_HANDLE;
+    }
+    if (g_post_pipeline_layout) vkDestroyPipelineLayout(g_device, g_post_pipeline_layout, nullptr);
+    if (g_post_descriptor_pool) vkDestroyDescriptorPool(g_device, g_post_descriptor_pool, nullptr);
+    if (g_post_set_layout) vkDestroyDescriptorSetLayout(g_device, g_post_set_layout, nullptr);
+    g_post_pipeline_layout = VK_NULL_HANDLE;
+    g_post_descriptor_pool = VK_NULL_HANDLE;
+    g_post_set_layout = VK_NULL_HANDLE;
+    g_post_effects = 0;
+    if (g_oit_pipeline_layout) vkDestroyPipelineLayout(g_device, g_oit_pipeline_layout, nullptr);
+    if (g_oit_descriptor_pool) vkDestroyDescriptorPool(g_device, g_oit_descriptor_pool, nullptr);
+    if (g_oit_set_layout) vkDestroyDescriptorSetLayout(g_device, g_oit_set_layout, nullptr);
+    if (g_oit_sampler) vkDestroySampler(g_device, g_oit_sampler, nullptr);
+    g_oit_pipeline_layout = VK_NULL_HANDLE;
+    g_oit_descriptor_pool = VK_NULL_HANDLE;
+    g_oit_set_layout = VK_NULL_HANDLE;
+    g_oit_sampler = VK_NULL_HANDLE;
+    g_oit_set = VK_NULL_HANDLE;
+    g_oit_enabled = false;
+    if (g_cull_pipeline) vkDestroyPipeline(g_device, g_cull_pipeline, nullptr);
+    if (g_cull_pipeline_layout) vkDestroyPipelineLayout(g_device, g_cull_pipeline_layout, nullptr);
+    if (g_cull_set_layout) vkDestroyDescriptorSetLayout(g_device, g_cull_set_layout, nullptr);
+    if (g_quad_index_buffer) vkDestroyBuffer(g_device, g_quad_index_buffer, nullptr);
+    if (g_quad_index_memory) vkFreeMemory(g_device, g_quad_index_memory, nullptr);
+    if (g_instance_descriptor_pool) vkDestroyDescriptorPool(g_device, g_instance_descriptor_pool, nullptr);
+    if (g_instance_set_layout) vkDestroyDescriptorSetLayout(g_device, g_instance_set_layout, nullptr);
+    if (g_texture_descriptor_pool) vkDestroyDescriptorPool(g_device, g_texture_descriptor_pool, nullptr);
+    if (g_texture_set_layout) vkDestroyDescriptorSetLayout(g_device, g_texture_set_layout, nullptr);
+    if (g_texture_sampler) vkDestroySampler(g_device, g_texture_sampler, nullptr);
+
     if (g_command_pool) vkDestroyCommandPool(g_device, g_command_pool, nullptr);
+    for (auto& contexts : g_record_contexts) {
+        for (RecordContext& context : contexts) {
+            if (context.pool) vkDestroyCommandPool(g_device, context.pool, nullptr);
+        }
+        contexts.clear();
+    }
+    g_secondary_buffers.clear();
+
+    // Bulk jobs may still be writing into caller memory
+    for (auto& job : g_batch_jobs) {
+        if (job->active) hxo::job_system().wait(job->counter);
+    }
+    g_batch_jobs.clear();
+    g_free_batch_jobs.clear();
 
     cleanup_swapchain();
+    g_depth_format = VK_FORMAT_UNDEFINED;
 
-    if (g_graphics_pipeline) vkDestroyPipeline(g_device, g_graphics_pipeline, nullptr);
-    if (g_pipeline_layout) vkDestroyPipelineLayout(g_device, g_pipeline_layout, nullptr);
+    destroy_graphics_pipelines();
     if (g_render_pass) vkDestroyRenderPass(g_device, g_render_pass, nullptr);
     if (g_device) vkDestroyDevice(g_device, nullptr);
 
@@ -857,10 +6418,23 @@ uint64_t engine_get_ticks(void) {
 }
 
 int engine_render_frame(float r, float g, float b, float a) {
-    vkWaitForFences(g_device, 1, &g_in_flight_fences[g_current_frame], VK_TRUE, UINT64_MAX);
+    // Tasks resumed here may queue texture uploads for this frame's flush
+    pump_tasks();
+    if (flush_texture_uploads() != 0) return 5;
+    update_ecs_instances();
+    update_scene_instances();
+    if (ensure_shadow_maps() != 0) return 6;
+
+    g_vk.vkWaitForFences(g_device, 1, &g_in_flight_fences[g_current_frame], VK_TRUE, UINT64_MAX);
+    apply_deferred_descriptors();
+    free_retired_textures();
+    read_frame_timestamps();
+    // Last frame's output becomes this frame's history
+    if (g_temporal_upscaling) g_history_index ^= 1;
+    update_jitter();
 
     uint32_t image_index;
-    VkResult result = vkAcquireNextImageKHR(g_device, g_swapchain, UINT64_MAX,
+    VkResult result = g_vk.vkAcquireNextImageKHR(g_device, g_swapchain, UINT64_MAX,
         g_image_available_semaphores[g_current_frame], VK_NULL_HANDLE, &image_index);
 
     if (result == VK_ERROR_OUT_OF_DATE_KHR) {
@@ -871,80 +6445,379 @@ int engine_render_frame(float r, float g, float b, float a) {
         return 2;
     }
 
-    vkResetFences(g_device, 1, &g_in_flight_fences[g_current_frame]);
-
-    VkCommandBuffer cmd = g_command_buffers[g_current_frame];
-    vkResetCommandBuffer(cmd, 0);
-
-    VkCommandBufferBeginInfo begin_info = {};
-    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    vkBeginCommandBuffer(cmd, &begin_info);
-
-    VkClearValue clear_value = {{{r, g, b, a}}};
-
-    VkRenderPassBeginInfo rp_info = {};
-    rp_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    rp_info.renderPass = g_render_pass;
-    rp_info.framebuffer = g_framebuffers[image_index];
-    rp_info.renderArea.offset = {0, 0};
-    rp_info.renderArea.extent = g_swapchain_extent;
-    rp_info.clearValueCount = 1;
-    rp_info.pClearValues = &clear_value;
-
-    vkCmdBeginRenderPass(cmd, &rp_info, VK_SUBPASS_CONTENTS_INLINE);
+    g_vk.vkResetFences(g_device, 1, &g_in_flight_fences[g_current_frame]);
+
+    // This frame's instance buffer is no longer read by the GPU
+    FrameInstances& frame = g_frame_instances[g_current_frame];
+    uint32_t instance_count = static_cast<uint32_t>(g_instances.size());
+    const std::vector<DrawItem>* draws = &g_draw_list;
+    if (cpu_culling_active()) {
+        if (upload_visible_instances(frame) != 0) return 6;
+        draws = &g_visible_draw_list;
+    } else if (instance_count > 0) {
+        if (reserve_frame_instances(frame, instance_count) != 0) return 6;
+        memcpy(frame.mapped, g_instances.data(), instance_count * sizeof(InstanceData));
+    }
+    if (g_temporal_upscaling) upload_motion_data(frame, cpu_culling_active());
+    if (update_shadows(g_frame_shadows[g_current_frame]) != 0) return 6;
+    if (upload_frame_lights(g_frame_lights[g_current_frame], frame.set) != 0) return 6;
+
+    bool gpu_culled = gpu_culling_active();
+    if (gpu_culled) {
+        uint32_t command_count = static_cast<uint32_t>(g_draw_templates.size());
+        if (reserve_frame_commands(frame, command_count) != 0) return 6;
+        memcpy(frame.bounds_mapped, g_instance_bounds.data(), instance_count * sizeof(BoundingSphere));
+
+        // Draw count starts at zero; cull.comp raises it to the last live command
+        auto* templates = static_cast<uint8_t*>(frame.template_mapped);
+        memset(templates, 0, INDIRECT_COMMANDS_OFFSET);
+        memcpy(templates + INDIRECT_COMMANDS_OFFSET, g_draw_templates.data(),
+            command_count * sizeof(VkDrawIndexedIndirectCommand));
+    }
 
-    if (g_draw_triangle && g_graphics_pipeline) {
-        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, g_graphics_pipeline);
+    // Culling on the compute queue overlaps the previous frame's rendering
+    if (gpu_culled && async_compute_active()) {
+        // Outputs of the compute graph: the graphics submit's semaphore wait
+        // replaces a trailing barrier, whose vertex stage a compute-only
+        // queue cannot name
+        g_compute_graph.reset();
+        add_cull_passes(g_compute_graph,
+            g_compute_graph.import_buffer("indirect_draws", frame.indirect_buffer, true),
+            g_compute_graph.import_buffer("visible_instances", frame.visible_buffer, true));
+        if (!g_compute_graph.compile()) return 6;
+
+        VkCommandBuffer compute_cmd = begin_async_compute();
+        g_compute_graph.execute(compute_cmd);
+        if (submit_async_compute(compute_cmd,
+                VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT) != 0) {
+            return 6;
+        }
+    }
 
-        VkViewport viewport = {};
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = static_cast<float>(g_swapchain_extent.width);
-        viewport.height = static_cast<float>(g_swapchain_extent.height);
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-        vkCmdSetViewport(cmd, 0, 1, &viewport);
+    bool secondary = !g_draw_list.empty() && use_secondary_recording(*draws);
+    VkFramebuffer framebuffer = g_framebuffers.empty() ? VK_NULL_HANDLE : g_framebuffers[image_index];
+    if (secondary && record_secondary_draws(*draws, framebuffer) != 0) return 6;
+
+    // The acquire semaphore is waited on at the attachment output stage, so
+    // the image's first barrier chains off that stage
+    bool present_handoff = g_present_command_pool != VK_NULL_HANDLE;
+    hxo::ImageImport target = {};
+    target.image = g_swapchain_images[image_index];
+    target.view = g_swapchain_image_views[image_index];
+    target.initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    target.initial_stage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR;
+    target.final_usage = hxo::ResourceUsage::Present;
+    if (present_handoff) {
+        // Hand the image to the present family; its queue acquires it below
+        target.release_from_family = g_graphics_family;
+        target.release_to_family = g_present_family;
+    }
 
-        VkRect2D scissor = {};
-        scissor.offset = {0, 0};
-        scissor.extent = g_swapchain_extent;
-        vkCmdSetScissor(cmd, 0, 1, &scissor);
+    g_frame_graph.reset();
+    hxo::ResourceHandle swapchain = g_frame_graph.import_image("swapchain", target);
+    // Under dynamic resolution or temporal upscaling the pass draws into the
+    // scene target; the only hazard on it is last frame's upscale or resolve
+    // still reading it
+    VkPipelineStageFlags2 scene_reader = g_temporal_upscaling ? VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR
+                                                              : VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR;
+    hxo::ResourceHandle color = swapchain;
+    if (scene_target_active()) {
+        hxo::ImageImport scene_target = {};
+        scene_target.image = g_scene_color_image;
+        scene_target.view = g_scene_color_view;
+        scene_target.initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        scene_target.initial_stage = scene_reader;
+        color = g_frame_graph.import_image("scene_color", scene_target);
+    }
+    // The resolve writes one history image while sampling the other, which
+    // last frame wrote and then copied to its swapchain image
+    hxo::ResourceHandle motion = hxo::INVALID_RESOURCE;
+    hxo::ResourceHandle history_in = hxo::INVALID_RESOURCE;
+    hxo::ResourceHandle history_out = hxo::INVALID_RESOURCE;
+    if (g_temporal_upscaling) {
+        hxo::ImageImport motion_target = {};
+        motion_target.image = g_motion_image;
+        motion_target.view = g_motion_view;
+        motion_target.initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        motion_target.initial_stage = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+        motion = g_frame_graph.import_image("motion_vectors", motion_target);
+
+        hxo::ImageImport previous = {};
+        previous.image = g_history_images[g_history_index ^ 1];
+        previous.view = g_history_views[g_history_index ^ 1];
+        previous.initial_layout = g_history_valid ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+        previous.initial_stage = VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR;
+        history_in = g_frame_graph.import_image("history_in", previous);
+
+        hxo::ImageImport current = {};
+        current.image = g_history_images[g_history_index];
+        current.view = g_history_views[g_history_index];
+        current.initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        current.initial_stage = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+        history_out = g_frame_graph.import_image("history_out", current);
+    }
+    // Dynamic rendering takes depth and the MSAA color target from the graph,
+    // which keeps them across frames and orders the last frame's use of
+    // them. The render pass framebuffers hold views of images of our own.
+    hxo::ResourceHandle depth = hxo::INVALID_RESOURCE;
+    hxo::ResourceHandle msaa_color = hxo::INVALID_RESOURCE;
+    bool msaa = g_msaa_samples != VK_SAMPLE_COUNT_1_BIT;
+    if (g_dynamic_rendering_supported) {
+        hxo::ImageDesc depth_desc = {};
+        depth_desc.width = g_swapchain_extent.width;
+        depth_desc.height = g_swapchain_extent.height;
+        depth_desc.format = g_depth_format;
+        depth_desc.usage = VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        depth_desc.samples = g_msaa_samples;
+        depth_desc.aspect = depth_aspect(g_depth_format);
+        depth = g_frame_graph.create_image("depth", depth_desc);
+        if (msaa) {
+            hxo::ImageDesc msaa_desc = depth_desc;
+            msaa_desc.format = g_main_color_formats[MAIN_COLOR_SLOT];
+            msaa_desc.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+            msaa_color = g_frame_graph.create_image("msaa_color", msaa_desc);
+        }
+    } else {
+        // One depth buffer serves every frame in flight, so the previous
+        // frame's depth tests must finish before this one clears it
+        hxo::ImageImport depth_target = {};
+        depth_target.image = g_depth_image;
+        depth_target.view = g_depth_view;
+        depth_target.aspect = depth_aspect(g_depth_format);
+        depth_target.initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        depth_target.initial_stage = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT_KHR |
+                                     VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT_KHR;
+        depth_target.initial_access = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT_KHR;
+        depth = g_frame_graph.import_image("depth", depth_target);
+        if (msaa) {
+            hxo::ImageImport msaa_target = {};
+            msaa_target.image = g_msaa_color_image;
+            msaa_target.view = g_msaa_color_view;
+            msaa_target.initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            msaa_target.initial_stage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR;
+            msaa_target.initial_access = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR;
+            msaa_color = g_frame_graph.import_image("msaa_color", msaa_target);
+        }
+    }
+    // Post attachments stay inside the render pass, but the last frame's
+    // post subpasses may still be reading them
+    hxo::ResourceHandle post_attachments[2] = {hxo::INVALID_RESOURCE, hxo::INVALID_RESOURCE};
+    for (uint32_t i = 0; i < post_attachment_count(); i++) {
+        hxo::ImageImport post_target = {};
+        post_target.image = g_post_images[i];
+        post_target.view = g_post_views[i];
+        post_target.initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        post_target.initial_stage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR |
+                                    VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR;
+        post_target.initial_access = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR;
+        post_attachments[i] = g_frame_graph.import_image(i == 0 ? "post_0" : "post_1", post_target);
+    }
+    // The sums are cleared every frame; only the last frame's composite
+    // may still be reading them, and the MSAA pair is only ever resolved
+    hxo::ResourceHandle oit_sums[4] = {
+        hxo::INVALID_RESOURCE, hxo::INVALID_RESOURCE, hxo::INVALID_RESOURCE, hxo::INVALID_RESOURCE
+    };
+    if (oit_active()) {
+        static const char* const oit_names[4] = {"oit_accum", "oit_revealage", "oit_accum_msaa", "oit_revealage_msaa"};
+        for (uint32_t i = 0; i < 4; i++) {
+            VkImage image = i < 2 ? g_oit_images[i] : g_oit_msaa_images[i - 2];
+            if (!image) continue;
+            hxo::ImageImport oit_target = {};
+            oit_target.image = image;
+            oit_target.view = i < 2 ? g_oit_views[i] : g_oit_msaa_views[i - 2];
+            oit_target.initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            oit_target.initial_stage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR |
+                                       VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR;
+            oit_target.initial_access = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR;
+            oit_sums[i] = g_frame_graph.import_image(oit_names[i], oit_target);
+        }
+    }
+    hxo::ResourceHandle indirect = hxo::INVALID_RESOURCE;
+    hxo::ResourceHandle visible = hxo::INVALID_RESOURCE;
+    if (gpu_culled) {
+        // Under async compute these were produced on the compute queue and
+        // the submit's semaphore wait orders them
+        indirect = g_frame_graph.import_buffer("indirect_draws", frame.indirect_buffer);
+        visible = g_frame_graph.import_buffer("visible_instances", frame.visible_buffer);
+        if (!async_compute_active()) add_cull_passes(g_frame_graph, indirect, visible);
+    }
+    hxo::ResourceHandle light_clusters = hxo::INVALID_RESOURCE;
+    hxo::ResourceHandle light_indices = hxo::INVALID_RESOURCE;
+    if (lighting_active()) {
+        light_clusters = g_frame_graph.import_buffer("light_clusters", g_frame_lights[g_current_frame].cluster_buffer);
+        light_indices = g_frame_graph.import_buffer("light_indices", g_frame_lights[g_current_frame].index_buffer);
+        add_light_passes(g_frame_graph, light_clusters, light_indices);
+    }
+    // Shaded instances sample the composite shadow layers, placeholder or
+    // not. The last frame's shading may still read them when they are
+    // redrawn.
+    hxo::ResourceHandle shadow_map = hxo::INVALID_RESOURCE;
+    if (!g_draw_list.empty()) {
+        hxo::ImageImport shadow_target = {};
+        shadow_target.image = g_shadow_images[SHADOW_COMPOSITE];
+        shadow_target.view = g_shadow_view;
+        shadow_target.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+        shadow_target.initial_layout = g_shadow_layouts_valid[SHADOW_COMPOSITE]
+            ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+        shadow_target.initial_stage = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR;
+        shadow_target.final_usage = hxo::ResourceUsage::FragmentSampled;
+        shadow_map = g_frame_graph.import_image("shadow_map", shadow_target);
+        if (!g_shadow_draws.empty()) add_shadow_passes(g_frame_graph, shadow_map);
+    }
 
-        // Draw triangle with hardcoded vertices in shader
-        vkCmdDraw(cmd, 3, 1, 0, 0);
+    VkClearValue clear_value = {{{r, g, b, a}}};
+    auto main_pass = g_frame_graph.add_pass("main", [&](VkCommandBuffer cmd) {
+        VkImageView msaa_view = msaa ? g_frame_graph.view(msaa_color) : VK_NULL_HANDLE;
+        begin_main_pass(cmd, image_index, clear_value, secondary, g_frame_graph.view(depth), msaa_view);
+        if (secondary) {
+            g_vk.vkCmdExecuteCommands(cmd, static_cast<uint32_t>(g_secondary_buffers.size()), g_secondary_buffers.data());
+        } else {
+            set_viewport_and_scissor(cmd);
+            if (!g_draw_list.empty()) {
+                record_instance_draws(cmd, *draws);
+            } else if (g_draw_triangle && g_graphics_pipeline) {
+                g_vk.vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, g_graphics_pipeline);
+
+                // Draw triangle with hardcoded vertices in shader
+                g_vk.vkCmdDraw(cmd, 3, 1, 0, 0);
+            }
+        }
+        end_main_pass(cmd);
+    });
+    main_pass.write(color, hxo::ResourceUsage::ColorAttachment)
+        .read(depth, hxo::ResourceUsage::DepthAttachment)
+        .write(depth, hxo::ResourceUsage::DepthAttachment);
+    // The resolve into the swapchain image is a color attachment write too
+    if (msaa_color != hxo::INVALID_RESOURCE) main_pass.write(msaa_color, hxo::ResourceUsage::ColorAttachment);
+    if (motion != hxo::INVALID_RESOURCE) main_pass.write(motion, hxo::ResourceUsage::ColorAttachment);
+    for (hxo::ResourceHandle post : post_attachments) {
+        if (post != hxo::INVALID_RESOURCE) main_pass.write(post, hxo::ResourceUsage::ColorAttachment);
+    }
+    for (hxo::ResourceHandle sum : oit_sums) {
+        if (sum != hxo::INVALID_RESOURCE) main_pass.write(sum, hxo::ResourceUsage::ColorAttachment);
     }
+    if (gpu_culled) {
+        main_pass.read(indirect, hxo::ResourceUsage::IndirectCommands)
+            .read(visible, hxo::ResourceUsage::VertexStorage);
+    }
+    if (lighting_active()) {
+        main_pass.read(light_clusters, hxo::ResourceUsage::FragmentStorage)
+            .read(light_indices, hxo::ResourceUsage::FragmentStorage);
+    }
+    if (shadow_map != hxo::INVALID_RESOURCE) main_pass.read(shadow_map, hxo::ResourceUsage::FragmentSampled);
+    // Under a render pass the composite is the main pass's second subpass
+    if (oit_active() && g_dynamic_rendering_supported) {
+        g_frame_graph.add_pass("oit_composite",
+                [image_index](VkCommandBuffer cmd) { record_oit_composite_pass(cmd, image_index); })
+            .read(oit_sums[0], hxo::ResourceUsage::FragmentSampled)
+            .read(oit_sums[1], hxo::ResourceUsage::FragmentSampled)
+            .read(color, hxo::ResourceUsage::ColorAttachment)
+            .write(color, hxo::ResourceUsage::ColorAttachment);
+    }
+    if (post_compute_active()) {
+        g_frame_graph.add_pass("post_process", record_post_compute)
+            .read(color, hxo::ResourceUsage::ComputeStorage)
+            .write(color, hxo::ResourceUsage::ComputeStorage);
+    }
+    hxo::ResourceHandle upscaled = color;
+    if (g_temporal_upscaling) {
+        g_frame_graph.add_pass("temporal_resolve", record_temporal_resolve)
+            .read(color, hxo::ResourceUsage::ComputeSampled)
+            .read(motion, hxo::ResourceUsage::ComputeSampled)
+            .read(history_in, hxo::ResourceUsage::ComputeSampled)
+            .write(history_out, hxo::ResourceUsage::ComputeStorage);
+        upscaled = history_out;
+    }
+    if (scene_target_active()) {
+        g_frame_graph.add_pass("upscale", [image_index](VkCommandBuffer cmd) { record_upscale(cmd, image_index); })
+            .read(upscaled, hxo::ResourceUsage::TransferSrc)
+            .write(swapchain, hxo::ResourceUsage::TransferDst);
+    }
+    if (!g_frame_graph.compile()) return 6;
 
-    vkCmdEndRenderPass(cmd);
-    vkEndCommandBuffer(cmd);
+    VkCommandBuffer cmd = g_command_buffers[g_current_frame];
+    g_vk.vkResetCommandBuffer(cmd, 0);
 
-    VkSemaphore wait_semaphores[] = {g_image_available_semaphores[g_current_frame]};
-    VkPipelineStageFlags wait_stages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    g_vk.vkBeginCommandBuffer(cmd, &begin_info);
+    uint32_t first_query = g_current_frame * 2;
+    if (g_timestamp_pool) {
+        g_vk.vkCmdResetQueryPool(cmd, g_timestamp_pool, first_query, 2);
+        g_vk.vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, g_timestamp_pool, first_query);
+    }
+    g_frame_graph.execute(cmd);
+    g_history_valid = g_temporal_upscaling;
+    if (shadow_map != hxo::INVALID_RESOURCE) g_shadow_layouts_valid[SHADOW_COMPOSITE] = true;
+    if (!g_shadow_draws.empty()) g_shadow_layouts_valid[SHADOW_STATIC] = true;
+    if (g_timestamp_pool) {
+        g_vk.vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, g_timestamp_pool, first_query + 1);
+        g_timestamps_pending[g_current_frame] = true;
+    }
+    g_vk.vkEndCommandBuffer(cmd);
+
+    // The binary acquire semaphore plus any timeline values from other queues;
+    // the value paired with a binary semaphore is ignored
+    std::vector<VkSemaphore> wait_semaphores = {g_image_available_semaphores[g_current_frame]};
+    std::vector<VkPipelineStageFlags> wait_stages = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+    std::vector<uint64_t> wait_values = {0};
+    for (const QueueWait& wait : g_graphics_waits) {
+        wait_semaphores.push_back(wait.semaphore);
+        wait_stages.push_back(wait.stage);
+        wait_values.push_back(wait.value);
+    }
+    g_graphics_waits.clear();
     VkSemaphore signal_semaphores[] = {g_render_finished_semaphores[g_current_frame]};
 
+    VkTimelineSemaphoreSubmitInfo timeline_info = {};
+    timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timeline_info.waitSemaphoreValueCount = static_cast<uint32_t>(wait_values.size());
+    timeline_info.pWaitSemaphoreValues = wait_values.data();
+
     VkSubmitInfo submit_info = {};
     submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submit_info.waitSemaphoreCount = 1;
-    submit_info.pWaitSemaphores = wait_semaphores;
-    submit_info.pWaitDstStageMask = wait_stages;
+    if (wait_semaphores.size() > 1) submit_info.pNext = &timeline_info;
+    submit_info.waitSemaphoreCount = static_cast<uint32_t>(wait_semaphores.size());
+    submit_info.pWaitSemaphores = wait_semaphores.data();
+    submit_info.pWaitDstStageMask = wait_stages.data();
     submit_info.commandBufferCount = 1;
     submit_info.pCommandBuffers = &cmd;
     submit_info.signalSemaphoreCount = 1;
     submit_info.pSignalSemaphores = signal_semaphores;
 
-    if (vkQueueSubmit(g_graphics_queue, 1, &submit_info, g_in_flight_fences[g_current_frame]) != VK_SUCCESS) {
+    if (g_vk.vkQueueSubmit(g_graphics_queue, 1, &submit_info, g_in_flight_fences[g_current_frame]) != VK_SUCCESS) {
         SDL_Log("Failed to submit draw command buffer");
         return 3;
     }
 
+    VkSemaphore present_wait = signal_semaphores[0];
+    if (present_handoff) {
+        VkPipelineStageFlags acquire_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        VkSubmitInfo acquire_info = {};
+        acquire_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        acquire_info.waitSemaphoreCount = 1;
+        acquire_info.pWaitSemaphores = signal_semaphores;
+        acquire_info.pWaitDstStageMask = &acquire_stage;
+        acquire_info.commandBufferCount = 1;
+        acquire_info.pCommandBuffers = &g_present_acquire_buffers[image_index];
+        acquire_info.signalSemaphoreCount = 1;
+        acquire_info.pSignalSemaphores = &g_present_ready_semaphores[g_current_frame];
+        if (g_vk.vkQueueSubmit(g_present_queue, 1, &acquire_info, VK_NULL_HANDLE) != VK_SUCCESS) {
+            SDL_Log("Failed to submit present ownership transfer");
+            return 3;
+        }
+        present_wait = g_present_ready_semaphores[g_current_frame];
+    }
+
     VkPresentInfoKHR present_info = {};
     present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     present_info.waitSemaphoreCount = 1;
-    present_info.pWaitSemaphores = signal_semaphores;
+    present_info.pWaitSemaphores = &present_wait;
     present_info.swapchainCount = 1;
     present_info.pSwapchains = &g_swapchain;
     present_info.pImageIndices = &image_index;
 
-    result = vkQueuePresentKHR(g_present_queue, &present_info);
+    result = g_vk.vkQueuePresentKHR(g_present_queue, &present_info);
     if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
         recreate_swapchain();
     } else if (result != VK_SUCCESS) {
@@ -953,6 +6826,7 @@ int engine_render_frame(float r, float g, float b, float a) {
     }
 
     g_current_frame = (g_current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+    g_frame_count++;
     return 0;
 }
 
@@ -960,4 +6834,605 @@ int engine_handle_resize(void) {
     return recreate_swapchain();
 }
 
+uint32_t engine_create_texture(const void* pixels, uint32_t width, uint32_t height) {
+    return create_texture(pixels, width, height);
+}
+
+bool engine_bindless_enabled(void) {
+    return g_bindless_supported;
+}
+
+bool engine_async_compute_enabled(void) {
+    return async_compute_active();
+}
+
+bool engine_dynamic_rendering_enabled(void) {
+    return g_dynamic_rendering_supported;
+}
+
+void engine_set_depth_prepass(bool enabled) {
+    g_depth_prepass = enabled;
+}
+
+int engine_set_dynamic_resolution(float min_scale, float max_scale, float target_ms) {
+    if (!g_device) return 1;
+    bool enable = target_ms > 0.0f;
+    if (enable && (!g_timestamp_pool || !g_swapchain_blit_supported)) {
+        SDL_Log("Dynamic resolution needs GPU timestamps and swapchain blits");
+        return 2;
+    }
+    hxo::ResolutionController previous = g_resolution;
+    if (enable) g_resolution.configure(min_scale, max_scale, target_ms);
+    if (enable == g_dynamic_resolution) {
+        if (enable) g_render_extent = scaled_extent(g_resolution.scale());
+        return 0;
+    }
+
+    g_dynamic_resolution = enable;
+    if (rebuild_attachments() != 0) {
+        // Go back to the attachments that last built, so rendering goes on
+        SDL_Log("Failed to rebuild attachments for dynamic resolution");
+        g_dynamic_resolution = !enable;
+        g_resolution = previous;
+        if (rebuild_attachments() != 0) SDL_Log("Failed to restore the previous attachments");
+        return 3;
+    }
+    SDL_Log("Dynamic resolution: %s", enable ? "on" : "off");
+    return 0;
+}
+
+float engine_render_scale(void) {
+    if (g_dynamic_resolution) return g_resolution.scale();
+    return g_temporal_upscaling ? g_temporal_scale : 1.0f;
+}
+
+int engine_set_post_effects(uint32_t effects) {
+    if (!g_device) return 1;
+    effects &= POST_EFFECT_MASK;
+    // The compute fallback's result reaches the swapchain through the upscale blit
+    if (effects != 0 && g_dynamic_rendering_supported && !g_swapchain_blit_supported) {
+        SDL_Log("Post-processing under dynamic rendering needs blits into the swapchain format");
+        return 2;
+    }
+    if (effects == g_post_effects) return 0;
+
+    uint32_t previous = g_post_effects;
+    g_post_effects = effects;
+    if (rebuild_main_pass() != 0) {
+        // Go back to the effects that last built, so rendering goes on
+        SDL_Log("Failed to rebuild the main pass for post-processing");
+        g_post_effects = previous;
+        if (rebuild_main_pass() != 0) SDL_Log("Failed to restore the previous post-processing");
+        return 3;
+    }
+    SDL_Log("Post-processing: %u effects as %s", post_effect_count(),
+        g_dynamic_rendering_supported ? "a compute pass" : "subpasses");
+    return 0;
+}
+
+void engine_set_post_params(float exposure, float contrast, float saturation, float vignette) {
+    g_post_exposure = std::max(exposure, 0.0f);
+    g_post_contrast = std::max(contrast, 0.0f);
+    g_post_saturation = std::max(saturation, 0.0f);
+    g_post_vignette = std::clamp(vignette, 0.0f, 1.0f);
+}
+
+int engine_set_temporal_upscaling(float scale) {
+    if (!g_device) return 1;
+    bool enable = scale > 0.0f;
+    if (enable && !g_swapchain_blit_supported) {
+        SDL_Log("Temporal upscaling needs blits into the swapchain format");
+        return 2;
+    }
+    if (enable) g_temporal_scale = std::clamp(scale, hxo::ResolutionController::MIN_SCALE, 1.0f);
+    if (enable == g_temporal_upscaling) {
+        if (enable && !g_dynamic_resolution) {
+            g_render_extent = scaled_extent(g_temporal_scale);
+            g_history_valid = false;
+        }
+        return 0;
+    }
+
+    VkSampleCountFlagBits previous_samples = g_msaa_samples;
+    g_temporal_upscaling = enable;
+    g_previous_models.clear();
+    g_msaa_samples = main_sample_count();
+    if (rebuild_main_pass() != 0) {
+        // Go back to the mode that last built, so rendering goes on
+        SDL_Log("Failed to rebuild the main pass for temporal upscaling");
+        g_temporal_upscaling = !enable;
+        g_msaa_samples = previous_samples;
+        if (rebuild_main_pass() != 0) SDL_Log("Failed to restore the previous upscaling mode");
+        return 3;
+    }
+    SDL_Log("Temporal upscaling: %s", enable ? "on" : "off");
+    return 0;
+}
+
+float engine_gpu_frame_time(void) {
+    return g_gpu_frame_ms;
+}
+
+uint32_t engine_set_msaa_samples(uint32_t samples) {
+    uint32_t previous_request = g_requested_msaa;
+    g_requested_msaa = samples;
+    if (!g_device) return 0;
+
+    VkSampleCountFlagBits clamped = main_sample_count();
+    if (clamped == g_msaa_samples) return clamped;
+    VkSampleCountFlagBits previous = g_msaa_samples;
+    g_msaa_samples = clamped;
+    if (rebuild_main_pass() != 0) {
+        // Go back to the sample count that last built, so rendering goes on
+        SDL_Log("Failed to rebuild the main pass for %ux MSAA", static_cast<uint32_t>(clamped));
+        g_requested_msaa = previous_request;
+        g_msaa_samples = previous;
+        if (rebuild_main_pass() != 0) SDL_Log("Failed to restore %ux MSAA", static_cast<uint32_t>(previous));
+        return 0;
+    }
+    SDL_Log("MSAA: %ux", static_cast<uint32_t>(clamped));
+    return clamped;
+}
+
+void engine_set_preferred_device(const char* device) {
+    g_preferred_device = device ? device : "";
+}
+
+const char* engine_device_report(void) {
+    return g_device_report.c_str();
+}
+
+void engine_set_camera(const float* view, const float* proj) {
+    if (view) memcpy(g_view, view, sizeof(g_view));
+    if (proj) memcpy(g_proj, proj, sizeof(g_proj));
+    multiply_mat4(g_view_proj, g_proj, g_view);
+    update_camera_position();
+    update_frustum_planes();
+}
+
+void engine_set_instances(const EngineInstance* instances, uint32_t count) {
+    if (!instances) count = 0;
+    g_instances.resize(count);
+    if (count > 0) {
+        memcpy(g_instances.data(), instances, count * sizeof(InstanceData));
+    }
+    g_instance_ids.resize(count);
+    for (uint32_t i = 0; i < count; i++) g_instance_ids[i] = i + 1;
+    compute_instance_bounds();
+    build_draw_list();
+    g_scene.rewrite_instances();
+}
+
+int engine_set_cull_mode(int mode) {
+    switch (mode) {
+    case ENGINE_CULL_NONE:
+    case ENGINE_CULL_CPU:
+        break;
+    case ENGINE_CULL_GPU:
+        // Classic draws index into the visible list through firstInstance
+        if (!g_bindless_supported && !g_draw_indirect_first_instance_supported) {
+            SDL_Log("GPU culling needs drawIndirectFirstInstance without bindless textures");
+            return 1;
+        }
+        break;
+    default:
+        SDL_Log("Unknown cull mode: %d", mode);
+        return 2;
+    }
+    g_cull_mode = mode;
+    return 0;
+}
+
+void engine_set_cull_distance(float distance) {
+    g_cull_distance = distance > 0.0f ? distance : 0.0f;
+}
+
+void engine_set_lights(const EngineLight* lights, uint32_t count) {
+    if (!lights) count = 0;
+    g_lights.assign(lights, lights + count);
+}
+
+void engine_set_ambient_light(float r, float g, float b) {
+    g_ambient_light[0] = std::max(r, 0.0f);
+    g_ambient_light[1] = std::max(g, 0.0f);
+    g_ambient_light[2] = std::max(b, 0.0f);
+}
+
+void engine_set_directional_light(float dx, float dy, float dz, float r, float g, float b) {
+    float length = std::sqrt(dx * dx + dy * dy + dz * dz);
+    if (length > 0.0f) {
+        g_sun_direction[0] = dx / length;
+        g_sun_direction[1] = dy / length;
+        g_sun_direction[2] = dz / length;
+    }
+    g_sun_color[0] = std::max(r, 0.0f);
+    g_sun_color[1] = std::max(g, 0.0f);
+    g_sun_color[2] = std::max(b, 0.0f);
+}
+
+void engine_set_shadows(uint32_t resolution, float distance, uint32_t far_interval) {
+    g_shadow_resolution = std::min(resolution, MAX_SHADOW_RESOLUTION);
+    g_shadow_distance = distance > 0.0f ? distance : DEFAULT_SHADOW_DISTANCE;
+    g_shadow_far_interval = std::max(far_interval, 1u);
+    // A new resolution reallocates the maps, and configures them, next frame
+    g_shadow_cascades.configure(std::max(g_shadow_map_size, 1u), g_shadow_distance, g_shadow_far_interval);
+}
+
+int engine_set_oit(bool enabled) {
+    if (!g_device) return 1;
+    if (enabled == g_oit_enabled) return 0;
+
+    g_oit_enabled = enabled;
+    if (rebuild_main_pass() != 0) {
+        // Go back to the mode that last built, so rendering goes on
+        SDL_Log("Failed to rebuild the main pass for order-independent transparency");
+        g_oit_enabled = !enabled;
+        if (rebuild_main_pass() != 0) SDL_Log("Failed to restore the previous transparency mode");
+        return 2;
+    }
+    // Transparent instances cast shadows only while drawn opaque
+    g_shadow_cascades.invalidate();
+    SDL_Log("Order-independent transparency: %s", enabled ? "on" : "off");
+    return 0;
+}
+
+void engine_destroy_texture(uint32_t handle) {
+    Texture* tex = get_texture(handle);
+    if (!tex) return;
+
+    // Drop a still-pending upload so the flush never touches the freed image.
+    // A batch between queues is finished instead: its transfer semaphore
+    // signal must be waited on even if every texture in it is gone.
+    uint32_t index = (handle & TEXTURE_INDEX_MASK) - 1;
+    g_pending_uploads.erase(
+        std::remove_if(g_pending_uploads.begin(), g_pending_uploads.end(),
+            [index](const PendingUpload& u) { return u.texture == index; }),
+        g_pending_uploads.end());
+    g_deferred_descriptors.erase(
+        std::remove_if(g_deferred_descriptors.begin(), g_deferred_descriptors.end(),
+            [index](const DeferredDescriptor& d) { return d.texture == index; }),
+        g_deferred_descriptors.end());
+    finish_transfer_uploads();
+
+    // The handle goes stale now, so draws fall back to white; the image is
+    // freed once the frames submitted so far (and the uploads before the
+    // next one) have completed
+    tex->generation++;
+    tex->ready = false;
+    g_retired_textures.push_back({index, g_frame_count + MAX_FRAMES_IN_FLIGHT});
+}
+
+uint32_t engine_scene_create_node(uint32_t parent) {
+    return g_scene.create_node(parent);
+}
+
+void engine_scene_destroy_node(uint32_t node) {
+    g_scene.destroy_node(node);
+}
+
+bool engine_scene_set_parent(uint32_t node, uint32_t parent) {
+    return g_scene.set_parent(node, parent);
+}
+
+void engine_scene_set_transforms(const uint32_t* nodes, const float* transforms, uint32_t count) {
+    if (!nodes || !transforms) return;
+    for (uint32_t i = 0; i < count; i++) {
+        const float* trs = transforms + i * ENGINE_TRANSFORM_FLOATS;
+        g_scene.set_transform(nodes[i], trs, trs + 3, trs + 7);
+    }
+}
+
+bool engine_scene_bind_instance(uint32_t node, uint32_t instance) {
+    return g_scene.bind_instance(node, instance);
+}
+
+bool engine_scene_get_world_matrix(uint32_t node, float* out) {
+    return out && g_scene.world_matrix(node, out);
+}
+
+uint32_t engine_ecs_register_component(uint32_t size) {
+    return g_world.register_component(size);
+}
+
+uint32_t engine_ecs_component_size(uint32_t component) {
+    return g_world.component_size(component);
+}
+
+uint32_t engine_ecs_create_entities(uint64_t mask, uint32_t count, uint32_t* out) {
+    return g_world.create(mask, count, out);
+}
+
+void engine_ecs_destroy_entities(const uint32_t* entities, uint32_t count) {
+    if (entities) g_world.destroy(entities, count);
+}
+
+void engine_ecs_add_components(const uint32_t* entities, uint32_t count, uint64_t mask) {
+    if (entities) g_world.add_components(entities, count, mask);
+}
+
+void engine_ecs_remove_components(const uint32_t* entities, uint32_t count, uint64_t mask) {
+    if (entities) g_world.remove_components(entities, count, mask);
+}
+
+void engine_ecs_flush(void) {
+    g_world.flush();
+}
+
+bool engine_ecs_alive(uint32_t entity) {
+    return g_world.alive(entity);
+}
+
+uint32_t engine_ecs_version(void) {
+    return g_world.version();
+}
+
+uint32_t engine_ecs_query(uint64_t mask, uint32_t* chunks, uint32_t max) {
+    return g_world.query(mask, chunks, chunks ? max : 0);
+}
+
+uint32_t engine_ecs_chunk_rows(uint32_t chunk) {
+    return g_world.chunk_rows(chunk);
+}
+
+uint32_t engine_ecs_chunk_capacity(uint32_t chunk) {
+    return g_world.chunk_capacity(chunk);
+}
+
+const uint32_t* engine_ecs_chunk_entities(uint32_t chunk) {
+    return g_world.chunk_entities(chunk);
+}
+
+void* engine_ecs_chunk_column(uint32_t chunk, uint32_t component) {
+    return g_world.chunk_column(chunk, component);
+}
+
+void engine_ecs_mark_dirty(uint32_t chunk) {
+    g_world.mark_dirty(chunk);
+}
+
+} // extern "C"
+
+static BatchJob* get_batch_job(uint32_t handle) {
+    uint32_t slot = handle & BATCH_JOB_INDEX_MASK;
+    if (slot == 0 || slot > g_batch_jobs.size()) return nullptr;
+    BatchJob* job = g_batch_jobs[slot - 1].get();
+    if (!job->active || job->generation != handle >> BATCH_JOB_INDEX_BITS) return nullptr;
+    return job;
+}
+
+static void release_batch_job(uint32_t handle) {
+    uint32_t index = (handle & BATCH_JOB_INDEX_MASK) - 1;
+    BatchJob& job = *g_batch_jobs[index];
+    job.active = false;
+    job.generation++;
+    g_free_batch_jobs.push_back(index);
+}
+
+extern "C" {
+
+uint32_t engine_jobs_submit(int kind, const float* a, const float* b, float* out, uint32_t count) {
+    if (!a || !out || count == 0) return 0;
+    if (kind == ENGINE_JOB_MAT4_MULTIPLY && !b) return 0;
+    if (kind != ENGINE_JOB_MAT4_MULTIPLY && kind != ENGINE_JOB_COMPOSE_TRANSFORMS) {
+        SDL_Log("Unknown job kind: %d", kind);
+        return 0;
+    }
+
+    uint32_t index;
+    if (!g_free_batch_jobs.empty()) {
+        index = g_free_batch_jobs.back();
+        g_free_batch_jobs.pop_back();
+    } else if (g_batch_jobs.size() < BATCH_JOB_INDEX_MASK) {
+        index = static_cast<uint32_t>(g_batch_jobs.size());
+        g_batch_jobs.push_back(std::make_unique<BatchJob>());
+    } else {
+        SDL_Log("Too many bulk jobs in flight");
+        return 0;
+    }
+    BatchJob& job = *g_batch_jobs[index];
+    job.active = true;
+
+    // Caller keeps a, b and out alive until the job reports done
+    hxo::JobSystem& jobs = hxo::job_system();
+    for (uint32_t begin = 0; begin < count; begin += BATCH_JOB_GRAIN) {
+        uint32_t end = std::min(begin + BATCH_JOB_GRAIN, count);
+        if (kind == ENGINE_JOB_MAT4_MULTIPLY) {
+            jobs.submit(job.counter, [a, b, out, begin, end] {
+                for (uint32_t i = begin; i < end; i++) {
+                    hxo::mat4_multiply(out + i * 16, a + i * 16, b + i * 16);
+                }
+            });
+        } else {
+            jobs.submit(job.counter, [a, out, begin, end] {
+                for (uint32_t i = begin; i < end; i++) {
+                    hxo::compose_transform(a + i * ENGINE_TRANSFORM_FLOATS, out + i * 16);
+                }
+            });
+        }
+    }
+    return (static_cast<uint32_t>(job.generation) << BATCH_JOB_INDEX_BITS) | (index + 1);
+}
+
+bool engine_jobs_done(uint32_t job) {
+    BatchJob* batch = get_batch_job(job);
+    if (!batch) return true;
+    if (!batch->counter.done()) return false;
+    release_batch_job(job);
+    return true;
+}
+
+void engine_jobs_wait(uint32_t job) {
+    BatchJob* batch = get_batch_job(job);
+    if (!batch) return;
+    hxo::job_system().wait(batch->counter);
+    release_batch_job(job);
+}
+
+uint32_t engine_jobs_thread_count(void) {
+    return hxo::job_system().thread_count();
+}
+
+} // extern "C"
+
+// co_await timeline_reached(semaphore, value): resume once the GPU has
+// signalled value, checked every frame
+static hxo::ConditionAwaiter timeline_reached(VkSemaphore semaphore, uint64_t value) {
+    return hxo::wait_until([semaphore, value] {
+        uint64_t current = 0;
+        g_vk.vkGetSemaphoreCounterValue(g_device, semaphore, &current);
+        return current >= value;
+    });
+}
+
+// co_await upload_complete(batch): resume once that upload batch is on the GPU
+static hxo::ConditionAwaiter upload_complete(uint64_t batch) {
+    if (g_upload_timeline) return timeline_reached(g_upload_timeline, batch);
+    return hxo::wait_until([batch] { return upload_completed_value() >= batch; });
+}
+
+static hxo::Task<TaskResult> read_file_task(std::string path) {
+    TaskResult result;
+    std::optional<std::vector<uint8_t>> bytes = co_await hxo::read_file(path);
+    if (!bytes) {
+        SDL_Log("Failed to read file: %s", path.c_str());
+        co_return result;
+    }
+    result.ok = true;
+    result.bytes = std::move(*bytes);
+    co_return result;
+}
+
+static hxo::Task<TaskResult> load_texture_task(std::string path, uint32_t width, uint32_t height) {
+    TaskResult result;
+    std::optional<std::vector<uint8_t>> pixels = co_await hxo::read_file(path);
+    if (!pixels || pixels->size() != static_cast<size_t>(width) * height * 4) {
+        SDL_Log("Failed to read %ux%u RGBA8 texture: %s", width, height, path.c_str());
+        co_return result;
+    }
+
+    uint32_t handle = create_texture(pixels->data(), width, height);
+    if (handle == 0) co_return result;
+
+    // Submit now instead of at the next frame so the copy starts right away.
+    // With a transfer queue the graphics half is submitted on a later poll.
+    if (flush_texture_uploads() != 0) {
+        engine_destroy_texture(handle);
+        co_return result;
+    }
+    co_await hxo::wait_until([handle] {
+        Texture* tex = get_texture(handle);
+        return !tex || tex->ready;
+    });
+    co_await upload_complete(g_upload_submitted);
+    // Destroyed while loading; the handle no longer names this texture
+    if (!get_texture(handle)) co_return result;
+
+    result.ok = true;
+    result.value = handle;
+    co_return result;
+}
+
+static uint32_t start_task(hxo::Task<TaskResult> task, bool owns_texture = false) {
+    uint32_t index;
+    if (!g_free_tasks.empty()) {
+        index = g_free_tasks.back();
+        g_free_tasks.pop_back();
+    } else {
+        index = static_cast<uint32_t>(g_tasks.size());
+        g_tasks.emplace_back();
+    }
+    uint8_t generation = g_tasks[index].generation;
+    g_tasks[index] = AsyncTask{std::move(task), generation, false, owns_texture};
+    // g_tasks may grow while the task runs; the frame itself never moves
+    hxo::Task<TaskResult>* started = &g_tasks[index].task;
+    started->start();
+    return (static_cast<uint32_t>(generation) << TASK_INDEX_BITS) | (index + 1);
+}
+
+static AsyncTask* get_task(uint32_t handle) {
+    uint32_t slot = handle & TASK_INDEX_MASK;
+    if (slot == 0 || slot > g_tasks.size()) return nullptr;
+    AsyncTask* task = &g_tasks[slot - 1];
+    if (task->generation != handle >> TASK_INDEX_BITS) return nullptr;
+    return task->task.valid() && !task->released ? task : nullptr;
+}
+
+// Free a finished task's slot, with the texture nobody took. The texture
+// handle carries its own generation, so one destroyed meanwhile is skipped.
+static void free_task(uint32_t index) {
+    AsyncTask& task = g_tasks[index];
+    if (task.owns_texture && task.task.result().ok) engine_destroy_texture(task.task.result().value);
+    uint8_t generation = task.generation + 1;
+    task = AsyncTask{};
+    task.generation = generation;
+    g_free_tasks.push_back(index);
+}
+
+static void pump_tasks() {
+    // Lets texture loads complete while no frames are rendered
+    advance_transfer_uploads();
+    hxo::task_scheduler().poll();
+
+    // Released tasks are kept alive until they finish
+    for (uint32_t i = 0; i < g_tasks.size(); i++) {
+        AsyncTask& task = g_tasks[i];
+        if (task.released && task.task.done()) free_task(i);
+    }
+}
+
+extern "C" {
+
+uint32_t engine_task_read_file(const char* path) {
+    if (!path) return 0;
+    return start_task(read_file_task(path));
+}
+
+uint32_t engine_task_load_texture(const char* path, uint32_t width, uint32_t height) {
+    if (!path || width == 0 || height == 0) return 0;
+    return start_task(load_texture_task(path, width, height), true);
+}
+
+void engine_task_poll(void) {
+    pump_tasks();
+}
+
+int engine_task_status(uint32_t task) {
+    AsyncTask* async = get_task(task);
+    if (!async) return ENGINE_TASK_FAILED;
+    if (!async->task.done()) return ENGINE_TASK_PENDING;
+    return async->task.result().ok ? ENGINE_TASK_DONE : ENGINE_TASK_FAILED;
+}
+
+uint32_t engine_task_value(uint32_t task) {
+    AsyncTask* async = get_task(task);
+    if (!async || !async->task.done()) return 0;
+    async->owns_texture = false;
+    return async->task.result().value;
+}
+
+uint32_t engine_task_result_size(uint32_t task) {
+    AsyncTask* async = get_task(task);
+    if (!async || !async->task.done()) return 0;
+    return static_cast<uint32_t>(async->task.result().bytes.size());
+}
+
+uint32_t engine_task_copy_result(uint32_t task, void* dst, uint32_t capacity) {
+    AsyncTask* async = get_task(task);
+    if (!async || !async->task.done() || !dst) return 0;
+    const std::vector<uint8_t>& bytes = async->task.result().bytes;
+    uint32_t size = std::min(capacity, static_cast<uint32_t>(bytes.size()));
+    memcpy(dst, bytes.data(), size);
+    return size;
+}
+
+void engine_task_release(uint32_t task) {
+    AsyncTask* async = get_task(task);
+    if (!async) return;
+    if (async->task.done()) {
+        free_task((task & TASK_INDEX_MASK) - 1);
+    } else {
+        async->released = true;
+    }
+}
+
 } // extern "C"
@@ -0,0 +1,184 @@
+#include "jobs.h"
+
+namespace hxo {
+
+static thread_local uint32_t t_thread_index = 0;
+
+uint32_t JobSystem::thread_index() {
+    return t_thread_index;
+}
+
+bool JobSystem::Deque::push(Job* job) {
+    int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+    int64_t top = m_top.load(std::memory_order_acquire);
+    if (bottom - top >= CAPACITY) return false;
+
+    m_items[bottom & (CAPACITY - 1)].store(job, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    return true;
+}
+
+JobSystem::Job* JobSystem::Deque::pop() {
+    int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+    m_bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = m_top.load(std::memory_order_relaxed);
+
+    if (top > bottom) {
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Job* job = m_items[bottom & (CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (top == bottom) {
+        // Last item: race thieves for it
+        if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            job = nullptr;
+        }
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+JobSystem::Job* JobSystem::Deque::steal() {
+    int64_t top = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = m_bottom.load(std::memory_order_acquire);
+    if (top >= bottom) return nullptr;
+
+    Job* job = m_items[top & (CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    return job;
+}
+
+JobSystem::JobSystem(uint32_t worker_count) {
+    if (worker_count == 0) {
+        uint32_t hardware = std::thread::hardware_concurrency();
+        worker_count = hardware > 1 ? hardware - 1 : 0;
+    }
+    for (uint32_t i = 0; i <= worker_count; i++) {
+        m_deques.push_back(std::make_unique<Deque>());
+    }
+    m_threads.reserve(worker_count);
+    for (uint32_t i = 1; i <= worker_count; i++) {
+        m_threads.emplace_back([this, i] {
+            t_thread_index = i;
+            worker_loop(i);
+        });
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+}
+
+void JobSystem::run(Job* job) {
+    job->fn();
+    JobCounter* counter = job->counter;
+    delete job;
+    // The last job of a counter wakes threads sleeping in wait(). The counter
+    // may be gone once it reads zero, so it is not touched after this.
+    if (counter->m_pending.fetch_sub(1) == 1 && m_sleeping.load() > 0) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_wake.notify_all();
+    }
+}
+
+// Own deque first (LIFO, cache-warm), then steal round-robin from the rest
+JobSystem::Job* JobSystem::find_job(uint32_t index) {
+    uint32_t count = thread_count();
+    Job* job = m_deques[index]->pop();
+    for (uint32_t i = 1; !job && i < count; i++) {
+        job = m_deques[(index + i) % count]->steal();
+    }
+    if (job) m_queued.fetch_sub(1);
+    return job;
+}
+
+void JobSystem::submit(JobCounter& counter, Fn fn) {
+    counter.m_pending.fetch_add(1, std::memory_order_relaxed);
+    Job* job = new Job{std::move(fn), &counter};
+
+    // Without workers nobody would steal it. A full deque means plenty of
+    // queued work. Either way run this one here instead.
+    if (m_threads.empty() || !m_deques[thread_index()]->push(job)) {
+        run(job);
+        return;
+    }
+
+    // Pairs with the check in worker_loop so a worker going to sleep either
+    // sees the job or gets the notify
+    m_queued.fetch_add(1);
+    if (m_sleeping.load() > 0) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_wake.notify_one();
+    }
+}
+
+void JobSystem::wait(JobCounter& counter) {
+    uint32_t index = thread_index();
+    while (!counter.done()) {
+        if (Job* job = find_job(index)) {
+            run(job);
+            continue;
+        }
+
+        // What is left runs elsewhere: sleep until it finishes or new work
+        // to help with is queued. Pairs with the check in run().
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_sleeping.fetch_add(1);
+        m_wake.wait(lock, [&] { return counter.m_pending.load() == 0 || m_queued.load() > 0; });
+        m_sleeping.fetch_sub(1);
+    }
+}
+
+void JobSystem::worker_loop(uint32_t index) {
+    for (;;) {
+        if (Job* job = find_job(index)) {
+            run(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_sleeping.fetch_add(1);
+        m_wake.wait(lock, [&] { return m_stopping || m_queued.load() > 0; });
+        m_sleeping.fetch_sub(1);
+        if (m_stopping) return;
+    }
+}
+
+void JobSystem::parallel_for(uint32_t count, uint32_t grain, const RangeFn& fn) {
+    if (count == 0) return;
+    if (grain == 0) grain = 1;
+
+    if (m_threads.empty() || count <= grain) {
+        for (uint32_t begin = 0; begin < count; begin += grain) {
+            fn(begin, begin + grain < count ? begin + grain : count);
+        }
+        return;
+    }
+
+    JobCounter counter;
+    for (uint32_t begin = 0; begin < count; begin += grain) {
+        uint32_t end = begin + grain < count ? begin + grain : count;
+        submit(counter, [&fn, begin, end] { fn(begin, end); });
+    }
+    wait(counter);
+}
+
+JobSystem& job_system() {
+    static JobSystem system;
+    return system;
+}
+
+} // namespace hxo
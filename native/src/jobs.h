@@ -0,0 +1,105 @@
+#ifndef HXO_JOBS_H
+#define HXO_JOBS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace hxo {
+
+// Tracks outstanding jobs. Submitting against a counter raises it, finishing
+// a job lowers it; a job may submit children against another counter and
+// wait on it, which runs other jobs and sleeps only when none are queued.
+class JobCounter {
+public:
+    bool done() const { return m_pending.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class JobSystem;
+    std::atomic<uint32_t> m_pending{0};
+};
+
+// Work-stealing scheduler. Each worker owns a Chase-Lev deque: it pushes and
+// pops at the bottom, idle threads steal from the top. The thread that calls
+// into the system from outside (the Bun thread) owns deque 0 and helps run
+// jobs while it waits. A submit pushes to the calling thread's own deque, so
+// only two kinds of thread may submit: that external thread, and workers
+// submitting children from inside a job.
+class JobSystem {
+public:
+    using Fn = std::function<void()>;
+    using RangeFn = std::function<void(uint32_t begin, uint32_t end)>;
+
+    // worker_count 0 uses one worker per hardware thread besides the caller
+    explicit JobSystem(uint32_t worker_count = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Threads running jobs, including the external thread
+    uint32_t thread_count() const { return static_cast<uint32_t>(m_deques.size()); }
+
+    // 1..thread_count()-1 on workers, 0 on any other thread. Lets job bodies
+    // pick per-thread state.
+    static uint32_t thread_index();
+
+    // Queue fn against counter. Runs inline when there are no workers.
+    void submit(JobCounter& counter, Fn fn);
+
+    // Run jobs until the counter drains, sleeping while there are none to
+    // help with, e.g. while a worker is busy with a file read
+    void wait(JobCounter& counter);
+
+    // Split [0, count) into chunks of `grain` items (the last may be shorter)
+    // and run fn on each as a job. Chunk k always covers [k * grain, ...), so
+    // callers can index per-chunk output by begin / grain. Blocks until done.
+    void parallel_for(uint32_t count, uint32_t grain, const RangeFn& fn);
+
+private:
+    struct Job {
+        Fn fn;
+        JobCounter* counter;
+    };
+
+    // Fixed-capacity Chase-Lev deque (Le et al., "Correct and Efficient
+    // Work-Stealing for Weak Memory Models")
+    class Deque {
+    public:
+        static constexpr int64_t CAPACITY = 4096;
+
+        bool push(Job* job);
+        Job* pop();
+        Job* steal();
+
+    private:
+        alignas(64) std::atomic<int64_t> m_top{0};
+        alignas(64) std::atomic<int64_t> m_bottom{0};
+        std::atomic<Job*> m_items[CAPACITY] = {};
+    };
+
+    void worker_loop(uint32_t index);
+    Job* find_job(uint32_t index);
+    void run(Job* job);
+
+    std::vector<std::unique_ptr<Deque>> m_deques;
+    std::vector<std::thread> m_threads;
+
+    std::atomic<int64_t> m_queued{0};
+    std::atomic<uint32_t> m_sleeping{0};
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_stopping = false;
+};
+
+// Shared job system used by the engine, created on first use
+JobSystem& job_system();
+
+} // namespace hxo
+
+#endif // HXO_JOBS_H
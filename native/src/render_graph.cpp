@@ -0,0 +1,623 @@
+#include "render_graph.h"
+
+#include <SDL3/SDL.h>
+#include <algorithm>
+#include <numeric>
+
+namespace hxo {
+
+namespace {
+
+struct UsageInfo {
+    VkPipelineStageFlags2 stages;
+    VkAccessFlags2 read_access;
+    VkAccessFlags2 write_access;
+    VkImageLayout read_layout;
+    VkImageLayout write_layout;
+    VkImageUsageFlags image_usage;
+};
+
+// Only flags with a synchronization1 equivalent, so barriers translate
+// directly when synchronization2 is unavailable
+UsageInfo usage_info(ResourceUsage usage) {
+    switch (usage) {
+    case ResourceUsage::ColorAttachment:
+        return {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
+                VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT_KHR, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR,
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT};
+    case ResourceUsage::DepthAttachment:
+        return {VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT_KHR | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT_KHR,
+                VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT_KHR, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT_KHR,
+                VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT};
+    case ResourceUsage::InputAttachment:
+        return {VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR,
+                VK_ACCESS_2_INPUT_ATTACHMENT_READ_BIT_KHR, 0,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT};
+    case ResourceUsage::FragmentSampled:
+        return {VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR,
+                VK_ACCESS_2_SHADER_READ_BIT_KHR, 0,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_IMAGE_USAGE_SAMPLED_BIT};
+    case ResourceUsage::ComputeSampled:
+        return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR,
+                VK_ACCESS_2_SHADER_READ_BIT_KHR, 0,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_IMAGE_USAGE_SAMPLED_BIT};
+    case ResourceUsage::VertexStorage:
+        return {VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT_KHR,
+                VK_ACCESS_2_SHADER_READ_BIT_KHR, VK_ACCESS_2_SHADER_WRITE_BIT_KHR,
+                VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT};
+    case ResourceUsage::FragmentStorage:
+        return {VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR,
+                VK_ACCESS_2_SHADER_READ_BIT_KHR, VK_ACCESS_2_SHADER_WRITE_BIT_KHR,
+                VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT};
+    case ResourceUsage::ComputeStorage:
+        return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR,
+                VK_ACCESS_2_SHADER_READ_BIT_KHR, VK_ACCESS_2_SHADER_WRITE_BIT_KHR,
+                VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT};
+    case ResourceUsage::IndirectCommands:
+        return {VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT_KHR,
+                VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT_KHR, 0,
+                VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED, 0};
+    case ResourceUsage::TransferSrc:
+        return {VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR,
+                VK_ACCESS_2_TRANSFER_READ_BIT_KHR, 0,
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                VK_IMAGE_USAGE_TRANSFER_SRC_BIT};
+    case ResourceUsage::TransferDst:
+        return {VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR,
+                0, VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                VK_IMAGE_USAGE_TRANSFER_DST_BIT};
+    case ResourceUsage::Present:
+        return {VK_PIPELINE_STAGE_2_NONE_KHR, 0, 0,
+                VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, 0};
+    }
+    return {};
+}
+
+} // namespace
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::read(ResourceHandle resource, ResourceUsage usage) {
+    m_graph.use(m_pass, resource, usage, true, false);
+    return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::write(ResourceHandle resource, ResourceUsage usage) {
+    m_graph.use(m_pass, resource, usage, false, true);
+    return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::side_effect() {
+    m_graph.m_passes[m_pass].side_effect = true;
+    return *this;
+}
+
+void RenderGraph::init(VkDevice device, const DeviceDispatch& vk, const VkPhysicalDeviceMemoryProperties& memory,
+                       bool sync2, uint32_t frames_in_flight) {
+    m_device = device;
+    m_vk = &vk;
+    m_memory = memory;
+    m_sync2 = sync2;
+    m_frames_in_flight = frames_in_flight;
+}
+
+void RenderGraph::destroy() {
+    destroy_physical(m_physical, m_blocks);
+    for (Retired& retired : m_retired) destroy_physical(retired.images, retired.blocks);
+    m_retired.clear();
+    reset();
+}
+
+void RenderGraph::reset() {
+    m_passes.clear();
+    m_resources.clear();
+    m_order.clear();
+}
+
+ResourceHandle RenderGraph::import_image(const char* name, const ImageImport& image) {
+    Resource resource = {};
+    resource.name = name;
+    resource.kind = ResourceKind::ImportedImage;
+    resource.import = image;
+    resource.output = image.final_usage.has_value();
+    m_resources.push_back(resource);
+    return static_cast<ResourceHandle>(m_resources.size() - 1);
+}
+
+ResourceHandle RenderGraph::import_buffer(const char* name, VkBuffer buffer, bool output) {
+    Resource resource = {};
+    resource.name = name;
+    resource.kind = ResourceKind::ImportedBuffer;
+    resource.buffer = buffer;
+    resource.output = output;
+    m_resources.push_back(resource);
+    return static_cast<ResourceHandle>(m_resources.size() - 1);
+}
+
+ResourceHandle RenderGraph::create_image(const char* name, const ImageDesc& desc) {
+    Resource resource = {};
+    resource.name = name;
+    resource.kind = ResourceKind::TransientImage;
+    resource.desc = desc;
+    m_resources.push_back(resource);
+    return static_cast<ResourceHandle>(m_resources.size() - 1);
+}
+
+RenderGraph::PassBuilder RenderGraph::add_pass(const char* name, Execute execute) {
+    Pass pass;
+    pass.name = name;
+    pass.execute = std::move(execute);
+    m_passes.push_back(std::move(pass));
+    return PassBuilder(*this, static_cast<uint32_t>(m_passes.size() - 1));
+}
+
+RenderGraph::Access RenderGraph::describe_access(ResourceHandle resource, ResourceUsage usage,
+                                                 bool read, bool write) {
+    UsageInfo info = usage_info(usage);
+    return {resource, usage, info.stages,
+            read ? info.read_access : 0, write ? info.write_access : 0,
+            write ? info.write_layout : info.read_layout, info.image_usage, read, write};
+}
+
+// A pass touches each resource once; declaring it again merges the stages,
+// access and image usage of both, so one barrier covers every use. Layouts
+// of one usage settle on its write layout; different layouts need GENERAL.
+void RenderGraph::use(uint32_t pass, ResourceHandle resource, ResourceUsage usage, bool read, bool write) {
+    Access added = describe_access(resource, usage, read, write);
+    for (Access& access : m_passes[pass].accesses) {
+        if (access.resource != resource) continue;
+        if (added.layout != access.layout) {
+            UsageInfo info = usage_info(usage);
+            bool same_usage = usage == access.usage &&
+                (access.layout == info.read_layout || access.layout == info.write_layout);
+            access.layout = same_usage ? info.write_layout : VK_IMAGE_LAYOUT_GENERAL;
+        }
+        access.stages |= added.stages;
+        access.read_access |= added.read_access;
+        access.write_access |= added.write_access;
+        access.image_usage |= added.image_usage;
+        access.read = access.read || read;
+        access.write = access.write || write;
+        return;
+    }
+    m_passes[pass].accesses.push_back(added);
+}
+
+// Walk backwards from the outputs: a pass lives if it has side effects or
+// writes something a live pass (or the caller) reads
+void RenderGraph::cull_passes() {
+    std::vector<bool> needed(m_resources.size());
+    for (size_t i = 0; i < m_resources.size(); i++) needed[i] = m_resources[i].output;
+
+    for (size_t i = m_passes.size(); i-- > 0;) {
+        Pass& pass = m_passes[i];
+        pass.live = pass.side_effect;
+        for (const Access& access : pass.accesses) {
+            if (access.write && needed[access.resource]) pass.live = true;
+        }
+        if (!pass.live) continue;
+        for (const Access& access : pass.accesses) {
+            if (access.read) needed[access.resource] = true;
+        }
+    }
+
+    m_order.clear();
+    for (uint32_t i = 0; i < m_passes.size(); i++) {
+        if (m_passes[i].live) m_order.push_back(i);
+    }
+    m_stats.passes = static_cast<uint32_t>(m_order.size());
+    m_stats.culled_passes = static_cast<uint32_t>(m_passes.size() - m_order.size());
+
+    for (Resource& resource : m_resources) {
+        resource.first_pass = UINT32_MAX;
+        resource.last_pass = 0;
+    }
+    for (uint32_t position = 0; position < m_order.size(); position++) {
+        for (const Access& access : m_passes[m_order[position]].accesses) {
+            Resource& resource = m_resources[access.resource];
+            resource.first_pass = std::min(resource.first_pass, position);
+            resource.last_pass = std::max(resource.last_pass, position);
+            if (resource.kind == ResourceKind::TransientImage) {
+                resource.desc.usage |= access.image_usage;
+            }
+        }
+    }
+}
+
+uint32_t RenderGraph::find_memory_type(uint32_t type_bits, VkMemoryPropertyFlags properties) const {
+    for (uint32_t i = 0; i < m_memory.memoryTypeCount; i++) {
+        if ((type_bits & (1u << i)) && (m_memory.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+    return UINT32_MAX;
+}
+
+void RenderGraph::destroy_physical(std::vector<PhysicalImage>& images, std::vector<MemoryBlock>& blocks) {
+    for (PhysicalImage& image : images) {
+        if (image.view) vkDestroyImageView(m_device, image.view, nullptr);
+        if (image.image) vkDestroyImage(m_device, image.image, nullptr);
+    }
+    for (MemoryBlock& block : blocks) {
+        if (block.memory) vkFreeMemory(m_device, block.memory, nullptr);
+    }
+    images.clear();
+    blocks.clear();
+}
+
+// Called once per compile, which the caller does once per frame after
+// waiting for that frame slot's fence
+void RenderGraph::release_retired() {
+    for (Retired& retired : m_retired) {
+        if (retired.frames_left > 0) retired.frames_left--;
+        if (retired.frames_left == 0) destroy_physical(retired.images, retired.blocks);
+    }
+    m_retired.erase(std::remove_if(m_retired.begin(), m_retired.end(),
+        [](const Retired& retired) { return retired.images.empty() && retired.blocks.empty(); }),
+        m_retired.end());
+}
+
+bool RenderGraph::allocate_transients() {
+    // The physical set is reused while the live transients, their
+    // descriptions and their lifetimes match the previous frame's
+    std::vector<PhysicalImage> wanted;
+    for (Resource& resource : m_resources) {
+        if (resource.kind != ResourceKind::TransientImage || resource.first_pass == UINT32_MAX) continue;
+        resource.physical = static_cast<uint32_t>(wanted.size());
+        PhysicalImage image;
+        image.desc = resource.desc;
+        image.first_pass = resource.first_pass;
+        image.last_pass = resource.last_pass;
+        wanted.push_back(image);
+    }
+
+    bool same = wanted.size() == m_physical.size();
+    for (size_t i = 0; same && i < wanted.size(); i++) {
+        same = wanted[i].desc == m_physical[i].desc &&
+            wanted[i].first_pass == m_physical[i].first_pass &&
+            wanted[i].last_pass == m_physical[i].last_pass;
+    }
+    if (same) return true;
+
+    if (!m_physical.empty() || !m_blocks.empty()) {
+        Retired retired;
+        retired.images = std::move(m_physical);
+        retired.blocks = std::move(m_blocks);
+        retired.frames_left = m_frames_in_flight;
+        m_retired.push_back(std::move(retired));
+    }
+    m_physical = std::move(wanted);
+    m_blocks.clear();
+    m_stats.transient_images = static_cast<uint32_t>(m_physical.size());
+    m_stats.memory_blocks = 0;
+    m_stats.transient_bytes = 0;
+    m_stats.unaliased_bytes = 0;
+    if (m_physical.empty()) return true;
+
+    for (PhysicalImage& image : m_physical) {
+        VkImageCreateInfo image_info = {};
+        image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        image_info.imageType = VK_IMAGE_TYPE_2D;
+        image_info.format = image.desc.format;
+        image_info.extent = {image.desc.width, image.desc.height, 1};
+        image_info.mipLevels = 1;
+        image_info.arrayLayers = 1;
+        image_info.samples = image.desc.samples;
+        image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        image_info.usage = image.desc.usage;
+        image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        if (vkCreateImage(m_device, &image_info, nullptr, &image.image) != VK_SUCCESS) {
+            SDL_Log("Render graph: failed to create transient image");
+            return false;
+        }
+        vkGetImageMemoryRequirements(m_device, image.image, &image.requirements);
+        m_stats.unaliased_bytes += image.requirements.size;
+    }
+
+    // Largest first into the first block whose members are all dead while
+    // this one lives. Every member binds at offset 0, so a block only needs
+    // the largest size and a memory type all members accept.
+    std::vector<uint32_t> by_size(m_physical.size());
+    std::iota(by_size.begin(), by_size.end(), 0u);
+    std::stable_sort(by_size.begin(), by_size.end(), [&](uint32_t a, uint32_t b) {
+        return m_physical[a].requirements.size > m_physical[b].requirements.size;
+    });
+
+    std::vector<std::vector<uint32_t>> members;
+    std::vector<uint32_t> type_bits;
+    std::vector<bool> lazy;
+    for (uint32_t index : by_size) {
+        PhysicalImage& image = m_physical[index];
+        uint32_t block = UINT32_MAX;
+        for (uint32_t b = 0; b < members.size() && block == UINT32_MAX; b++) {
+            if ((type_bits[b] & image.requirements.memoryTypeBits) == 0) continue;
+            bool disjoint = true;
+            for (uint32_t other : members[b]) {
+                const PhysicalImage& o = m_physical[other];
+                if (image.first_pass <= o.last_pass && o.first_pass <= image.last_pass) disjoint = false;
+            }
+            if (disjoint) block = b;
+        }
+        if (block == UINT32_MAX) {
+            block = static_cast<uint32_t>(members.size());
+            members.emplace_back();
+            type_bits.push_back(image.requirements.memoryTypeBits);
+            lazy.push_back(true);
+            m_blocks.emplace_back();
+        }
+        members[block].push_back(index);
+        type_bits[block] &= image.requirements.memoryTypeBits;
+        lazy[block] = lazy[block] && (image.desc.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT);
+        m_blocks[block].size = std::max(m_blocks[block].size, image.requirements.size);
+        image.block = block;
+    }
+
+    for (uint32_t b = 0; b < m_blocks.size(); b++) {
+        // Tile-based GPUs may never back lazily allocated memory at all
+        uint32_t type = UINT32_MAX;
+        if (lazy[b]) {
+            type = find_memory_type(type_bits[b],
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+        }
+        if (type == UINT32_MAX) type = find_memory_type(type_bits[b], VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        if (type == UINT32_MAX) {
+            SDL_Log("Render graph: no memory type for transient images");
+            return false;
+        }
+
+        VkMemoryAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        alloc_info.allocationSize = m_blocks[b].size;
+        alloc_info.memoryTypeIndex = type;
+        if (vkAllocateMemory(m_device, &alloc_info, nullptr, &m_blocks[b].memory) != VK_SUCCESS) {
+            SDL_Log("Render graph: failed to allocate transient memory");
+            return false;
+        }
+        m_stats.transient_bytes += m_blocks[b].size;
+    }
+    m_stats.memory_blocks = static_cast<uint32_t>(m_blocks.size());
+
+    for (PhysicalImage& image : m_physical) {
+        if (vkBindImageMemory(m_device, image.image, m_blocks[image.block].memory, 0) != VK_SUCCESS) {
+            SDL_Log("Render graph: failed to bind transient memory");
+            return false;
+        }
+
+        VkImageViewCreateInfo view_info = {};
+        view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_info.image = image.image;
+        view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.format = image.desc.format;
+        view_info.subresourceRange.aspectMask = image.desc.aspect;
+        view_info.subresourceRange.levelCount = 1;
+        view_info.subresourceRange.layerCount = 1;
+        if (vkCreateImageView(m_device, &view_info, nullptr, &image.view) != VK_SUCCESS) {
+            SDL_Log("Render graph: failed to create transient view");
+            return false;
+        }
+    }
+
+    SDL_Log("Render graph: %u transient images in %u blocks, %.1f MB (%.1f MB unaliased)",
+        m_stats.transient_images, m_stats.memory_blocks,
+        m_stats.transient_bytes / (1024.0 * 1024.0), m_stats.unaliased_bytes / (1024.0 * 1024.0));
+    return true;
+}
+
+// Add whatever barrier orders this access after the resource's earlier
+// ones, then advance its state. Reads of an already visible write in the
+// same layout need nothing; writes wait for earlier reads (execution only)
+// and writes; layout changes and ownership transfers always need a barrier.
+void RenderGraph::plan_access(BarrierGroup& group, Resource& resource, const Access& wanted,
+                              uint32_t src_family, uint32_t dst_family) {
+    VkPipelineStageFlags2 stages = wanted.stages;
+    VkAccessFlags2 access = wanted.read_access | wanted.write_access;
+    bool write = wanted.write;
+    bool is_image = resource.kind != ResourceKind::ImportedBuffer;
+    VkImageLayout layout = is_image ? wanted.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+    State& state = resource.state;
+
+    bool transition = is_image && layout != state.layout;
+    bool transfer = src_family != dst_family;
+    VkPipelineStageFlags2 src_stages = 0;
+    VkAccessFlags2 src_access = 0;
+    bool needed = false;
+    if (transition || transfer || write) {
+        src_stages = state.write_stages | state.read_stages;
+        src_access = state.write_access;
+        needed = transition || transfer || src_stages != 0;
+    } else if (state.write_stages != 0 &&
+               ((stages & ~state.visible_stages) != 0 || (access & ~state.visible_access) != 0)) {
+        src_stages = state.write_stages;
+        src_access = state.write_access;
+        needed = true;
+    }
+
+    if (needed && is_image) {
+        VkImageMemoryBarrier2KHR barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+        barrier.srcStageMask = src_stages;
+        barrier.srcAccessMask = src_access;
+        barrier.dstStageMask = stages;
+        barrier.dstAccessMask = access;
+        barrier.oldLayout = state.layout;
+        barrier.newLayout = layout;
+        barrier.srcQueueFamilyIndex = src_family;
+        barrier.dstQueueFamilyIndex = dst_family;
+        barrier.image = image(static_cast<ResourceHandle>(&resource - m_resources.data()));
+        barrier.subresourceRange.aspectMask = resource.kind == ResourceKind::TransientImage
+            ? resource.desc.aspect : resource.import.aspect;
+        // Imports may be arrays, like the shadow cascades
+        barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+        barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+        m_image_barriers.push_back(barrier);
+    } else if (needed) {
+        // Buffer hazards of a pass share one global memory barrier
+        group.has_memory = true;
+        group.memory.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2_KHR;
+        group.memory.srcStageMask |= src_stages;
+        group.memory.srcAccessMask |= src_access;
+        group.memory.dstStageMask |= stages;
+        group.memory.dstAccessMask |= access;
+    }
+
+    if (write) {
+        state.write_stages = stages;
+        state.write_access = wanted.write_access;
+        state.read_stages = 0;
+        state.visible_stages = 0;
+        state.visible_access = 0;
+    } else if (needed && (transition || transfer)) {
+        // The transition is the new "write"; later readers chain off stages
+        state.write_stages = stages;
+        state.write_access = 0;
+        state.read_stages = stages;
+        state.visible_stages = stages;
+        state.visible_access = access;
+    } else {
+        state.read_stages |= stages;
+        if (needed) {
+            state.visible_stages |= stages;
+            state.visible_access |= access;
+        }
+    }
+    if (is_image) state.layout = layout;
+}
+
+bool RenderGraph::compile() {
+    release_retired();
+    cull_passes();
+    if (!allocate_transients()) return false;
+
+    for (Resource& resource : m_resources) {
+        resource.state = {};
+        if (resource.kind == ResourceKind::ImportedImage) {
+            resource.state.layout = resource.import.initial_layout;
+            resource.state.write_stages = resource.import.initial_stage;
+            resource.state.write_access = resource.import.initial_access;
+        }
+    }
+
+    m_image_barriers.clear();
+    m_groups.assign(m_order.size() + 1, BarrierGroup{});
+    for (uint32_t position = 0; position < m_order.size(); position++) {
+        BarrierGroup& group = m_groups[position];
+        group.first_image = static_cast<uint32_t>(m_image_barriers.size());
+        const Pass& pass = m_passes[m_order[position]];
+
+        for (const Access& access : pass.accesses) {
+            Resource& resource = m_resources[access.resource];
+            // A transient starts undefined, after whatever last used its memory
+            if (resource.kind == ResourceKind::TransientImage && position == resource.first_pass) {
+                const MemoryBlock& block = m_blocks[m_physical[resource.physical].block];
+                resource.state.write_stages = block.last_stages;
+                resource.state.write_access = block.last_access;
+            }
+            plan_access(group, resource, access, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+        }
+        for (const Access& access : pass.accesses) {
+            Resource& resource = m_resources[access.resource];
+            if (resource.kind == ResourceKind::TransientImage && position == resource.last_pass) {
+                MemoryBlock& block = m_blocks[m_physical[resource.physical].block];
+                block.last_stages = resource.state.write_stages | resource.state.read_stages;
+                block.last_access = resource.state.write_access;
+            }
+        }
+        group.image_count = static_cast<uint32_t>(m_image_barriers.size()) - group.first_image;
+    }
+
+    BarrierGroup& final_group = m_groups.back();
+    final_group.first_image = static_cast<uint32_t>(m_image_barriers.size());
+    for (Resource& resource : m_resources) {
+        if (resource.kind != ResourceKind::ImportedImage || !resource.import.final_usage) continue;
+        plan_access(final_group, resource,
+            describe_access(static_cast<ResourceHandle>(&resource - m_resources.data()),
+                *resource.import.final_usage, true, false),
+            resource.import.release_from_family, resource.import.release_to_family);
+    }
+    final_group.image_count = static_cast<uint32_t>(m_image_barriers.size()) - final_group.first_image;
+
+    m_stats.barriers = static_cast<uint32_t>(m_image_barriers.size());
+    for (const BarrierGroup& group : m_groups) m_stats.barriers += group.has_memory ? 1 : 0;
+    return true;
+}
+
+void RenderGraph::record_barriers(VkCommandBuffer cmd, const BarrierGroup& group) {
+    if (group.image_count == 0 && !group.has_memory) return;
+    const VkImageMemoryBarrier2KHR* images = m_image_barriers.data() + group.first_image;
+
+    if (m_sync2) {
+        VkDependencyInfoKHR dependency = {};
+        dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR;
+        dependency.memoryBarrierCount = group.has_memory ? 1 : 0;
+        dependency.pMemoryBarriers = &group.memory;
+        dependency.imageMemoryBarrierCount = group.image_count;
+        dependency.pImageMemoryBarriers = images;
+        m_vk->vkCmdPipelineBarrier2KHR(cmd, &dependency);
+        return;
+    }
+
+    // Synchronization1 takes one stage mask pair for the whole call
+    VkPipelineStageFlags src_stages = static_cast<VkPipelineStageFlags>(group.memory.srcStageMask);
+    VkPipelineStageFlags dst_stages = static_cast<VkPipelineStageFlags>(group.memory.dstStageMask);
+    m_legacy_barriers.resize(group.image_count);
+    for (uint32_t i = 0; i < group.image_count; i++) {
+        const VkImageMemoryBarrier2KHR& src = images[i];
+        VkImageMemoryBarrier& dst = m_legacy_barriers[i];
+        dst = {};
+        dst.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        dst.srcAccessMask = static_cast<VkAccessFlags>(src.srcAccessMask);
+        dst.dstAccessMask = static_cast<VkAccessFlags>(src.dstAccessMask);
+        dst.oldLayout = src.oldLayout;
+        dst.newLayout = src.newLayout;
+        dst.srcQueueFamilyIndex = src.srcQueueFamilyIndex;
+        dst.dstQueueFamilyIndex = src.dstQueueFamilyIndex;
+        dst.image = src.image;
+        dst.subresourceRange = src.subresourceRange;
+        src_stages |= static_cast<VkPipelineStageFlags>(src.srcStageMask);
+        dst_stages |= static_cast<VkPipelineStageFlags>(src.dstStageMask);
+    }
+    if (src_stages == 0) src_stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    if (dst_stages == 0) dst_stages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+
+    VkMemoryBarrier memory = {};
+    memory.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memory.srcAccessMask = static_cast<VkAccessFlags>(group.memory.srcAccessMask);
+    memory.dstAccessMask = static_cast<VkAccessFlags>(group.memory.dstAccessMask);
+    m_vk->vkCmdPipelineBarrier(cmd, src_stages, dst_stages, 0,
+        group.has_memory ? 1 : 0, &memory, 0, nullptr, group.image_count, m_legacy_barriers.data());
+}
+
+void RenderGraph::execute(VkCommandBuffer cmd) {
+    for (uint32_t position = 0; position < m_order.size(); position++) {
+        record_barriers(cmd, m_groups[position]);
+        m_passes[m_order[position]].execute(cmd);
+    }
+    record_barriers(cmd, m_groups.back());
+}
+
+VkImage RenderGraph::image(ResourceHandle resource) const {
+    const Resource& r = m_resources[resource];
+    if (r.kind == ResourceKind::TransientImage) {
+        return r.physical < m_physical.size() ? m_physical[r.physical].image : VK_NULL_HANDLE;
+    }
+    return r.import.image;
+}
+
+VkImageView RenderGraph::view(ResourceHandle resource) const {
+    const Resource& r = m_resources[resource];
+    if (r.kind == ResourceKind::TransientImage) {
+        return r.physical < m_physical.size() ? m_physical[r.physical].view : VK_NULL_HANDLE;
+    }
+    return r.import.view;
+}
+
+VkBuffer RenderGraph::buffer(ResourceHandle resource) const {
+    return m_resources[resource].buffer;
+}
+
+} // namespace hxo
@@ -0,0 +1,256 @@
+#ifndef HXO_RENDER_GRAPH_H
+#define HXO_RENDER_GRAPH_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include "vk_dispatch.h"
+
+namespace hxo {
+
+// How a pass touches a resource. Each usage implies the pipeline stage, the
+// access flags and, for images, the layout the graph moves the image into.
+enum class ResourceUsage : uint8_t {
+    ColorAttachment,
+    DepthAttachment,
+    InputAttachment,
+    FragmentSampled,
+    ComputeSampled,
+    VertexStorage,
+    FragmentStorage,
+    ComputeStorage,
+    IndirectCommands,
+    TransferSrc,
+    TransferDst,
+    Present,
+};
+
+using ResourceHandle = uint32_t;
+inline constexpr ResourceHandle INVALID_RESOURCE = UINT32_MAX;
+
+// An image owned outside the graph, such as a swapchain image
+struct ImageImport {
+    VkImage image = VK_NULL_HANDLE;
+    VkImageView view = VK_NULL_HANDLE;
+    VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+
+    // State when the command buffer starts. initial_stage is what the first
+    // barrier waits on, e.g. the stage a swapchain acquire semaphore waits at;
+    // initial_access is an earlier write there it must make available, e.g.
+    // the last frame's use of an image shared by all frames in flight.
+    VkImageLayout initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkPipelineStageFlags2 initial_stage = 0;
+    VkAccessFlags2 initial_access = 0;
+
+    // Usage to leave the image in after the last pass. Imports with a final
+    // usage are graph outputs: passes writing them are never culled.
+    std::optional<ResourceUsage> final_usage;
+
+    // Queue family ownership transfer done by the final barrier
+    uint32_t release_from_family = VK_QUEUE_FAMILY_IGNORED;
+    uint32_t release_to_family = VK_QUEUE_FAMILY_IGNORED;
+};
+
+// A transient image the graph allocates. Usage flags implied by the passes
+// that touch it are added to usage.
+struct ImageDesc {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkImageUsageFlags usage = 0;
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+    VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+
+    bool operator==(const ImageDesc&) const = default;
+};
+
+struct RenderGraphStats {
+    uint32_t passes = 0;
+    uint32_t culled_passes = 0;
+    uint32_t barriers = 0;
+    uint32_t transient_images = 0;
+    uint32_t memory_blocks = 0;
+    VkDeviceSize transient_bytes = 0;
+    // What the transients would take without aliasing
+    VkDeviceSize unaliased_bytes = 0;
+};
+
+// Frame graph recorded into one command buffer. Each frame the caller
+// declares passes with the resources they read and write, then compile()
+// drops passes whose results nothing uses, places transient images whose
+// lifetimes do not overlap in the same memory, and plans the fewest
+// barriers that order every hazard; execute() records them around the
+// passes. Transient memory persists across frames and is reallocated only
+// when the declared transients change.
+class RenderGraph {
+public:
+    using Execute = std::function<void(VkCommandBuffer)>;
+
+    class PassBuilder {
+    public:
+        PassBuilder& read(ResourceHandle resource, ResourceUsage usage);
+        PassBuilder& write(ResourceHandle resource, ResourceUsage usage);
+        // Keep the pass even when nothing reads what it writes
+        PassBuilder& side_effect();
+
+    private:
+        friend class RenderGraph;
+        PassBuilder(RenderGraph& graph, uint32_t pass) : m_graph(graph), m_pass(pass) {}
+
+        RenderGraph& m_graph;
+        uint32_t m_pass;
+    };
+
+    // sync2 selects vkCmdPipelineBarrier2KHR; otherwise barriers go through
+    // vkCmdPipelineBarrier. Retired transients are destroyed frames_in_flight
+    // compiles after they were last used.
+    void init(VkDevice device, const DeviceDispatch& vk, const VkPhysicalDeviceMemoryProperties& memory,
+              bool sync2, uint32_t frames_in_flight);
+    // Destroy all transient images and memory. The device must be idle.
+    void destroy();
+
+    // Forget last frame's declarations
+    void reset();
+
+    ResourceHandle import_image(const char* name, const ImageImport& image);
+    // output marks a buffer consumed outside the graph, like import final_usage
+    ResourceHandle import_buffer(const char* name, VkBuffer buffer, bool output = false);
+    ResourceHandle create_image(const char* name, const ImageDesc& desc);
+
+    PassBuilder add_pass(const char* name, Execute execute);
+
+    // Cull, allocate transients and plan barriers. Returns false if transient
+    // memory could not be allocated.
+    bool compile();
+    void execute(VkCommandBuffer cmd);
+
+    // Physical handles for use inside pass callbacks
+    VkImage image(ResourceHandle resource) const;
+    VkImageView view(ResourceHandle resource) const;
+    VkBuffer buffer(ResourceHandle resource) const;
+    bool pass_live(uint32_t pass) const { return m_passes[pass].live; }
+
+    const RenderGraphStats& stats() const { return m_stats; }
+
+private:
+    enum class ResourceKind : uint8_t { ImportedImage, ImportedBuffer, TransientImage };
+
+    // Everything a pass needs from one resource, merged over every usage it
+    // declared for it
+    struct Access {
+        ResourceHandle resource;
+        ResourceUsage usage;  // first declared, to merge layouts
+        VkPipelineStageFlags2 stages;
+        VkAccessFlags2 read_access;
+        VkAccessFlags2 write_access;
+        VkImageLayout layout;
+        VkImageUsageFlags image_usage;
+        bool read;
+        bool write;
+    };
+
+    struct Pass {
+        const char* name;
+        Execute execute;
+        std::vector<Access> accesses;
+        bool side_effect = false;
+        bool live = false;
+    };
+
+    // Hazard tracking for one resource while barriers are planned
+    struct State {
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        // Last write (or layout transition), and reads since then
+        VkPipelineStageFlags2 write_stages = 0;
+        VkAccessFlags2 write_access = 0;
+        VkPipelineStageFlags2 read_stages = 0;
+        // Where the last write has already been made visible
+        VkPipelineStageFlags2 visible_stages = 0;
+        VkAccessFlags2 visible_access = 0;
+    };
+
+    struct Resource {
+        const char* name;
+        ResourceKind kind;
+        ImageImport import;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        ImageDesc desc;
+        bool output = false;
+        uint32_t first_pass = UINT32_MAX;
+        uint32_t last_pass = 0;
+        uint32_t physical = UINT32_MAX;
+        State state;
+    };
+
+    struct PhysicalImage {
+        ImageDesc desc;
+        uint32_t first_pass = 0;
+        uint32_t last_pass = 0;
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkMemoryRequirements requirements = {};
+        uint32_t block = UINT32_MAX;
+    };
+
+    // Memory shared by transients with disjoint lifetimes. last_* is the
+    // final access of its latest occupant, which the next one waits on,
+    // including across frames.
+    struct MemoryBlock {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        VkPipelineStageFlags2 last_stages = 0;
+        VkAccessFlags2 last_access = 0;
+    };
+
+    struct Retired {
+        std::vector<PhysicalImage> images;
+        std::vector<MemoryBlock> blocks;
+        uint32_t frames_left = 0;
+    };
+
+    // Barriers recorded before one pass, or after the last one
+    struct BarrierGroup {
+        uint32_t first_image = 0;
+        uint32_t image_count = 0;
+        VkMemoryBarrier2KHR memory = {};
+        bool has_memory = false;
+    };
+
+    static Access describe_access(ResourceHandle resource, ResourceUsage usage, bool read, bool write);
+    void use(uint32_t pass, ResourceHandle resource, ResourceUsage usage, bool read, bool write);
+    void cull_passes();
+    bool allocate_transients();
+    void destroy_physical(std::vector<PhysicalImage>& images, std::vector<MemoryBlock>& blocks);
+    void release_retired();
+    void plan_access(BarrierGroup& group, Resource& resource, const Access& access,
+                     uint32_t src_family, uint32_t dst_family);
+    void record_barriers(VkCommandBuffer cmd, const BarrierGroup& group);
+    uint32_t find_memory_type(uint32_t type_bits, VkMemoryPropertyFlags properties) const;
+
+    VkDevice m_device = VK_NULL_HANDLE;
+    const DeviceDispatch* m_vk = nullptr;
+    VkPhysicalDeviceMemoryProperties m_memory = {};
+    bool m_sync2 = false;
+    uint32_t m_frames_in_flight = 1;
+
+    std::vector<Pass> m_passes;
+    std::vector<Resource> m_resources;
+    std::vector<uint32_t> m_order;
+
+    std::vector<PhysicalImage> m_physical;
+    std::vector<MemoryBlock> m_blocks;
+    std::vector<Retired> m_retired;
+
+    std::vector<BarrierGroup> m_groups;
+    std::vector<VkImageMemoryBarrier2KHR> m_image_barriers;
+    std::vector<VkImageMemoryBarrier> m_legacy_barriers;
+
+    RenderGraphStats m_stats;
+};
+
+} // namespace hxo
+
+#endif // HXO_RENDER_GRAPH_H
@@ -0,0 +1,43 @@
+#include "resolution.h"
+#include <algorithm>
+#include <cmath>
+
+namespace hxo {
+
+// Weight of the newest sample in the smoothed frame time
+static constexpr float SMOOTHING = 0.2f;
+// Aim below the target to leave room for spikes
+static constexpr float BUDGET_FRACTION = 0.9f;
+// Raise the scale only when frames take less than this much of the budget
+static constexpr float RAISE_THRESHOLD = 0.85f;
+// Fraction of the way to the ideal scale taken per update
+static constexpr float RESPONSE = 0.5f;
+
+void ResolutionController::configure(float min_scale, float max_scale, float target_ms) {
+    m_min_scale = std::clamp(min_scale, MIN_SCALE, 1.0f);
+    m_max_scale = std::clamp(max_scale, m_min_scale, 1.0f);
+    m_target_ms = target_ms;
+    m_scale = std::clamp(m_scale, m_min_scale, m_max_scale);
+    m_estimate_ms = 0.0f;
+}
+
+float ResolutionController::update(float gpu_ms) {
+    if (gpu_ms <= 0.0f) return m_scale;
+    m_estimate_ms = m_estimate_ms > 0.0f ? m_estimate_ms + (gpu_ms - m_estimate_ms) * SMOOTHING : gpu_ms;
+
+    float budget = m_target_ms * BUDGET_FRACTION;
+    bool over = m_estimate_ms > m_target_ms;
+    bool under = m_estimate_ms < budget * RAISE_THRESHOLD;
+    if (!over && !under) return m_scale;
+
+    float ideal = m_scale * std::sqrt(budget / m_estimate_ms);
+    float scale = std::clamp(m_scale + (ideal - m_scale) * RESPONSE, m_min_scale, m_max_scale);
+    if (scale != m_scale) {
+        float ratio = scale / m_scale;
+        m_estimate_ms *= ratio * ratio;
+        m_scale = scale;
+    }
+    return m_scale;
+}
+
+} // namespace hxo
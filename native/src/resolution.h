@@ -0,0 +1,38 @@
+#ifndef HXO_RESOLUTION_H
+#define HXO_RESOLUTION_H
+
+namespace hxo {
+
+// Picks the render scale for dynamic resolution from measured GPU frame
+// times. Scales are per axis, so fragment cost is taken to grow with the
+// square of the scale and the controller moves toward
+// scale * sqrt(budget / time). It drops resolution as soon as frames run
+// over the target, but only raises it again once they are clearly under,
+// so noise around the budget does not make the image pump.
+class ResolutionController {
+public:
+    // Bounds are clamped to [MIN_SCALE, 1]; target_ms must be positive
+    void configure(float min_scale, float max_scale, float target_ms);
+
+    // Feed the GPU time of one frame; returns the scale for the next one
+    float update(float gpu_ms);
+
+    float scale() const { return m_scale; }
+    float min_scale() const { return m_min_scale; }
+    float max_scale() const { return m_max_scale; }
+
+    static constexpr float MIN_SCALE = 0.25f;
+
+private:
+    float m_min_scale = 0.5f;
+    float m_max_scale = 1.0f;
+    float m_target_ms = 16.0f;
+    float m_scale = 1.0f;
+    // Smoothed frame time, rescaled whenever the scale changes so frames
+    // still in flight at the old scale do not cause a second correction
+    float m_estimate_ms = 0.0f;
+};
+
+} // namespace hxo
+
+#endif // HXO_RESOLUTION_H
@@ -0,0 +1,394 @@
+#include "scene.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#define HXO_SCENE_SSE 1
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define HXO_SCENE_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace hxo {
+
+static constexpr uint32_t NO_INDEX = 0xFFFFFFFFu;
+static constexpr uint32_t INDEX_BITS = 24;
+static constexpr uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+// Index + 1 must fit in the handle's index bits
+static constexpr uint32_t MAX_NODES = INDEX_MASK - 1;
+
+static const float IDENTITY[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+
+void mat4_multiply(float* out, const float* a, const float* b) {
+#if HXO_SCENE_SSE
+    __m128 a0 = _mm_loadu_ps(a + 0);
+    __m128 a1 = _mm_loadu_ps(a + 4);
+    __m128 a2 = _mm_loadu_ps(a + 8);
+    __m128 a3 = _mm_loadu_ps(a + 12);
+    for (int c = 0; c < 4; c++) {
+        const float* bc = b + c * 4;
+        __m128 r = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(bc[0])), _mm_mul_ps(a1, _mm_set1_ps(bc[1]))),
+            _mm_add_ps(_mm_mul_ps(a2, _mm_set1_ps(bc[2])), _mm_mul_ps(a3, _mm_set1_ps(bc[3]))));
+        _mm_storeu_ps(out + c * 4, r);
+    }
+#elif HXO_SCENE_NEON
+    float32x4_t a0 = vld1q_f32(a + 0);
+    float32x4_t a1 = vld1q_f32(a + 4);
+    float32x4_t a2 = vld1q_f32(a + 8);
+    float32x4_t a3 = vld1q_f32(a + 12);
+    for (int c = 0; c < 4; c++) {
+        float32x4_t bc = vld1q_f32(b + c * 4);
+        float32x4_t r = vmulq_laneq_f32(a0, bc, 0);
+        r = vfmaq_laneq_f32(r, a1, bc, 1);
+        r = vfmaq_laneq_f32(r, a2, bc, 2);
+        r = vfmaq_laneq_f32(r, a3, bc, 3);
+        vst1q_f32(out + c * 4, r);
+    }
+#else
+    for (int c = 0; c < 4; c++) {
+        for (int r = 0; r < 4; r++) {
+            out[c * 4 + r] = a[r] * b[c * 4] + a[4 + r] * b[c * 4 + 1] +
+                             a[8 + r] * b[c * 4 + 2] + a[12 + r] * b[c * 4 + 3];
+        }
+    }
+#endif
+}
+
+// Column-major T * R * S from a unit quaternion
+static void compose_trs(float* m, float tx, float ty, float tz,
+                        float qx, float qy, float qz, float qw,
+                        float sx, float sy, float sz) {
+    float xx = qx * qx, yy = qy * qy, zz = qz * qz;
+    float xy = qx * qy, xz = qx * qz, yz = qy * qz;
+    float wx = qw * qx, wy = qw * qy, wz = qw * qz;
+
+    m[0] = (1.0f - 2.0f * (yy + zz)) * sx;
+    m[1] = 2.0f * (xy + wz) * sx;
+    m[2] = 2.0f * (xz - wy) * sx;
+    m[3] = 0.0f;
+    m[4] = 2.0f * (xy - wz) * sy;
+    m[5] = (1.0f - 2.0f * (xx + zz)) * sy;
+    m[6] = 2.0f * (yz + wx) * sy;
+    m[7] = 0.0f;
+    m[8] = 2.0f * (xz + wy) * sz;
+    m[9] = 2.0f * (yz - wx) * sz;
+    m[10] = (1.0f - 2.0f * (xx + yy)) * sz;
+    m[11] = 0.0f;
+    m[12] = tx;
+    m[13] = ty;
+    m[14] = tz;
+    m[15] = 1.0f;
+}
+
+void compose_transform(const float* trs, float* out) {
+    float len = std::sqrt(trs[3] * trs[3] + trs[4] * trs[4] + trs[5] * trs[5] + trs[6] * trs[6]);
+    if (len > 0.0f) {
+        float inv = 1.0f / len;
+        compose_trs(out, trs[0], trs[1], trs[2], trs[3] * inv, trs[4] * inv, trs[5] * inv, trs[6] * inv,
+                    trs[7], trs[8], trs[9]);
+    } else {
+        compose_trs(out, trs[0], trs[1], trs[2], 0.0f, 0.0f, 0.0f, 1.0f, trs[7], trs[8], trs[9]);
+    }
+}
+
+template <typename T>
+static void permute(std::vector<T>& values, const std::vector<uint32_t>& order) {
+    std::vector<T> sorted(order.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        sorted[i] = values[order[i]];
+    }
+    values.swap(sorted);
+}
+
+bool SceneGraph::alive(uint32_t node) const {
+    uint32_t slot = node & INDEX_MASK;
+    if (slot == 0 || slot > m_dense.size()) return false;
+    if (m_generations[slot - 1] != (node >> INDEX_BITS)) return false;
+    uint32_t index = m_dense[slot - 1];
+    return index != NO_INDEX && !m_dead[index];
+}
+
+uint32_t SceneGraph::dense_index(uint32_t node) const {
+    return m_dense[(node & INDEX_MASK) - 1];
+}
+
+void SceneGraph::mark_dirty(uint32_t index) {
+    if (m_dirty[index]) return;
+    m_dirty[index] = 1;
+    m_dirty_list.push_back(index);
+}
+
+uint32_t SceneGraph::create_node(uint32_t parent) {
+    if (parent != 0 && !alive(parent)) return 0;
+
+    uint32_t slot;
+    if (!m_free_slots.empty()) {
+        slot = m_free_slots.back();
+        m_free_slots.pop_back();
+    } else if (m_dense.size() < MAX_NODES) {
+        slot = static_cast<uint32_t>(m_dense.size());
+        m_dense.push_back(NO_INDEX);
+        m_generations.push_back(0);
+    } else {
+        return 0;
+    }
+    uint32_t handle = (static_cast<uint32_t>(m_generations[slot]) << INDEX_BITS) | (slot + 1);
+
+    uint32_t index = static_cast<uint32_t>(m_handle.size());
+    uint32_t parent_index = parent ? dense_index(parent) : NO_PARENT;
+    uint32_t depth = parent ? m_depth[parent_index] + 1 : 0;
+
+    // Appending keeps parents ahead of children. The order is only lost if
+    // the depth sort breaks or the parent's children stop being adjacent.
+    if (index > 0 && depth < m_depth.back()) m_order_dirty = true;
+    if (!m_order_dirty && parent) {
+        if (m_child_count[parent_index] == 0) {
+            m_first_child[parent_index] = index;
+        } else if (m_first_child[parent_index] + m_child_count[parent_index] != index) {
+            m_order_dirty = true;
+        }
+        m_child_count[parent_index]++;
+    }
+
+    m_dense[slot] = index;
+    m_handle.push_back(handle);
+    m_parent_handle.push_back(parent);
+    m_parent.push_back(parent_index);
+    m_depth.push_back(depth);
+    m_tx.push_back(0.0f);
+    m_ty.push_back(0.0f);
+    m_tz.push_back(0.0f);
+    m_rx.push_back(0.0f);
+    m_ry.push_back(0.0f);
+    m_rz.push_back(0.0f);
+    m_rw.push_back(1.0f);
+    m_sx.push_back(1.0f);
+    m_sy.push_back(1.0f);
+    m_sz.push_back(1.0f);
+    m_instance.push_back(NO_INSTANCE);
+    m_dirty.push_back(0);
+    m_dead.push_back(0);
+    m_first_child.push_back(0);
+    m_child_count.push_back(0);
+    mark_dirty(index);
+
+    Mat4 world;
+    memcpy(world.m, IDENTITY, sizeof(world.m));
+    m_world.push_back(world);
+    return handle;
+}
+
+void SceneGraph::destroy_node(uint32_t node) {
+    if (!alive(node)) return;
+
+    // Walk the subtree through the child ranges. Dead nodes keep their
+    // places until the next rebuild frees them.
+    if (m_order_dirty) rebuild_order();
+    m_stack.assign(1, dense_index(node));
+    while (!m_stack.empty()) {
+        uint32_t i = m_stack.back();
+        m_stack.pop_back();
+        m_dead[i] = 1;
+        for (uint32_t c = 0; c < m_child_count[i]; c++) m_stack.push_back(m_first_child[i] + c);
+    }
+    m_order_dirty = true;
+}
+
+bool SceneGraph::set_parent(uint32_t node, uint32_t parent) {
+    if (!alive(node) || (parent != 0 && !alive(parent))) return false;
+
+    for (uint32_t ancestor = parent; ancestor != 0; ancestor = m_parent_handle[dense_index(ancestor)]) {
+        if (ancestor == node) return false;
+    }
+
+    uint32_t index = dense_index(node);
+    m_parent_handle[index] = parent;
+    mark_dirty(index);
+    m_order_dirty = true;
+    return true;
+}
+
+bool SceneGraph::set_transform(uint32_t node, const float* translation, const float* rotation, const float* scale) {
+    if (!alive(node)) return false;
+    uint32_t i = dense_index(node);
+
+    if (translation) {
+        m_tx[i] = translation[0];
+        m_ty[i] = translation[1];
+        m_tz[i] = translation[2];
+    }
+    if (rotation) {
+        float len = std::sqrt(rotation[0] * rotation[0] + rotation[1] * rotation[1] +
+                              rotation[2] * rotation[2] + rotation[3] * rotation[3]);
+        float inv = len > 0.0f ? 1.0f / len : 0.0f;
+        m_rx[i] = rotation[0] * inv;
+        m_ry[i] = rotation[1] * inv;
+        m_rz[i] = rotation[2] * inv;
+        m_rw[i] = len > 0.0f ? rotation[3] * inv : 1.0f;
+    }
+    if (scale) {
+        m_sx[i] = scale[0];
+        m_sy[i] = scale[1];
+        m_sz[i] = scale[2];
+    }
+    mark_dirty(i);
+    return true;
+}
+
+bool SceneGraph::bind_instance(uint32_t node, uint32_t instance) {
+    if (!alive(node)) return false;
+    uint32_t i = dense_index(node);
+    m_instance[i] = instance;
+    mark_dirty(i);
+    return true;
+}
+
+bool SceneGraph::world_matrix(uint32_t node, float* out) const {
+    if (!alive(node)) return false;
+    memcpy(out, m_world[dense_index(node)].m, sizeof(Mat4::m));
+    return true;
+}
+
+// Drop dead nodes and put the rest in breadth-first order from the roots,
+// which sorts them by depth and keeps each node's children together
+void SceneGraph::rebuild_order() {
+    uint32_t count = static_cast<uint32_t>(m_handle.size());
+
+    // Children of each node in their current order, as offsets into one list
+    std::vector<uint32_t> offsets(count + 1, 0);
+    std::vector<uint32_t> parent(count, NO_PARENT);
+    for (uint32_t i = 0; i < count; i++) {
+        if (m_parent_handle[i] == 0) continue;
+        parent[i] = dense_index(m_parent_handle[i]);
+        offsets[parent[i] + 1]++;
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    std::vector<uint32_t> children(offsets[count]);
+    std::vector<uint32_t> filled(offsets.begin(), offsets.end() - 1);
+    for (uint32_t i = 0; i < count; i++) {
+        if (parent[i] != NO_PARENT) children[filled[parent[i]]++] = i;
+    }
+
+    std::vector<uint32_t> order;
+    order.reserve(count);
+    std::vector<uint32_t> depth(count, 0);
+    for (uint32_t i = 0; i < count; i++) {
+        if (parent[i] == NO_PARENT) order.push_back(i);
+    }
+    for (size_t k = 0; k < order.size(); k++) {
+        uint32_t i = order[k];
+        for (uint32_t c = offsets[i]; c < offsets[i + 1]; c++) {
+            uint32_t child = children[c];
+            depth[child] = depth[i] + 1;
+            if (m_dead[i]) m_dead[child] = 1;
+            order.push_back(child);
+        }
+    }
+    m_depth.swap(depth);
+
+    // Dead subtrees go as a whole, so the live nodes stay breadth-first
+    size_t kept = 0;
+    for (uint32_t i : order) {
+        if (m_dead[i]) {
+            uint32_t slot = (m_handle[i] & INDEX_MASK) - 1;
+            m_dense[slot] = NO_INDEX;
+            m_generations[slot]++;
+            m_free_slots.push_back(slot);
+        } else {
+            order[kept++] = i;
+        }
+    }
+    order.resize(kept);
+
+    permute(m_handle, order);
+    permute(m_parent_handle, order);
+    permute(m_depth, order);
+    permute(m_tx, order);
+    permute(m_ty, order);
+    permute(m_tz, order);
+    permute(m_rx, order);
+    permute(m_ry, order);
+    permute(m_rz, order);
+    permute(m_rw, order);
+    permute(m_sx, order);
+    permute(m_sy, order);
+    permute(m_sz, order);
+    permute(m_instance, order);
+    permute(m_dirty, order);
+    permute(m_dead, order);
+    permute(m_world, order);
+
+    uint32_t live = static_cast<uint32_t>(order.size());
+    m_parent.resize(live);
+    m_first_child.assign(live, 0);
+    m_child_count.assign(live, 0);
+    m_dirty_list.clear();
+    for (uint32_t i = 0; i < live; i++) {
+        m_dense[(m_handle[i] & INDEX_MASK) - 1] = i;
+    }
+    for (uint32_t i = 0; i < live; i++) {
+        uint32_t parent_handle = m_parent_handle[i];
+        m_parent[i] = parent_handle ? dense_index(parent_handle) : NO_PARENT;
+        if (m_parent[i] != NO_PARENT) {
+            if (m_child_count[m_parent[i]]++ == 0) m_first_child[m_parent[i]] = i;
+        }
+        if (m_dirty[i]) m_dirty_list.push_back(i);
+    }
+    m_order_dirty = false;
+}
+
+bool SceneGraph::update(float* instances, size_t stride, uint32_t instance_count, uint32_t* first, uint32_t* end) {
+    if (m_order_dirty) rebuild_order();
+
+    uint32_t lo = NO_INSTANCE;
+    uint32_t hi = 0;
+    auto write_instance = [&](uint32_t i) {
+        uint32_t instance = m_instance[i];
+        if (instance >= instance_count || !instances) return;
+        memcpy(instances + instance * stride, m_world[i].m, sizeof(Mat4::m));
+        lo = std::min(lo, instance);
+        hi = std::max(hi, instance + 1);
+    };
+
+    // In dense order an ancestor comes before its descendants, so its walk
+    // covers any of them that are dirty too and they are skipped after
+    std::sort(m_dirty_list.begin(), m_dirty_list.end());
+    for (uint32_t root : m_dirty_list) {
+        if (!m_dirty[root]) continue;
+        m_stack.assign(1, root);
+        while (!m_stack.empty()) {
+            uint32_t i = m_stack.back();
+            m_stack.pop_back();
+            m_dirty[i] = 0;
+
+            float local[16];
+            compose_trs(local, m_tx[i], m_ty[i], m_tz[i], m_rx[i], m_ry[i], m_rz[i], m_rw[i],
+                        m_sx[i], m_sy[i], m_sz[i]);
+            uint32_t parent = m_parent[i];
+            if (parent == NO_PARENT) {
+                memcpy(m_world[i].m, local, sizeof(local));
+            } else {
+                mat4_multiply(m_world[i].m, m_world[parent].m, local);
+            }
+            if (!m_rewrite_all) write_instance(i);
+            for (uint32_t c = 0; c < m_child_count[i]; c++) m_stack.push_back(m_first_child[i] + c);
+        }
+    }
+    m_dirty_list.clear();
+
+    if (m_rewrite_all) {
+        for (uint32_t i = 0; i < m_handle.size(); i++) write_instance(i);
+        m_rewrite_all = false;
+    }
+
+    if (lo == NO_INSTANCE) return false;
+    *first = lo;
+    *end = hi;
+    return true;
+}
+
+} // namespace hxo
@@ -0,0 +1,104 @@
+#ifndef HXO_SCENE_H
+#define HXO_SCENE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace hxo {
+
+// out = a * b for column-major 4x4 matrices. out may not alias a or b.
+void mat4_multiply(float* out, const float* a, const float* b);
+
+// Column-major T * R * S from translation xyz, rotation quaternion xyzw and
+// scale xyz packed in 10 floats. The quaternion is normalized here.
+void compose_transform(const float* trs, float* out);
+
+// Transform hierarchy with local TRS in structure-of-arrays form. Nodes are
+// kept in breadth-first order, so sorted by depth with every parent ahead of
+// its children and each node's children next to each other. An update walks
+// only the subtrees of nodes whose local transform or ancestry changed since
+// the last one. Handles are 24-bit index + 8-bit generation like entity
+// handles, so a stale handle never names a newer node; 0 is invalid.
+class SceneGraph {
+public:
+    static constexpr uint32_t NO_INSTANCE = 0xFFFFFFFFu;
+
+    // parent 0 makes a root node. Returns 0 if parent is not a live node.
+    uint32_t create_node(uint32_t parent);
+
+    // Destroys the node and all of its descendants
+    void destroy_node(uint32_t node);
+
+    // Returns false if either handle is invalid or the move would make a cycle
+    bool set_parent(uint32_t node, uint32_t parent);
+
+    // translation xyz, rotation quaternion xyzw, scale xyz. NULL keeps a part.
+    bool set_transform(uint32_t node, const float* translation, const float* rotation, const float* scale);
+
+    // Write this node's world matrix into the model matrix of an instance on
+    // update. NO_INSTANCE unbinds.
+    bool bind_instance(uint32_t node, uint32_t instance);
+
+    // World matrix as of the last update (column-major)
+    bool world_matrix(uint32_t node, float* out) const;
+
+    // Force every bound node to be written on the next update, e.g. after the
+    // instance list was replaced
+    void rewrite_instances() { m_rewrite_all = true; }
+
+    // Recompose dirty subtrees and write world matrices of bound nodes to
+    // instances (stride floats apart, instance_count entries, each matrix at
+    // offset 0). Returns false if no instance was written; otherwise
+    // [*first, *end) covers every instance written.
+    bool update(float* instances, size_t stride, uint32_t instance_count, uint32_t* first, uint32_t* end);
+
+    uint32_t node_count() const { return static_cast<uint32_t>(m_handle.size()); }
+
+private:
+    static constexpr uint32_t NO_PARENT = 0xFFFFFFFFu;
+
+    struct alignas(16) Mat4 {
+        float m[16];
+    };
+
+    bool alive(uint32_t node) const;
+    uint32_t dense_index(uint32_t node) const;
+    void mark_dirty(uint32_t index);
+    void rebuild_order();
+
+    // Handle index -> dense index (NO_PARENT when free), generations by
+    // handle index, and the free handle indices
+    std::vector<uint32_t> m_dense;
+    std::vector<uint8_t> m_generations;
+    std::vector<uint32_t> m_free_slots;
+
+    // Dense arrays in depth order
+    std::vector<uint32_t> m_handle;
+    std::vector<uint32_t> m_parent_handle;  // 0 for roots
+    std::vector<uint32_t> m_parent;         // dense index of the parent, NO_PARENT for roots
+    std::vector<uint32_t> m_depth;
+    std::vector<float> m_tx, m_ty, m_tz;
+    std::vector<float> m_rx, m_ry, m_rz, m_rw;
+    std::vector<float> m_sx, m_sy, m_sz;
+    std::vector<uint32_t> m_instance;
+    std::vector<uint8_t> m_dirty;
+    std::vector<uint8_t> m_dead;
+    std::vector<Mat4> m_world;
+
+    // Children of dense index i are [m_first_child[i], + m_child_count[i]),
+    // valid while the order is not dirty
+    std::vector<uint32_t> m_first_child;
+    std::vector<uint32_t> m_child_count;
+
+    // Dense indices with m_dirty set, and scratch for subtree walks
+    std::vector<uint32_t> m_dirty_list;
+    std::vector<uint32_t> m_stack;
+
+    bool m_order_dirty = false;
+    bool m_rewrite_all = false;
+};
+
+} // namespace hxo
+
+#endif // HXO_SCENE_H
@@ -0,0 +1,203 @@
+#include "shadow.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace hxo {
+
+// Weight of logarithmic over even spacing in the split distances
+static constexpr float SPLIT_BLEND = 0.75f;
+// Cascade radii are rounded up to this step so float noise in the fitted
+// sphere does not move the matrix
+static constexpr float RADIUS_STEP = 1.0f / 16.0f;
+static constexpr float MIN_DISTANCE = 0.01f;
+
+void ShadowCascades::configure(uint32_t resolution, float distance, uint32_t far_interval) {
+    m_resolution = std::max(resolution, 1u);
+    m_distance = std::max(distance, MIN_DISTANCE);
+    m_far_interval = std::max(far_interval, 1u);
+    invalidate();
+}
+
+void ShadowCascades::set_direction(const float direction[3]) {
+    float length = std::sqrt(direction[0] * direction[0] + direction[1] * direction[1] +
+                             direction[2] * direction[2]);
+    if (!(length > 0.0f)) return;
+    float normalized[3] = {direction[0] / length, direction[1] / length, direction[2] / length};
+    if (memcmp(normalized, m_direction, sizeof(m_direction)) == 0) return;
+    memcpy(m_direction, normalized, sizeof(m_direction));
+    invalidate();
+}
+
+void ShadowCascades::invalidate() {
+    for (Cascade& cascade : m_cascades) {
+        cascade.valid = false;
+        cascade.static_dirty = true;
+        cascade.dirty = true;
+    }
+}
+
+void ShadowCascades::touch(const float center[3], float radius, bool is_static) {
+    for (uint32_t c = 0; c < CASCADES; c++) {
+        Cascade& cascade = m_cascades[c];
+        if (!cascade.valid || !overlaps(c, center, radius)) continue;
+        if (is_static) cascade.static_dirty = true;
+        cascade.dirty = true;
+    }
+}
+
+bool ShadowCascades::ready() const {
+    for (const Cascade& cascade : m_cascades) {
+        if (!cascade.valid) return false;
+    }
+    return true;
+}
+
+bool ShadowCascades::overlaps(uint32_t cascade, const float center[3], float radius) const {
+    const float* m = m_cascades[cascade].rendered;
+    for (int row = 0; row < 3; row++) {
+        float v = m[row] * center[0] + m[4 + row] * center[1] + m[8 + row] * center[2] + m[12 + row];
+        float margin = radius * std::sqrt(m[row] * m[row] + m[4 + row] * m[4 + row] + m[8 + row] * m[8 + row]);
+        // x and y span [-1, 1], depth [0, 1]
+        float low = row < 2 ? -1.0f : 0.0f;
+        if (v < low - margin || v > 1.0f + margin) return false;
+    }
+    return true;
+}
+
+bool ShadowCascades::update(const float* view, const float* proj, uint64_t frame, Update* updates) {
+    for (uint32_t c = 0; c < CASCADES; c++) updates[c] = {};
+    if (!fit(view, proj)) return false;
+
+    bool any = false;
+    for (uint32_t c = 0; c < CASCADES; c++) {
+        Cascade& cascade = m_cascades[c];
+        bool moved = !cascade.valid || memcmp(cascade.fitted, cascade.rendered, sizeof(cascade.fitted)) != 0;
+        if (!moved && !cascade.static_dirty && !cascade.dirty) continue;
+
+        // Far cascades take turns, one frame each out of every interval
+        bool due = !cascade.valid || c == 0 || frame % m_far_interval == c % m_far_interval;
+        if (!due) continue;
+
+        updates[c].static_layer = moved || cascade.static_dirty;
+        updates[c].composite = true;
+        memcpy(cascade.rendered, cascade.fitted, sizeof(cascade.rendered));
+        cascade.rendered_texel = cascade.fitted_texel;
+        cascade.valid = true;
+        cascade.static_dirty = false;
+        cascade.dirty = false;
+        any = true;
+    }
+    return any;
+}
+
+bool ShadowCascades::fit(const float* view, const float* proj) {
+    const float* p = proj;
+    if (p[0] == 0.0f || p[5] == 0.0f) return false;
+
+    // View z at NDC depth 0 and 1. Under a perspective projection the split
+    // distances grow from the plane nearer the eye; otherwise they are even.
+    auto view_z = [p](float depth) { return (p[14] - depth * p[15]) / (depth * p[11] - p[10]); };
+    float z0 = view_z(0.0f);
+    float z1 = view_z(1.0f);
+    float splits[CASCADES + 1];
+    if (p[11] != 0.0f) {
+        bool reversed = !(std::fabs(z0) <= std::fabs(z1));
+        float near_z = reversed ? z1 : z0;
+        float far_z = reversed ? z0 : z1;
+        float sign = near_z < 0.0f ? -1.0f : 1.0f;
+        float n = std::fabs(near_z);
+        float f = std::isfinite(far_z) ? std::min(std::fabs(far_z), m_distance) : m_distance;
+        if (!(n > 0.0f) || !(f > n)) return false;
+        for (uint32_t i = 0; i <= CASCADES; i++) {
+            float t = static_cast<float>(i) / CASCADES;
+            float log_split = n * std::pow(f / n, t);
+            float even_split = n + (f - n) * t;
+            splits[i] = sign * (SPLIT_BLEND * log_split + (1.0f - SPLIT_BLEND) * even_split);
+        }
+    } else {
+        float length = std::min(std::fabs(z1 - z0), m_distance);
+        float sign = z1 < z0 ? -1.0f : 1.0f;
+        if (!std::isfinite(z0) || !(length > 0.0f)) return false;
+        for (uint32_t i = 0; i <= CASCADES; i++) {
+            splits[i] = z0 + sign * length * static_cast<float>(i) / CASCADES;
+        }
+    }
+
+    // Light space axes: x and y across the map, z along the light
+    const float* f = m_direction;
+    float up[3] = {0.0f, 1.0f, 0.0f};
+    if (std::fabs(f[1]) > 0.99f) {
+        up[1] = 0.0f;
+        up[2] = 1.0f;
+    }
+    float x[3] = {up[1] * f[2] - up[2] * f[1], up[2] * f[0] - up[0] * f[2], up[0] * f[1] - up[1] * f[0]};
+    float x_length = std::sqrt(x[0] * x[0] + x[1] * x[1] + x[2] * x[2]);
+    for (float& v : x) v /= x_length;
+    float y[3] = {f[1] * x[2] - f[2] * x[1], f[2] * x[0] - f[0] * x[2], f[0] * x[1] - f[1] * x[0]};
+
+    for (uint32_t c = 0; c < CASCADES; c++) {
+        // Slice corners in world space. The view is rigid, so its inverse
+        // is R^T * (v - t).
+        float corners[8][3];
+        for (uint32_t i = 0; i < 8; i++) {
+            float ndc_x = (i & 1) ? 1.0f : -1.0f;
+            float ndc_y = (i & 2) ? 1.0f : -1.0f;
+            float z = splits[c + (i >> 2)];
+            float w = p[11] * z + p[15];
+            float v[3] = {(ndc_x * w - p[8] * z - p[12]) / p[0] - view[12],
+                          (ndc_y * w - p[9] * z - p[13]) / p[5] - view[13],
+                          z - view[14]};
+            for (int axis = 0; axis < 3; axis++) {
+                corners[i][axis] = view[axis * 4 + 0] * v[0] + view[axis * 4 + 1] * v[1] + view[axis * 4 + 2] * v[2];
+            }
+        }
+
+        // Bounding sphere of the slice. Its radius does not change as the
+        // camera turns, so neither does the texel size.
+        float center[3] = {};
+        for (const auto& corner : corners) {
+            for (int axis = 0; axis < 3; axis++) center[axis] += corner[axis] / 8.0f;
+        }
+        float radius = 0.0f;
+        for (const auto& corner : corners) {
+            float dx = corner[0] - center[0];
+            float dy = corner[1] - center[1];
+            float dz = corner[2] - center[2];
+            radius = std::max(radius, std::sqrt(dx * dx + dy * dy + dz * dz));
+        }
+        radius = std::ceil(radius / RADIUS_STEP) * RADIUS_STEP;
+        if (!std::isfinite(radius) || !(radius > 0.0f)) return false;
+
+        // Snap the center to whole texels in light space
+        float texel = 2.0f * radius / static_cast<float>(m_resolution);
+        auto snap = [texel](const float* axis, const float* point) {
+            float v = axis[0] * point[0] + axis[1] * point[1] + axis[2] * point[2];
+            return std::floor(v / texel) * texel;
+        };
+        float cx = snap(x, center);
+        float cy = snap(y, center);
+        float cz = snap(f, center);
+
+        // Depth covers the sphere plus casters up to the shadow distance
+        // toward the light
+        float near_d = cz - radius - m_distance;
+        float range = 2.0f * radius + m_distance;
+
+        float* m = m_cascades[c].fitted;
+        memset(m, 0, sizeof(m_cascades[c].fitted));
+        for (int axis = 0; axis < 3; axis++) {
+            m[axis * 4 + 0] = x[axis] / radius;
+            m[axis * 4 + 1] = y[axis] / radius;
+            m[axis * 4 + 2] = f[axis] / range;
+        }
+        m[12] = -cx / radius;
+        m[13] = -cy / radius;
+        m[14] = -near_d / range;
+        m[15] = 1.0f;
+        m_cascades[c].fitted_texel = texel;
+    }
+    return true;
+}
+
+} // namespace hxo
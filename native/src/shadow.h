@@ -0,0 +1,74 @@
+#ifndef HXO_SHADOW_H
+#define HXO_SHADOW_H
+
+#include <cstdint>
+
+namespace hxo {
+
+// Fits and schedules cascaded shadow maps for a directional light. Each
+// cascade covers a slice of the view frustum with an orthographic map whose
+// position is snapped to whole texels, so its matrix only changes once the
+// camera has moved a texel. Each cascade keeps two layers: static casters
+// alone, re-rendered only when the matrix moves or a static caster in it
+// changes, and the composite sampled by shading, which starts as a copy of
+// the static layer and has the dynamic casters drawn over it. A cascade
+// whose contents went stale re-renders at once if it is the first, and
+// otherwise on its turn every far_interval frames, keeping the matrix it was
+// last rendered with until then.
+class ShadowCascades {
+public:
+    static constexpr uint32_t CASCADES = 4;
+
+    // What update() asks for in one cascade this frame
+    struct Update {
+        bool static_layer = false;  // clear the cache and draw static casters
+        bool composite = false;     // copy the cache and draw dynamic casters over it
+    };
+
+    // Clamped to a resolution of at least 1, a positive distance and an
+    // interval of at least 1. Invalidates every cascade.
+    void configure(uint32_t resolution, float distance, uint32_t far_interval);
+    // Direction the light travels; invalidates every cascade when it changes
+    void set_direction(const float direction[3]);
+    // Forget every rendered layer, e.g. after the maps were recreated
+    void invalidate();
+    // A caster with this bounding sphere was added, moved or removed
+    void touch(const float center[3], float radius, bool is_static);
+
+    // Fit the cascades to the camera (column-major view and projection) and
+    // pick this frame's renders. Returns whether any cascade renders.
+    bool update(const float* view, const float* proj, uint64_t frame, Update* updates);
+
+    // Whether a sphere reaches into a cascade's rendered volume
+    bool overlaps(uint32_t cascade, const float center[3], float radius) const;
+    // World to shadow clip space, as the cascade was last rendered
+    const float* view_proj(uint32_t cascade) const { return m_cascades[cascade].rendered; }
+    // World-space size of one texel of the cascade
+    float texel_size(uint32_t cascade) const { return m_cascades[cascade].rendered_texel; }
+    uint32_t resolution() const { return m_resolution; }
+    // Whether every cascade has a rendered layer to sample
+    bool ready() const;
+
+private:
+    struct Cascade {
+        float fitted[16] = {};
+        float rendered[16] = {};
+        float fitted_texel = 0.0f;
+        float rendered_texel = 0.0f;
+        bool valid = false;
+        bool static_dirty = true;
+        bool dirty = true;
+    };
+
+    bool fit(const float* view, const float* proj);
+
+    uint32_t m_resolution = 2048;
+    float m_distance = 100.0f;
+    uint32_t m_far_interval = 4;
+    float m_direction[3] = {0.0f, -1.0f, 0.0f};
+    Cascade m_cascades[CASCADES];
+};
+
+} // namespace hxo
+
+#endif // HXO_SHADOW_H
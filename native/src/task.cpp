@@ -0,0 +1,76 @@
+#include "task.h"
+
+#include <cstdio>
+
+namespace hxo {
+
+void TaskScheduler::schedule(std::coroutine_handle<> handle) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_ready.push_back(handle);
+}
+
+void TaskScheduler::wait_until(std::coroutine_handle<> handle, Condition ready) {
+    m_waiters.push_back({handle, std::move(ready)});
+}
+
+void TaskScheduler::run_job(std::coroutine_handle<> handle, std::function<void()> fn) {
+    // The handle is only queued, never resumed on the worker, so an inline
+    // run (no workers) cannot re-enter the suspending coroutine
+    job_system().submit(m_jobs, [this, handle, fn = std::move(fn)] {
+        fn();
+        schedule(handle);
+    });
+}
+
+void TaskScheduler::poll() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_resuming.swap(m_ready);
+    }
+    for (std::coroutine_handle<> handle : m_resuming) handle.resume();
+    m_resuming.clear();
+
+    // Resumed tasks may register new waiters, so check a snapshot and put
+    // the ones still waiting back
+    m_checking.swap(m_waiters);
+    for (Waiter& waiter : m_checking) {
+        if (waiter.ready()) {
+            waiter.handle.resume();
+        } else {
+            m_waiters.push_back(std::move(waiter));
+        }
+    }
+    m_checking.clear();
+}
+
+void TaskScheduler::clear() {
+    job_system().wait(m_jobs);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_ready.clear();
+    m_waiters.clear();
+}
+
+TaskScheduler& task_scheduler() {
+    static TaskScheduler scheduler;
+    return scheduler;
+}
+
+std::optional<std::vector<uint8_t>> read_file_sync(const std::string& path) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) return std::nullopt;
+
+    std::optional<std::vector<uint8_t>> result;
+    if (std::fseek(file, 0, SEEK_END) == 0) {
+        long size = std::ftell(file);
+        if (size >= 0 && std::fseek(file, 0, SEEK_SET) == 0) {
+            std::vector<uint8_t> bytes(static_cast<size_t>(size));
+            if (std::fread(bytes.data(), 1, bytes.size(), file) == bytes.size()) {
+                result = std::move(bytes);
+            }
+        }
+    }
+    std::fclose(file);
+    return result;
+}
+
+} // namespace hxo
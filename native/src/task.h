@@ -0,0 +1,239 @@
+#ifndef HXO_TASK_H
+#define HXO_TASK_H
+
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "jobs.h"
+
+namespace hxo {
+
+template <typename T = void>
+class Task;
+
+namespace detail {
+
+struct PromiseBase {
+    // Resumed when this task finishes; null for root tasks
+    std::coroutine_handle<> continuation;
+
+    struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            std::coroutine_handle<> next = handle.promise().continuation;
+            return next ? next : std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() const noexcept { std::terminate(); }
+};
+
+template <typename T>
+struct Promise : PromiseBase {
+    std::optional<T> value;
+
+    Task<T> get_return_object();
+    void return_value(T result) { value.emplace(std::move(result)); }
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+    Task<void> get_return_object();
+    void return_void() const noexcept {}
+};
+
+} // namespace detail
+
+// Lazily started coroutine. Awaiting a task starts it and resumes the awaiter
+// when it finishes; a root task is started once with start() and owned by
+// whoever polls done(). Tasks only ever resume on the thread that pumps the
+// TaskScheduler, so their bodies may touch engine state freely.
+template <typename T>
+class Task {
+public:
+    using promise_type = detail::Promise<T>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    Task() = default;
+    explicit Task(Handle handle) : m_handle(handle) {}
+    Task(Task&& other) noexcept : m_handle(std::exchange(other.m_handle, {})) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (m_handle) m_handle.destroy();
+            m_handle = std::exchange(other.m_handle, {});
+        }
+        return *this;
+    }
+    ~Task() {
+        if (m_handle) m_handle.destroy();
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    bool valid() const { return static_cast<bool>(m_handle); }
+    bool done() const { return m_handle && m_handle.done(); }
+
+    // Run a root task up to its first suspension
+    void start() { m_handle.resume(); }
+
+    // Result of a finished task
+    template <typename U = T>
+    std::enable_if_t<!std::is_void_v<U>, U&> result() { return *m_handle.promise().value; }
+
+    auto operator co_await() && noexcept {
+        struct Awaiter {
+            Handle handle;
+
+            bool await_ready() const noexcept { return false; }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                handle.promise().continuation = awaiting;
+                return handle;
+            }
+
+            T await_resume() {
+                if constexpr (!std::is_void_v<T>) return std::move(*handle.promise().value);
+            }
+        };
+        return Awaiter{m_handle};
+    }
+
+private:
+    Handle m_handle;
+};
+
+namespace detail {
+
+template <typename T>
+Task<T> Promise<T>::get_return_object() {
+    return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline Task<void> Promise<void>::get_return_object() {
+    return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+} // namespace detail
+
+// Resumes suspended tasks on the thread that calls poll() (the frame loop).
+// Tasks suspend either on a condition that is re-checked every poll, such as
+// a timeline semaphore value, or on a job whose completion queues them.
+class TaskScheduler {
+public:
+    using Condition = std::function<bool()>;
+
+    // Queue handle to resume on the next poll. Safe from any thread.
+    void schedule(std::coroutine_handle<> handle);
+
+    // Resume handle on the first poll where ready() holds. Poll thread only.
+    void wait_until(std::coroutine_handle<> handle, Condition ready);
+
+    // Run fn on the job system, then queue handle. Poll thread only.
+    void run_job(std::coroutine_handle<> handle, std::function<void()> fn);
+
+    // Resume everything that became ready since the last poll
+    void poll();
+
+    // Wait for outstanding jobs and forget every suspended handle. The caller
+    // destroys the task frames afterwards.
+    void clear();
+
+private:
+    std::mutex m_mutex;
+    std::vector<std::coroutine_handle<>> m_ready;
+    std::vector<std::coroutine_handle<>> m_resuming;
+
+    struct Waiter {
+        std::coroutine_handle<> handle;
+        Condition ready;
+    };
+    std::vector<Waiter> m_waiters;
+    std::vector<Waiter> m_checking;
+
+    JobCounter m_jobs;
+};
+
+// Shared scheduler pumped by the engine's frame loop
+TaskScheduler& task_scheduler();
+
+// co_await wait_until(fn): suspend until fn() returns true on a poll
+class ConditionAwaiter {
+public:
+    explicit ConditionAwaiter(TaskScheduler::Condition ready) : m_ready(std::move(ready)) {}
+
+    bool await_ready() const { return m_ready(); }
+    void await_suspend(std::coroutine_handle<> handle) {
+        task_scheduler().wait_until(handle, std::move(m_ready));
+    }
+    void await_resume() const noexcept {}
+
+private:
+    TaskScheduler::Condition m_ready;
+};
+
+inline ConditionAwaiter wait_until(TaskScheduler::Condition ready) {
+    return ConditionAwaiter(std::move(ready));
+}
+
+// co_await offload(fn): run fn on a worker and resume with its result back on
+// the poll thread
+template <typename Fn>
+class OffloadAwaiter {
+public:
+    using Result = std::invoke_result_t<Fn&>;
+
+    explicit OffloadAwaiter(Fn fn) : m_fn(std::move(fn)) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        task_scheduler().run_job(handle, [this] {
+            if constexpr (std::is_void_v<Result>) {
+                m_fn();
+            } else {
+                m_result.emplace(m_fn());
+            }
+        });
+    }
+
+    Result await_resume() {
+        if constexpr (!std::is_void_v<Result>) return std::move(*m_result);
+    }
+
+private:
+    Fn m_fn;
+    std::conditional_t<std::is_void_v<Result>, bool, std::optional<Result>> m_result{};
+};
+
+template <typename Fn>
+OffloadAwaiter<Fn> offload(Fn fn) {
+    return OffloadAwaiter<Fn>(std::move(fn));
+}
+
+// Whole file contents, or nothing if it cannot be read. Blocking; use
+// read_file() from a task.
+std::optional<std::vector<uint8_t>> read_file_sync(const std::string& path);
+
+// co_await read_file(path): read on a worker without blocking the poll thread
+inline auto read_file(std::string path) {
+    return offload([path = std::move(path)] { return read_file_sync(path); });
+}
+
+} // namespace hxo
+
+#endif // HXO_TASK_H
@@ -0,0 +1,24 @@
+#include "vk_dispatch.h"
+
+namespace hxo {
+
+bool load_device_dispatch(VkDevice device, DeviceDispatch& table) {
+    bool complete = true;
+
+#define HXO_LOAD_REQUIRED(name)                                                   \
+    table.name = reinterpret_cast<PFN_##name>(vkGetDeviceProcAddr(device, #name)); \
+    complete = complete && table.name != nullptr;
+#define HXO_LOAD_OPTIONAL(name) \
+    table.name = reinterpret_cast<PFN_##name>(vkGetDeviceProcAddr(device, #name));
+
+    HXO_DEVICE_FUNCTIONS(HXO_LOAD_REQUIRED)
+    HXO_DEVICE_FUNCTIONS_1_2(HXO_LOAD_OPTIONAL)
+    HXO_DEVICE_FUNCTIONS_KHR(HXO_LOAD_OPTIONAL)
+
+#undef HXO_LOAD_REQUIRED
+#undef HXO_LOAD_OPTIONAL
+
+    return complete;
+}
+
+} // namespace hxo
@@ -0,0 +1,71 @@
+#ifndef HXO_VK_DISPATCH_H
+#define HXO_VK_DISPATCH_H
+
+#include <vulkan/vulkan.h>
+
+namespace hxo {
+
+// Device-level entry points used every frame. Calls through the loader's
+// exported vk* symbols first jump through a trampoline that looks up the
+// device's dispatch table; pointers from vkGetDeviceProcAddr go straight to
+// the driver (or the first enabled layer).
+#define HXO_DEVICE_FUNCTIONS(X)        \
+    X(vkAcquireNextImageKHR)           \
+    X(vkQueuePresentKHR)               \
+    X(vkQueueSubmit)                   \
+    X(vkWaitForFences)                 \
+    X(vkResetFences)                   \
+    X(vkGetFenceStatus)                \
+    X(vkResetCommandBuffer)            \
+    X(vkResetCommandPool)              \
+    X(vkAllocateCommandBuffers)        \
+    X(vkBeginCommandBuffer)            \
+    X(vkEndCommandBuffer)              \
+    X(vkCmdBeginRenderPass)            \
+    X(vkCmdNextSubpass)                \
+    X(vkCmdEndRenderPass)              \
+    X(vkCmdExecuteCommands)            \
+    X(vkCmdBindPipeline)               \
+    X(vkCmdBindDescriptorSets)         \
+    X(vkCmdBindIndexBuffer)            \
+    X(vkCmdPushConstants)              \
+    X(vkCmdSetViewport)                \
+    X(vkCmdSetScissor)                 \
+    X(vkCmdDraw)                       \
+    X(vkCmdDrawIndexed)                \
+    X(vkCmdDrawIndexedIndirect)        \
+    X(vkCmdDispatch)                   \
+    X(vkCmdCopyBuffer)                 \
+    X(vkCmdFillBuffer)                 \
+    X(vkCmdBlitImage)                  \
+    X(vkCmdCopyImage)                  \
+    X(vkCmdPipelineBarrier)            \
+    X(vkCmdResetQueryPool)             \
+    X(vkCmdWriteTimestamp)             \
+    X(vkGetQueryPoolResults)
+
+// Vulkan 1.2 entry points, null on older devices
+#define HXO_DEVICE_FUNCTIONS_1_2(X)    \
+    X(vkCmdDrawIndexedIndirectCount)   \
+    X(vkGetSemaphoreCounterValue)
+
+// Extension entry points, null unless the extension was enabled
+#define HXO_DEVICE_FUNCTIONS_KHR(X)    \
+    X(vkCmdBeginRenderingKHR)          \
+    X(vkCmdEndRenderingKHR)            \
+    X(vkCmdPipelineBarrier2KHR)
+
+struct DeviceDispatch {
+#define HXO_DECLARE_FUNCTION(name) PFN_##name name = nullptr;
+    HXO_DEVICE_FUNCTIONS(HXO_DECLARE_FUNCTION)
+    HXO_DEVICE_FUNCTIONS_1_2(HXO_DECLARE_FUNCTION)
+    HXO_DEVICE_FUNCTIONS_KHR(HXO_DECLARE_FUNCTION)
+#undef HXO_DECLARE_FUNCTION
+};
+
+// Fill table for device. Returns false if a required entry point is missing.
+bool load_device_dispatch(VkDevice device, DeviceDispatch& table);
+
+} // namespace hxo
+
+#endif // HXO_VK_DISPATCH_H
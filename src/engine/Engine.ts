@@ -1,5 +1,11 @@
-import { Context, Effect, Layer } from "effect";
+import { Context, Duration, Effect, Layer, Schedule } from "effect";
 import { Bridge } from "../ffi/Bridge";
+import {
+  INVALID_COMPONENT,
+  TaskStatus,
+  type CullMode,
+  type JobKind,
+} from "../ffi/types";
 
 export class EngineError extends Error {
   readonly _tag = "EngineError";
@@ -15,6 +21,8 @@ export interface EngineService {
     height: number
   ) => Effect.Effect<void, EngineError>;
   readonly shutdown: () => Effect.Effect<void>;
+  readonly setPreferredDevice: (device: string) => Effect.Effect<void>;
+  readonly deviceReport: () => Effect.Effect<string>;
   readonly pollEvents: () => Effect.Effect<boolean>;
   readonly getTicks: () => Effect.Effect<bigint>;
   readonly renderFrame: (
@@ -23,10 +31,156 @@ export interface EngineService {
     b: number,
     a: number
   ) => Effect.Effect<void, EngineError>;
+  readonly createTexture: (
+    pixels: ArrayBuffer | ArrayBufferView,
+    width: number,
+    height: number
+  ) => Effect.Effect<number, EngineError>;
+  readonly destroyTexture: (handle: number) => Effect.Effect<void>;
+  readonly setCamera: (
+    view: Float32Array,
+    proj: Float32Array
+  ) => Effect.Effect<void>;
+  readonly setInstances: (
+    instances: ArrayBufferView,
+    count: number
+  ) => Effect.Effect<void>;
+  readonly setCullMode: (mode: CullMode) => Effect.Effect<void, EngineError>;
+  readonly setCullDistance: (distance: number) => Effect.Effect<void>;
+  readonly setLights: (
+    lights: ArrayBufferView,
+    count: number
+  ) => Effect.Effect<void>;
+  readonly setAmbientLight: (
+    r: number,
+    g: number,
+    b: number
+  ) => Effect.Effect<void>;
+  readonly setDirectionalLight: (
+    direction: readonly [number, number, number],
+    color: readonly [number, number, number]
+  ) => Effect.Effect<void>;
+  readonly setShadows: (
+    resolution: number,
+    distance: number,
+    farInterval: number
+  ) => Effect.Effect<void>;
+  readonly setOit: (enabled: boolean) => Effect.Effect<void, EngineError>;
+  readonly setDepthPrepass: (enabled: boolean) => Effect.Effect<void>;
+  readonly setMsaaSamples: (
+    samples: number
+  ) => Effect.Effect<number, EngineError>;
+  readonly setDynamicResolution: (
+    minScale: number,
+    maxScale: number,
+    targetMs: number
+  ) => Effect.Effect<void, EngineError>;
+  readonly setTemporalUpscaling: (
+    scale: number
+  ) => Effect.Effect<void, EngineError>;
+  readonly setPostEffects: (
+    effects: number
+  ) => Effect.Effect<void, EngineError>;
+  readonly setPostParams: (
+    exposure: number,
+    contrast: number,
+    saturation: number,
+    vignette: number
+  ) => Effect.Effect<void>;
+  readonly renderScale: () => Effect.Effect<number>;
+  readonly gpuFrameTime: () => Effect.Effect<number>;
+  readonly createNode: (parent: number) => Effect.Effect<number, EngineError>;
+  readonly destroyNode: (node: number) => Effect.Effect<void>;
+  readonly setParent: (
+    node: number,
+    parent: number
+  ) => Effect.Effect<void, EngineError>;
+  readonly setNodeTransforms: (
+    nodes: Uint32Array,
+    transforms: Float32Array
+  ) => Effect.Effect<void>;
+  readonly bindNodeInstance: (
+    node: number,
+    instance: number
+  ) => Effect.Effect<void, EngineError>;
+  readonly registerComponent: (
+    size: number
+  ) => Effect.Effect<number, EngineError>;
+  readonly createEntities: (
+    mask: bigint,
+    count: number
+  ) => Effect.Effect<Uint32Array, EngineError>;
+  readonly destroyEntities: (entities: Uint32Array) => Effect.Effect<void>;
+  readonly addComponents: (
+    entities: Uint32Array,
+    mask: bigint
+  ) => Effect.Effect<void>;
+  readonly removeComponents: (
+    entities: Uint32Array,
+    mask: bigint
+  ) => Effect.Effect<void>;
+  readonly flushEntities: () => Effect.Effect<void>;
+  readonly queryChunks: (mask: bigint) => Effect.Effect<Uint32Array>;
+  readonly markChunkDirty: (chunk: number) => Effect.Effect<void>;
+  readonly runJob: (
+    kind: JobKind,
+    a: Float32Array,
+    b: Float32Array | null,
+    out: Float32Array
+  ) => Effect.Effect<void, EngineError>;
+  readonly readFile: (path: string) => Effect.Effect<Uint8Array, EngineError>;
+  readonly loadTexture: (
+    path: string,
+    width: number,
+    height: number
+  ) => Effect.Effect<number, EngineError>;
 }
 
 export const EngineService = Context.GenericTag<EngineService>("EngineService");
 
+// Starts a native task and resolves once it finishes, pumping the task
+// scheduler while it waits so loads progress even when no frames are
+// rendered. Only the wait can be interrupted, which releases the handle and
+// leaves the native side to drop whatever the task produces; the result is
+// taken and the handle released in one step, so it is never lost in between.
+const runTask = <A>(
+  start: () => number,
+  message: string,
+  result: (task: number) => A
+): Effect.Effect<A, EngineError> =>
+  Effect.uninterruptibleMask((restore) =>
+    Effect.sync(start).pipe(
+      Effect.flatMap((task) =>
+        task === 0
+          ? Effect.fail(new EngineError(message, 0))
+          : restore(
+              Effect.repeat(
+                Effect.sync(() => {
+                  Bridge.pollTasks();
+                  return Bridge.taskStatus(task);
+                }),
+                {
+                  until: (status) => status !== TaskStatus.Pending,
+                  schedule: Schedule.spaced(Duration.millis(1)),
+                }
+              )
+            ).pipe(
+              Effect.onInterrupt(() => Effect.sync(() => Bridge.releaseTask(task))),
+              Effect.flatMap((status) =>
+                Effect.suspend(() => {
+                  const outcome =
+                    status === TaskStatus.Done
+                      ? Effect.succeed(result(task))
+                      : Effect.fail(new EngineError(message, status));
+                  Bridge.releaseTask(task);
+                  return outcome;
+                })
+              )
+            )
+      )
+    )
+  );
+
 export const EngineServiceLive = Layer.succeed(
   EngineService,
   EngineService.of({
@@ -41,6 +195,11 @@ export const EngineServiceLive = Layer.succeed(
 
     shutdown: () => Effect.sync(() => Bridge.shutdown()),
 
+    setPreferredDevice: (device) =>
+      Effect.sync(() => Bridge.setPreferredDevice(device)),
+
+    deviceReport: () => Effect.sync(() => Bridge.deviceReport()),
+
     pollEvents: () => Effect.sync(() => Bridge.pollEvents()),
 
     getTicks: () => Effect.sync(() => Bridge.getTicks()),
@@ -53,5 +212,208 @@ export const EngineServiceLive = Layer.succeed(
             : Effect.fail(new EngineError("Render frame failed", result))
         )
       ),
+
+    createTexture: (pixels, width, height) =>
+      Effect.sync(() => Bridge.createTexture(pixels, width, height)).pipe(
+        Effect.flatMap((handle) =>
+          handle !== 0
+            ? Effect.succeed(handle)
+            : Effect.fail(new EngineError("Failed to create texture", 0))
+        )
+      ),
+
+    destroyTexture: (handle) => Effect.sync(() => Bridge.destroyTexture(handle)),
+
+    setCamera: (view, proj) => Effect.sync(() => Bridge.setCamera(view, proj)),
+
+    setInstances: (instances, count) =>
+      Effect.sync(() => Bridge.setInstances(instances, count)),
+
+    setCullMode: (mode) =>
+      Effect.sync(() => Bridge.setCullMode(mode)).pipe(
+        Effect.flatMap((result) =>
+          result === 0
+            ? Effect.void
+            : Effect.fail(new EngineError("Unsupported cull mode", result))
+        )
+      ),
+
+    setCullDistance: (distance) =>
+      Effect.sync(() => Bridge.setCullDistance(distance)),
+
+    setLights: (lights, count) =>
+      Effect.sync(() => Bridge.setLights(lights, count)),
+
+    setAmbientLight: (r, g, b) =>
+      Effect.sync(() => Bridge.setAmbientLight(r, g, b)),
+
+    setDirectionalLight: (direction, color) =>
+      Effect.sync(() => Bridge.setDirectionalLight(direction, color)),
+
+    setShadows: (resolution, distance, farInterval) =>
+      Effect.sync(() => Bridge.setShadows(resolution, distance, farInterval)),
+
+    setOit: (enabled) =>
+      Effect.sync(() => Bridge.setOit(enabled)).pipe(
+        Effect.flatMap((result) =>
+          result === 0
+            ? Effect.void
+            : Effect.fail(
+                new EngineError("Order-independent transparency unavailable", result)
+              )
+        )
+      ),
+
+    setDepthPrepass: (enabled) =>
+      Effect.sync(() => Bridge.setDepthPrepass(enabled)),
+
+    setMsaaSamples: (samples) =>
+      Effect.sync(() => Bridge.setMsaaSamples(samples)).pipe(
+        Effect.flatMap((applied) =>
+          applied !== 0
+            ? Effect.succeed(applied)
+            : Effect.fail(new EngineError("Failed to apply MSAA", 0))
+        )
+      ),
+
+    setDynamicResolution: (minScale, maxScale, targetMs) =>
+      Effect.sync(() =>
+        Bridge.setDynamicResolution(minScale, maxScale, targetMs)
+      ).pipe(
+        Effect.flatMap((result) =>
+          result === 0
+            ? Effect.void
+            : Effect.fail(
+                new EngineError("Dynamic resolution unavailable", result)
+              )
+        )
+      ),
+
+    setTemporalUpscaling: (scale) =>
+      Effect.sync(() => Bridge.setTemporalUpscaling(scale)).pipe(
+        Effect.flatMap((result) =>
+          result === 0
+            ? Effect.void
+            : Effect.fail(
+                new EngineError("Temporal upscaling unavailable", result)
+              )
+        )
+      ),
+
+    setPostEffects: (effects) =>
+      Effect.sync(() => Bridge.setPostEffects(effects)).pipe(
+        Effect.flatMap((result) =>
+          result === 0
+            ? Effect.void
+            : Effect.fail(
+                new EngineError("Post-processing unavailable", result)
+              )
+        )
+      ),
+
+    setPostParams: (exposure, contrast, saturation, vignette) =>
+      Effect.sync(() =>
+        Bridge.setPostParams(exposure, contrast, saturation, vignette)
+      ),
+
+    renderScale: () => Effect.sync(() => Bridge.renderScale()),
+
+    gpuFrameTime: () => Effect.sync(() => Bridge.gpuFrameTime()),
+
+    createNode: (parent) =>
+      Effect.sync(() => Bridge.createNode(parent)).pipe(
+        Effect.flatMap((node) =>
+          node !== 0
+            ? Effect.succeed(node)
+            : Effect.fail(new EngineError("Failed to create scene node", 0))
+        )
+      ),
+
+    destroyNode: (node) => Effect.sync(() => Bridge.destroyNode(node)),
+
+    setParent: (node, parent) =>
+      Effect.sync(() => Bridge.setParent(node, parent)).pipe(
+        Effect.flatMap((ok) =>
+          ok
+            ? Effect.void
+            : Effect.fail(new EngineError("Invalid scene node parent", 0))
+        )
+      ),
+
+    setNodeTransforms: (nodes, transforms) =>
+      Effect.sync(() => Bridge.setNodeTransforms(nodes, transforms)),
+
+    bindNodeInstance: (node, instance) =>
+      Effect.sync(() => Bridge.bindNodeInstance(node, instance)).pipe(
+        Effect.flatMap((ok) =>
+          ok
+            ? Effect.void
+            : Effect.fail(new EngineError("Invalid scene node", 0))
+        )
+      ),
+
+    registerComponent: (size) =>
+      Effect.sync(() => Bridge.registerComponent(size)).pipe(
+        Effect.flatMap((id) =>
+          id !== INVALID_COMPONENT
+            ? Effect.succeed(id)
+            : Effect.fail(new EngineError("Failed to register component", 0))
+        )
+      ),
+
+    createEntities: (mask, count) =>
+      Effect.sync(() => Bridge.createEntities(mask, count)).pipe(
+        Effect.flatMap((entities) =>
+          entities.length === count
+            ? Effect.succeed(entities)
+            : Effect.fail(
+                new EngineError("Failed to create entities", entities.length)
+              )
+        )
+      ),
+
+    destroyEntities: (entities) =>
+      Effect.sync(() => Bridge.destroyEntities(entities)),
+
+    addComponents: (entities, mask) =>
+      Effect.sync(() => Bridge.addComponents(entities, mask)),
+
+    removeComponents: (entities, mask) =>
+      Effect.sync(() => Bridge.removeComponents(entities, mask)),
+
+    flushEntities: () => Effect.sync(() => Bridge.flushEntities()),
+
+    queryChunks: (mask) => Effect.sync(() => Bridge.queryChunks(mask)),
+
+    markChunkDirty: (chunk) => Effect.sync(() => Bridge.markChunkDirty(chunk)),
+
+    // Runs on native worker threads; the fiber polls instead of blocking Bun
+    runJob: (kind, a, b, out) =>
+      Effect.sync(() => Bridge.submitJob(kind, a, b, out)).pipe(
+        Effect.flatMap((job) =>
+          job !== 0
+            ? Effect.repeat(Effect.sync(() => Bridge.jobDone(job)), {
+                until: (done) => done,
+                schedule: Schedule.spaced(Duration.millis(1)),
+              }).pipe(Effect.asVoid)
+            : Effect.fail(new EngineError("Failed to submit job", 0))
+        )
+      ),
+
+    readFile: (path) =>
+      runTask(
+        () => Bridge.readFileAsync(path),
+        `Failed to read ${path}`,
+        Bridge.taskBytes
+      ),
+
+    // Interrupted before the handle is taken, the native task destroys the
+    // texture once it finishes
+    loadTexture: (path, width, height) =>
+      runTask(
+        () => Bridge.loadTextureAsync(path, width, height),
+        `Failed to load texture ${path}`,
+        Bridge.taskValue
+      ),
   })
 );
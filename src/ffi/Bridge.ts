@@ -1,6 +1,14 @@
-import { dlopen, ptr, CString } from "bun:ffi";
+import { dlopen, ptr, toArrayBuffer, CString } from "bun:ffi";
 import { resolve, dirname } from "path";
-import { engineSymbols } from "./types";
+import {
+  engineSymbols,
+  INSTANCE_STRIDE,
+  LIGHT_STRIDE,
+  TRANSFORM_FLOATS,
+  JobKind,
+  type CullMode,
+  type TaskStatus,
+} from "./types";
 
 function getLibraryPath(): string {
   const scriptDir = dirname(Bun.main);
@@ -40,6 +48,18 @@ export const Bridge = {
     return getLib().symbols.engine_init(ptr(titleBuf), width, height);
   },
 
+  // "#" and an index ("#1"), UUID or name substring ("llvmpipe"); empty
+  // restores scoring.
+  // Takes effect at the next init and overrides HXO_GPU.
+  setPreferredDevice(device: string): void {
+    const deviceBuf = new TextEncoder().encode(device + "\0");
+    getLib().symbols.engine_set_preferred_device(ptr(deviceBuf));
+  },
+
+  deviceReport(): string {
+    return String(getLib().symbols.engine_device_report());
+  },
+
   shutdown(): void {
     getLib().symbols.engine_shutdown();
   },
@@ -60,6 +80,296 @@ export const Bridge = {
     return getLib().symbols.engine_handle_resize();
   },
 
+  createTexture(
+    pixels: ArrayBuffer | ArrayBufferView,
+    width: number,
+    height: number
+  ): number {
+    const bytes = ArrayBuffer.isView(pixels)
+      ? new Uint8Array(pixels.buffer, pixels.byteOffset, pixels.byteLength)
+      : new Uint8Array(pixels);
+    if (bytes.byteLength < width * height * 4) {
+      return 0;
+    }
+    return getLib().symbols.engine_create_texture(ptr(bytes), width, height);
+  },
+
+  destroyTexture(handle: number): void {
+    getLib().symbols.engine_destroy_texture(handle);
+  },
+
+  bindlessEnabled(): boolean {
+    return getLib().symbols.engine_bindless_enabled();
+  },
+
+  asyncComputeEnabled(): boolean {
+    return getLib().symbols.engine_async_compute_enabled();
+  },
+
+  dynamicRenderingEnabled(): boolean {
+    return getLib().symbols.engine_dynamic_rendering_enabled();
+  },
+
+  setDepthPrepass(enabled: boolean): void {
+    getLib().symbols.engine_set_depth_prepass(enabled);
+  },
+
+  // Returns the sample count in use after clamping, 0 on failure
+  setMsaaSamples(samples: number): number {
+    return getLib().symbols.engine_set_msaa_samples(samples);
+  },
+
+  // targetMs <= 0 turns dynamic resolution off
+  setDynamicResolution(minScale: number, maxScale: number, targetMs: number): number {
+    return getLib().symbols.engine_set_dynamic_resolution(minScale, maxScale, targetMs);
+  },
+
+  // scale <= 0 turns temporal upscaling off
+  setTemporalUpscaling(scale: number): number {
+    return getLib().symbols.engine_set_temporal_upscaling(scale);
+  },
+
+  // effects is a combination of PostEffect bits, 0 for none
+  setPostEffects(effects: number): number {
+    return getLib().symbols.engine_set_post_effects(effects);
+  },
+
+  setPostParams(exposure: number, contrast: number, saturation: number, vignette: number): void {
+    getLib().symbols.engine_set_post_params(exposure, contrast, saturation, vignette);
+  },
+
+  renderScale(): number {
+    return getLib().symbols.engine_render_scale();
+  },
+
+  gpuFrameTime(): number {
+    return getLib().symbols.engine_gpu_frame_time();
+  },
+
+  setCamera(view: Float32Array, proj: Float32Array): void {
+    getLib().symbols.engine_set_camera(ptr(view), ptr(proj));
+  },
+
+  // `instances` holds `count` packed EngineInstance records (INSTANCE_STRIDE bytes each)
+  setInstances(instances: ArrayBufferView, count: number): void {
+    const max = Math.floor(instances.byteLength / INSTANCE_STRIDE);
+    const n = Math.min(count, max);
+    getLib().symbols.engine_set_instances(n > 0 ? ptr(instances) : null, n);
+  },
+
+  setCullMode(mode: CullMode): number {
+    return getLib().symbols.engine_set_cull_mode(mode);
+  },
+
+  setCullDistance(distance: number): void {
+    getLib().symbols.engine_set_cull_distance(distance);
+  },
+
+  // `lights` holds `count` packed EngineLight records (LIGHT_STRIDE bytes each)
+  setLights(lights: ArrayBufferView, count: number): void {
+    const max = Math.floor(lights.byteLength / LIGHT_STRIDE);
+    const n = Math.min(count, max);
+    getLib().symbols.engine_set_lights(n > 0 ? ptr(lights) : null, n);
+  },
+
+  setAmbientLight(r: number, g: number, b: number): void {
+    getLib().symbols.engine_set_ambient_light(r, g, b);
+  },
+
+  setDirectionalLight(
+    direction: readonly [number, number, number],
+    color: readonly [number, number, number]
+  ): void {
+    getLib().symbols.engine_set_directional_light(
+      direction[0], direction[1], direction[2], color[0], color[1], color[2]
+    );
+  },
+
+  setShadows(resolution: number, distance: number, farInterval: number): void {
+    getLib().symbols.engine_set_shadows(resolution, distance, farInterval);
+  },
+
+  setOit(enabled: boolean): number {
+    return getLib().symbols.engine_set_oit(enabled);
+  },
+
+  createNode(parent: number): number {
+    return getLib().symbols.engine_scene_create_node(parent);
+  },
+
+  destroyNode(node: number): void {
+    getLib().symbols.engine_scene_destroy_node(node);
+  },
+
+  setParent(node: number, parent: number): boolean {
+    return getLib().symbols.engine_scene_set_parent(node, parent);
+  },
+
+  // `transforms` holds TRANSFORM_FLOATS floats per entry of `nodes`
+  setNodeTransforms(nodes: Uint32Array, transforms: Float32Array): void {
+    const n = Math.min(
+      nodes.length,
+      Math.floor(transforms.length / TRANSFORM_FLOATS)
+    );
+    if (n === 0) return;
+    getLib().symbols.engine_scene_set_transforms(ptr(nodes), ptr(transforms), n);
+  },
+
+  bindNodeInstance(node: number, instance: number): boolean {
+    return getLib().symbols.engine_scene_bind_instance(node, instance);
+  },
+
+  getWorldMatrix(node: number, out: Float32Array): boolean {
+    if (out.length < 16) return false;
+    return getLib().symbols.engine_scene_get_world_matrix(node, ptr(out));
+  },
+
+  registerComponent(size: number): number {
+    return getLib().symbols.engine_ecs_register_component(size);
+  },
+
+  createEntities(mask: bigint, count: number): Uint32Array {
+    const out = new Uint32Array(count);
+    if (count === 0) return out;
+    const n = getLib().symbols.engine_ecs_create_entities(mask, count, ptr(out));
+    return out.subarray(0, n);
+  },
+
+  destroyEntities(entities: Uint32Array): void {
+    if (entities.length === 0) return;
+    getLib().symbols.engine_ecs_destroy_entities(ptr(entities), entities.length);
+  },
+
+  addComponents(entities: Uint32Array, mask: bigint): void {
+    if (entities.length === 0) return;
+    getLib().symbols.engine_ecs_add_components(ptr(entities), entities.length, mask);
+  },
+
+  removeComponents(entities: Uint32Array, mask: bigint): void {
+    if (entities.length === 0) return;
+    getLib().symbols.engine_ecs_remove_components(ptr(entities), entities.length, mask);
+  },
+
+  flushEntities(): void {
+    getLib().symbols.engine_ecs_flush();
+  },
+
+  entityAlive(entity: number): boolean {
+    return getLib().symbols.engine_ecs_alive(entity);
+  },
+
+  ecsVersion(): number {
+    return getLib().symbols.engine_ecs_version();
+  },
+
+  // Ids of chunks holding every component in mask
+  queryChunks(mask: bigint): Uint32Array {
+    const symbols = getLib().symbols;
+    const total = symbols.engine_ecs_query(mask, null, 0);
+    const out = new Uint32Array(total);
+    if (total > 0) symbols.engine_ecs_query(mask, ptr(out), total);
+    return out;
+  },
+
+  chunkRows(chunk: number): number {
+    return getLib().symbols.engine_ecs_chunk_rows(chunk);
+  },
+
+  // Views over native chunk memory, valid until the ECS version changes. Only
+  // the first chunkRows(chunk) rows are live.
+  chunkEntities(chunk: number): Uint32Array | null {
+    const symbols = getLib().symbols;
+    const p = symbols.engine_ecs_chunk_entities(chunk);
+    if (!p) return null;
+    const capacity = symbols.engine_ecs_chunk_capacity(chunk);
+    return new Uint32Array(toArrayBuffer(p, 0, capacity * 4));
+  },
+
+  chunkColumn(chunk: number, component: number): ArrayBuffer | null {
+    const symbols = getLib().symbols;
+    const p = symbols.engine_ecs_chunk_column(chunk, component);
+    if (!p) return null;
+    const capacity = symbols.engine_ecs_chunk_capacity(chunk);
+    const size = symbols.engine_ecs_component_size(component);
+    return toArrayBuffer(p, 0, capacity * size);
+  },
+
+  // Report writes through chunkColumn views; native systems skip clean chunks
+  markChunkDirty(chunk: number): void {
+    getLib().symbols.engine_ecs_mark_dirty(chunk);
+  },
+
+  // Inputs and output must not be touched until jobDone/waitJob reports completion
+  submitJob(
+    kind: JobKind,
+    a: Float32Array,
+    b: Float32Array | null,
+    out: Float32Array
+  ): number {
+    const inputFloats = kind === JobKind.Mat4Multiply ? 16 : TRANSFORM_FLOATS;
+    let count = Math.min(
+      Math.floor(a.length / inputFloats),
+      Math.floor(out.length / 16)
+    );
+    if (b) count = Math.min(count, Math.floor(b.length / 16));
+    if (count === 0) return 0;
+    return getLib().symbols.engine_jobs_submit(
+      kind,
+      ptr(a),
+      b ? ptr(b) : null,
+      ptr(out),
+      count
+    );
+  },
+
+  jobDone(job: number): boolean {
+    return getLib().symbols.engine_jobs_done(job);
+  },
+
+  waitJob(job: number): void {
+    getLib().symbols.engine_jobs_wait(job);
+  },
+
+  jobThreadCount(): number {
+    return getLib().symbols.engine_jobs_thread_count();
+  },
+
+  readFileAsync(path: string): number {
+    const pathBuf = new TextEncoder().encode(path + "\0");
+    return getLib().symbols.engine_task_read_file(ptr(pathBuf));
+  },
+
+  // The file holds width * height raw RGBA8 pixels
+  loadTextureAsync(path: string, width: number, height: number): number {
+    const pathBuf = new TextEncoder().encode(path + "\0");
+    return getLib().symbols.engine_task_load_texture(ptr(pathBuf), width, height);
+  },
+
+  pollTasks(): void {
+    getLib().symbols.engine_task_poll();
+  },
+
+  taskStatus(task: number): TaskStatus {
+    return getLib().symbols.engine_task_status(task) as TaskStatus;
+  },
+
+  taskValue(task: number): number {
+    return getLib().symbols.engine_task_value(task);
+  },
+
+  taskBytes(task: number): Uint8Array {
+    const size = getLib().symbols.engine_task_result_size(task);
+    const bytes = new Uint8Array(size);
+    if (size > 0) {
+      getLib().symbols.engine_task_copy_result(task, ptr(bytes), size);
+    }
+    return bytes;
+  },
+
+  releaseTask(task: number): void {
+    getLib().symbols.engine_task_release(task);
+  },
+
   close(): void {
     if (lib) {
       lib.close();
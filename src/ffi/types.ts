@@ -1,6 +1,14 @@
 import type { FFIType } from "bun:ffi";
 
 export const engineSymbols = {
+  engine_set_preferred_device: {
+    args: ["cstring"] as const,
+    returns: "void" as FFIType,
+  },
+  engine_device_report: {
+    args: [] as const,
+    returns: "cstring" as FFIType,
+  },
   engine_init: {
     args: ["cstring", "i32", "i32"] as const,
     returns: "i32" as FFIType,
@@ -25,6 +33,291 @@ export const engineSymbols = {
     args: [] as const,
     returns: "i32" as FFIType,
   },
+  engine_create_texture: {
+    args: ["ptr", "u32", "u32"] as const,
+    returns: "u32" as FFIType,
+  },
+  engine_destroy_texture: {
+    args: ["u32"] as const,
+    returns: "void" as FFIType,
+  },
+  engine_bindless_enabled: {
+    args: [] as const,
+    returns: "bool" as FFIType,
+  },
+  engine_async_compute_enabled: {
+    args: [] as const,
+    returns: "bool" as FFIType,
+  },
+  engine_dynamic_rendering_enabled: {
+    args: [] as const,
+    returns: "bool" as FFIType,
+  },
+  engine_set_depth_prepass: {
+    args: ["bool"] as const,
+    returns: "void" as FFIType,
+  },
+  engine_set_msaa_samples: {
+    args: ["u32"] as const,
+    returns: "u32" as FFIType,
+  },
+  engine_set_dynamic_resolution: {
+    args: ["f32", "f32", "f32"] as const,
+    returns: "i32" as FFIType,
+  },
+  engine_set_temporal_upscaling: {
+    args: ["f32"] as const,
+    returns: "i32" as FFIType,
+  },
+  engine_set_post_effects: {
+    args: ["u32"] as const,
+    returns: "i32" as FFIType,
+  },
+  engine_set_post_params: {
+    args: ["f32", "f32", "f32", "f32"] as const,
+    returns: "void" as FFIType,
+  },
+  engine_render_scale: {
+    args: [] as const,
+    returns: "f32" as FFIType,
+  },
+  engine_gpu_frame_time: {
+    args: [] as const,
+    returns: "f32" as FFIType,
+  },
+  engine_set_camera: {
+    args: ["ptr", "ptr"] as const,
+    returns: "void" as FFIType,
+  },
+  engine_set_instances: {
+    args: ["ptr", "u32"] as const,
+    returns: "void" as FFIType,
+  },
+  engine_set_cull_mode: {
+    args: ["i32"] as const,
+    returns: "i32" as FFIType,
+  },
+  engine_set_cull_distance: {
+    args: ["f32"] as const,
+    returns: "void" as FFIType,
+  },
+  engine_set_lights: {
+    args: ["ptr", "u32"] as const,
+    returns: "void" as FFIType,
+  },
+  engine_set_ambient_light: {
+    args: ["f32", "f32", "f32"] as const,
+    returns: "void" as FFIType,
+  },
+  engine_set_directional_light: {
+    args: ["f32", "f32", "f32", "f32", "f32", "f32"] as const,
+    returns: "void" as FFIType,
+  },
+  engine_set_shadows: {
+    args: ["u32", "f32", "u32"] as const,
+    returns: "void" as FFIType,
+  },
+  engine_set_oit: {
+    args: ["bool"] as const,
+    returns: "i32" as FFIType,
+  },
+  engine_scene_create_node: {
+    args: ["u32"] as const,
+    returns: "u32" as FFIType,
+  },
+  engine_scene_destroy_node: {
+    args: ["u32"] as const,
+    returns: "void" as FFIType,
+  },
+  engine_scene_set_parent: {
+    args: ["u32", "u32"] as const,
+    returns: "bool" as FFIType,
+  },
+  engine_scene_set_transforms: {
+    args: ["ptr", "ptr", "u32"] as const,
+    returns: "void" as FFIType,
+  },
+  engine_scene_bind_instance: {
+    args: ["u32", "u32"] as const,
+    returns: "bool" as FFIType,
+  },
+  engine_scene_get_world_matrix: {
+    args: ["u32", "ptr"] as const,
+    returns: "bool" as FFIType,
+  },
+  engine_ecs_register_component: {
+    args: ["u32"] as const,
+    returns: "u32" as FFIType,
+  },
+  engine_ecs_component_size: {
+    args: ["u32"] as const,
+    returns: "u32" as FFIType,
+  },
+  engine_ecs_create_entities: {
+    args: ["u64", "u32", "ptr"] as const,
+    returns: "u32" as FFIType,
+  },
+  engine_ecs_destroy_entities: {
+    args: ["ptr", "u32"] as const,
+    returns: "void" as FFIType,
+  },
+  engine_ecs_add_components: {
+    args: ["ptr", "u32", "u64"] as const,
+    returns: "void" as FFIType,
+  },
+  engine_ecs_remove_components: {
+    args: ["ptr", "u32", "u64"] as const,
+    returns: "void" as FFIType,
+  },
+  engine_ecs_flush: {
+    args: [] as const,
+    returns: "void" as FFIType,
+  },
+  engine_ecs_alive: {
+    args: ["u32"] as const,
+    returns: "bool" as FFIType,
+  },
+  engine_ecs_version: {
+    args: [] as const,
+    returns: "u32" as FFIType,
+  },
+  engine_ecs_query: {
+    args: ["u64", "ptr", "u32"] as const,
+    returns: "u32" as FFIType,
+  },
+  engine_ecs_chunk_rows: {
+    args: ["u32"] as const,
+    returns: "u32" as FFIType,
+  },
+  engine_ecs_chunk_capacity: {
+    args: ["u32"] as const,
+    returns: "u32" as FFIType,
+  },
+  engine_ecs_chunk_entities: {
+    args: ["u32"] as const,
+    returns: "ptr" as FFIType,
+  },
+  engine_ecs_chunk_column: {
+    args: ["u32", "u32"] as const,
+    returns: "ptr" as FFIType,
+  },
+  engine_ecs_mark_dirty: {
+    args: ["u32"] as const,
+    returns: "void" as FFIType,
+  },
+  engine_jobs_submit: {
+    args: ["i32", "ptr", "ptr", "ptr", "u32"] as const,
+    returns: "u32" as FFIType,
+  },
+  engine_jobs_done: {
+    args: ["u32"] as const,
+    returns: "bool" as FFIType,
+  },
+  engine_jobs_wait: {
+    args: ["u32"] as const,
+    returns: "void" as FFIType,
+  },
+  engine_jobs_thread_count: {
+    args: [] as const,
+    returns: "u32" as FFIType,
+  },
+  engine_task_read_file: {
+    args: ["cstring"] as const,
+    returns: "u32" as FFIType,
+  },
+  engine_task_load_texture: {
+    args: ["cstring", "u32", "u32"] as const,
+    returns: "u32" as FFIType,
+  },
+  engine_task_poll: {
+    args: [] as const,
+    returns: "void" as FFIType,
+  },
+  engine_task_status: {
+    args: ["u32"] as const,
+    returns: "i32" as FFIType,
+  },
+  engine_task_value: {
+    args: ["u32"] as const,
+    returns: "u32" as FFIType,
+  },
+  engine_task_result_size: {
+    args: ["u32"] as const,
+    returns: "u32" as FFIType,
+  },
+  engine_task_copy_result: {
+    args: ["u32", "ptr", "u32"] as const,
+    returns: "u32" as FFIType,
+  },
+  engine_task_release: {
+    args: ["u32"] as const,
+    returns: "void" as FFIType,
+  },
 } as const;
 
 export type EngineSymbols = typeof engineSymbols;
+
+// Byte size of one EngineInstance (engine.h): mat4 model, vec4 color,
+// u32 texture, u32 flags, 2 x u32 reserved
+export const INSTANCE_STRIDE = 96;
+export const INSTANCE_FLOATS = INSTANCE_STRIDE / 4;
+
+// EngineInstance flag bits (ENGINE_INSTANCE_* in engine.h)
+export const InstanceFlag = {
+  Static: 1,
+  Transparent: 2,
+} as const;
+
+// Byte size of one EngineLight (engine.h): vec3 position, radius,
+// vec3 color, intensity
+export const LIGHT_STRIDE = 32;
+export const LIGHT_FLOATS = LIGHT_STRIDE / 4;
+
+// Floats per node in engine_scene_set_transforms: translation xyz,
+// rotation quaternion xyzw, scale xyz
+export const TRANSFORM_FLOATS = 10;
+
+// engine_scene_bind_instance target that unbinds the node
+export const NO_INSTANCE = 0xffffffff;
+
+// Built-in ECS component ids (ENGINE_COMPONENT_* in engine.h)
+export const Component = {
+  Instance: 0,
+  Transform: 1,
+} as const;
+
+export const INVALID_COMPONENT = 0xffffffff;
+
+// Bulk job kinds for engine_jobs_submit (ENGINE_JOB_* in engine.h)
+export const JobKind = {
+  Mat4Multiply: 0,
+  ComposeTransforms: 1,
+} as const;
+
+export type JobKind = (typeof JobKind)[keyof typeof JobKind];
+
+// Cull modes for engine_set_cull_mode (ENGINE_CULL_* in engine.h)
+export const CullMode = {
+  None: 0,
+  Gpu: 1,
+  Cpu: 2,
+} as const;
+
+export type CullMode = (typeof CullMode)[keyof typeof CullMode];
+
+// Post-process effect bits for engine_set_post_effects (ENGINE_POST_* in
+// engine.h), applied in this order
+export const PostEffect = {
+  Tonemap: 1,
+  ColorGrade: 2,
+  Vignette: 4,
+} as const;
+
+// Async task states from engine_task_status (ENGINE_TASK_* in engine.h)
+export const TaskStatus = {
+  Pending: 0,
+  Done: 1,
+  Failed: 2,
+} as const;
+
+export type TaskStatus = (typeof TaskStatus)[keyof typeof TaskStatus];
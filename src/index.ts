@@ -1,2 +1,16 @@
 export { Bridge } from "./ffi/Bridge";
 export { EngineService, EngineServiceLive, EngineError } from "./engine/Engine";
+export {
+  INSTANCE_STRIDE,
+  INSTANCE_FLOATS,
+  InstanceFlag,
+  LIGHT_STRIDE,
+  LIGHT_FLOATS,
+  TRANSFORM_FLOATS,
+  NO_INSTANCE,
+  CullMode,
+  Component,
+  JobKind,
+  PostEffect,
+  TaskStatus,
+} from "./ffi/types";